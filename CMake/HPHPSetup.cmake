@@ -1,6 +1,7 @@
 OPTION(INFINITE_LOOP_DETECTION "Enable Infinite Loop Detection" ON)
 OPTION(INFINITE_RECURSION_DETECTION "Enable Infinite Recursion Detection" ON)
 OPTION(REQUEST_TIMEOUT_DETECTION "Enable Timeout Detection" ON)
+OPTION(REFCOUNT_STATS "Count refcount operations per request" OFF)
 
 include(HPHPFunctions)
 include(HPHPFindLibs)
@@ -13,6 +14,10 @@ add_definitions(-DRELEASE=1)
 # eable the OSS options if we have any
 add_definitions(-DHPHP_OSS=1)
 
+if (REFCOUNT_STATS)
+	add_definitions(-DREFCOUNT_STATS=1)
+endif()
+
 set(HPHP_OPT "-O3")
 
 set(CMAKE_C_FLAGS "${HPHP_OPT} -w -fPIC")
@@ -37,6 +37,8 @@
 #include <compiler/statement/loop_statement.h>
 #include <compiler/statement/exp_statement.h>
 #include <compiler/analysis/alias_manager.h>
+#include <compiler/analysis/control_flow.h>
+#include <compiler/expression/constant_expression.h>
 #include <compiler/analysis/variable_table.h>
 #include <compiler/parser/hphp.tab.hpp>
 #include <util/util.h>
@@ -50,6 +52,7 @@ using std::string;
 bool AliasManager::s_deadCodeElim = true;
 bool AliasManager::s_localCopyProp = true;
 bool AliasManager::s_stringOpts = true;
+bool AliasManager::s_globalOpts = false;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -73,6 +76,8 @@ bool AliasManager::parseOptimizations(const std::string &optimizations,
       setLocalCopyProp(val);
     } else if (opt == "string") {
       setStringOpts(val);
+    } else if (opt == "global") {
+      setGlobalOpts(val);
     } else if (val && (opt == "all" || opt == "none")) {
       val = opt == "all";
       setDeadCodeElim(val);
@@ -1069,6 +1074,7 @@ bool AliasManager::optimize(AnalysisResultPtr ar, MethodStatementPtr m) {
   }
 
   if (doLocalCopyProp() || doDeadCodeElim()) {
+    if (doGlobalOpts()) globalOptimize(m);
     canonicalizeRecur(m->getStmts());
   }
 
@@ -1098,6 +1104,266 @@ bool AliasManager::optimize(AnalysisResultPtr ar, MethodStatementPtr m) {
   return m_changed;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// global optimizations
+
+static bool isConstantValue(ExpressionPtr e) {
+  if (e->is(Expression::KindOfScalarExpression)) return true;
+  if (e->is(Expression::KindOfConstantExpression)) {
+    ConstantExpressionPtr c = spc(ConstantExpression, e);
+    return c->isBoolean() || c->isNull();
+  }
+  return false;
+}
+
+static bool isSameConstant(ExpressionPtr e1, ExpressionPtr e2) {
+  if (e1 == e2) return true;
+  if (e1->getKindOf() != e2->getKindOf()) return false;
+  if (e1->is(Expression::KindOfScalarExpression)) {
+    ScalarExpressionPtr s1 = spc(ScalarExpression, e1);
+    ScalarExpressionPtr s2 = spc(ScalarExpression, e2);
+    return s1->getType() == s2->getType() &&
+      s1->getString() == s2->getString();
+  }
+  ConstantExpressionPtr c1 = spc(ConstantExpression, e1);
+  ConstantExpressionPtr c2 = spc(ConstantExpression, e2);
+  if (c1->isNull() || c2->isNull()) return c1->isNull() && c2->isNull();
+  return c1->getBooleanValue() == c2->getBooleanValue();
+}
+
+/**
+ * Whether a variable read in this position can become a literal.
+ */
+static bool canReplaceUse(const VariableAccess &use) {
+  if (use.exp->getContext() & ~(Expression::AssignmentRHS |
+                                Expression::CondExpr |
+                                Expression::NoRefWrapper |
+                                Expression::NoLValueWrapper)) {
+    return false;
+  }
+  if (StatementPtr s = dpc(Statement, use.parent)) {
+    switch (s->getKindOf()) {
+    case Statement::KindOfExpStatement:
+    case Statement::KindOfReturnStatement:
+    case Statement::KindOfIfBranchStatement:
+    case Statement::KindOfWhileStatement:
+    case Statement::KindOfDoStatement:
+    case Statement::KindOfForStatement:
+    case Statement::KindOfSwitchStatement:
+    case Statement::KindOfCaseStatement:
+      return true;
+    default:
+      return false;
+    }
+  }
+  ExpressionPtr e = spc(Expression, use.parent);
+  switch (e->getKindOf()) {
+  case Expression::KindOfExpressionList:
+  case Expression::KindOfQOpExpression:
+  case Expression::KindOfArrayPairExpression:
+    return true;
+  case Expression::KindOfAssignmentExpression:
+    return use.kid == 1;
+  case Expression::KindOfBinaryOpExpression:
+    return spc(BinaryOpExpression, e)->getOp() != T_INSTANCEOF;
+  case Expression::KindOfUnaryOpExpression:
+    switch (spc(UnaryOpExpression, e)->getOp()) {
+    case T_INC:
+    case T_DEC:
+    case T_ISSET:
+    case T_EMPTY:
+    case T_UNSET:
+    case T_CLONE:
+      return false;
+    default:
+      return true;
+    }
+  default:
+    return false;
+  }
+}
+
+/**
+ * Whether dropping this assignment can't change when a destructor runs.
+ */
+static bool canRemoveStore(const VariableAccess &def) {
+  if (def.exp->getContext() & (Expression::DeadStore |
+                               Expression::LValue |
+                               Expression::RefValue |
+                               Expression::RefParameter |
+                               Expression::InvokeArgument)) {
+    return false;
+  }
+  if (isConstantValue(def.value)) return true;
+  TypePtr type = def.value->getActualType();
+  return type && type->isNoObjectInvolved();
+}
+
+void AliasManager::globalOptimize(MethodStatementPtr m) {
+  if (m_wildRefs ||
+      m_variables->isPseudoMainTable() ||
+      m_variables->getAttribute(VariableTable::ContainsDynamicVariable) ||
+      m_variables->getAttribute(VariableTable::ContainsExtract) ||
+      m_variables->getAttribute(VariableTable::ContainsCompact) ||
+      m_variables->getAttribute(VariableTable::ContainsGetDefinedVars)) {
+    return;
+  }
+  FunctionScopePtr func = m_arp->getFunctionScope();
+  if (!func) return;
+
+  std::map<string, int> vars;
+  for (AliasInfoMap::iterator it = m_aliasInfo.begin(),
+         end = m_aliasInfo.end(); it != end; ++it) {
+    AliasInfo &ai = it->second;
+    if (ai.getIsGlobal() || ai.getIsRefTo() || ai.getRefLevels() ||
+        (ai.getIsParam() && func->isVariableArgument()) ||
+        it->first == "this" || m_variables->isSuperGlobal(it->first)) {
+      continue;
+    }
+    int index = vars.size();
+    vars[it->first] = index;
+  }
+  if (vars.empty()) return;
+
+  ControlFlowGraphPtr cfg = ControlFlowGraph::Build(m);
+  if (!cfg) return;
+
+  std::vector<VariableAccessVec> accesses(cfg->getBlockCount());
+  for (int i = 0; i < cfg->getBlockCount(); i++) {
+    DataFlow::CollectAccesses(cfg->getBlock(i), vars, accesses[i]);
+  }
+  if (doLocalCopyProp()) {
+    propagateConstants(*cfg, vars.size(), accesses);
+  }
+  if (doDeadCodeElim()) {
+    removeDeadStores(*cfg, vars.size(), accesses);
+  }
+}
+
+/**
+ * Reaching definitions: one bit per def, plus one per variable for the
+ * value it has on entry. A use reached only by defs assigning the same
+ * literal is replaced by that literal; folding and dead branch removal
+ * then take it from there on next iteration.
+ */
+void AliasManager::propagateConstants
+(const ControlFlowGraph &cfg, int varCount,
+ const std::vector<VariableAccessVec> &accesses) {
+  std::vector<const VariableAccess *> defs(varCount);
+  for (unsigned int i = 0; i < accesses.size(); i++) {
+    for (unsigned int j = 0; j < accesses[i].size(); j++) {
+      if (accesses[i][j].kind == VariableAccess::Def) {
+        defs.push_back(&accesses[i][j]);
+      }
+    }
+  }
+  if (defs.size() == (size_t)varCount) return;
+
+  std::vector<DataFlow::BitVec> varDefs(varCount,
+                                        DataFlow::BitVec(defs.size()));
+  for (unsigned int i = 0; i < defs.size(); i++) {
+    varDefs[i < (unsigned int)varCount ? i : defs[i]->var].set(i);
+  }
+
+  DataFlow df(cfg, defs.size(), DataFlow::Forward, DataFlow::Union);
+  DataFlow::BitVec entry(defs.size());
+  for (int i = 0; i < varCount; i++) entry.set(i);
+  df.setBoundary(entry);
+  unsigned int id = varCount;
+  for (unsigned int i = 0; i < accesses.size(); i++) {
+    DataFlow::BitVec &gen = df.gen(i);
+    DataFlow::BitVec &kill = df.kill(i);
+    for (unsigned int j = 0; j < accesses[i].size(); j++) {
+      const VariableAccess &access = accesses[i][j];
+      if (access.kind != VariableAccess::Def) continue;
+      if (!access.may) {
+        gen -= varDefs[access.var];
+        kill |= varDefs[access.var];
+      }
+      gen.set(id++);
+    }
+  }
+  df.solve();
+
+  id = varCount;
+  for (unsigned int i = 0; i < accesses.size(); i++) {
+    if (!df.isReachable(i)) {
+      for (unsigned int j = 0; j < accesses[i].size(); j++) {
+        if (accesses[i][j].kind == VariableAccess::Def) id++;
+      }
+      continue;
+    }
+    DataFlow::BitVec reaching = df.in(i);
+    for (unsigned int j = 0; j < accesses[i].size(); j++) {
+      const VariableAccess &access = accesses[i][j];
+      if (access.kind == VariableAccess::Def) {
+        if (!access.may) reaching -= varDefs[access.var];
+        reaching.set(id++);
+        continue;
+      }
+      if (!canReplaceUse(access)) continue;
+
+      DataFlow::BitVec from = reaching & varDefs[access.var];
+      ExpressionPtr value;
+      size_t d = from.find_first();
+      for (; d != DataFlow::BitVec::npos; d = from.find_next(d)) {
+        ExpressionPtr v = defs[d] ? defs[d]->value : ExpressionPtr();
+        if (!v || !isConstantValue(v) ||
+            (value && !isSameConstant(value, v))) {
+          break;
+        }
+        value = v;
+      }
+      if (value && d == DataFlow::BitVec::npos) {
+        access.parent->setNthKid(access.kid, value->clone());
+        m_changed = true;
+      }
+    }
+  }
+}
+
+/**
+ * Liveness: one bit per variable. Plain assignments of values that can't
+ * hold objects are marked as dead stores when nothing reads the variable
+ * afterwards, and canonicalizeRecur() reduces them to their values.
+ */
+void AliasManager::removeDeadStores
+(const ControlFlowGraph &cfg, int varCount,
+ const std::vector<VariableAccessVec> &accesses) {
+  DataFlow df(cfg, varCount, DataFlow::Backward, DataFlow::Union);
+  for (unsigned int i = 0; i < accesses.size(); i++) {
+    DataFlow::BitVec &gen = df.gen(i);
+    DataFlow::BitVec &kill = df.kill(i);
+    for (unsigned int j = accesses[i].size(); j--; ) {
+      const VariableAccess &access = accesses[i][j];
+      if (access.kind == VariableAccess::Use) {
+        gen.set(access.var);
+      } else if (!access.may) {
+        gen.reset(access.var);
+        kill.set(access.var);
+      }
+    }
+  }
+  df.solve();
+
+  for (unsigned int i = 0; i < accesses.size(); i++) {
+    if (!df.isReachable(i)) continue;
+    DataFlow::BitVec live = df.out(i);
+    for (unsigned int j = accesses[i].size(); j--; ) {
+      const VariableAccess &access = accesses[i][j];
+      if (access.kind == VariableAccess::Use) {
+        live.set(access.var);
+        continue;
+      }
+      if (access.value && !live.test(access.var) && canRemoveStore(access)) {
+        access.exp->setContext(Expression::DeadStore);
+        m_changed = true;
+      }
+      if (!access.may) live.reset(access.var);
+    }
+  }
+}
+
 AliasManager::LoopInfo::LoopInfo(StatementPtr s) :
   m_stmt(s), m_valid(!s->is(Statement::KindOfSwitchStatement)) {
 }
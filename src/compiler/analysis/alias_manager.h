@@ -18,6 +18,7 @@
 #define __ALIAS_MANAGER_H__
 
 #include <compiler/expression/expression.h>
+#include <compiler/analysis/data_flow.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -89,9 +90,11 @@ class AliasManager {
   static bool doLocalCopyProp() { return s_localCopyProp; }
   static bool doDeadCodeElim() { return s_deadCodeElim; }
   static bool doStringOpts() { return s_stringOpts; }
+  static bool doGlobalOpts() { return s_globalOpts; }
   static void setLocalCopyProp(bool f) { s_localCopyProp = f; }
   static void setDeadCodeElim(bool f) { s_deadCodeElim = f; }
   static void setStringOpts(bool f) { s_stringOpts = f; }
+  static void setGlobalOpts(bool f) { s_globalOpts = f; }
 
   static bool parseOptimizations(const std::string &optimizations,
                                  std::string &errs);
@@ -148,6 +151,16 @@ class AliasManager {
   void stringOptsRecur(StatementPtr s);
   void stringOptsRecur(ExpressionPtr s, bool ok);
 
+  /**
+   * Constant propagation and dead store elimination across basic blocks,
+   * for local variables that can only be accessed by name.
+   */
+  void globalOptimize(MethodStatementPtr m);
+  void propagateConstants(const ControlFlowGraph &cfg, int varCount,
+                          const std::vector<VariableAccessVec> &accesses);
+  void removeDeadStores(const ControlFlowGraph &cfg, int varCount,
+                        const std::vector<VariableAccessVec> &accesses);
+
   BucketMap             m_bucketMap;
   CondStack             m_stack;
 
@@ -168,6 +181,7 @@ class AliasManager {
   static bool           s_deadCodeElim;
   static bool           s_localCopyProp;
   static bool           s_stringOpts;
+  static bool           s_globalOpts;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
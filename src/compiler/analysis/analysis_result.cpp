@@ -21,6 +21,7 @@
 #include <compiler/analysis/code_error.h>
 #include <compiler/statement/statement_list.h>
 #include <compiler/statement/if_branch_statement.h>
+#include <compiler/statement/function_statement.h>
 #include <compiler/analysis/symbol_table.h>
 #include <util/logger.h>
 #include <compiler/package.h>
@@ -36,6 +37,7 @@
 #include <compiler/expression/constant_expression.h>
 #include <compiler/expression/expression_list.h>
 #include <compiler/expression/array_pair_expression.h>
+#include <compiler/expression/parameter_expression.h>
 #include <util/process.h>
 #include <runtime/base/rtti_info.h>
 #include <runtime/ext/ext_json.h>
@@ -857,6 +859,18 @@ void AnalysisResult::getTrueDeps(FileScopePtr f,
   }
 }
 
+void AnalysisResult::getFileDependencies(map<string, set<string> > &deps) {
+  BOOST_FOREACH(FileScopePtr f, m_fileScopes) {
+    map<string, FileScopePtr> trueDeps;
+    getTrueDeps(f, trueDeps);
+    set<string> &names = deps[f->getName()];
+    for (map<string, FileScopePtr>::const_iterator iter = trueDeps.begin();
+         iter != trueDeps.end(); ++iter) {
+      names.insert(iter->first);
+    }
+  }
+}
+
 void AnalysisResult::clusterByFileSizes(StringToFileScopePtrVecMap &clusters,
                                         int clusterCount) {
   ASSERT(clusterCount > 0);
@@ -894,6 +908,60 @@ void AnalysisResult::clusterByFileSizes(StringToFileScopePtrVecMap &clusters,
   }
 }
 
+void AnalysisResult::clusterByPrevious(StringToFileScopePtrVecMap &clusters,
+                                       int clusterCount) {
+  ASSERT(clusterCount > 0);
+
+  std::map<std::string, FileScopePtr> sortedFiles;
+  long totalSize = 0;
+  BOOST_FOREACH(FileScopePtr f, m_fileScopes) {
+    totalSize += f->getSize();
+    sortedFiles[f->getName()] = f;
+  }
+  int clusterSize = totalSize / clusterCount;
+
+  // files that were built before stay where they were
+  map<string, long> sizes;
+  for (int i = 1; i <= clusterCount; i++) {
+    sizes[Option::FormatClusterFile(i)] = 0;
+  }
+  FileScopePtrVec newFiles;
+  for (std::map<std::string, FileScopePtr>::const_iterator iter =
+         sortedFiles.begin(); iter != sortedFiles.end(); ++iter) {
+    FileScopePtr f = iter->second;
+    map<string, string>::const_iterator prev = m_clusters.find(f->getName());
+    if (prev == m_clusters.end()) {
+      newFiles.push_back(f);
+    } else {
+      clusters[prev->second].push_back(f);
+      sizes[prev->second] += f->getSize();
+    }
+  }
+
+  // new files go to the smallest cluster, or their own if they are large
+  int count = sizes.size();
+  for (unsigned int i = 0; i < newFiles.size(); i++) {
+    FileScopePtr f = newFiles[i];
+    string clusterName;
+    if (f->getSize() > clusterSize) {
+      do {
+        clusterName = Option::FormatClusterFile(++count);
+      } while (sizes.find(clusterName) != sizes.end());
+    } else {
+      long smallest = -1;
+      for (map<string, long>::const_iterator iter = sizes.begin();
+           iter != sizes.end(); ++iter) {
+        if (smallest < 0 || iter->second < smallest) {
+          smallest = iter->second;
+          clusterName = iter->first;
+        }
+      }
+    }
+    clusters[clusterName].push_back(f);
+    sizes[clusterName] += f->getSize();
+  }
+}
+
 void AnalysisResult::repartitionCPP(const string &filename, int64 targetSize,
                                     bool insideHPHP) {
   struct stat results;
@@ -1018,7 +1086,18 @@ void AnalysisResult::outputAllCPP(CodeGenerator::Output output,
   FileScopePtrVec trueDeps;
   StringToFileScopePtrVecMap clusters;
   if (clusterCount > 0) {
-    clusterByFileSizes(clusters, clusterCount);
+    if (m_clusters.empty()) {
+      clusterByFileSizes(clusters, clusterCount);
+    } else {
+      clusterByPrevious(clusters, clusterCount);
+    }
+    m_clusters.clear();
+    for (StringToFileScopePtrVecMap::const_iterator iter = clusters.begin();
+         iter != clusters.end(); ++iter) {
+      BOOST_FOREACH(FileScopePtr f, iter->second) {
+        m_clusters[f->getName()] = iter->first;
+      }
+    }
   } else {
     BOOST_FOREACH(FileScopePtr f, m_fileScopes) {
       clusters[f->outputFilebase()].push_back(f);
@@ -1354,7 +1433,16 @@ void AnalysisResult::outputRTTIMetaData(const char *filename) {
     throw Exception("Unable to open %s: %s", filename,
                     Util::safe_strerror(errno).c_str());
   }
+  fprintf(f, "%s\n", RTTIInfo::MetaDataVersion);
   fprintf(f, "%d\n", m_paramRTTICounter);
+  vector<const string *> params(m_paramRTTICounter);
+  for (map<string, int>::const_iterator
+         iter = m_paramRTTIs.begin(); iter != m_paramRTTIs.end(); ++iter) {
+    params[iter->second] = &iter->first;
+  }
+  for (int i = 0; i < m_paramRTTICounter; i++) {
+    fprintf(f, "%s\n", params[i]->c_str());
+  }
   for (set<string>::const_iterator
        iter = m_rttiFuncs.begin(); iter != m_rttiFuncs.end(); ++iter) {
     fprintf(f, "%s\n", iter->c_str());
@@ -2681,7 +2769,7 @@ void AnalysisResult::outputHSFFIStubs() {
     for (StringToFunctionScopePtrVecMap::const_iterator it = fns.begin();
          it != fns.end(); ++it) {
       BOOST_FOREACH(FunctionScopePtr func, it->second) {
-        if (func->inPseudoMain()) continue;
+        if (func->inPseudoMain() || func->isRTTISpecialization()) continue;
         if (first) {
           first = false;
         } else {
@@ -2927,39 +3015,169 @@ void AnalysisResult::addRTTIFunction(const std::string &id) {
   m_rttiFuncs.insert(id);
 }
 
-void AnalysisResult::cloneRTTIFuncs
-(ClassScopePtr cls, const StringToFunctionScopePtrVecMap &functions) {
-  for (StringToFunctionScopePtrVecMap::const_iterator iter =
-       functions.begin(); iter != functions.end(); ++iter) {
-    for (unsigned int j = 0; j < iter->second.size(); j++) {
-      FunctionScopePtr func = iter->second[j];
-      const string funcId = getFuncId(cls, func);
-      if (RTTIInfo::TheRTTIInfo.exists(funcId.c_str())) {
-        StatementPtr stmt = func->getStmt();
-        func->setStmtCloned(stmt->clone());
-      }
-    }
+static bool can_clone(ConstructPtr c) {
+  if (!c) return true;
+  StatementPtr s = dynamic_pointer_cast<Statement>(c);
+  if (s && (s->is(Statement::KindOfFunctionStatement) ||
+            s->is(Statement::KindOfClassStatement) ||
+            s->is(Statement::KindOfInterfaceStatement) ||
+            // a clone would have its own static variables
+            s->is(Statement::KindOfStaticStatement))) {
+    return false;
+  }
+  for (int i = 0; i < c->getKidCount(); i++) {
+    if (!can_clone(c->getNthKid(i))) return false;
+  }
+  return true;
+}
+
+/**
+ * The type a parameter had in at least Option::RTTIDominantTypeRatio
+ * percent of profiled calls, if any.
+ */
+static TypePtr get_dominant_type(const unsigned int *counter,
+                                 unsigned int &total) {
+  unsigned int counts[5];
+  TypePtr types[5] = {
+    Type::Boolean, Type::Int64, Type::Double, Type::String, Type::Array
+  };
+  counts[0] = counter[getDataTypeIndex(KindOfBoolean)];
+  counts[1] = counter[getDataTypeIndex(KindOfByte)] +
+              counter[getDataTypeIndex(KindOfInt16)] +
+              counter[getDataTypeIndex(KindOfInt32)] +
+              counter[getDataTypeIndex(KindOfInt64)];
+  counts[2] = counter[getDataTypeIndex(KindOfDouble)];
+  counts[3] = counter[getDataTypeIndex(LiteralString)] +
+              counter[getDataTypeIndex(KindOfStaticString)] +
+              counter[getDataTypeIndex(KindOfString)];
+  counts[4] = counter[getDataTypeIndex(KindOfArray)];
+
+  total = 0;
+  for (int i = 0; i < MaxNumDataTypes; i++) total += counter[i];
+  if (total == 0) return TypePtr();
+
+  int best = 0;
+  for (int i = 1; i < 5; i++) {
+    if (counts[i] > counts[best]) best = i;
+  }
+  if ((uint64)counts[best] * 100 <
+      (uint64)total * Option::RTTIDominantTypeRatio) {
+    return TypePtr();
+  }
+  return types[best];
+}
+
+bool AnalysisResult::cloneRTTIFunc(FileScopePtr fs, int index) {
+  StatementListPtr tree = fs->getStmt();
+  FunctionStatementPtr stmt =
+    dynamic_pointer_cast<FunctionStatement>((*tree)[index]);
+  if (!stmt) return false;
+  FunctionScopePtr func = stmt->getFunctionScope();
+  if (!func || func->inPseudoMain() || func->isRedeclaring() ||
+      stmt->isRef() || !stmt->getParams()) {
+    return false;
   }
+  const string funcId = getFuncId(ClassScopePtr(), func);
+  if (!RTTIInfo::TheRTTIInfo.exists(funcId.c_str())) return false;
+
+  ExpressionListPtr params = stmt->getParams();
+  vector<TypePtr> types(params->getCount());
+  unsigned int calls = 0;
+  bool specialized = false;
+  for (int i = 0; i < params->getCount(); i++) {
+    ParameterExpressionPtr param =
+      dynamic_pointer_cast<ParameterExpression>((*params)[i]);
+    if (param->isRef() || param->isOptional()) continue;
+    const unsigned int *counter = RTTIInfo::TheRTTIInfo.getParamCounter
+      (getParamRTTIEntryKey(ClassScopePtr(), func, param->getName()));
+    if (!counter) continue;
+    unsigned int total;
+    types[i] = get_dominant_type(counter, total);
+    if (types[i]) specialized = true;
+    if (total > calls) calls = total;
+  }
+  if (!specialized || calls < (unsigned int)Option::RTTIHotCallCount ||
+      !can_clone(stmt->getStmts())) {
+    return false;
+  }
+
+  // only the C++ name changes: the clone keeps original name, which is what
+  // __FUNCTION__, its frame in backtraces and error messages use
+  FunctionStatementPtr clone =
+    dynamic_pointer_cast<FunctionStatement>(stmt->clone());
+  clone->setName(stmt->getName() + "$rtti");
+  ExpressionListPtr cloneParams = clone->getParams();
+  for (int i = 0; i < cloneParams->getCount(); i++) {
+    if (!types[i]) continue;
+    ParameterExpressionPtr param =
+      dynamic_pointer_cast<ParameterExpression>((*cloneParams)[i]);
+    param->setSpecializedType(types[i]);
+  }
+  pushScope(fs);
+  clone->onParseRTTIClone(shared_from_this());
+  popScope();
+
+  clone->setFileLevel();
+  tree->insertElement(clone, index + 1);
+  func->setRTTISpecialization(clone->getFunctionScope());
+  // guard calls the clone, which has to be declared by then
+  func->disableInline();
+  return true;
 }
 
 void AnalysisResult::cloneRTTIFuncs(const char *RTTIDirectory) {
-  RTTIInfo::TheRTTIInfo.loadMetaData(Option::RTTIOutputFile.c_str());
-  RTTIInfo::TheRTTIInfo.loadProfData(RTTIDirectory);
+  if (!RTTIInfo::TheRTTIInfo.loadMetaData(Option::RTTIOutputFile.c_str())) {
+    return;
+  }
+  if (!RTTIInfo::TheRTTIInfo.loadProfData(RTTIDirectory)) {
+    Logger::Warning("no RTTI profile data in %s", RTTIDirectory);
+    return;
+  }
 
+  int count = 0;
   for (unsigned int i = 0; i < m_fileScopes.size(); i++) {
-    // standalone rtti functions
-    cloneRTTIFuncs(ClassScopePtr(), m_fileScopes[i]->getFunctions());
-
-    // class rtti methods
-    for (StringToClassScopePtrVecMap::const_iterator iter =
-         m_fileScopes[i]->getClasses().begin();
-         iter != m_fileScopes[i]->getClasses().end(); ++iter) {
-      for (unsigned int j = 0; j < iter->second.size(); j++) {
-        ClassScopePtr cls = iter->second[j];
-        cloneRTTIFuncs(cls, cls->getFunctions());
+    StatementListPtr tree = m_fileScopes[i]->getStmt();
+    if (!tree) continue;
+    for (int j = 0; j < tree->getCount(); j++) {
+      if (cloneRTTIFunc(m_fileScopes[i], j)) {
+        count++;
+        j++; // skipping the clone
       }
     }
   }
+  Logger::Info("%d functions specialized by RTTI profile", count);
+}
+
+void AnalysisResult::recordInlineDecision(ExpressionPtr call,
+                                          FunctionScopePtr func,
+                                          const char *decision) {
+  ostringstream site;
+  LocationPtr loc = call->getLocation();
+  if (loc) {
+    site << loc->file << ":" << loc->line0 << ":" << loc->char0;
+  }
+  FunctionScopePtr caller = getFunctionScope();
+  site << "\t" << (caller ? caller->getOriginalName() : "")
+       << "\t" << func->getOriginalName();
+  m_inlineDecisions[site.str()] = decision;
+}
+
+bool AnalysisResult::saveInlineReport(const std::string &filename) const {
+  ofstream f(filename.c_str());
+  if (!f) {
+    Logger::Error("unable to write %s", filename.c_str());
+    return false;
+  }
+  int inlined = 0;
+  for (map<string, string>::const_iterator iter = m_inlineDecisions.begin();
+       iter != m_inlineDecisions.end(); ++iter) {
+    f << iter->first << "\t" << iter->second << "\n";
+    if (iter->second == "inlined") inlined++;
+  }
+  f.close();
+  Logger::Info("inlined %d of %d calls to user functions", inlined,
+               (int)m_inlineDecisions.size());
+  return true;
 }
 
 void AnalysisResult::outputCPPLiteralStringPrecomputation() {
@@ -188,6 +188,19 @@ public:
                     const std::string *compileDir);
   void outputAllCPP(CodeGenerator &cg); // mainly for unit test
 
+  /**
+   * File to cluster assignment. When set before outputAllCPP(), files keep
+   * the clusters they had in a previous build, and only new files are
+   * placed by size, so editing one file doesn't reshuffle every cluster.
+   * outputAllCPP() fills it with the assignment it actually used.
+   */
+  void setClusters(const std::map<std::string, std::string> &clusters) {
+    m_clusters = clusters;
+  }
+  const std::map<std::string, std::string> &getClusters() const {
+    return m_clusters;
+  }
+
   void outputCPPSystemImplementations(CodeGenerator &cg);
   void outputCPPFileRunDecls(CodeGenerator &cg);
   void outputCPPFileRunImpls(CodeGenerator &cg);
@@ -263,6 +276,13 @@ public:
                              const std::string &constantName);
   void addCallee(StatementPtr stmt);
 
+  /**
+   * File level dependencies collected by the functions above, as
+   * file name => names of files it uses.
+   */
+  void getFileDependencies(std::map<std::string,
+                           std::set<std::string> > &deps);
+
   /**
    * Find class by that name, and update class name if it's "self" or
    * "parent".
@@ -329,8 +349,25 @@ public:
                           FunctionScopePtr func,
                           const std::string &paramName);
   void addRTTIFunction(const std::string &id);
+
+  /**
+   * Profile-guided specialization: each standalone function that was called
+   * at least Option::RTTIHotCallCount times gets a clone, in which every
+   * parameter that mostly had one type at runtime is compiled with that
+   * type. The original function checks these types first and calls the
+   * clone when they match, and runs as is otherwise. Has to be called
+   * before analyzeProgram().
+   */
   void cloneRTTIFuncs(const char *RTTIDirectory);
 
+  /**
+   * Why each call to a user function was or wasn't inlined by
+   * FunctionInliner. The report has one line per call site.
+   */
+  void recordInlineDecision(ExpressionPtr call, FunctionScopePtr func,
+                            const char *decision);
+  bool saveInlineReport(const std::string &filename) const;
+
   /**
    * For global state output
    */
@@ -388,6 +425,7 @@ private:
   std::map<std::string, int> m_paramRTTIs;
   std::set<std::string> m_rttiFuncs;
   int m_paramRTTICounter;
+  std::map<std::string, std::string> m_inlineDecisions;
 
   bool m_insideScalarArray;
   bool m_inExpression;
@@ -418,6 +456,9 @@ private:
                    std::map<std::string, FileScopePtr> &trueDeps);
   void clusterByFileSizes(StringToFileScopePtrVecMap &clusters,
                           int clusterCount);
+  void clusterByPrevious(StringToFileScopePtrVecMap &clusters,
+                         int clusterCount);
+  std::map<std::string, std::string> m_clusters;
 
   std::map<std::string, std::map<int, LocationPtr> > m_sourceInfos;
   std::map<std::string, std::set<std::string> > m_clsNameMap;
@@ -499,8 +540,7 @@ private:
   void outputCPPSepExtensionMake();
   void outputCPPSepExtensionIncludes(CodeGenerator &cg);
 
-  void cloneRTTIFuncs(ClassScopePtr cls,
-                      const StringToFunctionScopePtrVecMap &functions);
+  bool cloneRTTIFunc(FileScopePtr fs, int index);
 
   AnalysisResultPtr shared_from_this() {
     return boost::static_pointer_cast<AnalysisResult>
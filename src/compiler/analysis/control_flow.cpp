@@ -0,0 +1,294 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/control_flow.h>
+#include <compiler/statement/statement_list.h>
+#include <compiler/statement/method_statement.h>
+#include <compiler/statement/break_statement.h>
+
+#define spc(T,p) boost::static_pointer_cast<T>(p)
+
+using namespace HPHP;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+ConstructPtr ControlItem::get() const {
+  return m_kid < 0 ? m_parent : m_parent->getNthKid(m_kid);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ControlFlowGraphPtr ControlFlowGraph::Build(MethodStatementPtr m) {
+  ControlFlowGraphPtr cfg(new ControlFlowGraph());
+  cfg->newBlock(); // Entry
+  cfg->newBlock(); // Exit
+  int end = cfg->build(m->getStmts(), Entry);
+  cfg->addEdge(end, Exit);
+  if (!cfg->m_valid) return ControlFlowGraphPtr();
+  return cfg;
+}
+
+int ControlFlowGraph::newBlock() {
+  int id = m_blocks.size();
+  m_blocks.push_back(ControlBlockPtr(new ControlBlock(id, m_tryDepth > 0)));
+  return id;
+}
+
+void ControlFlowGraph::addEdge(int from, int to) {
+  vector<int> &succs = m_blocks[from]->m_succs;
+  if (find(succs.begin(), succs.end(), to) == succs.end()) {
+    succs.push_back(to);
+    m_blocks[to]->m_preds.push_back(from);
+  }
+}
+
+void ControlFlowGraph::addItem(int block, ConstructPtr parent, int kid) {
+  if (kid < 0 || parent->getNthKid(kid)) {
+    m_blocks[block]->m_items.push_back(ControlItem(parent, kid));
+  }
+}
+
+void ControlFlowGraph::getReversePostOrder(vector<int> &order) const {
+  vector<bool> visited(m_blocks.size());
+  vector<pair<int, unsigned int> > stack; // block, next successor
+  stack.push_back(make_pair((int)Entry, 0U));
+  visited[Entry] = true;
+  while (!stack.empty()) {
+    int id = stack.back().first;
+    const vector<int> &succs = m_blocks[id]->m_succs;
+    if (stack.back().second < succs.size()) {
+      int succ = succs[stack.back().second++];
+      if (!visited[succ]) {
+        visited[succ] = true;
+        stack.push_back(make_pair(succ, 0U));
+      }
+    } else {
+      order.push_back(id);
+      stack.pop_back();
+    }
+  }
+  reverse(order.begin(), order.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int ControlFlowGraph::build(StatementPtr s, int cur) {
+  if (!s) return cur;
+
+  switch (s->getKindOf()) {
+  case Statement::KindOfFunctionStatement:
+  case Statement::KindOfClassStatement:
+  case Statement::KindOfInterfaceStatement:
+    // declarations, their bodies are separate graphs
+    return cur;
+
+  case Statement::KindOfStatementList:
+  case Statement::KindOfBlockStatement:
+    for (int i = 0, n = s->getKidCount(); i < n; i++) {
+      cur = build(spc(Statement, s->getNthKid(i)), cur);
+    }
+    return cur;
+
+  case Statement::KindOfExpStatement:
+  case Statement::KindOfEchoStatement:
+  case Statement::KindOfUnsetStatement:
+  case Statement::KindOfGlobalStatement:
+  case Statement::KindOfStaticStatement:
+    addItem(cur, s, 0);
+    return cur;
+
+  case Statement::KindOfReturnStatement:
+  case Statement::KindOfThrowStatement:
+    // a throw inside try reaches catches through the try's edges
+    addItem(cur, s, 0);
+    addEdge(cur, Exit);
+    return newBlock();
+
+  case Statement::KindOfBreakStatement:
+    return buildJump(s, cur, true);
+  case Statement::KindOfContinueStatement:
+    return buildJump(s, cur, false);
+
+  case Statement::KindOfIfStatement: {
+    StatementPtr branches = spc(Statement, s->getNthKid(0));
+    vector<int> ends;
+    int test = cur;
+    bool hasElse = false;
+    for (int i = 0, n = branches ? branches->getKidCount() : 0; i < n; i++) {
+      StatementPtr branch = spc(Statement, branches->getNthKid(i));
+      StatementPtr stmt = spc(Statement, branch->getNthKid(1));
+      if (!branch->getNthKid(0)) {
+        ends.push_back(build(stmt, test));
+        hasElse = true;
+        break;
+      }
+      addItem(test, branch, 0);
+      int then = newBlock();
+      addEdge(test, then);
+      ends.push_back(build(stmt, then));
+      int next = newBlock();
+      addEdge(test, next);
+      test = next;
+    }
+    int after = newBlock();
+    if (!hasElse) addEdge(test, after);
+    for (unsigned int i = 0; i < ends.size(); i++) {
+      addEdge(ends[i], after);
+    }
+    return after;
+  }
+
+  case Statement::KindOfWhileStatement: {
+    int head = newBlock();
+    addEdge(cur, head);
+    addItem(head, s, 0);
+    int body = newBlock();
+    int after = newBlock();
+    addEdge(head, body);
+    addEdge(head, after);
+    m_loops.push_back(LoopTargets(after, head));
+    int end = build(spc(Statement, s->getNthKid(1)), body);
+    m_loops.pop_back();
+    addEdge(end, head);
+    return after;
+  }
+
+  case Statement::KindOfDoStatement: {
+    int body = newBlock();
+    addEdge(cur, body);
+    int test = newBlock();
+    int after = newBlock();
+    m_loops.push_back(LoopTargets(after, test));
+    int end = build(spc(Statement, s->getNthKid(0)), body);
+    m_loops.pop_back();
+    addEdge(end, test);
+    addItem(test, s, 1);
+    addEdge(test, body);
+    addEdge(test, after);
+    return after;
+  }
+
+  case Statement::KindOfForStatement: {
+    addItem(cur, s, 0);
+    int head = newBlock();
+    addEdge(cur, head);
+    addItem(head, s, 1);
+    int body = newBlock();
+    int after = newBlock();
+    int next = newBlock();
+    addEdge(head, body);
+    if (s->getNthKid(1)) addEdge(head, after);
+    m_loops.push_back(LoopTargets(after, next));
+    int end = build(spc(Statement, s->getNthKid(2)), body);
+    m_loops.pop_back();
+    addEdge(end, next);
+    addItem(next, s, 3);
+    addEdge(next, head);
+    return after;
+  }
+
+  case Statement::KindOfForEachStatement: {
+    addItem(cur, s, 0);
+    int head = newBlock();
+    addEdge(cur, head);
+    int body = newBlock();
+    int after = newBlock();
+    addEdge(head, body);
+    addEdge(head, after);
+    addItem(body, s, 1); // key
+    addItem(body, s, 2); // value
+    m_loops.push_back(LoopTargets(after, head));
+    int end = build(spc(Statement, s->getNthKid(3)), body);
+    m_loops.pop_back();
+    addEdge(end, head);
+    return after;
+  }
+
+  case Statement::KindOfSwitchStatement: {
+    addItem(cur, s, 0);
+    StatementPtr cases = spc(Statement, s->getNthKid(1));
+    int n = cases ? cases->getKidCount() : 0;
+    vector<int> entries;
+    for (int i = 0; i < n; i++) {
+      entries.push_back(newBlock());
+    }
+    int after = newBlock();
+    int test = cur;
+    int dflt = after;
+    for (int i = 0; i < n; i++) {
+      StatementPtr c = spc(Statement, cases->getNthKid(i));
+      if (!c->getNthKid(0)) {
+        dflt = entries[i];
+        continue;
+      }
+      addItem(test, c, 0);
+      addEdge(test, entries[i]);
+      int next = newBlock();
+      addEdge(test, next);
+      test = next;
+    }
+    addEdge(test, dflt);
+    m_loops.push_back(LoopTargets(after, after));
+    for (int i = 0; i < n; i++) {
+      StatementPtr c = spc(Statement, cases->getNthKid(i));
+      int end = build(spc(Statement, c->getNthKid(1)), entries[i]);
+      addEdge(end, i + 1 < n ? entries[i + 1] : after);
+    }
+    m_loops.pop_back();
+    return after;
+  }
+
+  case Statement::KindOfTryStatement: {
+    int first = m_blocks.size();
+    m_tryDepth++;
+    int body = newBlock();
+    addEdge(cur, body);
+    int end = build(spc(Statement, s->getNthKid(0)), body);
+    m_tryDepth--;
+    int last = m_blocks.size();
+    int after = newBlock();
+    addEdge(end, after);
+
+    StatementPtr catches = spc(Statement, s->getNthKid(1));
+    for (int i = 0, n = catches ? catches->getKidCount() : 0; i < n; i++) {
+      StatementPtr c = spc(Statement, catches->getNthKid(i));
+      int entry = newBlock();
+      for (int b = first; b < last; b++) {
+        addEdge(b, entry);
+      }
+      addItem(entry, c, -1);
+      addEdge(build(spc(Statement, c->getNthKid(0)), entry), after);
+    }
+    return after;
+  }
+
+  default:
+    m_valid = false;
+    return cur;
+  }
+}
+
+int ControlFlowGraph::buildJump(StatementPtr s, int cur, bool isBreak) {
+  int64 depth = spc(BreakStatement, s)->getDepth();
+  if (depth <= 0 || depth > (int64)m_loops.size()) {
+    m_valid = false;
+  } else {
+    const LoopTargets &loop = m_loops[m_loops.size() - depth];
+    addEdge(cur, isBreak ? loop.breakBlock : loop.continueBlock);
+  }
+  return newBlock();
+}
@@ -0,0 +1,132 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __CONTROL_FLOW_H__
+#define __CONTROL_FLOW_H__
+
+#include <compiler/hphp.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(Construct);
+DECLARE_BOOST_TYPES(Statement);
+DECLARE_BOOST_TYPES(MethodStatement);
+DECLARE_BOOST_TYPES(ControlBlock);
+DECLARE_BOOST_TYPES(ControlFlowGraph);
+
+/**
+ * One step of a basic block: kid "kid" of "parent", an expression that is
+ * evaluated as a whole. Expressions with their own control flow (&&, ||,
+ * ?:) are not split up, so a walker has to treat what is under their
+ * conditional operands as maybe executed. A CatchStatement with kid -1
+ * stands for binding the exception to catch variable.
+ */
+class ControlItem {
+public:
+  ControlItem(ConstructPtr parent, int kid) : m_parent(parent), m_kid(kid) {}
+
+  ConstructPtr getParent() const { return m_parent;}
+  int getKid() const { return m_kid;}
+  ConstructPtr get() const;
+
+private:
+  ConstructPtr m_parent;
+  int m_kid;
+};
+
+class ControlBlock {
+public:
+  ControlBlock(int id, bool inTry) : m_id(id), m_inTry(inTry) {}
+
+  int getId() const { return m_id;}
+
+  /**
+   * Whether an exception thrown in the middle of this block can land in a
+   * catch of the same function. Such a block has an edge to every catch
+   * that may handle it, but walkers should not assume that a store in it
+   * kills earlier ones.
+   */
+  bool inTry() const { return m_inTry;}
+
+  const std::vector<ControlItem> &getItems() const { return m_items;}
+  const std::vector<int> &getSuccs() const { return m_succs;}
+  const std::vector<int> &getPreds() const { return m_preds;}
+
+private:
+  friend class ControlFlowGraph;
+
+  int m_id;
+  bool m_inTry;
+  std::vector<ControlItem> m_items;
+  std::vector<int> m_succs;
+  std::vector<int> m_preds;
+};
+
+/**
+ * Basic blocks of one function or method body, built from its AST. Block 0
+ * is the entry and block 1 is the exit every return leads to. Blocks refer
+ * back to AST nodes, so optimizations computed on the graph are applied to
+ * the AST directly, and nothing has to be lowered for CodeGenerator.
+ */
+class ControlFlowGraph {
+public:
+  enum { Entry = 0, Exit = 1 };
+
+  /**
+   * Returns null when the body has control flow that is not modeled, e.g.
+   * break or continue with a non-constant depth.
+   */
+  static ControlFlowGraphPtr Build(MethodStatementPtr m);
+
+  int getBlockCount() const { return m_blocks.size();}
+  const ControlBlock &getBlock(int id) const { return *m_blocks[id];}
+
+  /**
+   * Reachable blocks in reverse postorder, the fastest order to visit them
+   * for a forward problem. Reverse it for a backward one.
+   */
+  void getReversePostOrder(std::vector<int> &order) const;
+
+private:
+  struct LoopTargets {
+    LoopTargets(int b, int c) : breakBlock(b), continueBlock(c) {}
+    int breakBlock;
+    int continueBlock;
+  };
+
+  ControlBlockPtrVec m_blocks;
+  std::vector<LoopTargets> m_loops;
+  int m_tryDepth;
+  bool m_valid;
+
+  ControlFlowGraph() : m_tryDepth(0), m_valid(true) {}
+
+  int newBlock();
+  void addEdge(int from, int to);
+  void addItem(int block, ConstructPtr parent, int kid);
+
+  /**
+   * Appends statement to block "cur", and returns the block where control
+   * continues after it.
+   */
+  int build(StatementPtr s, int cur);
+  int buildJump(StatementPtr s, int cur, bool isBreak);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+#endif // __CONTROL_FLOW_H__
@@ -0,0 +1,254 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/data_flow.h>
+#include <compiler/expression/simple_variable.h>
+#include <compiler/expression/assignment_expression.h>
+#include <compiler/expression/binary_op_expression.h>
+#include <compiler/statement/catch_statement.h>
+#include <compiler/parser/hphp.tab.hpp>
+
+#define spc(T,p) boost::static_pointer_cast<T>(p)
+
+using namespace HPHP;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+class AccessCollector {
+public:
+  AccessCollector(const map<string, int> &vars, bool inTry,
+                  VariableAccessVec &accesses)
+    : m_vars(vars), m_inTry(inTry), m_accesses(accesses) {}
+
+  void walk(ConstructPtr parent, int kid, bool may);
+  void catchVariable(CatchStatementPtr c);
+
+private:
+  const map<string, int> &m_vars;
+  bool m_inTry;
+  VariableAccessVec &m_accesses;
+
+  int find(const std::string &name) const {
+    map<string, int>::const_iterator iter = m_vars.find(name);
+    return iter == m_vars.end() ? -1 : iter->second;
+  }
+  void add(VariableAccess::Kind kind, int var, bool may, ExpressionPtr exp,
+           ExpressionPtr value, ConstructPtr parent, int kid);
+  void walkVariable(SimpleVariablePtr sv, ConstructPtr parent, int kid,
+                    bool may);
+};
+
+void AccessCollector::add(VariableAccess::Kind kind, int var, bool may,
+                          ExpressionPtr exp, ExpressionPtr value,
+                          ConstructPtr parent, int kid) {
+  VariableAccess access;
+  access.kind = kind;
+  access.var = var;
+  access.may = may || (kind == VariableAccess::Def && m_inTry);
+  access.exp = exp;
+  access.value = value;
+  access.parent = parent;
+  access.kid = kid;
+  m_accesses.push_back(access);
+}
+
+void AccessCollector::walkVariable(SimpleVariablePtr sv, ConstructPtr parent,
+                                   int kid, bool may) {
+  int var = find(sv->getName());
+  if (var < 0) return;
+
+  add(VariableAccess::Use, var, may, sv, ExpressionPtr(), parent, kid);
+
+  int context = sv->getContext();
+  if (context & (Expression::RefValue |
+                 Expression::RefParameter |
+                 Expression::InvokeArgument)) {
+    // whatever holds the reference may change it later, too
+    add(VariableAccess::Def, var, true, sv, ExpressionPtr(), parent, kid);
+  } else if (context & (Expression::LValue |
+                        Expression::AssignmentLHS |
+                        Expression::DeepAssignmentLHS |
+                        Expression::OprLValue |
+                        Expression::DeepOprLValue |
+                        Expression::UnsetContext)) {
+    add(VariableAccess::Def, var, may, sv, ExpressionPtr(), parent, kid);
+  }
+}
+
+void AccessCollector::walk(ConstructPtr parent, int kid, bool may) {
+  ExpressionPtr e = boost::dynamic_pointer_cast<Expression>
+    (parent->getNthKid(kid));
+  if (!e) return;
+
+  switch (e->getKindOf()) {
+  case Expression::KindOfSimpleVariable:
+    walkVariable(spc(SimpleVariable, e), parent, kid, may);
+    return;
+
+  case Expression::KindOfAssignmentExpression: {
+    AssignmentExpressionPtr ae = spc(AssignmentExpression, e);
+    ExpressionPtr var = ae->getVariable();
+    ExpressionPtr value = ae->getValue();
+    walk(e, 1, may);
+    int index;
+    if (var->is(Expression::KindOfSimpleVariable) &&
+        !(value->getContext() & Expression::RefValue) &&
+        (index = find(spc(SimpleVariable, var)->getName())) >= 0) {
+      add(VariableAccess::Def, index, may, e, value, parent, kid);
+    } else {
+      walk(e, 0, may);
+    }
+    return;
+  }
+
+  case Expression::KindOfListAssignment:
+    walk(e, 1, may);
+    walk(e, 0, may);
+    return;
+
+  case Expression::KindOfBinaryOpExpression: {
+    BinaryOpExpressionPtr b = spc(BinaryOpExpression, e);
+    switch (b->getOp()) {
+    case T_PLUS_EQUAL:
+    case T_MINUS_EQUAL:
+    case T_MUL_EQUAL:
+    case T_DIV_EQUAL:
+    case T_CONCAT_EQUAL:
+    case T_MOD_EQUAL:
+    case T_AND_EQUAL:
+    case T_OR_EQUAL:
+    case T_XOR_EQUAL:
+    case T_SL_EQUAL:
+    case T_SR_EQUAL:
+      walk(e, 1, may);
+      walk(e, 0, may);
+      return;
+    default:
+      walk(e, 0, may);
+      walk(e, 1, may || b->isShortCircuitOperator());
+      return;
+    }
+  }
+
+  case Expression::KindOfQOpExpression:
+    walk(e, 0, may);
+    walk(e, 1, true);
+    walk(e, 2, true);
+    return;
+
+  default:
+    for (int i = 0, n = e->getKidCount(); i < n; i++) {
+      walk(e, i, may);
+    }
+    return;
+  }
+}
+
+void AccessCollector::catchVariable(CatchStatementPtr c) {
+  int var = find(c->getVariable());
+  if (var >= 0) {
+    add(VariableAccess::Def, var, false, ExpressionPtr(), ExpressionPtr(),
+        c, -1);
+  }
+}
+
+}
+
+void DataFlow::CollectAccesses(const ControlBlock &block,
+                               const map<string, int> &vars,
+                               VariableAccessVec &accesses) {
+  AccessCollector collector(vars, block.inTry(), accesses);
+  const vector<ControlItem> &items = block.getItems();
+  for (unsigned int i = 0; i < items.size(); i++) {
+    const ControlItem &item = items[i];
+    if (item.getKid() < 0) {
+      collector.catchVariable(spc(CatchStatement, item.getParent()));
+    } else {
+      collector.walk(item.getParent(), item.getKid(), false);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DataFlow::DataFlow(const ControlFlowGraph &cfg, int width, Direction dir,
+                   Meet meet)
+  : m_cfg(cfg), m_dir(dir), m_meet(meet), m_boundary(width) {
+  int count = cfg.getBlockCount();
+  m_gen.resize(count, BitVec(width));
+  m_kill.resize(count, BitVec(width));
+  m_in.resize(count, BitVec(width));
+  m_out.resize(count, BitVec(width));
+  m_reachable.resize(count);
+}
+
+void DataFlow::solve() {
+  vector<int> order;
+  m_cfg.getReversePostOrder(order);
+  for (unsigned int i = 0; i < order.size(); i++) {
+    m_reachable[order[i]] = true;
+  }
+
+  bool forward = m_dir == Forward;
+  if (!forward) reverse(order.begin(), order.end());
+  vector<BitVec> &src = forward ? m_in : m_out;
+  vector<BitVec> &dst = forward ? m_out : m_in;
+  int boundary = forward ? ControlFlowGraph::Entry : ControlFlowGraph::Exit;
+
+  if (m_meet == Intersection) {
+    for (unsigned int i = 0; i < order.size(); i++) {
+      dst[order[i]].set();
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned int i = 0; i < order.size(); i++) {
+      int id = order[i];
+      const ControlBlock &block = m_cfg.getBlock(id);
+      BitVec &value = src[id];
+      if (id == boundary) {
+        value = m_boundary;
+      } else {
+        const vector<int> &from =
+          forward ? block.getPreds() : block.getSuccs();
+        bool first = true;
+        for (unsigned int j = 0; j < from.size(); j++) {
+          if (!m_reachable[from[j]]) continue;
+          if (first) {
+            value = dst[from[j]];
+            first = false;
+          } else if (m_meet == Union) {
+            value |= dst[from[j]];
+          } else {
+            value &= dst[from[j]];
+          }
+        }
+        if (first) value.reset();
+      }
+
+      BitVec result = m_gen[id] | (value - m_kill[id]);
+      if (result != dst[id]) {
+        dst[id] = result;
+        changed = true;
+      }
+    }
+  }
+}
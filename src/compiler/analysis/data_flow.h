@@ -0,0 +1,101 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __DATA_FLOW_H__
+#define __DATA_FLOW_H__
+
+#include <compiler/analysis/control_flow.h>
+#include <boost/dynamic_bitset.hpp>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(Expression);
+
+/**
+ * A read or a write of a local variable, recorded in the order they happen
+ * within a basic block.
+ */
+struct VariableAccess {
+  enum Kind { Use, Def };
+
+  Kind kind;
+  int var;              // index into the variables being tracked
+  bool may;             // a def that may not happen, or not completely
+  ExpressionPtr exp;    // the variable, or the assignment for plain defs
+  ExpressionPtr value;  // for plain defs ($var = value), the value
+  ConstructPtr parent;  // where exp hangs, so a use can be replaced
+  int kid;
+};
+typedef std::vector<VariableAccess> VariableAccessVec;
+
+/**
+ * Iterative solver for bit-vector dataflow problems over a control flow
+ * graph: each block's effect is out = gen | (in & ~kill) in the direction
+ * of the problem, and blocks are joined by union or intersection.
+ */
+class DataFlow {
+public:
+  typedef boost::dynamic_bitset<> BitVec;
+
+  enum Direction { Forward, Backward };
+  enum Meet { Union, Intersection };
+
+  /**
+   * Walks all items of a block and lists accesses to variables in "vars".
+   * Only SimpleVariables are tracked, so callers have to give up on bodies
+   * that may access variables by name.
+   */
+  static void CollectAccesses(const ControlBlock &block,
+                              const std::map<std::string, int> &vars,
+                              VariableAccessVec &accesses);
+
+public:
+  DataFlow(const ControlFlowGraph &cfg, int width, Direction dir, Meet meet);
+
+  BitVec &gen(int block) { return m_gen[block];}
+  BitVec &kill(int block) { return m_kill[block];}
+
+  /**
+   * Value flowing into entry block for forward problems, or out of exit
+   * block for backward ones. Empty by default.
+   */
+  void setBoundary(const BitVec &value) { m_boundary = value;}
+
+  void solve();
+
+  /**
+   * Results are only meaningful for blocks that can be reached from entry.
+   */
+  bool isReachable(int block) const { return m_reachable[block];}
+  const BitVec &in(int block) const { return m_in[block];}
+  const BitVec &out(int block) const { return m_out[block];}
+
+private:
+  const ControlFlowGraph &m_cfg;
+  Direction m_dir;
+  Meet m_meet;
+  BitVec m_boundary;
+  std::vector<BitVec> m_gen;
+  std::vector<BitVec> m_kill;
+  std::vector<BitVec> m_in;
+  std::vector<BitVec> m_out;
+  std::vector<bool> m_reachable;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+#endif // __DATA_FLOW_H__
@@ -46,6 +46,10 @@ bool FunctionContainer::addFunction(AnalysisResultPtr ar,
   return false;
 }
 
+void FunctionContainer::addUndeclaredFunction(FunctionScopePtr funcScope) {
+  m_functions[funcScope->getName()].push_back(funcScope);
+}
+
 void FunctionContainer::countReturnTypes(std::map<std::string, int> &counts) {
   for (StringToFunctionScopePtrVecMap::const_iterator iter =
          m_functions.begin(); iter != m_functions.end(); ++iter) {
@@ -48,6 +48,12 @@ public:
    */
   virtual bool addFunction(AnalysisResultPtr ar, FunctionScopePtr funcScope);
 
+  /**
+   * Adds a function that is generated with this container but never
+   * declared to the program, like profile-guided clones.
+   */
+  void addUndeclaredFunction(FunctionScopePtr funcScope);
+
   /**
    * Code generation functions.
    */
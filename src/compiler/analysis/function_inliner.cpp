@@ -0,0 +1,279 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/function_inliner.h>
+#include <compiler/analysis/analysis_result.h>
+#include <compiler/analysis/function_scope.h>
+#include <compiler/expression/expression_list.h>
+#include <compiler/expression/scalar_expression.h>
+#include <compiler/expression/constant_expression.h>
+#include <compiler/expression/simple_variable.h>
+#include <compiler/expression/unary_op_expression.h>
+#include <compiler/expression/binary_op_expression.h>
+#include <compiler/expression/array_pair_expression.h>
+#include <compiler/expression/array_element_expression.h>
+#include <compiler/expression/parameter_expression.h>
+#include <compiler/statement/method_statement.h>
+#include <compiler/statement/statement_list.h>
+#include <compiler/statement/return_statement.h>
+#include <compiler/parser/hphp.tab.hpp>
+#include <compiler/option.h>
+
+#define spc(T,p) boost::static_pointer_cast<T>(p)
+
+using namespace HPHP;
+using namespace std;
+using namespace boost;
+
+///////////////////////////////////////////////////////////////////////////////
+
+ExpressionPtr FunctionInliner::Inline(AnalysisResultPtr ar,
+                                      ExpressionPtr call,
+                                      FunctionScopePtr func,
+                                      ExpressionListPtr params) {
+  FunctionInliner inliner(func);
+  ExpressionPtr body;
+  ExpressionPtrVec args;
+  const char *reason = inliner.checkFunction(body);
+  if (!reason) reason = inliner.checkBody(body);
+  if (!reason && inliner.m_size > Option::PHPInlineThreshold) {
+    reason = "body too large";
+  }
+  if (!reason) reason = inliner.checkArguments(params, args);
+  if (!reason) {
+    int context = call->getContext();
+    if (context & (Expression::LValue | Expression::RefValue |
+                   Expression::RefParameter | Expression::OprLValue |
+                   Expression::ObjectContext | Expression::UnsetContext)) {
+      reason = "result used as reference";
+    }
+  }
+  if (reason) {
+    ar->recordInlineDecision(call, func, reason);
+    return ExpressionPtr();
+  }
+
+  ExpressionPtr exp = inliner.substitute(Construct::Clone(body), args,
+                                         call->getLocation());
+  // parentheses keep operator precedence of the body within the caller
+  ExpressionPtr ret(new UnaryOpExpression(call->getLocation(),
+                                          Expression::KindOfUnaryOpExpression,
+                                          exp, '(', true));
+  ret->setContext((Expression::Context)(call->getContext() &
+                                        (Expression::InvokeArgument |
+                                         Expression::AssignmentRHS |
+                                         Expression::CondExpr)));
+  ar->recordInlineDecision(call, func, "inlined");
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *FunctionInliner::checkFunction(ExpressionPtr &body) {
+  if (!m_func->isUserFunction() || m_func->isSepExtension()) {
+    return "not a user function";
+  }
+  if (m_func->isRedeclaring()) return "redeclared";
+  if (m_func->isVolatile()) return "conditionally declared";
+  if (m_func->isRefReturn()) return "returns by reference";
+  if (m_func->isVariableArgument()) return "variable arguments";
+  if (Option::DynamicInvokeFunctions.find(m_func->getName()) !=
+      Option::DynamicInvokeFunctions.end()) {
+    return "dynamically invoked";
+  }
+
+  MethodStatementPtr m = dynamic_pointer_cast<MethodStatement>
+    (m_func->getStmt());
+  if (!m) return "no body";
+  StatementListPtr stmts = m->getStmts();
+  if (!stmts || stmts->getCount() != 1 ||
+      !(*stmts)[0]->is(Statement::KindOfReturnStatement)) {
+    return "body is not a single return";
+  }
+  body = spc(ReturnStatement, (*stmts)[0])->getRetExp();
+  if (!body) return "body is not a single return";
+
+  ExpressionListPtr params = m->getParams();
+  int count = params ? params->getCount() : 0;
+  for (int i = 0; i < count; i++) {
+    ParameterExpressionPtr param =
+      dynamic_pointer_cast<ParameterExpression>((*params)[i]);
+    if (param->isRef()) return "by-ref parameter";
+    if (param->hasTypeHint()) return "type-hinted parameter";
+    ExpressionPtr value = param->defaultValue();
+    if (value && !value->is(Expression::KindOfScalarExpression) &&
+        !(value->is(Expression::KindOfConstantExpression) &&
+          value->isScalar())) {
+      return "non-scalar default value";
+    }
+    m_paramIndex[param->getName()] = i;
+  }
+  m_uses.resize(count);
+  return NULL;
+}
+
+const char *FunctionInliner::checkBody(ExpressionPtr e) {
+  if (!e) return NULL;
+  m_size++;
+  int firstConditional = e->getKidCount();
+
+  switch (e->getKindOf()) {
+  case Expression::KindOfScalarExpression:
+    switch (spc(ScalarExpression, e)->getType()) {
+    case T_LINE:
+    case T_FILE:
+    case T_CLASS_C:
+    case T_METHOD_C:
+    case T_FUNC_C:
+      return "magic constant";
+    default:
+      break;
+    }
+    return NULL;
+  case Expression::KindOfConstantExpression:
+    return NULL;
+  case Expression::KindOfSimpleVariable: {
+    map<string, int>::const_iterator iter =
+      m_paramIndex.find(spc(SimpleVariable, e)->getName());
+    if (iter == m_paramIndex.end()) return "uses a local variable";
+    ParamUse &use = m_uses[iter->second];
+    if (use.count++ == 0) use.order = m_reads;
+    m_reads++;
+    if (m_conditional) use.conditional = true;
+    return NULL;
+  }
+  case Expression::KindOfArrayElementExpression: {
+    ArrayElementExpressionPtr el = spc(ArrayElementExpression, e);
+    ExpressionPtr var = el->getVariable();
+    if (!var->is(Expression::KindOfSimpleVariable) || !el->getOffset()) {
+      return "complex array access";
+    }
+    if (const char *reason = checkBody(var)) return reason;
+    m_uses[m_paramIndex[spc(SimpleVariable, var)->getName()]].arrayBase =
+      true;
+    return checkBody(el->getOffset());
+  }
+  case Expression::KindOfBinaryOpExpression: {
+    BinaryOpExpressionPtr b = spc(BinaryOpExpression, e);
+    if ((b->getLocalEffects() & Construct::AssignEffect) ||
+        b->getOp() == T_INSTANCEOF) {
+      return "unsupported operator";
+    }
+    switch (b->getOp()) {
+    case T_BOOLEAN_AND:
+    case T_BOOLEAN_OR:
+    case T_LOGICAL_AND:
+    case T_LOGICAL_OR:
+      firstConditional = 1;
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+  case Expression::KindOfUnaryOpExpression:
+    switch (spc(UnaryOpExpression, e)->getOp()) {
+    case '!': case '+': case '-': case '~': case '(':
+    case T_ARRAY:
+    case T_BOOL_CAST:
+    case T_INT_CAST:
+    case T_DOUBLE_CAST:
+    case T_STRING_CAST:
+    case T_ARRAY_CAST:
+      break;
+    default:
+      return "unsupported operator";
+    }
+    break;
+  case Expression::KindOfArrayPairExpression:
+    if (spc(ArrayPairExpression, e)->isRef()) return "reference in array";
+    break;
+  case Expression::KindOfQOpExpression:
+    firstConditional = 1;
+    break;
+  case Expression::KindOfExpressionList:
+    break;
+  default:
+    return "calls or accesses objects";
+  }
+
+  // kids are in evaluation order, and the ones from firstConditional on
+  // may be skipped
+  for (int i = 0; i < e->getKidCount(); i++) {
+    if (i == firstConditional) m_conditional++;
+    ExpressionPtr kid = dynamic_pointer_cast<Expression>(e->getNthKid(i));
+    if (const char *reason = checkBody(kid)) return reason;
+  }
+  if (firstConditional < e->getKidCount()) m_conditional--;
+  return NULL;
+}
+
+const char *FunctionInliner::checkArguments(ExpressionListPtr params,
+                                            ExpressionPtrVec &args) {
+  int count = params ? params->getCount() : 0;
+  if (count > (int)m_uses.size()) return "too many arguments";
+  if (count < m_func->getMinParamCount()) return "too few arguments";
+
+  MethodStatementPtr m = dynamic_pointer_cast<MethodStatement>
+    (m_func->getStmt());
+  ExpressionListPtr decls = m->getParams();
+  int lastOrder = -1;
+  for (unsigned int i = 0; i < m_uses.size(); i++) {
+    ExpressionPtr arg;
+    if ((int)i < count) {
+      arg = (*params)[i];
+    } else {
+      arg = spc(ParameterExpression, (*decls)[i])->defaultValue();
+    }
+    if (arg->is(Expression::KindOfSimpleVariable)) {
+      // reading a variable may raise a notice, which has to happen once
+      // and in the same order as if arguments were evaluated by the call
+      if (m_uses[i].count != 1) return "variable argument not used once";
+      if (m_uses[i].conditional) return "variable argument used conditionally";
+      if (m_uses[i].order < lastOrder) return "arguments used out of order";
+      lastOrder = m_uses[i].order;
+    } else if (arg->is(Expression::KindOfScalarExpression) ||
+               (arg->is(Expression::KindOfConstantExpression) &&
+                arg->isScalar())) {
+      if (m_uses[i].arrayBase) return "scalar argument used as array";
+    } else {
+      return "non-trivial argument";
+    }
+    args.push_back(arg);
+  }
+  return NULL;
+}
+
+ExpressionPtr FunctionInliner::substitute(ExpressionPtr e,
+                                          const ExpressionPtrVec &args,
+                                          LocationPtr loc) {
+  if (e->is(Expression::KindOfSimpleVariable)) {
+    ExpressionPtr arg = args[m_paramIndex[spc(SimpleVariable, e)->getName()]];
+    ExpressionPtr ret = Construct::Clone(arg);
+    ret->clearContext(Expression::InvokeArgument);
+    ret->clearContext(Expression::RefValue);
+    ret->clearContext(Expression::NoRefWrapper);
+    ret->setLocation(loc);
+    return ret;
+  }
+  // errors raised by the body are reported at the call site
+  e->setLocation(loc);
+  for (int i = 0; i < e->getKidCount(); i++) {
+    ExpressionPtr kid = dynamic_pointer_cast<Expression>(e->getNthKid(i));
+    if (kid) e->setNthKid(i, substitute(kid, args, loc));
+  }
+  return e;
+}
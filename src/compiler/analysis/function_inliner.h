@@ -0,0 +1,89 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __FUNCTION_INLINER_H__
+#define __FUNCTION_INLINER_H__
+
+#include <compiler/hphp.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(AnalysisResult);
+DECLARE_BOOST_TYPES(Expression);
+DECLARE_BOOST_TYPES(ExpressionList);
+DECLARE_BOOST_TYPES(FunctionScope);
+DECLARE_BOOST_TYPES(Location);
+
+/**
+ * Replaces calls to small user functions with their bodies at PHP level,
+ * so neither a C++ call nor a FrameInjection nor Variant conversions of
+ * arguments are paid for them.
+ *
+ * Only functions of the form "function f($a, $b = 1) { return <exp>; }"
+ * qualify, where <exp> is made of operators, constants and parameters, and
+ * has at most Option::PHPInlineThreshold nodes. As <exp> can't call any
+ * function, there is never a frame that a backtrace could miss. By-ref and
+ * type-hinted parameters, reference returns, func_get_args() and statics
+ * all disqualify a function, and so does being listed in
+ * DynamicInvokeFunctions, as fb_rename_function() may replace it.
+ *
+ * Arguments have to be scalars, constants or variables. Only reading a
+ * variable has an effect, a notice when it's undefined, so a variable
+ * argument's parameter has to be read exactly once, unconditionally, and
+ * after the parameters of all variable arguments before it. Anything else
+ * would change which notices are raised or their order.
+ */
+class FunctionInliner {
+public:
+  /**
+   * Returns expression that replaces this call, or null if the call is
+   * kept. Every decision is recorded with AnalysisResult for reporting.
+   */
+  static ExpressionPtr Inline(AnalysisResultPtr ar, ExpressionPtr call,
+                              FunctionScopePtr func, ExpressionListPtr params);
+
+private:
+  struct ParamUse {
+    ParamUse() : count(0), order(-1), arrayBase(false), conditional(false) {}
+    int count;
+    int order;        // of its first read among all parameter reads
+    bool arrayBase;
+    bool conditional; // read in a branch of &&, ||, "and", "or" or ?:
+  };
+
+  FunctionInliner(FunctionScopePtr func)
+    : m_func(func), m_size(0), m_reads(0), m_conditional(0) {}
+
+  FunctionScopePtr m_func;
+  std::map<std::string, int> m_paramIndex;
+  std::vector<ParamUse> m_uses;
+  int m_size;
+  int m_reads;
+  int m_conditional;
+
+  const char *checkFunction(ExpressionPtr &body);
+  const char *checkBody(ExpressionPtr e);
+  const char *checkArguments(ExpressionListPtr params,
+                             ExpressionPtrVec &args);
+  ExpressionPtr substitute(ExpressionPtr e, const ExpressionPtrVec &args,
+                           LocationPtr loc);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __FUNCTION_INLINER_H__
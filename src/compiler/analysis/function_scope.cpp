@@ -56,7 +56,7 @@ FunctionScope::FunctionScope(AnalysisResultPtr ar, bool method,
     m_magicMethod(false), m_system(false), m_inlineable(false), m_sep(false),
     m_containsThis(false), m_staticMethodAutoFixed(false),
     m_callTempCountMax(0), m_callTempCountCurrent(0),
-    m_nrvoFix(true) {
+    m_rttiSpecialized(false), m_nrvoFix(true) {
   bool canInline = true;
   if (inPseudoMain) {
     canInline = false;
@@ -134,7 +134,7 @@ FunctionScope::FunctionScope(bool method, const std::string &name,
     m_system(true), m_inlineable(false), m_sep(false),
     m_containsThis(false), m_staticMethodAutoFixed(false),
     m_callTempCountMax(0), m_callTempCountCurrent(0),
-    m_nrvoFix(true) {
+    m_rttiSpecialized(false), m_nrvoFix(true) {
   m_dynamic = Option::IsDynamicFunction(method, m_name);
 }
 
@@ -307,9 +307,19 @@ public:
     return m_magicMethod;
   }
 
-  void setStmtCloned(StatementPtr stmt) {
-    m_stmtCloned = stmt;
+  /**
+   * Profile-guided clone of this function, with some parameters typed by
+   * the types they dominantly had at runtime. See
+   * AnalysisResult::cloneRTTIFuncs().
+   */
+  void setRTTISpecialization(FunctionScopePtr func) {
+    m_rttiSpecialization = func;
+    func->m_rttiSpecialized = true;
+  }
+  FunctionScopePtr getRTTISpecialization() const {
+    return m_rttiSpecialization;
   }
+  bool isRTTISpecialization() const { return m_rttiSpecialized;}
 
   DECLARE_BOOST_TYPES(RefParamInfo);
 
@@ -375,7 +385,8 @@ private:
   bool m_staticMethodAutoFixed; // auto fixed static
   int m_callTempCountMax;
   int m_callTempCountCurrent;
-  StatementPtr m_stmtCloned; // cloned method body stmt
+  FunctionScopePtr m_rttiSpecialization;
+  bool m_rttiSpecialized;
   bool m_nrvoFix;
 
   void outputCPPInvokeArgCountCheck(CodeGenerator &cg, AnalysisResultPtr ar,
@@ -146,6 +146,10 @@ bool VariableTable::isLvalParam(const string &name) const {
   return m_lvalParam.find(name) != m_lvalParam.end();
 }
 
+bool VariableTable::isReferenced(const string &name) const {
+  return m_referenced.find(name) != m_referenced.end();
+}
+
 bool VariableTable::isUsed(const string &name) const {
   return m_used.find(name) != m_used.end();
 }
@@ -493,6 +497,10 @@ void VariableTable::addLvalParam(const string &name) {
   m_lvalParam.insert(name);
 }
 
+void VariableTable::addReferenced(const string &name) {
+  m_referenced.insert(name);
+}
+
 void VariableTable::addUsed(const string &name) {
   m_used.insert(name);
 }
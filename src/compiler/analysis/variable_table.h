@@ -129,6 +129,7 @@ public:
   bool isLocalGlobal(const std::string &name) const;
   bool isNestedStatic(const std::string &name) const;
   bool isLvalParam(const std::string &name) const;
+  bool isReferenced(const std::string &name) const;
   bool isUsed(const std::string &name) const;
   bool isNeeded(const std::string &name) const;
 
@@ -207,6 +208,7 @@ public:
    * Called when analyze simple variable
    */
   void addLvalParam(const std::string &name);
+  void addReferenced(const std::string &name);
   void addUsed(const std::string &name);
   bool checkUnused(const std::string &name);
   void addNeeded(const std::string &name);
@@ -300,6 +302,7 @@ private:
   std::set<std::string> m_nestedStatic; // the name occurred in a
                                         // nested static statement
   std::set<std::string> m_lvalParam;    // the non-readonly parameters
+  std::set<std::string> m_referenced;   // bound by reference somewhere
   std::set<std::string> m_used;         // the used (referenced) variables
   std::set<std::string> m_needed;       // needed even though not referenced
   StringToConstructPtrMap m_staticInitVal; // static stmt variable init value
@@ -0,0 +1,219 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/build_manifest.h>
+#include <compiler/analysis/analysis_result.h>
+#include <compiler/analysis/file_scope.h>
+#include <runtime/base/zend/zend_string.h>
+#include <util/logger.h>
+#include <util/util.h>
+
+using namespace HPHP;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *BuildManifest::FileName = "hphp.manifest";
+
+/**
+ * One record per line, fields separated by tabs:
+ *
+ *   fingerprint <md5>
+ *   file        <md5> <cluster> <name>
+ *   dep         <user> <provider>
+ */
+static const char *MANIFEST_VERSION = "hphp-manifest 1";
+
+string BuildManifest::ChecksumString(const std::string &data) {
+  int len;
+  char *md5 = string_md5(data.data(), data.size(), false, len);
+  string ret(md5, len);
+  free(md5);
+  return ret;
+}
+
+string BuildManifest::Fingerprint(const std::string &options,
+                                  std::vector<std::string> inputs) {
+  sort(inputs.begin(), inputs.end());
+  string data = options;
+  for (unsigned int i = 0; i < inputs.size(); i++) {
+    data += '\n';
+    data += inputs[i];
+  }
+  return ChecksumString(data);
+}
+
+string BuildManifest::Checksum(const std::string &path) {
+  ifstream f(path.c_str());
+  if (!f) return "";
+  stringstream ss;
+  ss << f.rdbuf();
+  return ChecksumString(ss.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool BuildManifest::load(const std::string &filename) {
+  ifstream f(filename.c_str());
+  if (!f) return false;
+
+  string line;
+  if (!getline(f, line) || line != MANIFEST_VERSION) {
+    Logger::Warning("ignoring %s from a different version of hphp",
+                    filename.c_str());
+    return false;
+  }
+  while (getline(f, line)) {
+    vector<string> fields;
+    Util::split('\t', line.c_str(), fields);
+    if (fields[0] == "fingerprint" && fields.size() == 2) {
+      m_fingerprint = fields[1];
+    } else if (fields[0] == "file" && fields.size() == 4) {
+      addFile(fields[3], fields[1], fields[2]);
+    } else if (fields[0] == "dep" && fields.size() == 3) {
+      addDependency(fields[1], fields[2]);
+    } else {
+      Logger::Warning("ignoring corrupted %s", filename.c_str());
+      m_files.clear();
+      m_users.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BuildManifest::save(const std::string &filename) const {
+  ofstream f(filename.c_str());
+  if (!f) {
+    Logger::Error("unable to write %s", filename.c_str());
+    return false;
+  }
+
+  f << MANIFEST_VERSION << "\n";
+  f << "fingerprint\t" << m_fingerprint << "\n";
+  for (map<string, FileInfo>::const_iterator iter = m_files.begin();
+       iter != m_files.end(); ++iter) {
+    const FileInfo &info = iter->second;
+    f << "file\t" << info.checksum << "\t" << info.cluster << "\t"
+      << iter->first << "\n";
+  }
+  for (map<string, set<string> >::const_iterator iter = m_users.begin();
+       iter != m_users.end(); ++iter) {
+    for (set<string>::const_iterator it = iter->second.begin();
+         it != iter->second.end(); ++it) {
+      f << "dep\t" << *it << "\t" << iter->first << "\n";
+    }
+  }
+  f.close();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void BuildManifest::addFile(const std::string &name,
+                            const std::string &checksum,
+                            const std::string &cluster) {
+  FileInfo &info = m_files[name];
+  info.checksum = checksum;
+  info.cluster = cluster;
+}
+
+void BuildManifest::addDependency(const std::string &user,
+                                  const std::string &provider) {
+  m_users[provider].insert(user);
+}
+
+void BuildManifest::collect(AnalysisResultPtr ar, const std::string &root) {
+  const map<string, string> &clusters = ar->getClusters();
+  const vector<FileScopePtr> &files = ar->getAllFilesVector();
+  for (unsigned int i = 0; i < files.size(); i++) {
+    const string &name = files[i]->getName();
+    map<string, string>::const_iterator iter = clusters.find(name);
+    addFile(name, Checksum(name[0] == '/' ? name : root + name),
+            iter == clusters.end() ? "-" : iter->second);
+  }
+
+  map<string, set<string> > deps;
+  ar->getFileDependencies(deps);
+  for (map<string, set<string> >::const_iterator iter = deps.begin();
+       iter != deps.end(); ++iter) {
+    for (set<string>::const_iterator it = iter->second.begin();
+         it != iter->second.end(); ++it) {
+      addDependency(iter->first, *it);
+    }
+  }
+}
+
+bool BuildManifest::isUpToDate(const std::string &root,
+                               const std::string &fingerprint) const {
+  if (m_files.empty() || fingerprint != m_fingerprint) return false;
+
+  for (map<string, FileInfo>::const_iterator iter = m_files.begin();
+       iter != m_files.end(); ++iter) {
+    const string &name = iter->first;
+    if (Checksum(name[0] == '/' ? name : root + name) !=
+        iter->second.checksum) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BuildManifest::diff(const BuildManifest &current,
+                         std::set<std::string> &changed,
+                         std::set<std::string> &removed) const {
+  for (map<string, FileInfo>::const_iterator iter = current.m_files.begin();
+       iter != current.m_files.end(); ++iter) {
+    map<string, FileInfo>::const_iterator prev = m_files.find(iter->first);
+    if (prev == m_files.end() ||
+        prev->second.checksum != iter->second.checksum) {
+      changed.insert(iter->first);
+    }
+  }
+  for (map<string, FileInfo>::const_iterator iter = m_files.begin();
+       iter != m_files.end(); ++iter) {
+    if (current.m_files.find(iter->first) == current.m_files.end()) {
+      removed.insert(iter->first);
+    }
+  }
+}
+
+void BuildManifest::getDependents(const std::set<std::string> &files,
+                                  std::set<std::string> &dependents) const {
+  vector<string> todo(files.begin(), files.end());
+  while (!todo.empty()) {
+    string name = todo.back();
+    todo.pop_back();
+    map<string, set<string> >::const_iterator iter = m_users.find(name);
+    if (iter == m_users.end()) continue;
+    for (set<string>::const_iterator it = iter->second.begin();
+         it != iter->second.end(); ++it) {
+      if (files.find(*it) == files.end() && dependents.insert(*it).second) {
+        todo.push_back(*it);
+      }
+    }
+  }
+}
+
+void BuildManifest::getClusters(std::map<std::string, std::string> &clusters)
+  const {
+  for (map<string, FileInfo>::const_iterator iter = m_files.begin();
+       iter != m_files.end(); ++iter) {
+    if (iter->second.cluster != "-") {
+      clusters[iter->first] = iter->second.cluster;
+    }
+  }
+}
@@ -0,0 +1,117 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __BUILD_MANIFEST_H__
+#define __BUILD_MANIFEST_H__
+
+#include <compiler/hphp.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(AnalysisResult);
+DECLARE_BOOST_TYPES(BuildManifest);
+
+/**
+ * What an incremental build remembers about the previous one, saved in
+ * output directory: a fingerprint of compiler binary and options, checksum
+ * and cluster of every PHP file that was compiled, and file dependencies.
+ *
+ * Type inference is whole-program, so a changed file is always compiled
+ * together with the rest of the program. What the manifest buys is
+ *
+ *   1. skipping everything when no input changed at all,
+ *   2. keeping each file in its previous cluster, so only clusters whose
+ *      contents really changed are rewritten and recompiled by make.
+ */
+class BuildManifest {
+public:
+  static const char *FileName;
+
+  /**
+   * MD5 of a file's contents in hex, or empty string if it can't be read.
+   */
+  static std::string Checksum(const std::string &path);
+  static std::string ChecksumString(const std::string &data);
+
+  /**
+   * Fingerprint of a build: compiler and options, as summarized by
+   * "options", and the list of input files, in whatever order given, so a
+   * file that was added or dropped invalidates the previous build.
+   */
+  static std::string Fingerprint(const std::string &options,
+                                 std::vector<std::string> inputs);
+
+public:
+  bool load(const std::string &filename);
+  bool save(const std::string &filename) const;
+
+  void setFingerprint(const std::string &fingerprint) {
+    m_fingerprint = fingerprint;
+  }
+  const std::string &getFingerprint() const { return m_fingerprint;}
+
+  void addFile(const std::string &name, const std::string &checksum,
+               const std::string &cluster);
+  void addDependency(const std::string &user, const std::string &provider);
+
+  /**
+   * Records all files of a compiled program, and the clusters they were
+   * put in. Files are read from root to compute checksums.
+   */
+  void collect(AnalysisResultPtr ar, const std::string &root);
+
+  /**
+   * Whether the same compiler with the same options would read exactly the
+   * same files as last time.
+   */
+  bool isUpToDate(const std::string &root,
+                  const std::string &fingerprint) const;
+
+  /**
+   * Files in "current" that are new or changed, and files that are gone.
+   */
+  void diff(const BuildManifest &current, std::set<std::string> &changed,
+            std::set<std::string> &removed) const;
+
+  /**
+   * Files that directly or indirectly use any of these files.
+   */
+  void getDependents(const std::set<std::string> &files,
+                     std::set<std::string> &dependents) const;
+
+  /**
+   * File name => cluster name, for AnalysisResult::setClusters().
+   */
+  void getClusters(std::map<std::string, std::string> &clusters) const;
+
+  int getFileCount() const { return m_files.size();}
+
+private:
+  struct FileInfo {
+    std::string checksum;
+    std::string cluster;
+  };
+
+  std::string m_fingerprint;
+  std::map<std::string, FileInfo> m_files;
+  std::map<std::string, std::set<std::string> > m_users; // provider => users
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __BUILD_MANIFEST_H__
@@ -199,6 +199,11 @@ TypePtr AssignmentExpression::inferTypes(AnalysisResultPtr ar, TypePtr type,
                                  beforeAssignmentExpressionInferTypes);
   }
 
+  if (m_ref && m_variable->is(Expression::KindOfSimpleVariable)) {
+    SimpleVariablePtr var = dynamic_pointer_cast<SimpleVariable>(m_variable);
+    ar->getScope()->getVariables()->addReferenced(var->getName());
+  }
+
   TypePtr ret = inferAssignmentTypes(ar, type, coerce, m_variable, m_value);
 
   if (VariableTable::m_hookHandler) {
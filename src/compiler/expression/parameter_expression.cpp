@@ -112,7 +112,9 @@ ExpressionPtr ParameterExpression::postOptimize(AnalysisResultPtr ar) {
 
 TypePtr ParameterExpression::getTypeSpec(AnalysisResultPtr ar) {
   TypePtr ret;
-  if (m_type.empty() || m_defaultValue) {
+  if (m_specializedType) {
+    ret = m_specializedType;
+  } else if (m_type.empty() || m_defaultValue) {
     ret = NEW_TYPE(Some);
   } else if (m_type == "array") {
     ret = Type::Array;
@@ -154,9 +156,10 @@ TypePtr ParameterExpression::inferTypes(AnalysisResultPtr ar, TypePtr type,
   } else {
     // Functions that can be called dynamically have to have
     // variant parameters.
-    if (m_type.empty() && (ar->getFunctionScope()->isDynamic() ||
-                           ar->getFunctionScope()->isRedeclaring() ||
-                           ar->getFunctionScope()->isVirtual())) {
+    if (m_type.empty() && !m_specializedType &&
+        (ar->getFunctionScope()->isDynamic() ||
+         ar->getFunctionScope()->isRedeclaring() ||
+         ar->getFunctionScope()->isVirtual())) {
       variables->forceVariant(ar, m_name);
     }
     int p;
@@ -36,6 +36,7 @@ public:
 
   bool isRef() const { return m_ref;}
   bool isOptional() const { return m_defaultValue;}
+  bool hasTypeHint() const { return !m_type.empty();}
   bool hasRTTI() const { return m_hasRTTI;}
   void setHasRTTI() { m_hasRTTI = true;}
   const std::string &getName() const { return m_name;}
@@ -44,12 +45,19 @@ public:
   void rename(const std::string &name) { m_name = name;}
   ExpressionPtr defaultValue() { return m_defaultValue; }
   TypePtr getTypeSpec(AnalysisResultPtr ar);
+
+  /**
+   * Type this parameter has in a profile-guided clone of its function.
+   */
+  void setSpecializedType(TypePtr type) { m_specializedType = type;}
+  TypePtr getSpecializedType() const { return m_specializedType;}
 private:
   std::string m_type;
   std::string m_name;
   bool m_ref;
   bool m_hasRTTI;
   ExpressionPtr m_defaultValue;
+  TypePtr m_specializedType;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -26,6 +26,7 @@
 #include <compiler/expression/constant_expression.h>
 #include <compiler/analysis/constant_table.h>
 #include <compiler/analysis/variable_table.h>
+#include <compiler/analysis/function_inliner.h>
 #include <util/util.h>
 #include <compiler/option.h>
 #include <compiler/expression/simple_variable.h>
@@ -355,6 +356,28 @@ void SimpleFunctionCall::analyzeProgram(AnalysisResultPtr ar) {
   }
 }
 
+bool SimpleFunctionCall::outputCPPStreamingEcho(CodeGenerator &cg,
+                                                AnalysisResultPtr ar) {
+  if (!m_valid || !m_builtinFunction || m_redeclared || hasCPPTemp() ||
+      m_class || !m_className.empty() || !m_params) {
+    return false;
+  }
+  const char *func;
+  int count = m_params->getCount();
+  if (m_name == "serialize" && count == 1) {
+    func = "echo_serialize";
+  } else if (m_name == "json_encode" && (count == 1 || count == 2)) {
+    func = "echo_json_encode";
+  } else {
+    return false;
+  }
+  cg_printf("%s(", func);
+  FunctionScope::outputCPPArguments(m_params, cg, ar, m_extraArg,
+                                    m_variableArgument, m_argArrayId);
+  cg_printf(");\n");
+  return true;
+}
+
 bool SimpleFunctionCall::isDefineWithoutImpl(AnalysisResultPtr ar) {
   if (m_class || !m_className.empty()) return false;
   if (m_type == DefineFunction && m_params && m_params->getCount() >= 2) {
@@ -470,6 +493,13 @@ ExpressionPtr SimpleFunctionCall::preOptimize(AnalysisResultPtr ar) {
       }
     }
   }
+
+  if (Option::PHPInlineThreshold > 0 && m_funcScope && !m_class &&
+      m_className.empty() && m_type == UnknownType) {
+    return FunctionInliner::Inline
+      (ar, static_pointer_cast<Expression>(shared_from_this()),
+       m_funcScope, m_params);
+  }
   return ExpressionPtr();
 }
 
@@ -56,6 +56,13 @@ public:
   }
 
   const std::string &getName() const { return m_name;}
+
+  /**
+   * For "echo f(...)" where f has a runtime counterpart that writes its
+   * result straight into the output buffer, like serialize() and
+   * json_encode(): outputs a call to that and returns true.
+   */
+  bool outputCPPStreamingEcho(CodeGenerator &cg, AnalysisResultPtr ar);
 private:
   enum FunctionType {
     UnknownType,
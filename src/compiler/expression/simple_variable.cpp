@@ -124,6 +124,9 @@ TypePtr SimpleVariable::inferAndCheck(AnalysisResultPtr ar, TypePtr type,
       }
     }
   }
+  if (m_context & RefValue) {
+    variables->addReferenced(m_name);
+  }
   if (m_name == "this") {
     ClassScopePtr cls = getOriginalScope(ar);
     if (cls) {
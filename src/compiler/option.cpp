@@ -142,6 +142,8 @@ std::string Option::RTTIOutputFile;
 std::string Option::RTTIDirectory;
 bool Option::GenRTTIProfileData = false;
 bool Option::UseRTTIProfileData = false;
+int Option::RTTIHotCallCount = 1000;
+int Option::RTTIDominantTypeRatio = 90;
 
 bool Option::StaticMethodAutoFix = false;
 
@@ -170,6 +172,7 @@ int Option::InvokeFewArgsCount = 6;
 bool Option::PrecomputeLiteralStrings = true;
 bool Option::FlattenInvoke = true;
 int Option::InlineFunctionThreshold = -1;
+int Option::PHPInlineThreshold = 0;
 bool Option::ControlEvalOrder = true;
 
 bool Option::AllDynamic = true;
@@ -325,6 +328,9 @@ void Option::Load(Hdf &config) {
   FlibDirectory = config["FlibDirectory"].getString();
   EnableXHP = config["EnableXHP"].getBool();
   RTTIOutputFile = config["RTTIOutputFile"].getString();
+  RTTIHotCallCount = config["RTTIHotCallCount"].getInt32(1000);
+  RTTIDominantTypeRatio = config["RTTIDominantTypeRatio"].getInt32(90);
+  PHPInlineThreshold = config["PHPInlineThreshold"].getInt32(0);
   EnableEval = (EvalLevel)config["EnableEval"].getByte(0);
   AllDynamic = config["AllDynamic"].getBool(true);
   AllVolatile = config["AllVolatile"].getBool();
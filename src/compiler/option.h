@@ -125,6 +125,14 @@ public:
   static bool GenRTTIProfileData;
   static bool UseRTTIProfileData;
 
+  /**
+   * How many profiled calls make a function worth specializing, and what
+   * percentage of calls have to pass one type for a parameter to be
+   * specialized to it.
+   */
+  static int RTTIHotCallCount;
+  static int RTTIDominantTypeRatio;
+
   /**
    * Whether to change a method to static if it is called statically
    */
@@ -300,6 +308,12 @@ public:
   static bool PrecomputeLiteralStrings;
   static bool FlattenInvoke;
   static int InlineFunctionThreshold;
+
+  /**
+   * Calls to a user function whose body is "return <exp>;" are replaced by
+   * <exp> when it has at most this many nodes. 0 turns inlining off.
+   */
+  static int PHPInlineThreshold;
   static bool ControlEvalOrder;
   static bool GenerateSourceInfo;
   static bool UseVirtualDispatch;
@@ -16,6 +16,7 @@
 
 #include <compiler/statement/echo_statement.h>
 #include <compiler/expression/expression_list.h>
+#include <compiler/expression/simple_function_call.h>
 
 using namespace HPHP;
 using namespace std;
@@ -101,11 +102,16 @@ void EchoStatement::outputPHP(CodeGenerator &cg, AnalysisResultPtr ar) {
 void EchoStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
   if (m_exp->getCount() > 1) cg_indentBegin("{\n");
   for (int i = 0; i < m_exp->getCount(); i++) {
-    (*m_exp)[i]->outputCPPBegin(cg, ar);
-    cg_printf("echo(");
-    (*m_exp)[i]->outputCPP(cg, ar);
-    cg_printf(");\n");
-    (*m_exp)[i]->outputCPPEnd(cg, ar);
+    ExpressionPtr exp = (*m_exp)[i];
+    exp->outputCPPBegin(cg, ar);
+    if (!exp->is(Expression::KindOfSimpleFunctionCall) ||
+        !static_pointer_cast<SimpleFunctionCall>(exp)->
+        outputCPPStreamingEcho(cg, ar)) {
+      cg_printf("echo(");
+      exp->outputCPP(cg, ar);
+      cg_printf(");\n");
+    }
+    exp->outputCPPEnd(cg, ar);
   }
   if (m_exp->getCount() > 1) cg_indentEnd("}\n");
 }
@@ -68,6 +68,10 @@ void FunctionStatement::onParse(AnalysisResultPtr ar) {
   ar->recordFunctionSource(m_name, fileScope->getName());
 }
 
+void FunctionStatement::onParseRTTIClone(AnalysisResultPtr ar) {
+  ar->getFileScope()->addUndeclaredFunction(onParseImpl(ar));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // static analysis functions
 
@@ -237,6 +241,7 @@ void FunctionStatement::outputCPPImpl(CodeGenerator &cg,
         cg_printf("PSEUDOMAIN_INJECTION(%s);\n",
                   origFuncName.c_str());
       } else {
+        outputCPPRTTIGuard(cg, ar);
         if (m_stmt->hasBody()) {
           cg_printf("FUNCTION_INJECTION(%s);\n", origFuncName.c_str());
         }
@@ -269,3 +274,90 @@ void FunctionStatement::outputCPPImpl(CodeGenerator &cg,
 
   ar->popScope();
 }
+
+/**
+ * Hands a call over to the profile-guided clone of this function when
+ * all specialized parameters have the types it was compiled for. This
+ * happens before the frame is injected, so the clone's frame, which
+ * carries the original name, takes its place in backtraces.
+ */
+void FunctionStatement::outputCPPRTTIGuard(CodeGenerator &cg,
+                                           AnalysisResultPtr ar) {
+  FunctionScopePtr funcScope = m_funcScope.lock();
+  FunctionScopePtr spec = funcScope->getRTTISpecialization();
+  if (!spec || !m_params || m_ref || funcScope->isVariableArgument() ||
+      funcScope->isRedeclaring()) {
+    return;
+  }
+  VariableTablePtr variables = funcScope->getVariables();
+  if (variables->getAttribute(VariableTable::ContainsDynamicVariable) ||
+      variables->getAttribute(VariableTable::ContainsExtract)) {
+    return;
+  }
+
+  // the clone has seen the same code, but the profile may be out of date
+  TypePtr retType = funcScope->getReturnType();
+  TypePtr specRetType = spec->getReturnType();
+  if (!retType != !specRetType ||
+      (retType && !retType->is(Type::KindOfVariant) &&
+       !Type::SameType(retType, specRetType))) {
+    return;
+  }
+
+  MethodStatementPtr specStmt =
+    dynamic_pointer_cast<MethodStatement>(spec->getStmt());
+  ExpressionListPtr specParams = specStmt->getParams();
+  vector<string> checks;
+  for (int i = 0; i < m_params->getCount(); i++) {
+    ParameterExpressionPtr param =
+      dynamic_pointer_cast<ParameterExpression>((*specParams)[i]);
+    TypePtr type = param->getSpecializedType();
+    if (!type) continue;
+    TypePtr paramType = funcScope->getParamType(i);
+    if (Type::SameType(paramType, type)) continue;
+    if (!paramType->is(Type::KindOfVariant) || variables->isLvalParam(
+          param->getName())) {
+      return;
+    }
+    const char *check = NULL;
+    switch (type->getKindOf()) {
+    case Type::KindOfBoolean: check = "isBoolean"; break;
+    case Type::KindOfInt64:   check = "isInteger"; break;
+    case Type::KindOfDouble:  check = "isDouble";  break;
+    case Type::KindOfString:  check = "isString";  break;
+    case Type::KindOfArray:   check = "isArray";   break;
+    default:
+      return;
+    }
+    checks.push_back(string(Option::VariablePrefix) + param->getName() + "." +
+                     check + "()");
+  }
+  if (checks.empty()) return;
+
+  cg_printf("if (");
+  for (unsigned int i = 0; i < checks.size(); i++) {
+    if (i) cg_printf(" && ");
+    cg_printf("%s", checks[i].c_str());
+  }
+  cg_indentBegin(") {\n");
+  if (retType) cg_printf("return ");
+  cg_printf("%s%s(", Option::FunctionPrefix, spec->getId(cg).c_str());
+  for (int i = 0; i < m_params->getCount(); i++) {
+    ParameterExpressionPtr param =
+      dynamic_pointer_cast<ParameterExpression>((*specParams)[i]);
+    TypePtr paramType = funcScope->getParamType(i);
+    TypePtr specType = spec->getParamType(i);
+    if (i) cg_printf(", ");
+    if (!Type::SameType(paramType, specType) &&
+        (specType->isPrimitive() || specType->is(Type::KindOfString) ||
+         specType->is(Type::KindOfArray))) {
+      specType->outputCPPCast(cg, ar);
+      cg_printf("(%s%s)", Option::VariablePrefix, param->getName().c_str());
+    } else {
+      cg_printf("%s%s", Option::VariablePrefix, param->getName().c_str());
+    }
+  }
+  cg_printf(");\n");
+  if (!retType) cg_printf("return;\n");
+  cg_indentEnd("}\n");
+}
@@ -45,8 +45,17 @@ public:
   virtual void onParse(AnalysisResultPtr ar);
   bool ignored() const { return m_ignored;}
 
+  /**
+   * Registers a profile-guided clone with its file for code generation,
+   * without declaring it, so it is invisible to function_exists(),
+   * get_defined_functions() and dynamic calls.
+   */
+  void onParseRTTIClone(AnalysisResultPtr ar);
+
 private:
   bool m_ignored;
+
+  void outputCPPRTTIGuard(CodeGenerator &cg, AnalysisResultPtr ar);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
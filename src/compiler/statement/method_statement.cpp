@@ -276,10 +276,13 @@ void MethodStatement::analyzeProgramImpl(AnalysisResultPtr ar) {
   if (ar->isFirstPass()) {
     ar->getDependencyGraph()->addParent(DependencyGraph::KindOfFunctionCall,
                                         "", getFullName(), shared_from_this());
-    if (Option::AllDynamic || hasHphpNote("Dynamic") ||
-        funcScope->isSepExtension() ||
-        BuiltinSymbols::IsDeclaredDynamic(m_name) ||
-        Option::IsDynamicFunction(m_method, m_name)) {
+    // profile-guided clones are only called from the functions they were
+    // cloned from, with parameters of their specialized types
+    if (!funcScope->isRTTISpecialization() &&
+        (Option::AllDynamic || hasHphpNote("Dynamic") ||
+         funcScope->isSepExtension() ||
+         BuiltinSymbols::IsDeclaredDynamic(m_name) ||
+         Option::IsDynamicFunction(m_method, m_name))) {
       funcScope->setDynamic();
     }
     if (hasHphpNote("Volatile")) funcScope->setVolatile();
@@ -668,7 +671,9 @@ bool MethodStatement::outputFFI(CodeGenerator &cg, AnalysisResultPtr ar) {
     inClass && (!m_modifiers->isPublic() || clsScope->isRedeclaring());
   // skip constructors
   bool isConstructor = inClass && funcScope->isConstructor(clsScope);
-  bool valid = !pseudoMain && !inaccessible && !isConstructor;
+  // profile-guided clones are internal to the functions they came from
+  bool valid = !pseudoMain && !inaccessible && !isConstructor &&
+    !funcScope->isRTTISpecialization();
 
   if (cg.getContext() == CodeGenerator::CppFFIDecl ||
       cg.getContext() == CodeGenerator::CppFFIImpl) {
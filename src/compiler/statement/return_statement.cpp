@@ -21,6 +21,9 @@
 #include <compiler/analysis/function_scope.h>
 #include <compiler/analysis/code_error.h>
 #include <compiler/analysis/class_scope.h>
+#include <compiler/analysis/variable_table.h>
+#include <compiler/expression/simple_variable.h>
+#include <compiler/builtin_symbols.h>
 
 using namespace HPHP;
 using namespace std;
@@ -170,6 +173,64 @@ static bool checkCopyElision(FunctionScopePtr func, ExpressionPtr exp) {
   return false;
 }
 
+/**
+ * A local dies with the return statement, so unless it was ever bound by
+ * reference, its value can be handed over to the return value instead of
+ * being copied, saving an incRefCount() and a decRefCount().
+ */
+static bool checkOwnershipTransfer(FunctionScopePtr func, ExpressionPtr exp) {
+  if (!func || func->inPseudoMain() || func->isRefReturn() ||
+      !exp->is(Expression::KindOfSimpleVariable) || exp->isThis() ||
+      exp->hasCPPTemp()) {
+    return false;
+  }
+
+  VariableTablePtr variables = func->getVariables();
+  if (variables->getAttribute(VariableTable::ContainsDynamicVariable) ||
+      variables->getAttribute(VariableTable::ContainsExtract) ||
+      variables->getAttribute(VariableTable::ContainsCompact) ||
+      variables->getAttribute(VariableTable::ContainsGetDefinedVars)) {
+    return false;
+  }
+
+  const string &name = dynamic_pointer_cast<SimpleVariable>(exp)->getName();
+  if (name == "GLOBALS" || BuiltinSymbols::IsSuperGlobal(name) ||
+      variables->isReferenced(name)) {
+    return false;
+  }
+  if (variables->isParameter(name)) {
+    // only a modified by-value parameter is a copy owned by this function
+    if (!variables->isLvalParam(name)) return false;
+    for (int i = 0; i < func->getMaxParamCount(); i++) {
+      if (func->getParamName(i) == name && func->isRefParam(i)) return false;
+    }
+  } else if (!variables->isLocal(name)) {
+    return false;
+  }
+
+  // no conversion is allowed in between
+  TypePtr type = variables->getFinalType(name);
+  TypePtr actual = exp->getActualType();
+  TypePtr expected = exp->getExpectedType();
+  TypePtr implemented = exp->getImplementedType();
+  if (!type || !actual || !Type::SameType(type, actual) ||
+      (expected && !Type::SameType(expected, actual)) ||
+      (implemented && !Type::SameType(implemented, actual)) ||
+      !func->getReturnType() ||
+      !Type::SameType(func->getReturnType(), actual)) {
+    return false;
+  }
+  switch (type->getKindOf()) {
+  case Type::KindOfVariant:
+  case Type::KindOfString:
+  case Type::KindOfArray:
+  case Type::KindOfObject:
+    return true;
+  default:
+    return false;
+  }
+}
+
 void ReturnStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
   if (hasHphpNote("C++")) {
     cg_printf("%s", getEmbedded().c_str());
@@ -191,7 +252,10 @@ void ReturnStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
   if (m_exp) {
     bool close = false;
     cg_printf(" ");
-    if (checkCopyElision(func, m_exp)) {
+    if (checkOwnershipTransfer(func, m_exp)) {
+      cg_printf("take(");
+      close = true;
+    } else if (checkCopyElision(func, m_exp)) {
       cg_printf("wrap_variant(");
       close = true;
     }
@@ -18,6 +18,7 @@
 #include <boost/program_options/positional_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 #include <boost/program_options/parsers.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <compiler/package.h>
 #include <compiler/analysis/analysis_result.h>
@@ -30,6 +31,7 @@
 #include <compiler/option.h>
 #include <compiler/parser/parser.h>
 #include <compiler/builtin_symbols.h>
+#include <compiler/build_manifest.h>
 #include <util/db_conn.h>
 #include <util/exception.h>
 #include <util/process.h>
@@ -51,6 +53,8 @@ struct ProgramOptions {
   string outputDir;
   string outputFile;
   string syncDir;
+  bool incremental;
+  string fingerprint;
   vector<string> config;
   string configDir;
   vector<string> confStrings;
@@ -84,6 +88,7 @@ struct ProgramOptions {
   int optimizeLevel;
   string filecache;
   string rttiDirectory;
+  string inlineReport;
   string javaRoot;
   bool generateFFI;
   bool dump;
@@ -231,6 +236,11 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
      "Files will be created in this directory first, then sync with output "
      "directory without overwriting identical files. Great for incremental "
      "compilation and build.")
+    ("incremental",
+     value<bool>(&po.incremental)->default_value(false),
+     "reuse output directory of a previous build: do nothing if no input "
+     "changed, otherwise keep files in their previous clusters and only "
+     "overwrite generated files that changed; implies --sync-dir")
     ("optimize-level", value<int>(&po.optimizeLevel)->default_value(1),
      "optimization level")
     ("gen-stats", value<bool>(&po.genStats)->default_value(false),
@@ -273,6 +283,9 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
      "if specified, generate a static file cache with this file name")
     ("rtti-directory", value<string>(&po.rttiDirectory)->default_value(""),
      "the directory of rtti profiling data")
+    ("inline-report", value<string>(&po.inlineReport)->default_value(""),
+     "write why each call to a user function was or wasn't inlined to "
+     "this file")
     ("java-root",
      value<string>(&po.javaRoot)->default_value("php"),
      "the root package of generated Java FFI classes")
@@ -455,6 +468,38 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
     Option::JavaFFIRootPackage = po.javaRoot;
   }
 
+  if (po.incremental) {
+    if (po.target != "cpp" || po.outputDir.empty()) {
+      Logger::Warning("--incremental only works with --target=cpp and an "
+                      "--output-dir, ignored");
+      po.incremental = false;
+    } else {
+      while (po.outputDir.size() > 1 &&
+             po.outputDir[po.outputDir.size() - 1] == '/') {
+        po.outputDir.resize(po.outputDir.size() - 1);
+      }
+      if (po.syncDir.empty()) {
+        po.syncDir = po.outputDir + ".sync";
+      }
+
+      // same compiler binary, command line and configurations
+      string fingerprint;
+      struct stat sb;
+      if (stat("/proc/self/exe", &sb) == 0) {
+        fingerprint += boost::lexical_cast<string>(sb.st_size) + ":" +
+          boost::lexical_cast<string>(sb.st_mtime) + "\n";
+      }
+      for (int i = 1; i < argc; i++) {
+        fingerprint += argv[i];
+        fingerprint += '\n';
+      }
+      for (unsigned int i = 0; i < po.config.size(); i++) {
+        fingerprint += BuildManifest::Checksum(po.config[i]) + "\n";
+      }
+      po.fingerprint = BuildManifest::ChecksumString(fingerprint);
+    }
+  }
+
   return 0;
 }
 
@@ -496,6 +541,10 @@ int process(const ProgramOptions &po) {
     ar->loadBuiltins();
   }
 
+  BuildManifest previous;
+  string manifestPath;
+  string fingerprint;
+  bool hasPrevious = false;
   {
     Timer timer(Timer::WallTime, "parsing inputs");
     if (!po.inputs.empty() && po.target == "php" && po.format == "pickled") {
@@ -535,10 +584,36 @@ int process(const ProgramOptions &po) {
         }
       }
     }
+
+    // only now do we know all input files, including new ones
+    if (po.incremental) {
+      vector<string> inputs;
+      package.getFiles(inputs);
+      fingerprint = BuildManifest::Fingerprint(po.fingerprint, inputs);
+      manifestPath = po.outputDir + "/" + BuildManifest::FileName;
+      hasPrevious = previous.load(manifestPath);
+      if (hasPrevious) {
+        if (previous.isUpToDate(po.inputDir, fingerprint)) {
+          Logger::Info("no input changed since last build of %s",
+                       po.outputDir.c_str());
+          return 0;
+        }
+        map<string, string> clusters;
+        previous.getClusters(clusters);
+        ar->setClusters(clusters);
+      }
+    }
+
     if (po.target != "filecache") {
       if (!package.parse()) {
         return 1;
       }
+      if ((po.target == "cpp" || po.target == "run") &&
+          !Option::RTTIOutputFile.empty() &&
+          !po.rttiDirectory.empty()) {
+        Option::UseRTTIProfileData = true;
+        ar->cloneRTTIFuncs(po.rttiDirectory.c_str());
+      }
       ar->analyzeProgram();
     }
   }
@@ -583,6 +658,22 @@ int process(const ProgramOptions &po) {
     ar->dump();
   }
 
+  if (po.incremental && ret == 0) {
+    BuildManifest current;
+    current.setFingerprint(fingerprint);
+    current.collect(ar, po.inputDir);
+    if (hasPrevious) {
+      set<string> changed, removed, dependents;
+      previous.diff(current, changed, removed);
+      changed.insert(removed.begin(), removed.end());
+      previous.getDependents(changed, dependents);
+      Logger::Info("%d of %d files changed or removed since last build, "
+                   "%d more depend on them", (int)changed.size(),
+                   current.getFileCount(), (int)dependents.size());
+    }
+    current.save(manifestPath);
+  }
+
   // saving stats
   if (po.target == "analyze" || po.genStats || !po.dbStats.empty()) {
     int seconds = timer.getMicroSeconds() / 1000000;
@@ -755,15 +846,12 @@ int cppTarget(const ProgramOptions &po, AnalysisResultPtr ar,
     Timer timer(Timer::WallTime, "pre-optimizing");
     ar->preOptimize();
   }
+  if (!po.inlineReport.empty()) {
+    ar->saveInlineReport(po.inlineReport);
+  }
 
-
-  if (!Option::RTTIOutputFile.empty()) {
-    if (!po.rttiDirectory.empty()) {
-      Option::UseRTTIProfileData = true;
-      ar->cloneRTTIFuncs(po.rttiDirectory.c_str());
-    } else {
-      Option::GenRTTIProfileData = true;
-    }
+  if (!Option::RTTIOutputFile.empty() && po.rttiDirectory.empty()) {
+    Option::GenRTTIProfileData = true;
   }
 
   if (Option::GenerateInferredTypes) {
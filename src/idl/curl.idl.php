@@ -107,3 +107,15 @@ f('evhttp_async_post', Variant,
 
 f('evhttp_recv', Variant,
   array('handle' => Object));
+
+f('evhttp_task_start', Variant,
+  array('url' => String,
+        'headers' => array(StringVec, 'null_array'),
+        'timeout' => array(Int32, '5'),
+        'post_data' => array(String, 'null_string')));
+
+f('evhttp_task_status', Boolean,
+  array('task' => Object));
+
+f('evhttp_task_result', Variant,
+  array('task' => Object));
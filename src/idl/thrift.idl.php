@@ -18,4 +18,15 @@ f('thrift_protocol_read_binary', Variant,
         'obj_typename' => String,
         'strict_read' => Boolean));
 
+f('thrift_protocol_write_compact', NULL,
+  array('transportObj' => Object,
+        'method_name' => String,
+        'msgtype' => Int64,
+        'request_struct' => Object,
+        'seqid' => Int32));
+
+f('thrift_protocol_read_compact', Variant,
+  array('transportObj' => Object,
+        'obj_typename' => String));
+
 dyn('getTransport', 'flush', 'write', 'read');
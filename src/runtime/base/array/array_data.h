@@ -231,6 +231,16 @@ class ArrayData : public Countable {
    */
   virtual void renumber() {}
 
+  /**
+   * Sorting support: relinks all elements in the order of "positions", which
+   * has every valid position exactly once, and gives them integer keys from 0
+   * on if renumber is true. Returns false if not supported, in which case
+   * caller has to build a sorted copy instead.
+   */
+  virtual bool reorder(const std::vector<ssize_t> &positions, bool renumber) {
+    return false;
+  }
+
   /**
    * When an array data is set static, some calculated data members need to
    * be initialized, for example, Map::getKeyVector(). More importantly, all
@@ -15,6 +15,8 @@
 */
 
 #include <runtime/base/array/array_util.h>
+#include <runtime/base/array/value_set.h>
+#include <runtime/base/array/array_init.h>
 #include <runtime/base/string_util.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/runtime_error.h>
@@ -41,12 +43,13 @@ Variant ArrayUtil::CreateArray(int start_index, int num, CVarRef value) {
     return false;
   }
 
-  Array ret;
-  ret.set(start_index, value);
-  for (int i = num - 1; i > 0; i--) {
-    ret.append(value);
+  // sized upfront, so filling a large array never grows its hash table
+  ArrayInit ret(num, false);
+  ret.set(0, (int64)start_index, value);
+  for (int i = 1; i < num; i++) {
+    ret.set(i, value);
   }
-  return ret;
+  return Array(ret.create());
 }
 
 Variant ArrayUtil::Combine(CArrRef keys, CArrRef values) {
@@ -610,13 +613,11 @@ Variant ArrayUtil::Filter(CArrRef input, PFUNC_FILTER filter /* = NULL */,
 }
 
 Variant ArrayUtil::Unique(CArrRef input) {
-  Array seenValues;
+  ValueSet seenValues;
   Array ret = Array::Create();
   for (ArrayIter iter(input); iter; ++iter) {
     Variant entry(iter.second());
-    String str(entry.toString());
-    if (!seenValues.exists(str)) {
-      seenValues.set(str, 1);
+    if (seenValues.insert(entry)) {
       ret.set(iter.first(), entry);
     }
   }
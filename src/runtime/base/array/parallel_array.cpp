@@ -0,0 +1,411 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/parallel_array.h>
+#include <runtime/base/builtin_functions.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/zend/zend_string.h>
+#include <util/async_job.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+// pure builtins
+
+enum Kernel {
+  KernelNone,
+  KernelIntval,
+  KernelStrlen,
+  KernelStrtolower,
+  KernelStrtoupper,
+  KernelMd5,
+  KernelSha1,
+  KernelCrc32,
+};
+
+static const struct {
+  const char *name;
+  Kernel kernel;
+} s_kernels[] = {
+  { "intval",     KernelIntval     },
+  { "strlen",     KernelStrlen     },
+  { "strtolower", KernelStrtolower },
+  { "strtoupper", KernelStrtoupper },
+  { "md5",        KernelMd5        },
+  { "sha1",       KernelSha1       },
+  { "crc32",      KernelCrc32      },
+};
+
+static bool parallel_enabled(CArrRef input) {
+  return RuntimeOption::ParallelArrayThreads > 1 &&
+    input.size() >= RuntimeOption::ParallelArrayMinSize;
+}
+
+static bool builtins_intact() {
+  // fb_rename_function() may have replaced any builtin with user code
+  return get_renamed_functions().empty() && get_unmapped_functions().empty();
+}
+
+static bool is_builtin(CStrRef name, const char *builtin) {
+  return name.size() == (int)strlen(builtin) &&
+    strcasecmp(name.data(), builtin) == 0;
+}
+
+static Kernel get_kernel(CVarRef callback) {
+  if (!callback.isString() || !builtins_intact()) return KernelNone;
+  String name = callback.toString();
+  for (unsigned int i = 0; i < sizeof(s_kernels) / sizeof(s_kernels[0]);
+       i++) {
+    if (is_builtin(name, s_kernels[i].name)) return s_kernels[i].kernel;
+  }
+  return KernelNone;
+}
+
+static bool returns_string(Kernel kernel) {
+  return kernel == KernelStrtolower || kernel == KernelStrtoupper ||
+    kernel == KernelMd5 || kernel == KernelSha1;
+}
+
+/**
+ * An element as workers see it: bytes of its string value, or its integer
+ * value when data is NULL.
+ */
+struct Item {
+  const char *data;
+  int len;
+  int64 num;
+};
+
+/**
+ * What a kernel returns: a malloc()-ed string, or an integer when data is
+ * NULL and kernel doesn't return strings.
+ */
+struct Result {
+  char *data;
+  int len;
+  int64 num;
+};
+
+static void run_kernel(Kernel kernel, const Item &item, Result &r) {
+  r.data = NULL;
+  r.len = 0;
+  r.num = 0;
+  switch (kernel) {
+  case KernelIntval:
+    r.num = item.data ? strtoll(item.data, NULL, 10) : item.num;
+    break;
+  case KernelStrlen:
+    r.num = item.len;
+    break;
+  case KernelStrtolower:
+    if (item.len) r.data = string_to_lower(item.data, item.len);
+    r.len = item.len;
+    break;
+  case KernelStrtoupper:
+    if (item.len) r.data = string_to_upper(item.data, item.len);
+    r.len = item.len;
+    break;
+  case KernelMd5:
+    r.data = string_md5(item.data, item.len, false, r.len);
+    break;
+  case KernelSha1:
+    r.data = string_sha1(item.data, item.len, false, r.len);
+    break;
+  case KernelCrc32:
+    r.num = (uint32)string_crc32(item.data, item.len);
+    break;
+  default:
+    ASSERT(false);
+    break;
+  }
+}
+
+/**
+ * Converts elements on request thread. Fails on anything whose conversion
+ * could have side effects: arrays raise notices and objects may run
+ * __toString().
+ */
+static bool prepare_items(CArrRef input, Kernel kernel,
+                          vector<String> &strings, vector<Item> &items) {
+  items.resize(input.size());
+  strings.reserve(input.size());
+  int i = 0;
+  for (ArrayIter iter(input); iter; ++iter, ++i) {
+    Variant v(iter.second());
+    if (v.is(KindOfArray) || v.is(KindOfObject)) return false;
+    Item &item = items[i];
+    if (kernel == KernelIntval && !v.isString()) {
+      item.data = NULL;
+      item.len = 0;
+      item.num = v.toInt64();
+    } else {
+      strings.push_back(v.toString());
+      item.data = strings.back().data();
+      item.len = strings.back().size();
+      item.num = 0;
+    }
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// jobs
+
+DECLARE_BOOST_TYPES(ParallelJob);
+class ParallelJob {
+public:
+  virtual ~ParallelJob() {}
+  virtual void run() = 0;
+};
+
+class ParallelWorker {
+public:
+  void onThreadEnter() {}
+  void doJob(ParallelJobPtr job) { job->run();}
+  void onThreadExit() {}
+};
+
+static void run_jobs(ParallelJobPtrVec &jobs) {
+  JobDispatcher<ParallelJob, ParallelWorker>
+    (jobs, RuntimeOption::ParallelArrayThreads).run();
+}
+
+/**
+ * Runs a kernel over items [begin, end). For filtering, only truthiness of
+ * each result is kept, in Result::num.
+ */
+class KernelJob : public ParallelJob {
+public:
+  KernelJob(Kernel kernel, bool filter, const vector<Item> &items,
+            vector<Result> &results, int begin, int end)
+    : m_kernel(kernel), m_filter(filter), m_items(items),
+      m_results(results), m_begin(begin), m_end(end) {
+  }
+
+  virtual void run() {
+    for (int i = m_begin; i < m_end; i++) {
+      Result &r = m_results[i];
+      run_kernel(m_kernel, m_items[i], r);
+      if (m_filter) {
+        if (returns_string(m_kernel)) {
+          r.num = !(r.len == 0 || (r.len == 1 && r.data[0] == '0'));
+          free(r.data);
+          r.data = NULL;
+        } else {
+          r.num = r.num != 0;
+        }
+      }
+    }
+  }
+
+private:
+  Kernel m_kernel;
+  bool m_filter;
+  const vector<Item> &m_items;
+  vector<Result> &m_results;
+  int m_begin;
+  int m_end;
+};
+
+static void run_kernel_jobs(Kernel kernel, bool filter,
+                            const vector<Item> &items,
+                            vector<Result> &results) {
+  int size = items.size();
+  results.resize(size);
+
+  // a few jobs per thread, so one slow range doesn't hold up the rest
+  int count = RuntimeOption::ParallelArrayThreads * 4;
+  int step = (size + count - 1) / count;
+  ParallelJobPtrVec jobs;
+  for (int begin = 0; begin < size; begin += step) {
+    int end = begin + step < size ? begin + step : size;
+    jobs.push_back(ParallelJobPtr(new KernelJob(kernel, filter, items,
+                                                results, begin, end)));
+  }
+  run_jobs(jobs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// map and filter
+
+bool ParallelArray::Map(CArrRef input, CVarRef callback, Variant &ret) {
+  if (!parallel_enabled(input)) return false;
+  Kernel kernel = get_kernel(callback);
+  if (kernel == KernelNone) return false;
+
+  vector<String> strings;
+  vector<Item> items;
+  if (!prepare_items(input, kernel, strings, items)) return false;
+  vector<Result> results;
+  run_kernel_jobs(kernel, false, items, results);
+
+  Array arr = Array::Create();
+  int i = 0;
+  for (ArrayIter iter(input); iter; ++iter, ++i) {
+    Result &r = results[i];
+    if (!returns_string(kernel)) {
+      arr.set(iter.first(), r.num);
+    } else if (r.data) {
+      arr.set(iter.first(), String(r.data, r.len, AttachString));
+    } else {
+      arr.set(iter.first(), "");
+    }
+  }
+  ret = arr;
+  return true;
+}
+
+bool ParallelArray::Filter(CArrRef input, CVarRef callback, Variant &ret) {
+  if (!parallel_enabled(input)) return false;
+  Kernel kernel = get_kernel(callback);
+  if (kernel == KernelNone) return false;
+
+  vector<String> strings;
+  vector<Item> items;
+  if (!prepare_items(input, kernel, strings, items)) return false;
+  vector<Result> results;
+  run_kernel_jobs(kernel, true, items, results);
+
+  Array arr = Array::Create();
+  int i = 0;
+  for (ArrayIter iter(input); iter; ++iter, ++i) {
+    if (results[i].num) {
+      arr.set(iter.first(), iter.second());
+    }
+  }
+  ret = arr;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usort
+
+struct SortItem {
+  const char *data;
+  int len;
+  int pos;
+};
+
+static bool sort_item_less(const SortItem &a, const SortItem &b) {
+  int cmp = string_strcmp(a.data, a.len, b.data, b.len);
+  return cmp ? cmp < 0 : a.pos < b.pos;
+}
+
+class SortJob : public ParallelJob {
+public:
+  SortJob(vector<SortItem> &items, int begin, int end)
+    : m_items(items), m_begin(begin), m_end(end) {
+  }
+
+  virtual void run() {
+    sort(m_items.begin() + m_begin, m_items.begin() + m_end, sort_item_less);
+  }
+
+private:
+  vector<SortItem> &m_items;
+  int m_begin;
+  int m_end;
+};
+
+/**
+ * Merges sorted [begin, mid) and [mid, end) of one buffer into another.
+ */
+class MergeJob : public ParallelJob {
+public:
+  MergeJob(const vector<SortItem> &from, vector<SortItem> &to,
+           int begin, int mid, int end)
+    : m_from(from), m_to(to), m_begin(begin), m_mid(mid), m_end(end) {
+  }
+
+  virtual void run() {
+    merge(m_from.begin() + m_begin, m_from.begin() + m_mid,
+          m_from.begin() + m_mid, m_from.begin() + m_end,
+          m_to.begin() + m_begin, sort_item_less);
+  }
+
+private:
+  const vector<SortItem> &m_from;
+  vector<SortItem> &m_to;
+  int m_begin;
+  int m_mid;
+  int m_end;
+};
+
+bool ParallelArray::Usort(CArrRef input, CVarRef cmp_function, Array &ret) {
+  if (!parallel_enabled(input) || !cmp_function.isString() ||
+      !builtins_intact() ||
+      !is_builtin(cmp_function.toString(), "strcmp")) {
+    return false;
+  }
+
+  int size = input.size();
+  vector<String> strings;
+  strings.reserve(size);
+  vector<SortItem> items(size);
+  int i = 0;
+  for (ArrayIter iter(input); iter; ++iter, ++i) {
+    Variant v(iter.second());
+    if (!v.isString()) return false;
+    strings.push_back(v.toString());
+    items[i].data = strings.back().data();
+    items[i].len = strings.back().size();
+    items[i].pos = i;
+  }
+
+  // one chunk per thread, then pairwise merges until one chunk is left
+  int count = RuntimeOption::ParallelArrayThreads;
+  int step = (size + count - 1) / count;
+  vector<int> bounds;
+  ParallelJobPtrVec jobs;
+  for (int begin = 0; begin < size; begin += step) {
+    int end = begin + step < size ? begin + step : size;
+    bounds.push_back(begin);
+    jobs.push_back(ParallelJobPtr(new SortJob(items, begin, end)));
+  }
+  bounds.push_back(size);
+  run_jobs(jobs);
+
+  vector<SortItem> buffer(size);
+  vector<SortItem> *from = &items;
+  vector<SortItem> *to = &buffer;
+  while (bounds.size() > 2) {
+    vector<int> merged;
+    jobs.clear();
+    int chunks = bounds.size() - 1;
+    for (int k = 0; k < chunks; k += 2) {
+      // an odd chunk out is merged with nothing, which copies it over
+      int mid = bounds[k + 1];
+      int end = k + 2 <= chunks ? bounds[k + 2] : mid;
+      merged.push_back(bounds[k]);
+      jobs.push_back(ParallelJobPtr(new MergeJob(*from, *to, bounds[k],
+                                                 mid, end)));
+    }
+    merged.push_back(size);
+    run_jobs(jobs);
+    bounds.swap(merged);
+    swap(from, to);
+  }
+
+  ret = Array::Create();
+  for (i = 0; i < size; i++) {
+    ret.append(strings[(*from)[i].pos]);
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,57 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_PARALLEL_ARRAY_H__
+#define __HPHP_PARALLEL_ARRAY_H__
+
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Multi-threaded array_map(), array_filter() and usort(). They are only
+ * used when RuntimeOption::ParallelArrayThreads is more than 1, the array
+ * has at least RuntimeOption::ParallelArrayMinSize elements, and callback
+ * is one of a few builtins known to be pure: intval, strlen, strtolower,
+ * strtoupper, md5, sha1 and crc32 for map and filter, strcmp for usort.
+ *
+ * Worker threads never see a Variant. Elements are converted to strings or
+ * integers on request thread first, workers only read raw bytes and produce
+ * plain values or malloc()-ed buffers, and result array is assembled
+ * afterwards in original element order. So results, keys and their order
+ * included, are exactly what serial code produces.
+ *
+ * Each function returns false without touching anything when it can't take
+ * the parallel path, and caller should run the serial one instead.
+ */
+class ParallelArray {
+public:
+  static bool Map(CArrRef input, CVarRef callback, Variant &ret);
+  static bool Filter(CArrRef input, CVarRef callback, Variant &ret);
+
+  /**
+   * usort() with 'strcmp' on an array of strings only, where elements that
+   * compare equal are identical, so it doesn't matter that sort is done by
+   * merging independently sorted chunks.
+   */
+  static bool Usort(CArrRef input, CVarRef cmp_function, Array &ret);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_PARALLEL_ARRAY_H__
@@ -0,0 +1,599 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/typed_vector.h>
+#include <runtime/base/array/zend_array.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/runtime_error.h>
+
+namespace HPHP {
+
+IMPLEMENT_SMART_ALLOCATION(TypedVector, SmartAllocatorImpl::NeedRestoreOnce);
+
+///////////////////////////////////////////////////////////////////////////////
+// packing
+
+DataType TypedVector::KindOf(CVarRef v) {
+  switch (v.getType()) {
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+    return KindOfInt64;
+  case KindOfDouble:
+    return KindOfDouble;
+  case LiteralString:
+  case KindOfStaticString:
+  case KindOfString:
+    return KindOfString;
+  default:
+    break;
+  }
+  return KindOfNull;
+}
+
+TypedVector *TypedVector::Pack(const ArrayData *arr) {
+  ssize_t size = arr->size();
+  // escalation is to ZendArray only
+  if (size < MinSize || !RuntimeOption::UseTypedVector ||
+      !RuntimeOption::UseZendArray) {
+    return NULL;
+  }
+
+  bool supportRef = arr->supportValueRef();
+  TypedVector *ret = NULL;
+  int64 k = 0;
+  for (ssize_t pos = arr->iter_begin(); pos != ArrayData::invalid_index;
+       pos = arr->iter_advance(pos), k++) {
+    Variant key(arr->getKey(pos));
+    if (!key.isInteger() || key.toInt64() != k) break;
+
+    Variant value;
+    if (supportRef) {
+      CVarRef v = arr->getValueRef(pos);
+      if (v.isReferenced()) break;
+      value = v;
+    } else {
+      arr->fetchValue(pos, value);
+    }
+
+    DataType type = KindOf(value);
+    if (!ret) {
+      if (type == KindOfNull) break;
+      ret = NEW(TypedVector)(type, size);
+    } else if (type != ret->m_type) {
+      break;
+    }
+    ret->nextInsert(value);
+  }
+
+  if (k != size) {
+    if (ret) ret->release();
+    return NULL;
+  }
+  return ret;
+}
+
+void TypedVector::PackAll(Variant &v) {
+  if (v.getRawType() != KindOfArray) return;
+  ArrayData *arr = v.getArrayData();
+  if (arr->getCount() > 1) return;
+
+  TypedVector *packed = Pack(arr);
+  if (packed) {
+    v = Array(packed);
+    return;
+  }
+  if (arr->supportValueRef()) {
+    for (ssize_t pos = arr->iter_begin(); pos != ArrayData::invalid_index;
+         pos = arr->iter_advance(pos)) {
+      PackAll(const_cast<Variant&>(arr->getValueRef(pos)));
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// construction/destruction
+
+TypedVector::TypedVector(DataType type, ssize_t capacity)
+  : m_type(type), m_size(0), m_capacity(0), m_elems(NULL), m_linear(false) {
+  ASSERT(type == KindOfInt64 || type == KindOfDouble || type == KindOfString);
+  if (capacity > 0) grow(capacity);
+}
+
+TypedVector::TypedVector(const TypedVector &src)
+  : ArrayData(&src), m_type(src.m_type), m_size(src.m_size),
+    m_capacity(0), m_elems(NULL), m_linear(false) {
+  if (m_size > 0) {
+    grow(m_size);
+    memcpy(m_elems, src.m_elems, m_size * sizeof(Elem));
+    if (m_type == KindOfString) {
+      for (ssize_t i = 0; i < m_size; i++) {
+        m_elems[i].str->incRefCount();
+      }
+    }
+  }
+}
+
+TypedVector::~TypedVector() {
+  if (m_type == KindOfString) {
+    for (ssize_t i = 0; i < m_size; i++) {
+      clear(m_elems[i]);
+    }
+  }
+  if (!m_linear && m_elems) {
+    free(m_elems);
+  }
+}
+
+void TypedVector::grow(ssize_t capacity) {
+  ASSERT(capacity >= m_size);
+  if (m_linear) {
+    Elem *elems = (Elem *)malloc(capacity * sizeof(Elem));
+    memcpy(elems, m_elems, m_size * sizeof(Elem));
+    m_elems = elems;
+    m_linear = false;
+  } else {
+    m_elems = (Elem *)realloc(m_elems, capacity * sizeof(Elem));
+  }
+  m_capacity = capacity;
+}
+
+void TypedVector::store(Elem &e, CVarRef v) {
+  ASSERT(KindOf(v) == m_type);
+  switch (m_type) {
+  case KindOfInt64:
+    e.num = v.toInt64();
+    break;
+  case KindOfDouble:
+    e.dbl = v.toDouble();
+    break;
+  default:
+    if (v.is(LiteralString)) {
+      const char *s = v.getLiteralString();
+      e.str = NEW(StringData)(s, strlen(s), AttachLiteral);
+    } else {
+      e.str = v.getStringData();
+    }
+    e.str->incRefCount();
+    break;
+  }
+}
+
+void TypedVector::clear(Elem &e) {
+  if (m_type == KindOfString && e.str->decRefCount() == 0) {
+    e.str->release();
+  }
+}
+
+void TypedVector::nextInsert(CVarRef v) {
+  prepareElemsForWrite();
+  if (m_size == m_capacity) {
+    grow(m_capacity < MinSize ? MinSize : m_capacity * 2);
+  }
+  store(m_elems[m_size], v);
+  if (m_pos < 0) m_pos = m_size;
+  m_size++;
+}
+
+void TypedVector::assign(ssize_t k, CVarRef v) {
+  ASSERT(inRange(k));
+  prepareElemsForWrite();
+  Elem e;
+  store(e, v);
+  clear(m_elems[k]);
+  m_elems[k] = e;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reads
+
+Variant TypedVector::getKey(ssize_t pos) const {
+  ASSERT(inRange(pos));
+  return (int64)pos;
+}
+
+Variant TypedVector::getValue(ssize_t pos) const {
+  ASSERT(inRange(pos));
+  const Elem &e = m_elems[pos];
+  switch (m_type) {
+  case KindOfInt64:  return e.num;
+  case KindOfDouble: return e.dbl;
+  default:           break;
+  }
+  return e.str;
+}
+
+bool TypedVector::exists(int64 k, int64 prehash /* = -1 */) const {
+  return inRange(k);
+}
+
+bool TypedVector::exists(litstr k, int64 prehash /* = -1 */) const {
+  return false;
+}
+
+bool TypedVector::exists(CStrRef k, int64 prehash /* = -1 */) const {
+  return false;
+}
+
+bool TypedVector::exists(CVarRef k, int64 prehash /* = -1 */) const {
+  return k.isNumeric() && inRange(k.toInt64());
+}
+
+bool TypedVector::idxExists(ssize_t idx) const {
+  return inRange(idx);
+}
+
+Variant TypedVector::get(int64 k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  if (inRange(k)) {
+    return getValue(k);
+  }
+  if (error) {
+    raise_notice("Undefined index: %lld", k);
+  }
+  return null;
+}
+
+Variant TypedVector::get(litstr k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  if (error) {
+    raise_notice("Undefined index: %s", k);
+  }
+  return null;
+}
+
+Variant TypedVector::get(CStrRef k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  if (error) {
+    raise_notice("Undefined index: %s", k.data());
+  }
+  return null;
+}
+
+Variant TypedVector::get(CVarRef k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  if (k.isNumeric()) {
+    int64 index = k.toInt64();
+    if (inRange(index)) {
+      return getValue(index);
+    }
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k.toString().data());
+  }
+  return null;
+}
+
+ssize_t TypedVector::getIndex(int64 k, int64 prehash /* = -1 */) const {
+  return inRange(k) ? k : ArrayData::invalid_index;
+}
+
+ssize_t TypedVector::getIndex(litstr k, int64 prehash /* = -1 */) const {
+  return ArrayData::invalid_index;
+}
+
+ssize_t TypedVector::getIndex(CStrRef k, int64 prehash /* = -1 */) const {
+  return ArrayData::invalid_index;
+}
+
+ssize_t TypedVector::getIndex(CVarRef k, int64 prehash /* = -1 */) const {
+  if (k.isNumeric()) {
+    return getIndex(k.toInt64(), prehash);
+  }
+  return ArrayData::invalid_index;
+}
+
+void TypedVector::getFullPos(FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("TypedVector should have been escalated");
+}
+
+bool TypedVector::setFullPos(const FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("TypedVector should have been escalated");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// escalation
+
+ArrayData *TypedVector::escalate(bool mutableIteration /* = false */) const {
+  return escalateToZendArray();
+}
+
+ArrayData *TypedVector::escalateToZendArray() const {
+  ASSERT(RuntimeOption::UseZendArray);
+  ZendArray *ret = NEW(ZendArray)(m_size);
+  for (ssize_t i = 0; i < m_size; i++) {
+    ret->append(getValue(i), false);
+  }
+  // ZendArray's positions are Bucket pointers, and NULL is past the end.
+  ret->setPosition(inRange(m_pos) ? ret->getIndex((int64)m_pos) : 0);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writes
+
+ArrayData *TypedVector::lval(Variant *&ret, bool copy) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(ret, false);
+  return a;
+}
+
+ArrayData *TypedVector::lval(int64 k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(k, ret, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::lval(litstr k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(k, ret, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::lval(CStrRef k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(k, ret, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::lval(CVarRef k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(k, ret, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::set(int64 k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  if (k >= 0 && k <= m_size && storable(v)) {
+    TypedVector *result = copy ? copyImpl() : NULL;
+    TypedVector *a = result ? result : this;
+    if (k == m_size) {
+      a->nextInsert(v);
+    } else {
+      a->assign(k, v);
+    }
+    return result;
+  }
+  ArrayData *a = escalateToZendArray();
+  a->set(k, v, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::set(litstr k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  ArrayData *a = escalateToZendArray();
+  a->set(k, v, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::set(CStrRef k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  ArrayData *a = escalateToZendArray();
+  a->set(k, v, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::set(CVarRef k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return set(k.toInt64(), v, copy, prehash);
+  }
+  if (k.is(LiteralString)) {
+    return set(k.getLiteralString(), v, copy, prehash);
+  }
+  return set(k.toString(), v, copy, prehash);
+}
+
+ArrayData *TypedVector::remove(int64 k, bool copy, int64 prehash /* = -1 */) {
+  if (!inRange(k)) return NULL;
+  // Even the last element, as unset() doesn't give its key back to append().
+  ArrayData *a = escalateToZendArray();
+  a->remove(k, false, prehash);
+  return a;
+}
+
+ArrayData *TypedVector::remove(litstr k, bool copy, int64 prehash /* = -1 */) {
+  return NULL;
+}
+
+ArrayData *TypedVector::remove(CStrRef k, bool copy,
+                               int64 prehash /* = -1 */) {
+  return NULL;
+}
+
+ArrayData *TypedVector::remove(CVarRef k, bool copy,
+                               int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return remove(k.toInt64(), copy, prehash);
+  }
+  return NULL;
+}
+
+ArrayData *TypedVector::copy() const {
+  return copyImpl();
+}
+
+ArrayData *TypedVector::append(CVarRef v, bool copy) {
+  if (storable(v)) {
+    if (copy) {
+      TypedVector *a = copyImpl();
+      a->nextInsert(v);
+      return a;
+    }
+    nextInsert(v);
+    return NULL;
+  }
+  ArrayData *a = escalateToZendArray();
+  a->append(v, false);
+  return a;
+}
+
+ArrayData *TypedVector::append(const ArrayData *elems, ArrayOp op,
+                               bool copy) {
+  const TypedVector *vec = dynamic_cast<const TypedVector *>(elems);
+  if (!vec || vec->m_type != m_type) {
+    ArrayData *a = escalateToZendArray();
+    a->append(elems, op, false);
+    return a;
+  }
+
+  // Plus only adds the keys this vector doesn't have yet.
+  ssize_t start = op == Plus ? m_size : 0;
+  if (start >= vec->m_size) return NULL;
+  if (copy) {
+    TypedVector *a = copyImpl();
+    a->append(elems, op, false);
+    return a;
+  }
+
+  ssize_t count = vec->m_size - start;
+  prepareElemsForWrite();
+  if (m_size + count > m_capacity) grow(m_size + count);
+  memcpy(m_elems + m_size, vec->m_elems + start, count * sizeof(Elem));
+  if (m_type == KindOfString) {
+    for (ssize_t i = m_size; i < m_size + count; i++) {
+      m_elems[i].str->incRefCount();
+    }
+  }
+  if (m_pos < 0) m_pos = m_size;
+  m_size += count;
+  return NULL;
+}
+
+ArrayData *TypedVector::pop(Variant &value) {
+  if (m_size == 0) {
+    value = null;
+    return NULL;
+  }
+  if (getCount() > 1) {
+    TypedVector *a = copyImpl();
+    a->pop(value);
+    return a;
+  }
+  value = getValue(m_size - 1);
+  clear(m_elems[--m_size]);
+  if (m_pos >= m_size) m_pos = ArrayData::invalid_index;
+  return NULL;
+}
+
+ArrayData *TypedVector::dequeue(Variant &value) {
+  if (m_size == 0) {
+    value = null;
+    return NULL;
+  }
+  if (getCount() > 1) {
+    TypedVector *a = copyImpl();
+    a->dequeue(value);
+    return a;
+  }
+  value = getValue(0);
+  prepareElemsForWrite();
+  clear(m_elems[0]);
+  memmove(m_elems, m_elems + 1, (--m_size) * sizeof(Elem));
+  if (m_pos > 0) m_pos--;
+  return NULL;
+}
+
+ArrayData *TypedVector::prepend(CVarRef v, bool copy) {
+  if (!storable(v)) {
+    ArrayData *a = escalateToZendArray();
+    a->prepend(v, false);
+    return a;
+  }
+  if (copy) {
+    TypedVector *a = copyImpl();
+    a->prepend(v, false);
+    return a;
+  }
+
+  prepareElemsForWrite();
+  if (m_size == m_capacity) {
+    grow(m_capacity < MinSize ? MinSize : m_capacity * 2);
+  }
+  memmove(m_elems + 1, m_elems, m_size * sizeof(Elem));
+  store(m_elems[0], v);
+  m_size++;
+  if (m_pos < 0 || m_size == 1) {
+    m_pos = 0;
+  } else {
+    m_pos++;
+  }
+  return NULL;
+}
+
+bool TypedVector::reorder(const std::vector<ssize_t> &positions,
+                          bool renumber) {
+  // keeping old keys in a new order would no longer be a vector
+  if (!renumber) return false;
+  ASSERT((ssize_t)positions.size() == m_size);
+
+  Elem *elems = (Elem *)malloc(m_capacity * sizeof(Elem));
+  for (ssize_t i = 0; i < m_size; i++) {
+    elems[i] = m_elems[positions[i]];
+  }
+  if (!m_linear) free(m_elems);
+  m_elems = elems;
+  m_linear = false;
+  m_pos = 0;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// misc
+
+void TypedVector::onSetStatic() {
+  if (m_type == KindOfString) {
+    for (ssize_t i = 0; i < m_size; i++) {
+      m_elems[i].str->setStatic();
+    }
+  }
+}
+
+bool TypedVector::calculate(int &size) {
+  size += m_capacity * sizeof(Elem);
+  return true;
+}
+
+void TypedVector::backup(LinearAllocator &allocator) {
+  allocator.backup((const char*)m_elems, m_capacity * sizeof(Elem));
+}
+
+void TypedVector::restore(const char *&data) {
+  m_elems = (Elem *)data;
+  data += m_capacity * sizeof(Elem);
+  m_linear = true;
+}
+
+void TypedVector::sweep() {
+  if (!m_linear && m_elems) {
+    free(m_elems);
+    m_elems = NULL;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
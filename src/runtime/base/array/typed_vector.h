@@ -0,0 +1,176 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_TYPED_VECTOR_H__
+#define __HPHP_TYPED_VECTOR_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/array/array_data.h>
+#include <runtime/base/memory/smart_allocator.h>
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An array with keys 0, 1, 2, ... whose values are all integers, all doubles
+ * or all strings, stored unboxed in one contiguous block: 8 bytes an element,
+ * instead of a Variant inside a ZendArray::Bucket.
+ *
+ * Anything it can't hold escalates it to ZendArray, the same way SmallArray
+ * does when it grows: a value of another type or a reference, a string key or
+ * a key past the end, removing anything but the last element, and lval(),
+ * since there is no Variant to point into.
+ */
+class TypedVector : public ArrayData {
+public:
+  /**
+   * Smaller arrays are better off as SmallArray.
+   */
+  static const int MinSize = 8;
+
+  /**
+   * What a value is stored as: KindOfInt64, KindOfDouble, KindOfString, or
+   * KindOfNull if it can't be stored unboxed.
+   */
+  static DataType KindOf(CVarRef v);
+
+  /**
+   * A TypedVector with the same elements as arr, or NULL if arr is too small,
+   * is not a vector or does not have values all of one storable type.
+   */
+  static TypedVector *Pack(const ArrayData *arr);
+
+  /**
+   * Replaces every array inside v, v included, that nobody else is holding
+   * with its TypedVector, when Pack() can make one. Arrays are only looked
+   * into through other arrays, and v must not contain any references.
+   */
+  static void PackAll(Variant &v);
+
+  TypedVector(DataType type, ssize_t capacity);
+  TypedVector(const TypedVector &src);
+  virtual ~TypedVector();
+
+  DataType getElemType() const { return m_type;}
+
+  virtual ssize_t size() const { return m_size;}
+
+  virtual Variant getKey(ssize_t pos) const;
+  virtual Variant getValue(ssize_t pos) const;
+  virtual bool isVectorData() const { return true;}
+
+  virtual bool exists(int64   k, int64 prehash = -1) const;
+  virtual bool exists(litstr  k, int64 prehash = -1) const;
+  virtual bool exists(CStrRef k, int64 prehash = -1) const;
+  virtual bool exists(CVarRef k, int64 prehash = -1) const;
+
+  virtual bool idxExists(ssize_t idx) const;
+
+  virtual Variant get(int64   k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(litstr  k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CStrRef k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CVarRef k, int64 prehash = -1, bool error = false) const;
+
+  virtual ssize_t getIndex(int64   k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(litstr  k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CStrRef k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CVarRef k, int64 prehash = -1) const;
+
+  virtual ArrayData *lval(Variant *&ret, bool copy);
+  virtual ArrayData *lval(int64   k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(litstr  k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CStrRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CVarRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+
+  virtual ArrayData *set(int64   k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(litstr  k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CStrRef k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CVarRef k, CVarRef v, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *remove(int64   k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(litstr  k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CStrRef k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CVarRef k, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *copy() const;
+  virtual ArrayData *append(CVarRef v, bool copy);
+  virtual ArrayData *append(const ArrayData *elems, ArrayOp op, bool copy);
+  virtual ArrayData *pop(Variant &value);
+  virtual ArrayData *dequeue(Variant &value);
+  virtual ArrayData *prepend(CVarRef v, bool copy);
+  virtual bool reorder(const std::vector<ssize_t> &positions, bool renumber);
+  virtual void onSetStatic();
+
+  virtual void getFullPos(FullPos &pos);
+  virtual bool setFullPos(const FullPos &pos);
+
+  /**
+   * Values can't be referenced in place, so any escalation is to ZendArray.
+   */
+  virtual ArrayData *escalate(bool mutableIteration = false) const;
+
+  /**
+   * Memory allocator methods.
+   */
+  DECLARE_SMART_ALLOCATION(TypedVector, SmartAllocatorImpl::NeedRestoreOnce);
+  bool calculate(int &size);
+  void backup(LinearAllocator &allocator);
+  void restore(const char *&data);
+  void sweep();
+
+private:
+  union Elem {
+    int64       num;
+    double      dbl;
+    StringData *str;
+  };
+
+  DataType m_type;
+  ssize_t  m_size;
+  ssize_t  m_capacity;
+  Elem    *m_elems;
+  bool     m_linear; // m_elems is in LinearAllocator's memory
+
+  ArrayData *escalateToZendArray() const;
+
+  TypedVector *copyImpl() const {
+    TypedVector *a = NEW(TypedVector)(*this);
+    a->_count = 0;
+    return a;
+  }
+
+  bool inRange(int64 k) const { return k >= 0 && k < m_size;}
+  bool storable(CVarRef v) const {
+    return !v.isContagious() && KindOf(v) == m_type;
+  }
+
+  void grow(ssize_t capacity);
+  void prepareElemsForWrite() { if (m_linear) grow(m_capacity);}
+  inline void store(Elem &e, CVarRef v);
+  inline void clear(Elem &e);
+  inline void nextInsert(CVarRef v);
+  inline void assign(ssize_t k, CVarRef v);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_TYPED_VECTOR_H__
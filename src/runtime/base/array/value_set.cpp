@@ -0,0 +1,80 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/value_set.h>
+#include <util/hash.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+size_t ValueSet::StringHash::operator()(CStrRef s) const {
+  return hash_string(s.data(), s.size());
+}
+
+bool ValueSet::Normalize(CVarRef v, int64 &n, String &s) {
+  switch (v.getType()) {
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+    n = v.toInt64();
+    // the only two integers is_strictly_integer() doesn't take back
+    if (n != LLONG_MAX && n != LLONG_MIN) return true;
+    s = String(n);
+    return false;
+  default:
+    s = v.toString();
+    break;
+  }
+  return is_strictly_integer(s.data(), s.size(), n);
+}
+
+ValueSet::ValueSet(CArrRef arr) {
+  for (ArrayIter iter(arr); iter; ++iter) {
+    insert(iter.second());
+  }
+}
+
+bool ValueSet::insert(CVarRef v) {
+  int64 n;
+  String s;
+  if (Normalize(v, n, s)) {
+    return m_ints.insert(n).second;
+  }
+  return m_strings.insert(s).second;
+}
+
+bool ValueSet::contains(CVarRef v) const {
+  int64 n;
+  String s;
+  if (Normalize(v, n, s)) {
+    return m_ints.find(n) != m_ints.end();
+  }
+  return m_strings.find(s) != m_strings.end();
+}
+
+bool ValueSet::Equal(CVarRef v1, CVarRef v2) {
+  int64 n1, n2;
+  String s1, s2;
+  bool int1 = Normalize(v1, n1, s1);
+  bool int2 = Normalize(v2, n2, s2);
+  if (int1 != int2) return false;
+  if (int1) return n1 == n2;
+  return StringEqual()(s1, s2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
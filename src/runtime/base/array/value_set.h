@@ -0,0 +1,77 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_VALUE_SET_H__
+#define __HPHP_VALUE_SET_H__
+
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A set of array values compared the way array_unique(), array_diff() and
+ * array_intersect() compare them: (string)$v1 === (string)$v2.
+ *
+ * Values are hashed directly instead of being converted to strings and
+ * stored into a PHP array. Integers, and strings that are integers in
+ * canonical form, are kept in a set of int64, so an integer never has to
+ * be turned into a string.
+ */
+class ValueSet {
+public:
+  ValueSet() {}
+
+  /**
+   * All values of an array.
+   */
+  explicit ValueSet(CArrRef arr);
+
+  /**
+   * Returns false if an equal value was already in the set.
+   */
+  bool insert(CVarRef v);
+  bool contains(CVarRef v) const;
+
+  /**
+   * Whether two values have the same string form.
+   */
+  static bool Equal(CVarRef v1, CVarRef v2);
+
+private:
+  struct StringHash {
+    size_t operator()(CStrRef s) const;
+  };
+  struct StringEqual {
+    bool operator()(CStrRef s1, CStrRef s2) const {
+      return s1.size() == s2.size() && !memcmp(s1.data(), s2.data(), s1.size());
+    }
+  };
+
+  hphp_hash_set<int64, int64_hash> m_ints;
+  hphp_hash_set<String, StringHash, StringEqual> m_strings;
+
+  /**
+   * Either sets n and returns true if value's string form is an integer, or
+   * sets s to that string form and returns false.
+   */
+  static bool Normalize(CVarRef v, int64 &n, String &s);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_VALUE_SET_H__
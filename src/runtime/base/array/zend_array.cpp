@@ -35,8 +35,10 @@ StaticEmptyZendArray StaticEmptyZendArray::s_theEmptyArray;
 // construction/destruciton
 
 ZendArray::ZendArray(uint nSize /* = 0 */) :
-  m_nNumOfElements(0), m_nNextFreeElement(0),
-  m_pListHead(NULL), m_pListTail(NULL), m_arBuckets(NULL), m_linear(false) {
+  m_nNumOfElements(0), m_nNextFreeElement(0), m_nKeyOffset(0),
+  m_pListHead(NULL), m_pListTail(NULL), m_arBuckets(NULL),
+  m_arOldBuckets(NULL), m_nOldTableMask(0), m_nRehashPos(0),
+  m_linear(false), m_vector(true) {
 
   if (nSize >= 0x80000000) {
     m_nTableSize = 0x80000000; // prevent overflow
@@ -61,6 +63,9 @@ ZendArray::~ZendArray() {
   if (!m_linear && m_arBuckets) {
     free(m_arBuckets);
   }
+  if (m_arOldBuckets) {
+    free(m_arOldBuckets);
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -100,7 +105,7 @@ Variant ZendArray::getKey(ssize_t pos) const {
   if (p->key) {
     return p->key;
   }
-  return (int64)p->h;
+  return (int64)p->h - m_nKeyOffset;
 }
 
 Variant ZendArray::getValue(ssize_t pos) const {
@@ -122,7 +127,8 @@ CVarRef ZendArray::getValueRef(ssize_t pos) const {
 }
 
 bool ZendArray::isVectorData() const {
-  int64 index = 0;
+  if (m_vector) return true;
+  int64 index = m_nKeyOffset;
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
     if (p->key || p->h != index++) return false;
   }
@@ -175,7 +181,7 @@ Variant ZendArray::key() const {
     if (p->key) {
       return p->key;
     }
-    return (int64)p->h;
+    return (int64)p->h - m_nKeyOffset;
   }
   return null;
 }
@@ -226,15 +232,40 @@ static bool hit_string_key(const ZendArray::Bucket *p, const char *k, int len,
          memcmp(data, k, len) == 0);
 }
 
+int ZendArray::getChains(int64 h, Bucket **chains[2]) const {
+  chains[0] = &m_arBuckets[h & m_nTableMask];
+  if (m_arOldBuckets) {
+    uint nIndex = (h & m_nOldTableMask);
+    if (nIndex >= m_nRehashPos) {
+      chains[1] = &m_arOldBuckets[nIndex];
+      return 2;
+    }
+  }
+  return 1;
+}
+
 ZendArray::Bucket *ZendArray::find(int64 h) const {
-  for (Bucket *p = m_arBuckets[h & m_nTableMask]; p; p = p->pNext) {
-    if (p->key == NULL && p->h == h) {
-      return p;
+  h += m_nKeyOffset;
+  Bucket **chains[2];
+  int count = getChains(h, chains);
+  for (int i = 0; i < count; i++) {
+    for (Bucket *p = *chains[i]; p; p = p->pNext) {
+      if (p->key == NULL && p->h == h) {
+        return p;
+      }
     }
   }
   return NULL;
 }
 
+/**
+ * Hash of a string key. Strings keep their hash once computed, so a key
+ * that is looked up many times is only hashed once.
+ */
+static inline int64 key_hash(const StringData *key, int64 prehash) {
+  return prehash >= 0 || key == NULL ? prehash : key->hash();
+}
+
 ZendArray::Bucket *ZendArray::find(const char *k, int len,
                                    int64 prehash /* = -1 */,
                                    int64 *h /* = NULL */) const {
@@ -244,21 +275,30 @@ ZendArray::Bucket *ZendArray::find(const char *k, int len,
       *h = prehash;
     }
   }
-  for (Bucket *p = m_arBuckets[prehash & m_nTableMask]; p; p = p->pNext) {
-    if (hit_string_key(p, k, len, prehash)) return p;
+  Bucket **chains[2];
+  int count = getChains(prehash, chains);
+  for (int i = 0; i < count; i++) {
+    for (Bucket *p = *chains[i]; p; p = p->pNext) {
+      if (hit_string_key(p, k, len, prehash)) return p;
+    }
   }
   return NULL;
 }
 
 ZendArray::Bucket ** ZendArray::findForErase(int64 h) const {
-  Bucket ** ret = &(m_arBuckets[h & m_nTableMask]);
-  Bucket * p = *ret;
-  while (p) {
-    if (p->key == NULL && p->h == h) {
-      return ret;
+  h += m_nKeyOffset;
+  Bucket **chains[2];
+  int count = getChains(h, chains);
+  for (int i = 0; i < count; i++) {
+    Bucket ** ret = chains[i];
+    Bucket * p = *ret;
+    while (p) {
+      if (p->key == NULL && p->h == h) {
+        return ret;
+      }
+      ret = &(p->pNext);
+      p = *ret;
     }
-    ret = &(p->pNext);
-    p = *ret;
   }
   return NULL;
 }
@@ -272,12 +312,16 @@ ZendArray::Bucket ** ZendArray::findForErase(const char *k, int len,
       *h = prehash;
     }
   }
-  Bucket ** ret = &(m_arBuckets[prehash & m_nTableMask]);
-  Bucket * p = *ret;
-  while (p) {
-    if (hit_string_key(p, k, len, prehash)) return ret;
-    ret = &(p->pNext);
-    p = *ret;
+  Bucket **chains[2];
+  int count = getChains(prehash, chains);
+  for (int i = 0; i < count; i++) {
+    Bucket ** ret = chains[i];
+    Bucket * p = *ret;
+    while (p) {
+      if (hit_string_key(p, k, len, prehash)) return ret;
+      ret = &(p->pNext);
+      p = *ret;
+    }
   }
   return NULL;
 }
@@ -285,13 +329,16 @@ ZendArray::Bucket ** ZendArray::findForErase(const char *k, int len,
 ZendArray::Bucket ** ZendArray::findForErase(Bucket * bucketPtr) const {
   if (bucketPtr == NULL)
     return NULL;
-  int64 h = bucketPtr->h;
-  Bucket ** ret = &(m_arBuckets[h & m_nTableMask]);
-  Bucket * p = *ret;
-  while (p) {
-    if (p == bucketPtr) return ret;
-    ret = &(p->pNext);
-    p = *ret;
+  Bucket **chains[2];
+  int count = getChains(bucketPtr->h, chains);
+  for (int i = 0; i < count; i++) {
+    Bucket ** ret = chains[i];
+    Bucket * p = *ret;
+    while (p) {
+      if (p == bucketPtr) return ret;
+      ret = &(p->pNext);
+      p = *ret;
+    }
   }
   return NULL;
 }
@@ -305,13 +352,13 @@ bool ZendArray::exists(litstr k, int64 prehash /* = -1 */) const {
 }
 
 bool ZendArray::exists(CStrRef k, int64 prehash /* = -1 */) const {
-  return find(k.data(), k.size(), prehash);
+  return find(k.data(), k.size(), key_hash(k.get(), prehash));
 }
 
 bool ZendArray::exists(CVarRef k, int64 prehash /* = -1 */) const {
   if (k.isNumeric()) return find(k.toInt64());
   String key = k.toString();
-  return find(key.data(), key.size(), prehash);
+  return find(key.data(), key.size(), key_hash(key.get(), prehash));
 }
 
 bool ZendArray::idxExists(ssize_t idx) const {
@@ -345,8 +392,7 @@ Variant ZendArray::get(litstr k, int64 prehash /* = -1 */,
 Variant ZendArray::get(CStrRef k, int64 prehash /* = -1 */,
                        bool error /* = false */) const {
   StringData *key = k.get();
-  if (key->isStatic()) prehash = key->getStaticHash();
-  Bucket *p = find(key->data(), key->size(), prehash);
+  Bucket *p = find(key->data(), key->size(), key_hash(key, prehash));
   if (p) {
     return p->data;
   }
@@ -364,8 +410,7 @@ Variant ZendArray::get(CVarRef k, int64 prehash /* = -1 */,
   } else {
     String key = k.toString();
     StringData *strkey = key.get();
-    if (strkey->isStatic()) prehash = key->getStaticHash();
-    p = find(strkey->data(), strkey->size(), prehash);
+    p = find(strkey->data(), strkey->size(), key_hash(strkey, prehash));
   }
   if (p) {
     return p->data;
@@ -393,7 +438,7 @@ ssize_t ZendArray::getIndex(litstr k, int64 prehash /* = -1 */) const {
 }
 
 ssize_t ZendArray::getIndex(CStrRef k, int64 prehash /* = -1 */) const {
-  Bucket *p = find(k.data(), k.size(), prehash);
+  Bucket *p = find(k.data(), k.size(), key_hash(k.get(), prehash));
   if (p) {
     return (ssize_t)p;
   }
@@ -406,7 +451,7 @@ ssize_t ZendArray::getIndex(CVarRef k, int64 prehash /* = -1 */) const {
     p = find(k.toInt64());
   } else {
     String key = k.toString();
-    p = find(key.data(), key.size(), prehash);
+    p = find(key.data(), key.size(), key_hash(key.get(), prehash));
   }
   if (p) {
     return (ssize_t)p;
@@ -447,7 +492,23 @@ do {                                                                    \
 } while (0)
 
 void ZendArray::resize() {
+  if (m_arOldBuckets) {
+    finishRehash();
+  }
   int curSize = m_nTableSize * sizeof(Bucket *);
+  if (!m_linear && m_nTableSize >= IncrementalRehashSize) {
+    // Keep the old table, and move its slots over a few at a time as more
+    // elements are inserted, instead of relinking all of them right now.
+    m_arOldBuckets = m_arBuckets;
+    m_nOldTableMask = m_nTableMask;
+    m_nRehashPos = 0;
+    m_arBuckets = (Bucket **)calloc(m_nTableSize << 1, sizeof(Bucket *));
+    m_nTableSize <<= 1;
+    m_nTableMask = m_nTableSize - 1;
+    rehashStep();
+    return;
+  }
+
   // No need to use calloc() or memset(), as rehash() is going to clear
   // m_arBuckets any way.
   if (m_linear) {
@@ -461,7 +522,39 @@ void ZendArray::resize() {
   rehash();
 }
 
+void ZendArray::rehashStep() {
+  ASSERT(m_arOldBuckets && !m_linear);
+  // The old table has half as many slots as the new one has room for
+  // elements, so moving two slots per insertion always finishes before
+  // the table needs to grow again.
+  uint oldSize = m_nOldTableMask + 1;
+  for (int i = 0; i < 2 && m_nRehashPos < oldSize; i++) {
+    Bucket *p = m_arOldBuckets[m_nRehashPos++];
+    while (p) {
+      Bucket *next = p->pNext;
+      uint nIndex = (p->h & m_nTableMask);
+      CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
+      m_arBuckets[nIndex] = p;
+      p = next;
+    }
+  }
+  if (m_nRehashPos == oldSize) {
+    free(m_arOldBuckets);
+    m_arOldBuckets = NULL;
+  }
+}
+
+void ZendArray::finishRehash() {
+  while (m_arOldBuckets) {
+    rehashStep();
+  }
+}
+
 void ZendArray::rehash() {
+  if (m_arOldBuckets) {
+    free(m_arOldBuckets);
+    m_arOldBuckets = NULL;
+  }
   memset(m_arBuckets, 0, m_nTableSize * sizeof(Bucket *));
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
     uint nIndex = (p->h & m_nTableMask);
@@ -473,14 +566,16 @@ void ZendArray::rehash() {
 bool ZendArray::nextInsert(CVarRef data) {
   int64 h = m_nNextFreeElement;
   Bucket * p = NEW(Bucket)(data);
-  p->h = h;
-  uint nIndex = (h & m_nTableMask);
+  p->h = h + m_nKeyOffset;
+  uint nIndex = (p->h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
   m_nNextFreeElement = h + 1;
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -496,11 +591,14 @@ bool ZendArray::addLval(int64 h, Variant **pDest, bool doFind /* = true */) {
     }
   }
   p = NEW(Bucket)();
-  p->h = h;
+  p->h = h + m_nKeyOffset;
   if (pDest) {
     *pDest = &p->data;
   }
-  uint nIndex = (h & m_nTableMask);
+  if (h != (int64)m_nNextFreeElement) {
+    m_vector = false;
+  }
+  uint nIndex = (p->h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
@@ -509,6 +607,8 @@ bool ZendArray::addLval(int64 h, Variant **pDest, bool doFind /* = true */) {
   }
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -530,6 +630,7 @@ bool ZendArray::addLval(litstr key, int len, int64 h, Variant **pDest,
   p->key = NEW(StringData)(key, len, AttachLiteral);
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
   *pDest = &p->data;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -537,6 +638,8 @@ bool ZendArray::addLval(litstr key, int len, int64 h, Variant **pDest,
   CONNECT_TO_GLOBAL_DLLIST(p);
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -544,6 +647,7 @@ bool ZendArray::addLval(litstr key, int len, int64 h, Variant **pDest,
 bool ZendArray::addLval(StringData *key, int64 h, Variant **pDest,
                         bool doFind /* = true */) {
   ASSERT(key != NULL && pDest != NULL);
+  h = key_hash(key, h);
   Bucket *p;
   if (doFind) {
     p = find(key->data(), key->size(), h, &h);
@@ -560,6 +664,7 @@ bool ZendArray::addLval(StringData *key, int64 h, Variant **pDest,
   }
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
   *pDest = &p->data;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -567,6 +672,8 @@ bool ZendArray::addLval(StringData *key, int64 h, Variant **pDest,
   CONNECT_TO_GLOBAL_DLLIST(p);
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -577,8 +684,11 @@ bool ZendArray::add(int64 h, CVarRef data) {
     return false;
   }
   p = NEW(Bucket)(data);
-  p->h = h;
-  uint nIndex = (h & m_nTableMask);
+  p->h = h + m_nKeyOffset;
+  if (h != (int64)m_nNextFreeElement) {
+    m_vector = false;
+  }
+  uint nIndex = (p->h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
@@ -587,6 +697,8 @@ bool ZendArray::add(int64 h, CVarRef data) {
   }
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -601,17 +713,21 @@ bool ZendArray::add(litstr key, int64 h, CVarRef data) {
   p->key = NEW(StringData)(key, len, AttachLiteral);
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
 
 bool ZendArray::add(StringData *key, int64 h, CVarRef data) {
+  h = key_hash(key, h);
   Bucket *p = find(key->data(), key->size(), h, &h);
   if (p) {
     return false;
@@ -624,12 +740,15 @@ bool ZendArray::add(StringData *key, int64 h, CVarRef data) {
   }
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -642,9 +761,12 @@ bool ZendArray::update(int64 h, CVarRef data) {
   }
 
   p = NEW(Bucket)(data);
-  p->h = h;
+  p->h = h + m_nKeyOffset;
+  if (h != (int64)m_nNextFreeElement) {
+    m_vector = false;
+  }
 
-  uint nIndex = (h & m_nTableMask);
+  uint nIndex = (p->h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   CONNECT_TO_GLOBAL_DLLIST(p);
@@ -654,6 +776,8 @@ bool ZendArray::update(int64 h, CVarRef data) {
   }
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -670,6 +794,7 @@ bool ZendArray::update(litstr key, int64 h, CVarRef data) {
   p->key = NEW(StringData)(key, len, AttachLiteral);
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
 
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -678,12 +803,14 @@ bool ZendArray::update(litstr key, int64 h, CVarRef data) {
 
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
 
 bool ZendArray::update(StringData *key, int64 h, CVarRef data) {
-  if (key->isStatic()) h = key->getStaticHash();
+  h = key_hash(key, h);
   Bucket *p = find(key->data(), key->size(), h, &h);
   if (p) {
     p->data = data;
@@ -698,6 +825,7 @@ bool ZendArray::update(StringData *key, int64 h, CVarRef data) {
   }
   p->key->incRefCount();
   p->h = h;
+  m_vector = false;
 
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -706,6 +834,8 @@ bool ZendArray::update(StringData *key, int64 h, CVarRef data) {
 
   if (++m_nNumOfElements > m_nTableSize) {
     resize();
+  } else if (m_arOldBuckets) {
+    rehashStep();
   }
   return true;
 }
@@ -748,7 +878,7 @@ ArrayData *ZendArray::lval(CStrRef k, Variant *&ret, bool copy,
                            int64 prehash /* = -1 */,
                            bool checkExist /* = false */) {
   StringData *key = k.get();
-  if (key->isStatic()) prehash = key->getStaticHash();
+  prehash = key_hash(key, prehash);
   if (!copy) {
     addLval(key, prehash, &ret);
     return NULL;
@@ -893,6 +1023,7 @@ void ZendArray::erase(Bucket ** prev) {
       m_pos = (ssize_t)p->pListNext;
     }
     m_nNumOfElements--;
+    m_vector = false;
 
     DELETE(Bucket)(p);
   }
@@ -924,11 +1055,12 @@ ArrayData *ZendArray::remove(CStrRef k, bool copy, int64 prehash /* = -1 */) {
   if (copy) {
     ZendArray *a = copyImpl();
     a->prepareBucketHeadsForWrite();
-    a->erase(a->findForErase(k.data(), k.size(), prehash));
+    a->erase(a->findForErase(k.data(), k.size(),
+                             key_hash(k.get(), prehash)));
     return a;
   }
   prepareBucketHeadsForWrite();
-  erase(findForErase(k.data(), k.size(), prehash));
+  erase(findForErase(k.data(), k.size(), key_hash(k.get(), prehash)));
   return NULL;
 }
 
@@ -957,6 +1089,7 @@ ArrayData *ZendArray::remove(CVarRef k, bool copy, int64 prehash /* = -1 */) {
     return NULL;
   } else {
     String key = k.toString();
+    prehash = key_hash(key.get(), prehash);
     if (copy) {
       ZendArray *a = copyImpl();
       a->prepareBucketHeadsForWrite();
@@ -981,13 +1114,15 @@ ZendArray *ZendArray::copyImpl() const {
       p->data.setContagious();
     }
     Bucket *np = NEW(Bucket)(p->data);
-    np->h = p->h;
     if (p->key) {
+      np->h = p->h;
       np->key = p->key;
       np->key->incRefCount();
+    } else {
+      np->h = p->h - m_nKeyOffset;
     }
 
-    uint nIndex = (p->h & target->m_nTableMask);
+    uint nIndex = (np->h & target->m_nTableMask);
     np->pNext = target->m_arBuckets[nIndex];
     target->m_arBuckets[nIndex] = np;
 
@@ -1005,6 +1140,7 @@ ZendArray *ZendArray::copyImpl() const {
 
   target->m_nNumOfElements = m_nNumOfElements;
   target->m_nNextFreeElement = m_nNextFreeElement;
+  target->m_vector = m_vector;
 
   Bucket *p = reinterpret_cast<Bucket *>(m_pos);
   if (p == NULL) {
@@ -1017,7 +1153,7 @@ ZendArray *ZendArray::copyImpl() const {
                                             p->key->size(),
                                             (int64)p->h);
     } else {
-      target->m_pos = (ssize_t)target->find((int64)p->h);
+      target->m_pos = (ssize_t)target->find((int64)p->h - m_nKeyOffset);
     }
   }
   return target;
@@ -1102,11 +1238,14 @@ ArrayData *ZendArray::pop(Variant &value) {
   }
   if (m_pListTail) {
     value = m_pListTail->data;
-    if (!m_pListTail->key && (uint)m_pListTail->h == m_nNextFreeElement - 1) {
+    if (!m_pListTail->key &&
+        (uint)(m_pListTail->h - m_nKeyOffset) == m_nNextFreeElement - 1) {
       m_nNextFreeElement--;
     }
+    bool vector = m_vector;
     prepareBucketHeadsForWrite();
     erase(findForErase(m_pListTail));
+    m_vector = vector;
   } else {
     value = null;
   }
@@ -1121,9 +1260,18 @@ ArrayData *ZendArray::dequeue(Variant &value) {
   }
   if (m_pListHead) {
     value = m_pListHead->data;
+    bool vector = m_vector;
     prepareBucketHeadsForWrite();
     erase(findForErase(m_pListHead));
-    renumber();
+    if (vector) {
+      // Keys were 0, 1, 2, ..., so renumbering would only decrement every
+      // one of them. Shift the mapping from keys to hashes instead.
+      m_nKeyOffset++;
+      m_nNextFreeElement--;
+      m_vector = true;
+    } else {
+      renumber();
+    }
   } else {
     value = null;
   }
@@ -1171,15 +1319,57 @@ ArrayData *ZendArray::prepend(CVarRef v, bool copy) {
 
 void ZendArray::renumber() {
   unsigned long i = 0;
+  bool vector = true;
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
     if (p->key == NULL) {
       p->h = i++;
+    } else {
+      vector = false;
     }
   }
   m_nNextFreeElement = i;
+  m_nKeyOffset = 0;
+  m_vector = vector;
   rehash();
 }
 
+bool ZendArray::reorder(const std::vector<ssize_t> &positions,
+                        bool renumber) {
+  ASSERT(positions.size() == m_nNumOfElements);
+  Bucket *last = NULL;
+  for (unsigned int i = 0; i < positions.size(); i++) {
+    Bucket *p = reinterpret_cast<Bucket *>(positions[i]);
+    if (renumber) {
+      if (p->key && p->key->decRefCount() == 0) {
+        DELETE(StringData)(p->key);
+      }
+      p->key = NULL;
+      p->h = i;
+    }
+    p->pListLast = last;
+    if (last) {
+      last->pListNext = p;
+    } else {
+      m_pListHead = p;
+    }
+    last = p;
+  }
+  if (last) last->pListNext = NULL;
+  m_pListTail = last;
+  m_pos = (ssize_t)m_pListHead;
+
+  if (renumber) {
+    m_nNextFreeElement = positions.size();
+    m_nKeyOffset = 0;
+    m_vector = true;
+    prepareBucketHeadsForWrite();
+    rehash();
+  } else {
+    m_vector = false;
+  }
+  return true;
+}
+
 void ZendArray::onSetStatic() {
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
     if (p->key) {
@@ -1208,11 +1398,14 @@ bool ZendArray::setFullPos(const FullPos &pos) {
   // Search for the Bucket* in the bucket corresponding to the key given
   // by pos.secondary. If the Bucket* is found, set m_pos to the Bucket*
   // and return true.
-  for (Bucket *p = m_arBuckets[pos.secondary & m_nTableMask]; p;
-       p = p->pNext) {
-    if ((ssize_t)p == pos.primary) {
-      m_pos = (ssize_t)p;
-      return true;
+  Bucket **chains[2];
+  int count = getChains(pos.secondary, chains);
+  for (int i = 0; i < count; i++) {
+    for (Bucket *p = *chains[i]; p; p = p->pNext) {
+      if ((ssize_t)p == pos.primary) {
+        m_pos = (ssize_t)p;
+        return true;
+      }
     }
   }
   // If the Bucket* could not be found, fall back to using m_pos. Return
@@ -1236,6 +1429,7 @@ CVarRef ZendArray::endRef() {
 // memory allocator methods.
 
 bool ZendArray::calculate(int &size) {
+  finishRehash();
   size += m_nTableSize * sizeof(Bucket *);
   return true;
 }
@@ -1255,6 +1449,10 @@ void ZendArray::sweep() {
     free(m_arBuckets);
     m_arBuckets = NULL;
   }
+  if (m_arOldBuckets) {
+    free(m_arOldBuckets);
+    m_arOldBuckets = NULL;
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -102,6 +102,7 @@ public:
   virtual ArrayData *dequeue(Variant &value);
   virtual ArrayData *prepend(CVarRef v, bool copy);
   virtual void renumber();
+  virtual bool reorder(const std::vector<ssize_t> &positions, bool renumber);
   virtual void onSetStatic();
 
   virtual void getFullPos(FullPos &pos);
@@ -130,14 +131,33 @@ public:
   };
 
 private:
+  /**
+   * Tables with at least this many slots grow incrementally: the old table
+   * is kept around and its slots are moved into the new one a few at a
+   * time by each following insertion, so no single insertion relinks a
+   * large array all at once.
+   */
+  static const uint IncrementalRehashSize = 4096;
+
   uint     m_nTableSize;
   uint     m_nTableMask;
   uint     m_nNumOfElements;
   ulong    m_nNextFreeElement;
+  int64    m_nKeyOffset;      // Bucket::h of an integer key minus the key
   Bucket * m_pListHead;
   Bucket * m_pListTail;
   Bucket **m_arBuckets;
+  Bucket **m_arOldBuckets;    // table still being moved into m_arBuckets
+  uint     m_nOldTableMask;
+  uint     m_nRehashPos;      // old slots below this are already moved
   bool     m_linear;
+  bool     m_vector;          // keys are exactly 0, 1, 2, ... in order
+
+  /**
+   * Chains hash h may be in: its slot in m_arBuckets, and while growing,
+   * its slot in m_arOldBuckets if that one hasn't been moved yet.
+   */
+  int getChains(int64 h, Bucket **chains[2]) const;
 
   Bucket *find(int64 h) const;
   Bucket *find(const char *k, int len, int64 prehash = -1,
@@ -165,6 +185,8 @@ private:
   ZendArray *copyImpl() const;
 
   void resize();
+  void rehashStep();
+  void finishRehash();
   void rehash();
 
   void prepareBucketHeadsForWrite();
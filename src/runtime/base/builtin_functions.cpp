@@ -303,6 +303,19 @@ String f_serialize(CVarRef value) {
   return vs.serialize(value, true);
 }
 
+void echo_serialize(CVarRef value) {
+  VariableSerializer vs(VariableSerializer::Serialize);
+  vs.serializeToOutput(value, true);
+}
+
+void echo_json_encode(CVarRef value, bool loose /* = false */) {
+  VariableSerializer vs(VariableSerializer::JSON, loose ? 1 : 0);
+  vs.serializeToOutput(value, true);
+  if (value.isContagious()) {
+    value.clearContagious();
+  }
+}
+
 Variant f_unserialize(CStrRef str) {
   if (str.empty()) {
     return false;
@@ -677,6 +677,14 @@ Object f_clone(Object obj);
 String f_serialize(CVarRef value);
 Variant f_unserialize(CStrRef str);
 
+/**
+ * What "echo serialize($v)" and "echo json_encode($v)" compile to: output is
+ * streamed into current output buffer, without building the whole string,
+ * unless serializing may call __sleep() or serialize() methods.
+ */
+void echo_serialize(CVarRef value);
+void echo_json_encode(CVarRef value, bool loose = false);
+
 
 class LVariableTable;
 Variant include(CStrRef file, bool once = false,
@@ -727,6 +735,27 @@ inline const SmartObject<T> &id(const SmartObject<T> &v) { return v; }
  */
 inline Variant wrap_variant(CVarRef x) { return x; }
 
+/**
+ * Hands a local over to a return value without reference counting. The
+ * compiler only uses these on locals that die with the return statement and
+ * that were never bound by reference, so nobody can see them emptied.
+ */
+template <class T>
+inline T take(T &v) {
+  T ret;
+  ret.swap(v);
+  return ret;
+}
+template <>
+inline Variant take(Variant &v) {
+  if (v.isContagious() || v.getRawType() == KindOfVariant) {
+    return wrap_variant(v);
+  }
+  Variant ret;
+  ret.swap(v);
+  return ret;
+}
+
 inline LVariableTable *lvar_ptr(const LVariableTable &vt) {
   return const_cast<LVariableTable*>(&vt);
 }
@@ -36,6 +36,46 @@ namespace HPHP {
 
 IMPLEMENT_THREAD_LOCAL(ExecutionContext, g_context);
 
+/**
+ * An ExecutionContext only lives as long as its request, so each thread keeps
+ * a few of its output buffers for next request, instead of constructing an
+ * ostringstream for every ob_start().
+ */
+class OutputBufferPool {
+public:
+  static const unsigned int MaxSize = 8;
+
+  ~OutputBufferPool() {
+    for (unsigned int i = 0; i < m_buffers.size(); i++) {
+      delete m_buffers[i];
+    }
+  }
+
+  ExecutionContext::OutputBuffer *get() {
+    if (m_buffers.empty()) {
+      return new ExecutionContext::OutputBuffer();
+    }
+    ExecutionContext::OutputBuffer *ob = m_buffers.back();
+    m_buffers.pop_back();
+    return ob;
+  }
+
+  void put(ExecutionContext::OutputBuffer *ob) {
+    if (m_buffers.size() >= MaxSize) {
+      delete ob;
+      return;
+    }
+    ob->oss.str("");
+    ob->oss.clear();
+    ob->handler.unset(); // can't outlive request's memory
+    m_buffers.push_back(ob);
+  }
+
+private:
+  std::vector<ExecutionContext::OutputBuffer*> m_buffers;
+};
+static IMPLEMENT_THREAD_LOCAL(OutputBufferPool, s_output_buffers);
+
 int RequestEventHandler::priority() const { return 0; }
 
 class RequestData : public RequestEventHandler {
@@ -132,7 +172,7 @@ ExecutionContext::~ExecutionContext() {
   obFlushAll();
   for (list<OutputBuffer*>::const_iterator iter = m_buffers.begin();
        iter != m_buffers.end(); ++iter) {
-    delete *iter;
+    s_output_buffers->put(*iter);
   }
 }
 
@@ -144,7 +184,7 @@ void ExecutionContext::obProtect(bool on) {
 }
 
 void ExecutionContext::obStart(CVarRef handler /* = null */) {
-  OutputBuffer *ob = new OutputBuffer();
+  OutputBuffer *ob = s_output_buffers->get();
   ob->handler = handler;
   m_buffers.push_back(ob);
   resetCurrentBuffer();
@@ -216,7 +256,7 @@ void ExecutionContext::obFlushAll() {
 bool ExecutionContext::obEnd() {
   ASSERT(m_protectedLevel >= 0);
   if ((int)m_buffers.size() > m_protectedLevel) {
-    delete m_buffers.back();
+    s_output_buffers->put(m_buffers.back());
     m_buffers.pop_back();
     resetCurrentBuffer();
     return true;
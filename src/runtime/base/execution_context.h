@@ -204,6 +204,7 @@ private:
     std::ostringstream oss;
     Variant handler;
   };
+  friend class OutputBufferPool;
 
   std::ostream *m_err;                // current error log stream
   std::ostream *m_out;                // current output buffer
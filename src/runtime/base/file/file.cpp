@@ -565,8 +565,8 @@ String File::readRecord(CStrRef delimiter, int64 maxlen /* = 0 */) {
 int64 File::print() {
   int64 total = 0;
   while (true) {
-    char buffer[1024];
-    int64 len = readImpl(buffer, 1024);
+    char buffer[CHUNK_SIZE];
+    int64 len = readImpl(buffer, CHUNK_SIZE);
     if (len == 0) break;
     total += len;
     g_context->out().write(buffer, len);
@@ -105,7 +105,7 @@ public:
   /**
    * Read entire file and print it out.
    */
-  int64 print();
+  virtual int64 print();
 
   /**
    * Write to file with specified format and arguments.
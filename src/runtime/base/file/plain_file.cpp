@@ -15,9 +15,12 @@
 */
 
 #include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <runtime/base/file/plain_file.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/util/request_local.h>
+#include <util/thread_local.h>
 
 namespace HPHP {
 
@@ -166,6 +169,84 @@ bool PlainFile::truncate(int64 size) {
   return ftruncate(m_fd, size) == 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// whole file operations
+
+int64 PlainFile::remaining() {
+  ASSERT(valid());
+  if (m_writepos != m_readpos) return -1;
+
+  // /proc files are regular but claim to be empty
+  struct stat sb;
+  if (fstat(m_fd, &sb) || !S_ISREG(sb.st_mode) || sb.st_size == 0) {
+    return -1;
+  }
+  return sb.st_size > m_position ? sb.st_size - m_position : 0;
+}
+
+String PlainFile::readRemaining(int64 maxlen /* = 0 */) {
+  int64 size = remaining();
+  if (size < 0) return String();
+  if (maxlen > 0 && maxlen < size) size = maxlen;
+
+  char *buf = (char *)malloc(size + 1);
+  int64 total = 0;
+  while (total < size) {
+    ssize_t n = ::read(m_fd, buf + total, size - total);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    total += n;
+  }
+  m_position += total;
+  buf[total] = '\0';
+  return String(buf, total, AttachString);
+}
+
+int64 PlainFile::sendfile(int fd, int64 maxlen /* = 0 */) {
+  int64 size = remaining();
+  if (size < 0) return -1;
+  if (maxlen > 0 && maxlen < size) size = maxlen;
+
+  off_t offset = m_position;
+  int64 total = 0;
+  while (total < size) {
+    ssize_t n = ::sendfile(fd, m_fd, &offset, size - total);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && total == 0) return -1; // e.g., older kernel, non-socket fd
+    if (n <= 0) break;
+    total += n;
+  }
+  // sendfile() with an offset doesn't move our own file position
+  m_position = lseek(m_fd, offset, SEEK_SET);
+  return total;
+}
+
+// for printing big files, allocated once per thread
+static IMPLEMENT_THREAD_LOCAL(std::vector<char>, s_print_buffer);
+
+int64 PlainFile::print() {
+  static const int64 BigFileSize = 256 * 1024;
+  static const int PrintChunkSize = 64 * 1024;
+  int64 total = 0;
+  if (remaining() < BigFileSize) {
+    total = File::print();
+  } else {
+    // Fewer, bigger reads than File::print(). Unlike printing from a
+    // mapping of the file, this can't fault when the file is truncated
+    // meanwhile.
+    std::vector<char> &buf = *s_print_buffer;
+    if (buf.empty()) buf.resize(PrintChunkSize);
+    while (true) {
+      int64 n = readImpl(&buf[0], buf.size());
+      if (n == 0) break;
+      g_context->out().write(&buf[0], n);
+      total += n;
+    }
+  }
+  m_position += total;
+  return total;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // BuiltinFiles
 
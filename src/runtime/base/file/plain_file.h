@@ -50,9 +50,31 @@ public:
   virtual bool rewind();
   virtual bool flush();
   virtual bool truncate(int64 size);
+  virtual int64 print();
 
   FILE *getStream() { return m_stream;}
 
+  /**
+   * Bytes from current position to the end, when this is a non-empty
+   * regular file and nothing is buffered. Otherwise -1, and caller has to
+   * read in chunks till eof.
+   */
+  int64 remaining();
+
+  /**
+   * Reads the rest of the file (at most maxlen bytes, if positive) with
+   * one read() into one allocation sized by fstat(). Returns a null string
+   * when remaining() is unknown.
+   */
+  String readRemaining(int64 maxlen = 0);
+
+  /**
+   * Copies the rest of the file (at most maxlen bytes, if positive) to fd
+   * with sendfile(), without bringing data into user space. Returns -1
+   * without copying anything when kernel can't do that for these files.
+   */
+  int64 sendfile(int fd, int64 maxlen = 0);
+
   static CVarRef getStdIn();
   static CVarRef getStdOut();
   static CVarRef getStdErr();
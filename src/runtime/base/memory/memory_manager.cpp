@@ -40,6 +40,7 @@ void MemoryManager::resetStats() {
   m_stats.alloc = 0;
   m_stats.peakUsage = 0;
   m_stats.peakAlloc = 0;
+  m_stats.allocCount = 0;
 }
 
 void MemoryManager::add(SmartAllocatorImpl *allocator) {
@@ -129,6 +130,7 @@ void MemoryManager::checkMemory(bool detailed) {
   printf("Current Alloc: %lld bytes\n", m_stats.alloc);
   printf("Peak Usage: %lld bytes\t", m_stats.peakUsage);
   printf("Peak Alloc: %lld bytes\n", m_stats.peakAlloc);
+  printf("Allocations: %lld\n", m_stats.allocCount);
 
   for (unsigned int i = 0; i < m_smartAllocators.size(); i++) {
     m_smartAllocators[i]->checkMemory(detailed);
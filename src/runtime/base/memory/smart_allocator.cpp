@@ -122,6 +122,7 @@ SmartAllocatorImpl::~SmartAllocatorImpl() {
 void *SmartAllocatorImpl::alloc() {
   if (m_stats) {
     m_stats->usage += m_itemSize;
+    m_stats->allocCount++;
     if (m_stats->usage > m_stats->peakUsage) {
       int64 prevPeakUsage = m_stats->peakUsage;
       m_stats->peakUsage = m_stats->usage;
@@ -111,13 +111,14 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * Usage stats, all in bytes.
+ * Usage stats, all in bytes, except allocCount.
  */
 struct MemoryUsageStats {
-  int64 usage;     // how many bytes are currently being used
-  int64 alloc;     // how many bytes are currently malloc-ed
-  int64 peakUsage; // how many bytes have been dispensed at maximum
-  int64 peakAlloc; // how many bytes malloc-ed at maximum
+  int64 usage;      // how many bytes are currently being used
+  int64 alloc;      // how many bytes are currently malloc-ed
+  int64 peakUsage;  // how many bytes have been dispensed at maximum
+  int64 peakAlloc;  // how many bytes malloc-ed at maximum
+  int64 allocCount; // how many objects have been dispensed
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -22,8 +22,10 @@
 #include <system/gen/sys/system_globals.h>
 #include <runtime/base/server/pagelet_server.h>
 #include <runtime/base/server/xbox_server.h>
+#include <runtime/base/util/libevent_http_client.h>
 #include <runtime/base/server/http_server.h>
 #include <runtime/base/server/replay_transport.h>
+#include <runtime/base/server/replay_benchmark.h>
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/server/admin_request_handler.h>
 #include <runtime/base/server/server_stats.h>
@@ -75,6 +77,10 @@ struct ProgramOptions {
   vector<string> args;
   string buildId;
   int    xhprofFlags;
+  int    threads;
+  int    qps;
+  string benchOutput;
+  string benchBaseline;
 };
 
 class StartTime {
@@ -507,7 +513,7 @@ int execute_program(int argc, char **argv) {
     ("compiler-id", "display the git hash for the compiler id")
 #endif
     ("mode,m", value<string>(&po.mode)->default_value("run"),
-     "run | server | daemon | replay | translate")
+     "run | server | daemon | replay | bench | translate")
     ("config,c", value<string>(&po.config),
      "load specified config file")
     ("config-value,v", value<vector<string> >(&po.confStrings)->composing(),
@@ -534,6 +540,14 @@ int execute_program(int argc, char **argv) {
      "unique identifier of compiled server code")
     ("xhprof-flags", value<int>(&po.xhprofFlags)->default_value(0),
      "Set XHProf flags")
+    ("threads", value<int>(&po.threads)->default_value(1),
+     "bench mode: how many requests to replay concurrently")
+    ("qps", value<int>(&po.qps)->default_value(0),
+     "bench mode: rate to replay requests at, 0 for as fast as possible")
+    ("bench-output", value<string>(&po.benchOutput),
+     "bench mode: save results to this file")
+    ("bench-baseline", value<string>(&po.benchBaseline),
+     "bench mode: compare results with ones saved by --bench-output")
     ;
 
   positional_options_description p;
@@ -636,6 +650,30 @@ int execute_program(int argc, char **argv) {
     return 0;
   }
 
+  if (po.mode == "bench" && !po.args.empty()) {
+    RuntimeOption::RecordInput = false;
+    RuntimeOption::ExecutionMode = "srv";
+    HttpServer server; // so we initialize runtime properly
+    ReplayBenchmark bench(po.threads, po.qps, po.count);
+    for (unsigned int i = 0; i < po.args.size(); i++) {
+      bench.addInput(po.args[i]);
+    }
+    if (bench.getInputCount() == 0) {
+      Logger::Error("no recorded requests to replay");
+      return -1;
+    }
+    bench.run();
+    bench.report(stdout);
+    if (!po.benchOutput.empty()) {
+      bench.save(po.benchOutput.c_str());
+    }
+    if (!po.benchBaseline.empty()) {
+      printf("\n");
+      if (!bench.diff(stdout, po.benchBaseline.c_str())) return -1;
+    }
+    return 0;
+  }
+
   if (po.mode == "translate" && !po.args.empty()) {
     if (!access(po.args[0].c_str(), F_OK)) {
       translate_rtti(po.args[0].c_str());
@@ -854,6 +892,7 @@ void hphp_session_exit() {
 }
 
 void hphp_process_exit() {
+  LibEventHttpMultiClient::Stop();
   Extension::ShutdownModules();
 }
 
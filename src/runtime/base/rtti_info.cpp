@@ -23,6 +23,7 @@
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/runtime_error.h>
 #include <util/lock.h>
+#include <util/logger.h>
 #include <util/util.h>
 
 using namespace std;
@@ -31,6 +32,7 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 RTTIInfo RTTIInfo::TheRTTIInfo;
+const char *RTTIInfo::MetaDataVersion = "hphp-rtti-meta 2";
 
 RTTIInfo::RTTIInfo() : m_loaded(false), m_count(0), m_profData(NULL) {
 }
@@ -84,14 +86,15 @@ public:
       m_count = RTTIInfo::TheRTTIInfo.getCount();
       if (m_count > 0) {
         m_data = (RTTICounter *)calloc(m_count, sizeof(RTTICounter));
+        RTTIInfo::TheRTTIInfo.registerCounters(m_data);
       }
     }
   }
   virtual void requestShutdown() {
     m_requests++;
-    if (strcmp(RuntimeOption::ExecutionMode, "svr") == 0 &&
-        m_requests % 10) return;
-    // write rtti profile data every 10 requests
+    // servers dump counters of all threads at once, from admin port's
+    // /rtti-dump and when shutting down, instead of on request threads
+    if (strcmp(RuntimeOption::ExecutionMode, "svr") == 0) return;
     if (m_data) {
       char path[PATH_MAX];
       snprintf(path, sizeof(path), "%s%d/%llx.rtti",
@@ -139,26 +142,55 @@ void RTTIInfo::loadParamMap(const char **p) {
   m_count = 0;
   while (*p) {
     const char *source = *p++;
-    m_count++;
+    m_name2id[source] = m_count++;
     m_id2name.push_back(source);
   }
 }
 
-void RTTIInfo::loadMetaData(const char *filename) {
+bool RTTIInfo::loadMetaData(const char *filename) {
   ASSERT(!m_loaded);
   FILE *f = fopen(filename, "r");
-  if (f == NULL) return;
+  if (f == NULL) {
+    Logger::Error("unable to open RTTI metadata %s", filename);
+    return false;
+  }
   char line[1024];
-  if (fgets(line, sizeof(line), f)) {
-    sscanf(line, "%d", &m_count);
+  int count = -1;
+  if (!fgets(line, sizeof(line), f) ||
+      strncmp(line, MetaDataVersion, strlen(MetaDataVersion)) != 0 ||
+      (line[strlen(MetaDataVersion)] != '\n' &&
+       line[strlen(MetaDataVersion)] != '\0') ||
+      !fgets(line, sizeof(line), f) || sscanf(line, "%d", &count) != 1 ||
+      count < 0) {
+    Logger::Error("%s is not RTTI metadata of this version of hphp, "
+                  "regenerate it together with its profile", filename);
+    fclose(f);
+    return false;
   }
+  // parameter names in id order, then names of all profiled functions
   while (fgets(line, sizeof(line), f)) {
     int len = strlen(line);
     ASSERT(len > 0);
     if (line[len-1] == '\n') line[len-1] = 0;
-    m_functions.insert(line);
+    if (m_count < count) {
+      m_name2id[line] = m_count++;
+      m_id2name.push_back(line);
+    } else {
+      m_functions.insert(line);
+    }
   }
   fclose(f);
+  if (m_count < count) {
+    Logger::Error("%s is truncated: %d of %d parameters", filename,
+                  m_count, count);
+    m_count = 0;
+    m_name2id.clear();
+    m_id2name.clear();
+    m_functions.clear();
+    return false;
+  }
+  m_loaded = true;
+  return true;
 }
 
 bool RTTIInfo::loadProfData(const char *rttiDirectory) {
@@ -219,5 +251,48 @@ bool RTTIInfo::exists(const char *funcName) {
   return m_functions.find(funcName) != m_functions.end();
 }
 
+const unsigned int *RTTIInfo::getParamCounter(const std::string &key) const {
+  if (!m_profData) return NULL;
+  map<string, int>::const_iterator iter = m_name2id.find(key);
+  if (iter == m_name2id.end()) return NULL;
+  return m_profData[iter->second];
+}
+
+void RTTIInfo::registerCounters(RTTICounter *counters) {
+  Lock lock(m_mutex);
+  m_counters.push_back(counters);
+}
+
+bool RTTIInfo::dump() {
+  Lock lock(m_mutex);
+  if (m_count == 0 || m_counters.empty()) return false;
+
+  RTTICounter *sum = (RTTICounter *)calloc(m_count, sizeof(RTTICounter));
+  for (unsigned int i = 0; i < m_counters.size(); i++) {
+    RTTICounter *cs, *cc;
+    for (cs = sum, cc = m_counters[i]; cs < sum + m_count; cs++, cc++) {
+      for (int j = 0; j < MaxNumDataTypes; j++) {
+        (*cs)[j] += (*cc)[j];
+      }
+    }
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s%d/process.rtti",
+           RuntimeOption::RTTIDirectory.c_str(), getpid());
+  bool ret = false;
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1) {
+    Logger::Error("unable to write %s: %s", path,
+                  Util::safe_strerror(errno).c_str());
+  } else {
+    int size = m_count * sizeof(RTTICounter);
+    ret = (write(fd, sum, size) == size);
+    close(fd);
+  }
+  free(sum);
+  return ret;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -19,6 +19,8 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
 #include <util/mutex.h>
 #include <runtime/base/types.h>
 
@@ -30,11 +32,32 @@ typedef unsigned int RTTICounter[MaxNumDataTypes];
 class RTTIInfo {
 public:
   static RTTIInfo TheRTTIInfo;
+
+  /**
+   * First line of metadata files, so ones from an older compiler, which
+   * only listed function names, are rejected instead of misread.
+   */
+  static const char *MetaDataVersion;
+
   void translate_rtti(const char *rttiDir);
-  void loadMetaData(const char *filename);
+  bool loadMetaData(const char *filename);
   bool loadProfData(const char *rttiDir);
   bool exists(const char *funcName);
 
+  /**
+   * Type counts of one parameter, keyed by "func::param" as in metadata,
+   * summed over all loaded profiles. NULL if it was not profiled.
+   */
+  const unsigned int *getParamCounter(const std::string &key) const;
+
+  /**
+   * Counters of all threads in this process, summed into one file under
+   * RTTIDirectory. Worker threads keep counting while this reads them, so
+   * a dump is only as exact as a profile needs to be.
+   */
+  bool dump();
+  void registerCounters(RTTICounter *counters);
+
 public:
   RTTIInfo();
   ~RTTIInfo() { if (m_profData) free(m_profData);}
@@ -47,8 +70,10 @@ private:
   bool m_loaded;
   int m_count;
   std::vector<std::string> m_id2name;
+  std::map<std::string, int> m_name2id;
   std::set<std::string> m_functions;
   RTTICounter *m_profData;
+  std::vector<RTTICounter *> m_counters; // of all threads
 
   void loadParamMap(const char **p);
 };
@@ -23,6 +23,7 @@
 #include <util/stack_trace.h>
 #include <util/process.h>
 #include <util/file_cache.h>
+#include <util/db_conn.h>
 #include <runtime/base/preg.h>
 #include <runtime/base/server/access_log.h>
 #include <runtime/base/util/extended_logger.h>
@@ -59,6 +60,8 @@ bool RuntimeOption::AssertWarning = false;
 int RuntimeOption::NoticeFrequency = 1;
 int RuntimeOption::WarningFrequency = 1;
 int64 RuntimeOption::SerializationSizeLimit = 0;
+int RuntimeOption::ParallelArrayThreads = 0;
+int RuntimeOption::ParallelArrayMinSize = 10000;
 
 std::string RuntimeOption::AccessLogDefaultFormat;
 std::vector<std::pair<std::string, std::string> >  RuntimeOption::AccessLogs;
@@ -80,11 +83,14 @@ int RuntimeOption::RequestTimeoutSeconds = 0;
 int RuntimeOption::RequestMemoryMaxBytes = 0;
 int RuntimeOption::ImageMemoryMaxBytes = 0;
 int RuntimeOption::ResponseQueueCount;
+int RuntimeOption::ServerReactorCount = 1;
 int RuntimeOption::ServerGracefulShutdownWait;
 bool RuntimeOption::ServerHarshShutdown = true;
 bool RuntimeOption::ServerEvilShutdown = true;
 int RuntimeOption::ServerDanglingWait;
 int RuntimeOption::GzipCompressionLevel = 3;
+int RuntimeOption::GzipLargeBodySize = 0;
+int RuntimeOption::GzipLargeBodyCompressionLevel = 1;
 bool RuntimeOption::EnableMagicQuotesGpc = false;
 bool RuntimeOption::EnableKeepAlive = true;
 int RuntimeOption::ConnectionTimeoutSeconds = -1;
@@ -176,9 +182,12 @@ int RuntimeOption::MySQLReadTimeout = 1000;
 int RuntimeOption::MySQLWaitTimeout = -1;
 int RuntimeOption::MySQLSlowQueryThreshold = 1000; // ms
 bool RuntimeOption::MySQLKillOnTimeout = false;
+bool RuntimeOption::MySQLAsyncParallelQuery = false;
+int RuntimeOption::MySQLMaxAsyncConnections = 1000;
 
 int RuntimeOption::HttpDefaultTimeout = 30;
 int RuntimeOption::HttpSlowQueryThreshold = 5000; // ms
+int RuntimeOption::HttpMaxConnectionsPerHost = 8;
 
 bool RuntimeOption::TranslateLeakStackTrace = false;
 bool RuntimeOption::NativeStackTrace = false;
@@ -219,6 +228,7 @@ bool RuntimeOption::EnableMemoryManager = true;
 bool RuntimeOption::CheckMemory = false;
 bool RuntimeOption::UseZendArray = true;
 bool RuntimeOption::UseSmallArray = true;
+bool RuntimeOption::UseTypedVector = true;
 bool RuntimeOption::EnableApc = true;
 bool RuntimeOption::ApcUseSharedMemory = false;
 int RuntimeOption::ApcSharedMemorySize = 1024; // 1GB
@@ -431,6 +441,8 @@ void RuntimeOption::Load(Hdf &config) {
     MaxSQLRowCount = rlimit["MaxSQLRowCount"].getInt64(0);
     MaxMemcacheKeyCount = rlimit["MaxMemcacheKeyCount"].getInt64(0);
     SerializationSizeLimit = rlimit["SerializationSizeLimit"].getInt64(0);
+    ParallelArrayThreads = rlimit["ParallelArrayThreads"].getInt32(0);
+    ParallelArrayMinSize = rlimit["ParallelArrayMinSize"].getInt32(10000);
   }
   {
     Hdf server = config["Server"];
@@ -447,6 +459,8 @@ void RuntimeOption::Load(Hdf &config) {
       ResponseQueueCount = ServerThreadCount / 10;
       if (ResponseQueueCount <= 0) ResponseQueueCount = 1;
     }
+    ServerReactorCount = server["ReactorCount"].getInt32(1);
+    if (ServerReactorCount <= 0) ServerReactorCount = 1;
     ServerGracefulShutdownWait = server["GracefulShutdownWait"].getInt16(0);
     ServerHarshShutdown = server["HarshShutdown"].getBool(true);
     ServerEvilShutdown = server["EvilShutdown"].getBool(true);
@@ -455,6 +469,9 @@ void RuntimeOption::Load(Hdf &config) {
       ServerGracefulShutdownWait = ServerDanglingWait;
     }
     GzipCompressionLevel = server["GzipCompressionLevel"].getInt16(3);
+    GzipLargeBodySize = server["GzipLargeBodySize"].getInt32(0);
+    GzipLargeBodyCompressionLevel =
+      server["GzipLargeBodyCompressionLevel"].getInt16(1);
     EnableMagicQuotesGpc = server["EnableMagicQuotesGpc"].getBool();
     EnableKeepAlive = server["EnableKeepAlive"].getBool(true);
     ConnectionTimeoutSeconds = server["ConnectionTimeoutSeconds"].getInt16(-1);
@@ -545,6 +562,7 @@ void RuntimeOption::Load(Hdf &config) {
     CheckMemory = server["CheckMemory"].getBool();
     UseZendArray = server["UseZendArray"].getBool(true);
     UseSmallArray = server["UseSmallArray"].getBool(true);
+    UseTypedVector = server["UseTypedVector"].getBool(true);
 
     Hdf apc = server["APC"];
     EnableApc = apc["EnableApc"].getBool(true);
@@ -709,11 +727,16 @@ void RuntimeOption::Load(Hdf &config) {
     MySQLWaitTimeout = mysql["WaitTimeout"].getInt32(-1);
     MySQLSlowQueryThreshold = mysql["SlowQueryThreshold"].getInt32(1000);
     MySQLKillOnTimeout = mysql["KillOnTimeout"].getBool();
+    MySQLAsyncParallelQuery = mysql["AsyncParallelQuery"].getBool();
+    MySQLMaxAsyncConnections = mysql["MaxAsyncConnections"].getInt32(1000);
+    DBConn::AsyncEnabled = MySQLAsyncParallelQuery;
+    DBConn::AsyncMaxConnections = MySQLMaxAsyncConnections;
   }
   {
     Hdf http = config["Http"];
     HttpDefaultTimeout = http["DefaultTimeout"].getInt32(30);
     HttpSlowQueryThreshold = http["SlowQueryThreshold"].getInt32(5000);
+    HttpMaxConnectionsPerHost = http["MaxConnectionsPerHost"].getInt32(8);
   }
   {
     Hdf debug = config["Debug"];
@@ -59,6 +59,8 @@ public:
   static int NoticeFrequency; // output 1 out of NoticeFrequency notices
   static int WarningFrequency;
   static int64 SerializationSizeLimit;
+  static int ParallelArrayThreads;
+  static int ParallelArrayMinSize;
 
   static std::string AccessLogDefaultFormat;
   static std::vector<std::pair<std::string, std::string> > AccessLogs;
@@ -79,11 +81,14 @@ public:
   static int RequestMemoryMaxBytes;
   static int ImageMemoryMaxBytes;
   static int ResponseQueueCount;
+  static int ServerReactorCount;
   static int ServerGracefulShutdownWait;
   static int ServerDanglingWait;
   static bool ServerHarshShutdown;
   static bool ServerEvilShutdown;
   static int GzipCompressionLevel;
+  static int GzipLargeBodySize;
+  static int GzipLargeBodyCompressionLevel;
   static bool EnableMagicQuotesGpc;
   static bool EnableKeepAlive;
   static int ConnectionTimeoutSeconds;
@@ -176,9 +181,12 @@ public:
   static int  MySQLWaitTimeout;
   static int  MySQLSlowQueryThreshold;
   static bool MySQLKillOnTimeout;
+  static bool MySQLAsyncParallelQuery;
+  static int  MySQLMaxAsyncConnections;
 
   static int  HttpDefaultTimeout;
   static int  HttpSlowQueryThreshold;
+  static int  HttpMaxConnectionsPerHost;
 
   static bool TranslateLeakStackTrace;
   static bool NativeStackTrace;
@@ -219,6 +227,7 @@ public:
   static bool CheckMemory;
   static bool UseZendArray;
   static bool UseSmallArray;
+  static bool UseTypedVector;
   static bool EnableApc;
   static bool ApcUseSharedMemory;
   static int ApcSharedMemorySize;
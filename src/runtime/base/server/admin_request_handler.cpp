@@ -19,6 +19,7 @@
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/rtti_info.h>
 #include <util/process.h>
 #include <util/logger.h>
 #include <util/util.h>
@@ -87,6 +88,8 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "/check-mem:       report memory quick statistics in log file\n"
         "/check-apc:       report APC quick statistics\n"
         "/check-sql:       report SQL table statistics\n"
+        "/rtti-dump:       write RTTI profile of all threads for hphp's\n"
+        "                  --rtti-directory\n"
 
         "/status.xml:      show server status in XML\n"
         "/status.json:     show server status in JSON\n"
@@ -190,6 +193,14 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
       transport->sendString(translated);
       break;
     }
+    if (cmd == "rtti-dump") {
+      if (RTTIInfo::TheRTTIInfo.dump()) {
+        transport->sendString("OK\n");
+      } else {
+        transport->sendString("No RTTI profile to dump", 404);
+      }
+      break;
+    }
     if (strncmp(cmd.c_str(), "check", 5) == 0 &&
         handleCheckRequest(cmd, transport)) {
       break;
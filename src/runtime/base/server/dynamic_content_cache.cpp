@@ -54,6 +54,14 @@ void DynamicContentCache::store(const std::string &name, const char *data,
   ASSERT(!name.empty());
   ASSERT(size > 0);
 
+  {
+    // gzencode() at level 9 is costly, don't do it just to throw it away
+    ReadLock lock(m_mutex);
+    if (m_files.find(name) != m_files.end()) {
+      return;
+    }
+  }
+
   ResourceFilePtr f(new ResourceFile());
   StringBufferPtr sb(new StringBuffer(size));
   sb->append(data, size);
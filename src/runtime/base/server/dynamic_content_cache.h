@@ -37,7 +37,8 @@ public:
             bool &compressed);
 
   /**
-   * Store a file to cache.
+   * Store a file to cache, together with its gzipped copy if that is smaller.
+   * Entries are never removed, so what find() returns stays valid.
    */
   void store(const std::string &name, const char *data, int size);
 
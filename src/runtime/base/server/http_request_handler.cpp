@@ -276,14 +276,27 @@ bool HttpRequestHandler::executePHPRequest(Transport *transport,
 
     if (ret) {
       std::string content = context->getContents();
+      const char *data = content.data();
+      int len = content.size();
+      bool compressed = false;
       if (cachableDynamicContent && !content.empty()) {
         ASSERT(transport->getUrl());
         string key = file + transport->getUrl();
         DynamicContentCache::TheCache.store(key, content.data(),
                                             content.size());
+
+        // sending the gzipped copy just made, rather than gzipping again
+        if (!transport->headersSent() && transport->isCompressionEnabled() &&
+            transport->acceptEncoding("gzip")) {
+          compressed = true;
+          if (!DynamicContentCache::TheCache.find(key, data, len,
+                                                  compressed)) {
+            compressed = false;
+          }
+        }
       }
       code = 200;
-      transport->sendRaw((void*)content.data(), content.size());
+      transport->sendRaw((void*)data, len, 200, compressed);
     } else if (error) {
       code = 500;
 
@@ -58,17 +58,20 @@ HttpServer::HttpServer()
   LockProfiler::s_pfunc_profile = server_stats_log_mutex;
 
   if (RuntimeOption::TakeoverFilename.empty()) {
-    m_pageServer = ServerPtr
+    LibEventServer* server =
       (new TypedServer<LibEventServer, HttpRequestHandler>
        (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
         RuntimeOption::ServerThreadCount,
         RuntimeOption::RequestTimeoutSeconds));
+    server->setReactorCount(RuntimeOption::ServerReactorCount);
+    m_pageServer = ServerPtr(server);
   } else {
     LibEventServerWithTakeover* server =
       (new TypedServer<LibEventServerWithTakeover, HttpRequestHandler>
        (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
         RuntimeOption::ServerThreadCount,
         RuntimeOption::RequestTimeoutSeconds));
+    server->setReactorCount(RuntimeOption::ServerReactorCount);
     server->setTransferFilename(RuntimeOption::TakeoverFilename);
     server->addTakeoverListener(this);
     m_pageServer = ServerPtr(server);
@@ -240,6 +243,7 @@ void HttpServer::run() {
   if (RuntimeOption::ServerPort) {
     m_pageServer->stop();
   }
+  RTTIInfo::TheRTTIInfo.dump();
   time_t t1 = time(0);
   if (!m_danglings.empty() && RuntimeOption::ServerDanglingWait > 0) {
     int elapsed = t1 - t0;
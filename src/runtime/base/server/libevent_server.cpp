@@ -19,13 +19,26 @@
 #include <runtime/base/memory/memory_manager.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/server/http_protocol.h>
+#include <util/atomic.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 // static handler
 
 static void on_request(struct evhttp_request *request, void *obj) {
   ASSERT(obj);
-  ((HPHP::LibEventServer*)obj)->onRequest(request);
+  ((HPHP::LibEventServer*)obj)->onRequest(request, 0);
+}
+
+static void on_reactor_request(struct evhttp_request *request, void *obj) {
+  ASSERT(obj);
+  ((HPHP::LibEventReactor*)obj)->onRequest(request);
+}
+
+static void on_reactor_command(int fd, short events, void *obj) {
+  ASSERT(obj);
+  ((HPHP::LibEventReactor*)obj)->onCommand();
 }
 
 static void on_response(int fd, short what, void *obj) {
@@ -41,11 +54,28 @@ static void on_thread_stop(int fd, short events, void *context) {
   event_base_loopbreak((struct event_base *)context);
 }
 
+static void dispatch_with_timeout(struct event_base *eventBase,
+                                  int timeoutSeconds) {
+  struct timeval timeout;
+  timeout.tv_sec = timeoutSeconds;
+  timeout.tv_usec = 0;
+
+  event eventTimeout;
+  event_set(&eventTimeout, -1, 0, on_timer, eventBase);
+  event_base_set(eventBase, &eventTimeout);
+  event_add(&eventTimeout, &timeout);
+
+  event_base_loop(eventBase, EVLOOP_ONCE);
+
+  event_del(&eventTimeout);
+}
+
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 // LibEventJob
 
-LibEventJob::LibEventJob(evhttp_request *req) : request(req) {
+LibEventJob::LibEventJob(evhttp_request *req, int reactor)
+  : request(req), reactor(reactor) {
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
     clock_gettime(CLOCK_MONOTONIC, &start);
   }
@@ -59,16 +89,24 @@ void LibEventJob::stopTimer() {
     long dnsec = end.tv_nsec - start.tv_nsec;
     int64 dusec = dsec * 1000000 + dnsec / 1000;
     ServerStats::Log("page.wall.queuing", dusec);
+
+    // per-reactor counters show whether connections are spread evenly
+    char name[64];
+    snprintf(name, sizeof(name), "libevent.reactor.%d.requests", reactor);
+    ServerStats::Log(name, 1);
+    snprintf(name, sizeof(name), "libevent.reactor.%d.queuing", reactor);
+    ServerStats::Log(name, dusec);
   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // LibEventWorker
 
-LibEventWorker::LibEventWorker() : m_handler(NULL) {
+LibEventWorker::LibEventWorker() : m_handler(NULL), m_transport(NULL) {
 }
 
 LibEventWorker::~LibEventWorker() {
+  delete m_transport;
 }
 
 void LibEventWorker::doJob(LibEventJobPtr job) {
@@ -82,7 +120,11 @@ void LibEventWorker::doJob(LibEventJobPtr job) {
     ASSERT(m_handler);
   }
 
-  LibEventTransport transport(server, request, m_id);
+  if (m_transport == NULL) {
+    m_transport = new LibEventTransport(server, m_id);
+  }
+  LibEventTransport &transport = *m_transport;
+  transport.reset(request, job->reactor);
   bool error = true;
   std::string errorMsg;
   try {
@@ -154,6 +196,7 @@ LibEventServer::LibEventServer(const std::string &address, int port,
 LibEventServer::~LibEventServer() {
   ASSERT (getStatus() == STOPPED || getStatus() == STOPPING ||
           getStatus() == NOT_YET_STARTED);
+  m_reactors.clear();
   // We can't free event base when server is still working on it.
   // This will cause a leak with event base, but normally this happens when
   // process exits, so we're probably fine.
@@ -197,31 +240,36 @@ void LibEventServer::start() {
   setStatus(RUNNING);
   m_dispatcher.start();
   m_dispatcherThread.start();
+  for (unsigned int i = 0; i < m_reactors.size(); i++) {
+    m_reactors[i]->start(m_accept_sock);
+  }
   m_timeoutThread.start();
 }
 
+void LibEventServer::setReactorCount(int count) {
+  ASSERT(getStatus() == NOT_YET_STARTED);
+  m_reactors.clear();
+  for (int i = 1; i < count; i++) {
+    m_reactors.push_back(LibEventReactorPtr(new LibEventReactor(this, i)));
+  }
+}
+
+void LibEventServer::stopReactorsAccepting() {
+  for (unsigned int i = 0; i < m_reactors.size(); i++) {
+    m_reactors[i]->stopAccepting();
+  }
+}
+
 void LibEventServer::waitForEnd() {
   m_dispatcherThread.waitForEnd();
+  for (unsigned int i = 0; i < m_reactors.size(); i++) {
+    m_reactors[i]->waitForEnd();
+  }
 
   m_timeoutThreadData.stop();
   m_timeoutThread.waitForEnd();
 }
 
-void LibEventServer::dispatchWithTimeout(int timeoutSeconds) {
-  struct timeval timeout;
-  timeout.tv_sec = timeoutSeconds;
-  timeout.tv_usec = 0;
-
-  event eventTimeout;
-  event_set(&eventTimeout, -1, 0, on_timer, m_eventBase);
-  event_base_set(m_eventBase, &eventTimeout);
-  event_add(&eventTimeout, &timeout);
-
-  event_base_loop(m_eventBase, EVLOOP_ONCE);
-
-  event_del(&eventTimeout);
-}
-
 void LibEventServer::dispatch() {
   m_pipeStop.open();
   event_set(&m_eventStop, m_pipeStop.getOut(), EV_READ|EV_PERSIST,
@@ -243,7 +291,8 @@ void LibEventServer::dispatch() {
 
   // flusing all remaining events
   if (RuntimeOption::ServerGracefulShutdownWait) {
-    dispatchWithTimeout(RuntimeOption::ServerGracefulShutdownWait);
+    dispatch_with_timeout(m_eventBase,
+                          RuntimeOption::ServerGracefulShutdownWait);
   }
 }
 
@@ -257,12 +306,18 @@ void LibEventServer::stop() {
   // stop JobQueue processing
   m_dispatcher.stop();
 
-  // stop event loop
+  // stop event loops, letting all of them flush at the same time
   setStatus(STOPPED);
+  for (unsigned int i = 0; i < m_reactors.size(); i++) {
+    m_reactors[i]->stop();
+  }
   if (write(m_pipeStop.getIn(), "", 1) < 0) {
     // an error occured but we're in shutdown already, so ignore
   }
   m_dispatcherThread.waitForEnd();
+  for (unsigned int i = 0; i < m_reactors.size(); i++) {
+    m_reactors[i]->waitForEnd();
+  }
   evhttp_free(m_server);
   m_server = NULL;
 }
@@ -315,7 +370,7 @@ void LibEventServer::onThreadEnter() {
     (&ThreadInfo::s_threadInfo->m_reqInjectionData);
 }
 
-void LibEventServer::onRequest(struct evhttp_request *request) {
+void LibEventServer::onRequest(struct evhttp_request *request, int reactor) {
   if (RuntimeOption::EnableKeepAlive &&
       RuntimeOption::ConnectionTimeoutSeconds > 0) {
     // before processing request, set the connection timeout
@@ -324,14 +379,20 @@ void LibEventServer::onRequest(struct evhttp_request *request) {
                                   RuntimeOption::ConnectionTimeoutSeconds);
   }
   if (getStatus() == RUNNING) {
-    m_dispatcher.enqueue(LibEventJobPtr(new LibEventJob(request)));
+    m_dispatcher.enqueue(LibEventJobPtr(new LibEventJob(request, reactor)));
   } else {
     Logger::Error("throwing away one new request while shutting down");
   }
 }
 
-void LibEventServer::onResponse(int worker, evhttp_request *request,
-                                int code) {
+PendingResponseQueue &LibEventServer::getResponseQueue(int reactor) {
+  if (reactor == 0) return m_responseQueue;
+  ASSERT(reactor > 0 && reactor <= (int)m_reactors.size());
+  return m_reactors[reactor - 1]->getResponseQueue();
+}
+
+void LibEventServer::onResponse(int worker, int reactor,
+                                evhttp_request *request, int code) {
   int nwritten = 0;
   bool skip_sync = false;
 #ifdef _EVENT_USE_OPENSSL
@@ -342,44 +403,201 @@ void LibEventServer::onResponse(int worker, evhttp_request *request,
     const char *reason = HttpProtocol::GetReasonString(code);
     nwritten = evhttp_send_reply_sync_begin(request, code, reason, NULL);
   }
-  m_responseQueue.enqueue(worker, request, code, nwritten);
+  getResponseQueue(reactor).enqueue(worker, request, code, nwritten);
 }
 
-void LibEventServer::onChunkedResponse(int worker, evhttp_request *request,
-                                       int code, evbuffer *chunk,
-                                       bool firstChunk) {
-  m_responseQueue.enqueue(worker, request, code, chunk, firstChunk);
+void LibEventServer::onChunkedResponse(int worker, int reactor,
+                                       evhttp_request *request, int code,
+                                       evbuffer *chunk, bool firstChunk) {
+  getResponseQueue(reactor).enqueue(worker, request, code, chunk,
+                                    firstChunk);
 }
 
-void LibEventServer::onChunkedResponseEnd(int worker,
+void LibEventServer::onChunkedResponseEnd(int worker, int reactor,
                                           evhttp_request *request) {
-  m_responseQueue.enqueue(worker, request);
+  getResponseQueue(reactor).enqueue(worker, request);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LibEventReactor
+
+LibEventReactor::LibEventReactor(LibEventServer *server, int id)
+  : m_server(server), m_id(id), m_acceptSock(-1), m_accepting(false),
+    m_running(false), m_stopped(false),
+    m_thread(this, &LibEventReactor::dispatch) {
+  m_eventBase = event_base_new();
+  m_http = evhttp_new(m_eventBase);
+  evhttp_set_gencb(m_http, on_reactor_request, this);
+#ifdef EVHTTP_READ_LIMITING
+  evhttp_set_read_limit(m_http, RuntimeOption::RequestBodyReadLimit);
+#endif
+  m_responseQueue.create(m_eventBase);
+
+  if (!m_pipeCommand.open()) {
+    throw FatalErrorException("unable to create pipe for reactor commands");
+  }
+  event_set(&m_eventCommand, m_pipeCommand.getOut(), EV_READ|EV_PERSIST,
+            on_reactor_command, this);
+  event_base_set(m_eventBase, &m_eventCommand);
+  event_add(&m_eventCommand, NULL);
+}
+
+LibEventReactor::~LibEventReactor() {
+  // same as LibEventServer, leaking the event base if it is still in use
+  if (!m_running) {
+    m_responseQueue.close();
+    event_del(&m_eventCommand);
+    if (m_http) {
+      evhttp_free(m_http);
+    }
+    event_base_free(m_eventBase);
+  }
+}
+
+void LibEventReactor::start(int acceptSock) {
+  if (evhttp_accept_socket(m_http, acceptSock) < 0) {
+    Logger::Error("reactor %d unable to accept on socket %d",
+                  m_id, acceptSock);
+  } else {
+    Lock lock(this);
+    m_acceptSock = acceptSock;
+    m_accepting = true;
+  }
+  m_running = true;
+  m_thread.start();
+}
+
+void LibEventReactor::sendCommand(char cmd) {
+  if (write(m_pipeCommand.getIn(), &cmd, 1) < 0) {
+    // an error occured but nothing we can really do
+  }
+}
+
+void LibEventReactor::stopAccepting() {
+  Lock lock(this);
+  if (!m_accepting) return;
+  sendCommand('d');
+  while (m_accepting) {
+    wait();
+  }
+}
+
+void LibEventReactor::stop() {
+  sendCommand('s');
+}
+
+void LibEventReactor::waitForEnd() {
+  if (!m_running) return;
+  m_thread.waitForEnd();
+  m_running = false;
+}
+
+void LibEventReactor::onRequest(evhttp_request *request) {
+  m_server->onRequest(request, m_id);
+}
+
+void LibEventReactor::onCommand() {
+  char cmds[64];
+  int n = read(m_pipeCommand.getOut(), cmds, sizeof(cmds));
+  for (int i = 0; i < n; i++) {
+    if (cmds[i] == 's') {
+      m_stopped = true;
+      event_base_loopbreak(m_eventBase);
+    }
+  }
+  // 'd' and 's' both mean no more new connections
+  Lock lock(this);
+  if (m_accepting && n > 0) {
+    if (evhttp_del_accept_socket(m_http, m_acceptSock) < 0) {
+      Logger::Error("reactor %d unable to delete accept socket", m_id);
+    }
+    m_accepting = false;
+    notifyAll();
+  }
+}
+
+void LibEventReactor::dispatch() {
+  while (!m_stopped) {
+    event_base_loop(m_eventBase, EVLOOP_ONCE);
+  }
+
+  event_del(&m_eventCommand);
+  {
+    // nobody is left to answer a stopAccepting() request
+    Lock lock(this);
+    if (m_accepting) {
+      evhttp_del_accept_socket(m_http, m_acceptSock);
+      m_accepting = false;
+      notifyAll();
+    }
+  }
+
+  // flushing all responses
+  if (!m_responseQueue.empty()) {
+    m_responseQueue.process();
+  }
+  m_responseQueue.close();
+
+  // flusing all remaining events
+  if (RuntimeOption::ServerGracefulShutdownWait) {
+    dispatch_with_timeout(m_eventBase,
+                          RuntimeOption::ServerGracefulShutdownWait);
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PendingResponseQueue
 
-PendingResponseQueue::PendingResponseQueue() {
+static int64 monotonic_usec() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Counts value into a power-of-2 bucket, e.g. "<name>.16" for 9 to 16.
+ */
+static void log_histogram(const char *name, int64 value) {
+  int64 bound = 1;
+  while (bound < value && bound < (1LL << 30)) bound <<= 1;
+  char key[64];
+  snprintf(key, sizeof(key), "%s.%lld", name, bound);
+  ServerStats::Log(key, 1);
+}
+
+PendingResponseQueue::PendingResponseQueue()
+  : m_ready(-1), m_signaled(0), m_statsFlushed(0) {
   ASSERT(RuntimeOption::ResponseQueueCount > 0);
-  for (int i = 0; i < RuntimeOption::ResponseQueueCount; i++) {
-    m_responseQueues.push_back(ResponseQueuePtr(new ResponseQueue()));
+  m_stacks.resize(RuntimeOption::ResponseQueueCount);
+}
+
+PendingResponseQueue::~PendingResponseQueue() {
+  for (unsigned int i = 0; i < m_stacks.size(); i++) {
+    Response *res = m_stacks[i].head;
+    while (res) {
+      Response *next = res->next;
+      delete res;
+      res = next;
+    }
+  }
+  if (m_ready >= 0) {
+    ::close(m_ready);
   }
 }
 
 bool PendingResponseQueue::empty() {
-  for (int i = 0; i < RuntimeOption::ResponseQueueCount; i++) {
-    ResponseQueue &q = *m_responseQueues[i];
-    Lock lock(q.m_mutex);
-    if (!q.m_responses.empty()) return false;
+  for (unsigned int i = 0; i < m_stacks.size(); i++) {
+    if (m_stacks[i].head) return false;
   }
   return true;
 }
 
 void PendingResponseQueue::create(event_base *eventBase) {
-  if (!m_ready.open()) {
-    throw FatalErrorException("unable to create pipe for ready signal");
+  m_ready = eventfd(0, 0);
+  if (m_ready < 0 || fcntl(m_ready, F_SETFL, O_NONBLOCK) < 0) {
+    throw FatalErrorException("unable to create eventfd for ready signal");
   }
-  event_set(&m_event, m_ready.getOut(), EV_READ|EV_PERSIST, on_response, this);
+  event_set(&m_event, m_ready, EV_READ|EV_PERSIST, on_response, this);
   event_base_set(eventBase, &m_event);
   event_add(&m_event, NULL);
 }
@@ -388,23 +606,30 @@ void PendingResponseQueue::close() {
   event_del(&m_event);
 }
 
-void PendingResponseQueue::enqueue(int worker, ResponsePtr response) {
-  {
-    int i = worker % RuntimeOption::ResponseQueueCount;
-    ResponseQueue &q = *m_responseQueues[i];
-    Lock lock(q.m_mutex);
-    q.m_responses.push_back(response);
+void PendingResponseQueue::enqueue(int worker, Response *response) {
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+    response->queued = monotonic_usec();
   }
 
-  // signal to call process()
-  if (write(m_ready.getIn(), &response, 1) < 0) {
-    // an error occured but nothing we can really do
+  ResponseStack &stack = m_stacks[worker % m_stacks.size()];
+  Response *head;
+  do {
+    head = stack.head;
+    response->next = head;
+  } while (!atomic_cas(stack.head, head, response));
+
+  // signal to call process(), unless it's already signaled and not yet run
+  if (atomic_swap(m_signaled, 1) == 0) {
+    uint64 one = 1;
+    if (write(m_ready, &one, sizeof(one)) < 0) {
+      // an error occured but nothing we can really do
+    }
   }
 }
 
 void PendingResponseQueue::enqueue(int worker, evhttp_request *request,
                                    int code, int nwritten) {
-  ResponsePtr res(new Response());
+  Response *res = new Response();
   res->request = request;
   res->code = code;
   res->nwritten = nwritten;
@@ -414,7 +639,7 @@ void PendingResponseQueue::enqueue(int worker, evhttp_request *request,
 void PendingResponseQueue::enqueue(int worker, evhttp_request *request,
                                    int code, evbuffer *chunk,
                                    bool firstChunk) {
-  ResponsePtr res(new Response());
+  Response *res = new Response();
   res->request = request;
   res->code = code;
   res->chunked = true;
@@ -424,60 +649,89 @@ void PendingResponseQueue::enqueue(int worker, evhttp_request *request,
 }
 
 void PendingResponseQueue::enqueue(int worker, evhttp_request *request) {
-  ResponsePtr res(new Response());
+  Response *res = new Response();
   res->request = request;
   res->chunked = true;
   enqueue(worker, res);
 }
 
 void PendingResponseQueue::process() {
-  // clean up the pipe for next signals
-  char buf[512];
-  if (read(m_ready.getOut(), buf, sizeof(buf)) < 0) {
+  // clean up the signal first, so any response queued from now on will
+  // signal again
+  uint64 count;
+  if (read(m_ready, &count, sizeof(count)) < 0) {
     // an error occured but nothing we can really do
   }
+  atomic_swap(m_signaled, 0);
+
+  // taking all responses without holding up any worker; each stack is in
+  // reverse order, and one worker's responses have to be sent in order
+  m_batch.clear();
+  for (unsigned int i = 0; i < m_stacks.size(); i++) {
+    Response *res = atomic_swap(m_stacks[i].head, (Response*)NULL);
+    unsigned int first = m_batch.size();
+    for (; res; res = res->next) {
+      m_batch.push_back(res);
+    }
+    std::reverse(m_batch.begin() + first, m_batch.end());
+  }
+
+  bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableWebStats;
+  int64 now = stats ? monotonic_usec() : 0;
+  for (unsigned int i = 0; i < m_batch.size(); i++) {
+    Response *res = m_batch[i];
+    if (stats && res->queued) {
+      log_histogram("libevent.response.queuing", now - res->queued);
+    }
+    send(*res);
+    delete res;
+  }
 
-  // making a copy so we don't hold up the mutex very long
-  ResponsePtrVec responses;
-  for (int i = 0; i < RuntimeOption::ResponseQueueCount; i++) {
-    ResponseQueue &q = *m_responseQueues[i];
-    Lock lock(q.m_mutex);
-    responses.insert(responses.end(),q.m_responses.begin(),q.m_responses.end());
-    q.m_responses.clear();
+  if (stats && !m_batch.empty()) {
+    ServerStats::Log("libevent.response.wakeup", 1);
+    ServerStats::Log("libevent.response.count", m_batch.size());
+    log_histogram("libevent.response.batch", m_batch.size());
+
+    // event loop never finishes a page, so its counters are committed as
+    // a page of their own, once a second
+    time_t sec = time(NULL);
+    if (sec != m_statsFlushed) {
+      m_statsFlushed = sec;
+      ServerStats::LogPage("libevent", 0);
+    }
   }
+}
 
-  for (unsigned int i = 0; i < responses.size(); i++) {
-    Response &res = *responses[i];
-    evhttp_request *request = res.request;
-    int code = res.code;
+void PendingResponseQueue::send(Response &res) {
+  evhttp_request *request = res.request;
+  int code = res.code;
 
-    bool skip_sync = false;
+  bool skip_sync = false;
 #ifdef _EVENT_USE_OPENSSL
-    skip_sync = evhttp_is_connection_ssl(request->evcon);
+  skip_sync = evhttp_is_connection_ssl(request->evcon);
 #endif
 
-    if (res.chunked) {
-      if (res.chunk) {
-        if (res.firstChunk) {
-          const char *reason = HttpProtocol::GetReasonString(code);
-          evhttp_send_reply_start(request, code, reason);
-        }
-        evhttp_send_reply_chunk(request, res.chunk);
-      } else {
-        evhttp_send_reply_end(request);
+  if (res.chunked) {
+    if (res.chunk) {
+      if (res.firstChunk) {
+        const char *reason = HttpProtocol::GetReasonString(code);
+        evhttp_send_reply_start(request, code, reason);
       }
-    } else if (RuntimeOption::LibEventSyncSend && !skip_sync) {
-      evhttp_send_reply_sync_end(res.nwritten, request);
+      evhttp_send_reply_chunk(request, res.chunk);
     } else {
-      const char *reason = HttpProtocol::GetReasonString(code);
-      evhttp_send_reply(request, code, reason, NULL);
+      evhttp_send_reply_end(request);
     }
+  } else if (RuntimeOption::LibEventSyncSend && !skip_sync) {
+    evhttp_send_reply_sync_end(res.nwritten, request);
+  } else {
+    const char *reason = HttpProtocol::GetReasonString(code);
+    evhttp_send_reply(request, code, reason, NULL);
   }
 }
 
 PendingResponseQueue::Response::Response()
   : request(NULL), code(0), nwritten(0),
-    chunked(false), firstChunk(false), chunk(NULL) {
+    chunked(false), firstChunk(false), chunk(NULL), next(NULL), queued(0) {
 }
 
 PendingResponseQueue::Response::~Response() {
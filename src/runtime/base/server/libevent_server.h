@@ -22,21 +22,24 @@
 #include <runtime/base/timeout_thread.h>
 #include <util/job_queue.h>
 #include <util/process.h>
+#include <util/synchronizable.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
  * Wrapping evhttp_request to keep track of queuing time: from onRequest() to
- * doJob().
+ * doJob(). Also remembers which reactor's event loop the request came from,
+ * as its response has to be sent from that same event loop.
  */
 DECLARE_BOOST_TYPES(LibEventJob);
 class LibEventJob {
 public:
-  LibEventJob(evhttp_request *req);
+  LibEventJob(evhttp_request *req, int reactor);
   void stopTimer();
 
   evhttp_request *request;
+  int reactor;
 
 private:
   timespec start;
@@ -65,14 +68,19 @@ public:
 
 private:
   RequestHandler *m_handler;
+  LibEventTransport *m_transport; // reused by every request of this worker
 };
 
 /**
- * Helper class for queuing up response sending back to event loop.
+ * Helper class for queuing up response sending back to event loop. Workers
+ * push responses onto lock-free stacks, and only the first response after
+ * event loop drained the queue signals it, through an eventfd. So under load,
+ * one wakeup sends many responses.
  */
 class PendingResponseQueue {
 public:
   PendingResponseQueue();
+  ~PendingResponseQueue();
 
   bool empty();
   void create(event_base *eventBase);
@@ -96,22 +104,95 @@ private:
     bool chunked;
     bool firstChunk;
     evbuffer *chunk;
+
+    Response *next; // in ResponseStack
+    int64 queued;   // usec, when stats are turned on
   };
-  DECLARE_BOOST_TYPES(Response);
 
-  class ResponseQueue {
-  public:
-    Mutex m_mutex;
-    std::deque<ResponsePtr> m_responses;
+  /**
+   * Workers push with compare-and-swap, and event loop takes the whole stack
+   * at once, so there is never a mutex between them. One stack per
+   * ResponseQueueCount, padded to a cache line.
+   */
+  struct ResponseStack {
+    ResponseStack() : head(NULL) {}
+    Response *head;
+    char padding[64 - sizeof(Response*)];
   };
-  DECLARE_BOOST_TYPES(ResponseQueue);
 
   // signal between worker thread and response processing thread
   event m_event;
-  CPipe m_ready;
-  ResponseQueuePtrVec m_responseQueues;
+  int m_ready;    // eventfd
+  int m_signaled; // whether m_ready was written since last process()
+  std::vector<ResponseStack> m_stacks;
+  std::vector<Response*> m_batch; // only used by process()
+  time_t m_statsFlushed;
+
+  void enqueue(int worker, Response *response);
+  void send(Response &res);
+};
+
+class LibEventServer;
+
+/**
+ * An additional event loop that accepts connections from the same listen
+ * socket as LibEventServer's own event loop. A connection stays with the
+ * reactor that accepted it, so each reactor has its own evhttp and its own
+ * PendingResponseQueue. Reactor 0 is always LibEventServer's own event loop.
+ */
+DECLARE_BOOST_TYPES(LibEventReactor);
+class LibEventReactor : public Synchronizable {
+public:
+  LibEventReactor(LibEventServer *server, int id);
+  ~LibEventReactor();
+
+  int getId() const { return m_id;}
+  PendingResponseQueue &getResponseQueue() { return m_responseQueue;}
+
+  /**
+   * Starts accepting connections from this socket on a new thread.
+   */
+  void start(int acceptSock);
+
+  /**
+   * Makes evhttp forget the listen socket. Has to be done from reactor's own
+   * thread, so this blocks until the reactor has done so.
+   */
+  void stopAccepting();
+
+  /**
+   * Breaks the event loop, flushes pending responses and waits for the
+   * thread to finish.
+   */
+  void stop();
+  void waitForEnd();
 
-  void enqueue(int worker, ResponsePtr response);
+  /**
+   * Called by evhttp and by the command pipe on reactor's thread.
+   */
+  void onRequest(evhttp_request *request);
+  void onCommand();
+
+private:
+  LibEventServer *m_server;
+  int m_id;
+  event_base *m_eventBase;
+  evhttp *m_http;
+  int m_acceptSock;
+  bool m_accepting;
+  bool m_running;
+  bool m_stopped;
+
+  // commands from other threads: 'd' to delete accept socket, 's' to stop
+  event m_eventCommand;
+  CPipe m_pipeCommand;
+
+  PendingResponseQueue m_responseQueue;
+  AsyncFunc<LibEventReactor> m_thread;
+
+  // reactor thread runs this function
+  void dispatch();
+  void sendCommand(char cmd);
 };
 
 /**
@@ -138,17 +219,25 @@ public:
   void onThreadEnter();
 
   /**
-   * Request handler called by evhttp library.
+   * How many event loops accept and send on connections, including the
+   * dispatcher thread's own. Has to be called before start().
    */
-  void onRequest(evhttp_request *request);
+  void setReactorCount(int count);
+  int getReactorCount() const { return m_reactors.size() + 1;}
+
+  /**
+   * Request handler called by evhttp library of one reactor.
+   */
+  void onRequest(evhttp_request *request, int reactor);
 
   /**
    * Called by LibEventTransport when a response is fully prepared.
    */
-  void onResponse(int worker, evhttp_request *request, int code);
-  void onChunkedResponse(int worker, evhttp_request *request, int code,
-                         evbuffer *chunk, bool firstChunk);
-  void onChunkedResponseEnd(int worker, evhttp_request *request);
+  void onResponse(int worker, int reactor, evhttp_request *request, int code);
+  void onChunkedResponse(int worker, int reactor, evhttp_request *request,
+                         int code, evbuffer *chunk, bool firstChunk);
+  void onChunkedResponseEnd(int worker, int reactor,
+                            evhttp_request *request);
 
   /**
    * To enable SSL of the current server, it will listen to an additional
@@ -161,6 +250,12 @@ protected:
   virtual int getAcceptSocket();
   virtual int getAcceptSocketSSL();
 
+  /**
+   * Makes all additional reactors forget m_accept_sock, so only the
+   * dispatcher thread's evhttp needs to be told about it.
+   */
+  void stopReactorsAccepting();
+
   int m_accept_sock;
   int m_accept_sock_ssl;
   event_base *m_eventBase;
@@ -181,11 +276,12 @@ private:
   AsyncFunc<LibEventServer> m_dispatcherThread;
 
   PendingResponseQueue m_responseQueue;
+  LibEventReactorPtrVec m_reactors; // reactor i + 1 is m_reactors[i]
+
+  PendingResponseQueue &getResponseQueue(int reactor);
 
   // dispatcher thread runs this function
   void dispatch();
-
-  void dispatchWithTimeout(int timeoutSeconds);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
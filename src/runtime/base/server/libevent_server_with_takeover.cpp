@@ -101,6 +101,7 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
     // shutdown request so that we can still serve AFDT requests (if the new
     // server crashes or something).  The downside is that it will take the LB
     // longer to figure out that we are broken.
+    stopReactorsAccepting();
     ret = evhttp_del_accept_socket(m_server, m_accept_sock);
     if (ret < 0) {
       // This will fail if we get a second AFDT request, but the spurious
@@ -115,6 +116,7 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
     // within the main libevent thread.
     int ret;
     *response = P_VERSION C_TERM_BAD;
+    stopReactorsAccepting();
     ret = close(m_accept_sock);
     if (ret < 0) {
       Logger::Error("Unable to close accept socket");
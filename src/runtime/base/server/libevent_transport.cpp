@@ -39,11 +39,20 @@ struct m_evkeyvalq {
   struct evkeyval *tqh_first;
 };
 
-LibEventTransport::LibEventTransport(LibEventServer *server,
-                                     evhttp_request *request,
-                                     int workerId)
-  : m_server(server), m_request(request), m_workerId(workerId),
-    m_sendStarted(false), m_sendEnded(false) {
+LibEventTransport::LibEventTransport(LibEventServer *server, int workerId)
+  : m_server(server), m_request(NULL), m_workerId(workerId), m_reactor(-1),
+    m_method(Transport::UnknownMethod), m_extended_method(NULL),
+    m_sendStarted(false), m_sendEnded(false), m_url(0), m_remote_host(0) {
+  m_http_version[0] = '\0';
+}
+
+void LibEventTransport::reset(evhttp_request *request, int reactor) {
+  Transport::reset();
+  m_request = request;
+  m_reactor = reactor;
+  m_sendStarted = false;
+  m_sendEnded = false;
+
   // HttpProtocol::PrepareSystemVariables needs this
   evbuffer *buf = m_request->input_buffer;
   ASSERT(buf);
@@ -54,13 +63,12 @@ LibEventTransport::LibEventTransport(LibEventServer *server,
     ((char*)EVBUFFER_DATA(buf))[size] = '\0';
   }
 
-  m_remote_host = m_request->remote_host;
+  m_strings.clear();
+  m_requestHeaders.clear();
+  m_remote_host = copyString(m_request->remote_host);
 
-  {
-    char buf[6];
-    snprintf(buf, 6, "%d.%d", m_request->major, m_request->minor);
-    m_http_version = buf;
-  }
+  snprintf(m_http_version, sizeof(m_http_version), "%d.%d",
+           m_request->major, m_request->minor);
 
   switch (m_request->type) {
   case EVHTTP_REQ_GET:
@@ -83,19 +91,26 @@ LibEventTransport::LibEventTransport(LibEventServer *server,
   for (evkeyval *p = ((m_evkeyvalq*)m_request->input_headers)->tqh_first; p;
        p = p->next.tqe_next) {
     if (p->key && p->value) {
-      m_requestHeaders[p->key].push_back(p->value);
+      int name = copyString(p->key);
+      m_requestHeaders.push_back(std::make_pair(name, copyString(p->value)));
     }
   }
 
-  m_url = m_request->uri;
+  m_url = copyString(m_request->uri);
+}
+
+int LibEventTransport::copyString(const char *s) {
+  int offset = m_strings.size();
+  m_strings.insert(m_strings.end(), s, s + strlen(s) + 1);
+  return offset;
 }
 
 const char *LibEventTransport::getUrl() {
-  return m_url.c_str();
+  return getString(m_url);
 }
 
 const char *LibEventTransport::getRemoteHost() {
-  return m_remote_host.c_str();
+  return getString(m_remote_host);
 }
 
 const void *LibEventTransport::getPostData(int &size) {
@@ -159,16 +174,20 @@ std::string LibEventTransport::getHTTPVersion() const {
 std::string LibEventTransport::getHeader(const char *name) {
   ASSERT(name && *name);
 
-  HeaderMap::const_iterator iter = m_requestHeaders.find(name);
-  if (iter != m_requestHeaders.end()) {
-    return iter->second[0];
+  // a request has a dozen headers or so, cheaper to scan than to index
+  for (unsigned int i = 0; i < m_requestHeaders.size(); i++) {
+    if (strcasecmp(getString(m_requestHeaders[i].first), name) == 0) {
+      return getString(m_requestHeaders[i].second);
+    }
   }
   return "";
 }
 
 void LibEventTransport::getHeaders(HeaderMap &headers) {
-  if (&m_requestHeaders != &headers) {
-    headers = m_requestHeaders;
+  headers.clear();
+  for (unsigned int i = 0; i < m_requestHeaders.size(); i++) {
+    headers[getString(m_requestHeaders[i].first)].push_back
+      (getString(m_requestHeaders[i].second));
   }
 }
 
@@ -211,14 +230,21 @@ void LibEventTransport::addRequestHeaderImpl(const char *name,
   if (ret < 0) {
     throw InvalidHeaderException(name, value);
   }
-  m_requestHeaders[name].push_back(value);
+  int n = copyString(name);
+  m_requestHeaders.push_back(std::make_pair(n, copyString(value)));
 }
 
 void LibEventTransport::removeRequestHeaderImpl(const char *name) {
   ASSERT(name && *name);
   ASSERT(m_request->input_headers);
   evhttp_remove_header(m_request->input_headers, name);
-  m_requestHeaders.erase(name);
+  for (unsigned int i = 0; i < m_requestHeaders.size(); ) {
+    if (strcasecmp(getString(m_requestHeaders[i].first), name) == 0) {
+      m_requestHeaders.erase(m_requestHeaders.begin() + i);
+    } else {
+      i++;
+    }
+  }
 }
 
 bool LibEventTransport::isServerStopping() {
@@ -235,13 +261,13 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
     ASSERT(m_method != HEAD);
     evbuffer *chunk = evbuffer_new();
     evbuffer_add(chunk, data, size);
-    m_server->onChunkedResponse(m_workerId, m_request, code, chunk,
-                               !m_sendStarted);
+    m_server->onChunkedResponse(m_workerId, m_reactor, m_request, code,
+                                chunk, !m_sendStarted);
   } else {
     if (m_method != HEAD) {
       evbuffer_add(m_request->output_buffer, data, size);
     }
-    m_server->onResponse(m_workerId, m_request, code);
+    m_server->onResponse(m_workerId, m_reactor, m_request, code);
     m_sendEnded = true;
   }
   m_sendStarted = true;
@@ -249,7 +275,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
 
 void LibEventTransport::onSendEndImpl() {
   if (m_chunkedEncoding) {
-    m_server->onChunkedResponseEnd(m_workerId, m_request);
+    m_server->onChunkedResponseEnd(m_workerId, m_reactor, m_request);
     m_sendEnded = true;
   } else {
     ASSERT(m_sendEnded); // otherwise, we didn't call send for this request
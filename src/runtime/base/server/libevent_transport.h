@@ -24,10 +24,20 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 class LibEventServer;
+
+/**
+ * One of these is kept by each worker and reset() for every request it
+ * serves, so maps, buffers and the gzip stream are reused instead of being
+ * allocated again.
+ */
 class LibEventTransport : public Transport {
 public:
-  LibEventTransport(LibEventServer *server, evhttp_request *request,
-                    int workerId);
+  LibEventTransport(LibEventServer *server, int workerId);
+
+  /**
+   * Starts serving a new request.
+   */
+  void reset(evhttp_request *request, int reactor);
 
   /**
    * Implementing Transport...
@@ -54,14 +64,25 @@ private:
   LibEventServer *m_server;
   evhttp_request *m_request;
   int m_workerId;
-  std::string m_url;
-  std::string m_remote_host;
-  std::string m_http_version;
+  int m_reactor;
+  char m_http_version[6];
   Method m_method;
   const char *m_extended_method;
-  HeaderMap m_requestHeaders;
   bool m_sendStarted;
   bool m_sendEnded;
+
+  /**
+   * URL, remote host and request headers are copied into one buffer, as
+   * event loop may free evhttp_request once response is queued, while we are
+   * still writing access log. Everything else refers to them by offsets.
+   */
+  std::vector<char> m_strings;
+  int m_url;
+  int m_remote_host;
+  std::vector<std::pair<int, int> > m_requestHeaders; // name, value
+
+  int copyString(const char *s);
+  const char *getString(int offset) const { return &m_strings[offset];}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,346 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/server/replay_benchmark.h>
+#include <runtime/base/server/replay_transport.h>
+#include <runtime/base/server/http_request_handler.h>
+#include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/util/countable.h>
+#include <util/async_func.h>
+#include <util/logger.h>
+#include <util/lock.h>
+#include <util/hdf.h>
+#include <dirent.h>
+#include <sys/time.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static int64 now_usec() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (int64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int64 thread_cpu_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64 percentile(const vector<int64> &values, int permille) {
+  if (values.empty()) return 0;
+  size_t index = values.size() * permille / 1000;
+  if (index >= values.size()) index = values.size() - 1;
+  return values[index];
+}
+
+static string format_change(double base, double value) {
+  if (base == 0) return "";
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%+.1f%%", (value - base) * 100 / base);
+  return buf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ReplayBenchmark::ReplayBenchmark(int threadCount, int qps, int rounds)
+  : m_threadCount(threadCount > 0 ? threadCount : 1), m_qps(qps),
+    m_rounds(rounds > 0 ? rounds : 1), m_next(0), m_start(0),
+    m_elapsed(0) {
+}
+
+bool ReplayBenchmark::addInput(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    Logger::Error("unable to stat %s", path.c_str());
+    return false;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+      Logger::Error("unable to open directory %s", path.c_str());
+      return false;
+    }
+    vector<string> files;
+    dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+      string file = path + "/" + de->d_name;
+      if (de->d_name[0] != '.' && stat(file.c_str(), &st) == 0 &&
+          S_ISREG(st.st_mode)) {
+        files.push_back(file);
+      }
+    }
+    closedir(dir);
+    sort(files.begin(), files.end());
+    bool ret = true;
+    for (unsigned int i = 0; i < files.size(); i++) {
+      if (!addInput(files[i])) ret = false;
+    }
+    return ret;
+  }
+
+  try {
+    Hdf hdf;
+    hdf.open(path);
+    if (!hdf["url"].exists()) {
+      Logger::Warning("%s is not a recorded request", path.c_str());
+      return false;
+    }
+    m_names.push_back(path);
+    m_inputs.push_back(hdf.toString());
+  } catch (const HdfException &e) {
+    Logger::Error("unable to read %s: %s", path.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ReplayBenchmark::run() {
+  if (m_inputs.empty()) return;
+
+  vector<AsyncFunc<ReplayBenchmark> *> threads;
+  for (int i = 0; i < m_threadCount; i++) {
+    threads.push_back(new AsyncFunc<ReplayBenchmark>
+                      (this, &ReplayBenchmark::runRequests));
+  }
+  m_next = 0;
+  m_samples.clear();
+  m_start = now_usec();
+  for (unsigned int i = 0; i < threads.size(); i++) {
+    threads[i]->start();
+  }
+  for (unsigned int i = 0; i < threads.size(); i++) {
+    threads[i]->waitForEnd();
+    delete threads[i];
+  }
+  m_elapsed = now_usec() - m_start;
+}
+
+void ReplayBenchmark::runRequests() {
+  HttpRequestHandler handler;
+  vector<Sample> samples;
+  int total = m_inputs.size() * m_rounds;
+  while (true) {
+    int i;
+    {
+      Lock lock(m_mutex);
+      if (m_next >= total) break;
+      i = m_next++;
+    }
+
+    Sample sample;
+    sample.input = i % m_inputs.size();
+    Hdf hdf;
+    hdf.fromString(m_inputs[sample.input].c_str());
+    ReplayTransport rt;
+    rt.replayInput(hdf);
+
+    int64 due;
+    if (m_qps > 0) {
+      due = m_start + (int64)i * 1000000 / m_qps;
+      int64 now = now_usec();
+      if (due > now) usleep(due - now);
+    } else {
+      due = now_usec();
+    }
+
+    int64 cpu = thread_cpu_usec();
+    int64 refOps = get_refcount_ops();
+    handler.handleRequest(&rt);
+    sample.latency = now_usec() - due;
+    sample.cpu = thread_cpu_usec() - cpu;
+    sample.refOps = get_refcount_ops() - refOps;
+    sample.code = rt.getResponseCode();
+
+    // reset at the beginning of each request, and left as is at the end
+    const MemoryUsageStats &stats =
+      MemoryManager::TheMemoryManager()->getStats();
+    sample.allocs = stats.allocCount;
+    sample.peakUsage = stats.peakUsage;
+    samples.push_back(sample);
+  }
+
+  Lock lock(m_mutex);
+  m_samples.insert(m_samples.end(), samples.begin(), samples.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ReplayBenchmark::summarize(Summary &summary, int input) const {
+  vector<int64> latencies;
+  for (unsigned int i = 0; i < m_samples.size(); i++) {
+    const Sample &sample = m_samples[i];
+    if (input >= 0 && sample.input != input) continue;
+    summary.count++;
+    if (sample.code != 200) summary.errors++;
+    latencies.push_back(sample.latency);
+    summary.cpu += sample.cpu;
+    summary.allocs += sample.allocs;
+    summary.peakUsage += sample.peakUsage;
+    summary.refOps += sample.refOps;
+  }
+  if (summary.count == 0) return;
+
+  sort(latencies.begin(), latencies.end());
+  summary.p50 = percentile(latencies, 500);
+  summary.p99 = percentile(latencies, 990);
+  summary.p999 = percentile(latencies, 999);
+  summary.max = latencies.back();
+  summary.cpu /= summary.count;
+  summary.allocs /= summary.count;
+  summary.peakUsage /= summary.count;
+  summary.refOps /= summary.count;
+}
+
+void ReplayBenchmark::report(FILE *f) const {
+  Summary all;
+  summarize(all, -1);
+  double seconds = m_elapsed / 1000000.0;
+
+  fprintf(f, "requests:     %d (%d errors) on %d threads\n",
+          all.count, all.errors, m_threadCount);
+  fprintf(f, "throughput:   %.1f requests/sec", seconds > 0 ?
+          all.count / seconds : 0);
+  if (m_qps > 0) fprintf(f, " (target %d)", m_qps);
+  fprintf(f, "\n");
+  fprintf(f, "latency:      p50 %lldus, p99 %lldus, p999 %lldus, max %lldus\n",
+          all.p50, all.p99, all.p999, all.max);
+  fprintf(f, "per request:  %lldus CPU, %lld allocations, %lld bytes peak\n",
+          all.cpu, all.allocs, all.peakUsage);
+  if (all.refOps) {
+    fprintf(f, "              %lld refcount operations\n", all.refOps);
+  }
+
+  if (m_inputs.size() > 1) {
+    fprintf(f, "\n%10s %10s %10s %10s  %s\n",
+            "p50(us)", "p99(us)", "cpu(us)", "allocs", "request");
+    for (unsigned int i = 0; i < m_inputs.size(); i++) {
+      Summary summary;
+      summarize(summary, i);
+      fprintf(f, "%10lld %10lld %10lld %10lld  %s\n", summary.p50,
+              summary.p99, summary.cpu, summary.allocs, m_names[i].c_str());
+    }
+  }
+}
+
+void ReplayBenchmark::save(const char *filename) const {
+  Summary all;
+  summarize(all, -1);
+
+  Hdf hdf;
+  hdf["threads"] = m_threadCount;
+  hdf["qps"] = m_qps;
+  hdf["elapsed"] = m_elapsed;
+  hdf["requests"] = all.count;
+  hdf["errors"] = all.errors;
+  hdf["p50"] = all.p50;
+  hdf["p99"] = all.p99;
+  hdf["p999"] = all.p999;
+  hdf["max"] = all.max;
+  hdf["cpu"] = all.cpu;
+  hdf["allocs"] = all.allocs;
+  hdf["peak"] = all.peakUsage;
+  hdf["refops"] = all.refOps;
+  for (unsigned int i = 0; i < m_inputs.size(); i++) {
+    Summary summary;
+    summarize(summary, i);
+    Hdf input = hdf["inputs"][(int)i];
+    input["name"] = m_names[i];
+    input["p50"] = summary.p50;
+    input["p99"] = summary.p99;
+    input["cpu"] = summary.cpu;
+    input["allocs"] = summary.allocs;
+    input["refops"] = summary.refOps;
+  }
+  hdf.write(filename);
+}
+
+bool ReplayBenchmark::diff(FILE *f, const char *filename,
+                           int threshold /* = 10 */) const {
+  Hdf base;
+  try {
+    base.open(filename);
+  } catch (const HdfException &e) {
+    Logger::Error("unable to read %s: %s", filename, e.what());
+    return false;
+  }
+
+  Summary all;
+  summarize(all, -1);
+  double seconds = m_elapsed / 1000000.0;
+  double baseSeconds = base["elapsed"].getInt64() / 1000000.0;
+  double qps = seconds > 0 ? all.count / seconds : 0;
+  double baseQps = baseSeconds > 0 ?
+    base["requests"].getInt32() / baseSeconds : 0;
+
+  struct {
+    const char *name;
+    double base;
+    double value;
+  } metrics[] = {
+    {"requests/sec", baseQps,                          qps},
+    {"p50(us)",      (double)base["p50"].getInt64(),    (double)all.p50},
+    {"p99(us)",      (double)base["p99"].getInt64(),    (double)all.p99},
+    {"p999(us)",     (double)base["p999"].getInt64(),   (double)all.p999},
+    {"cpu(us)",      (double)base["cpu"].getInt64(),    (double)all.cpu},
+    {"allocs",       (double)base["allocs"].getInt64(), (double)all.allocs},
+    {"peak(bytes)",  (double)base["peak"].getInt64(),   (double)all.peakUsage},
+    {"refcount ops", (double)base["refops"].getInt64(), (double)all.refOps},
+    {"errors",       (double)base["errors"].getInt32(), (double)all.errors},
+  };
+
+  fprintf(f, "%-14s %12s %12s %8s\n", "", "baseline", "this run", "change");
+  for (unsigned int i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) {
+    fprintf(f, "%-14s %12.0f %12.0f %8s\n", metrics[i].name, metrics[i].base,
+            metrics[i].value,
+            format_change(metrics[i].base, metrics[i].value).c_str());
+  }
+
+  map<string, Hdf> baseInputs;
+  for (Hdf hdf = base["inputs"].firstChild(); hdf.exists();
+       hdf = hdf.next()) {
+    baseInputs[hdf["name"].getString()] = hdf;
+  }
+  bool header = false;
+  for (unsigned int i = 0; i < m_inputs.size(); i++) {
+    map<string, Hdf>::const_iterator iter = baseInputs.find(m_names[i]);
+    if (iter == baseInputs.end()) continue;
+    Summary summary;
+    summarize(summary, i);
+    int64 p50 = iter->second["p50"].getInt64();
+    if (p50 <= 0 ||
+        llabs(summary.p50 - p50) * 100 <= (int64)p50 * threshold) {
+      continue;
+    }
+    if (!header) {
+      fprintf(f, "\nmedian latency changed by more than %d%%:\n", threshold);
+      header = true;
+    }
+    fprintf(f, "%8s %10lld -> %10lldus  %s\n",
+            format_change(p50, summary.p50).c_str(), p50, summary.p50,
+            m_names[i].c_str());
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,114 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_REPLAY_BENCHMARK_H__
+#define __HPHP_REPLAY_BENCHMARK_H__
+
+#include <util/mutex.h>
+#include <util/base.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Replays a corpus of requests recorded by ReplayTransport through
+ * HttpRequestHandler on a number of threads, to measure how fast a build
+ * serves them, without any networking.
+ *
+ * With a target QPS, request i is due i / qps seconds after start (open
+ * loop) and its latency is counted from then, so time spent waiting for a
+ * free thread shows up in latency instead of slowing down arrivals. Without
+ * one, each thread runs requests back to back.
+ */
+class ReplayBenchmark {
+public:
+  ReplayBenchmark(int threadCount, int qps, int rounds);
+
+  /**
+   * Adds a recorded request file, or all files directly under a directory.
+   */
+  bool addInput(const std::string &path);
+  int getInputCount() const { return m_inputs.size();}
+
+  void run();
+
+  /**
+   * Latency percentiles, CPU time and smart allocations per request.
+   */
+  void report(FILE *f) const;
+
+  /**
+   * Saves results in HDF format, so a later run of another build can diff()
+   * against them.
+   */
+  void save(const char *filename) const;
+
+  /**
+   * Prints how this run differs from saved results, including requests
+   * whose median latency changed by more than threshold percent.
+   */
+  bool diff(FILE *f, const char *filename, int threshold = 10) const;
+
+  /**
+   * Body of each worker thread.
+   */
+  void runRequests();
+
+private:
+  struct Sample {
+    int input;
+    int code;
+    int64 latency;    // us since request was due
+    int64 cpu;        // us of thread CPU time
+    int64 allocs;     // smart allocations
+    int64 peakUsage;  // bytes
+    int64 refOps;     // incRefCount()/decRefCount() calls, counting build
+  };
+
+  struct Summary {
+    Summary() : count(0), errors(0), p50(0), p99(0), p999(0), max(0),
+                cpu(0), allocs(0), peakUsage(0), refOps(0) {}
+    int count;
+    int errors;
+    int64 p50;
+    int64 p99;
+    int64 p999;
+    int64 max;
+    int64 cpu;
+    int64 allocs;
+    int64 peakUsage;
+    int64 refOps;
+  };
+
+  int m_threadCount;
+  int m_qps;
+  int m_rounds;
+  std::vector<std::string> m_names;
+  std::vector<std::string> m_inputs; // recorded HDF of each request
+
+  Mutex m_mutex;
+  int m_next;
+  int64 m_start;   // us
+  int64 m_elapsed; // us
+  std::vector<Sample> m_samples;
+
+  void summarize(Summary &summary, int input) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_REPLAY_BENCHMARK_H__
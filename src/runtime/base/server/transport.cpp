@@ -26,12 +26,55 @@
 #include <runtime/base/zend/zend_url.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/access_log.h>
+#include <util/thread_local.h>
 
 using namespace std;
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * deflateInit2() mallocs a few hundred KB of window and hash tables, so each
+ * thread keeps the compressors its responses are done with, and hands them
+ * out again after a deflateReset().
+ */
+class CompressorPool {
+public:
+  static const unsigned int MaxSize = 4;
+
+  ~CompressorPool() {
+    for (unsigned int i = 0; i < m_compressors.size(); i++) {
+      delete m_compressors[i];
+    }
+  }
+
+  StreamCompressor *get(int level) {
+    for (unsigned int i = m_compressors.size(); i--; ) {
+      StreamCompressor *compressor = m_compressors[i];
+      if (compressor->getLevel() == level) {
+        m_compressors.erase(m_compressors.begin() + i);
+        compressor->reset();
+        return compressor;
+      }
+    }
+    return new StreamCompressor(level, CODING_GZIP, true);
+  }
+
+  void put(StreamCompressor *compressor) {
+    if (m_compressors.size() >= MaxSize) {
+      delete m_compressors.front();
+      m_compressors.erase(m_compressors.begin());
+    }
+    m_compressors.push_back(compressor);
+  }
+
+private:
+  std::vector<StreamCompressor*> m_compressors;
+};
+static IMPLEMENT_THREAD_LOCAL(CompressorPool, s_compressors);
+
+///////////////////////////////////////////////////////////////////////////////
+
 Transport::Transport()
   : m_url(NULL), m_postData(NULL), m_postDataParsed(false),
     m_chunkedEncoding(false), m_headerSent(false),
@@ -47,8 +90,39 @@ Transport::~Transport() {
     free(m_postData);
   }
   if (m_compressor) {
-    delete m_compressor;
+    s_compressors->put(m_compressor);
+  }
+}
+
+void Transport::reset() {
+  if (m_url) {
+    free(m_url);
+    m_url = NULL;
+  }
+  if (m_postData) {
+    free(m_postData);
+    m_postData = NULL;
+  }
+  m_postDataParsed = false;
+  m_getParams.clear();
+  m_postParams.clear();
+
+  m_chunkedEncoding = false;
+  m_headerSent = false;
+  m_responseCode = -1;
+  m_responseHeaders.clear();
+  m_responseCookies.clear();
+  m_responseSize = 0;
+
+  m_mimeType.clear();
+  m_sendContentType = true;
+  m_compression = true;
+  if (m_compressor) {
+    s_compressors->put(m_compressor);
+    m_compressor = NULL;
   }
+
+  m_threadType = RequestThread;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -507,8 +581,16 @@ String Transport::prepareResponse(const void *data, int size, bool &compressed,
   // where we don't really know if next chunk will benefit from compresseion.
   if (m_chunkedEncoding || size > 1000) {
     if (m_compressor == NULL) {
-      m_compressor = new StreamCompressor(RuntimeOption::GzipCompressionLevel,
-                                         CODING_GZIP, true);
+      int level = RuntimeOption::GzipCompressionLevel;
+      if (RuntimeOption::GzipLargeBodySize > 0 &&
+          size >= RuntimeOption::GzipLargeBodySize) {
+        level = RuntimeOption::GzipLargeBodyCompressionLevel;
+      }
+      m_compressor = s_compressors->get(level);
+    }
+    ServerStatsHelper ssh("gzip");
+    if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+      ServerStats::Log("network.gzipped", size);
     }
     int len = size;
     char *compressedData = m_compressor->compress((const char*)data, len, last);
@@ -520,7 +602,7 @@ String Transport::prepareResponse(const void *data, int size, bool &compressed,
       }
     } else {
       Logger::Error("Unable to compress response: level=%d len=%d",
-                    RuntimeOption::GzipCompressionLevel, len);
+                    m_compressor->getLevel(), len);
     }
   }
 
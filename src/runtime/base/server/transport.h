@@ -307,6 +307,12 @@ protected:
 
   ThreadType m_threadType;
 
+  /**
+   * For transports that are reused from request to request: clears what the
+   * last request left, keeping containers' memory.
+   */
+  void reset();
+
   // helpers
   void parseGetParams();
   void parsePostParams();
@@ -17,6 +17,7 @@
 #include <runtime/base/shared/shared_map.h>
 #include <runtime/base/array/map_variant.h>
 #include <runtime/base/array/zend_array.h>
+#include <runtime/base/array/typed_vector.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/runtime_error.h>
 
@@ -100,7 +101,7 @@ ArrayData *SharedMap::lval(CVarRef k, Variant *&ret, bool copy,
 }
 
 ArrayData *SharedMap::set(int64 k, CVarRef v, bool copy, int64 prehash) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->set(k, v, false, prehash);
   if (ee) {
     escalated->release();
@@ -109,7 +110,7 @@ ArrayData *SharedMap::set(int64 k, CVarRef v, bool copy, int64 prehash) {
   return escalated;
 }
 ArrayData *SharedMap::set(litstr k, CVarRef v, bool copy, int64 prehash) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->set(k, v, false, prehash);
   if (ee) {
     escalated->release();
@@ -118,7 +119,7 @@ ArrayData *SharedMap::set(litstr k, CVarRef v, bool copy, int64 prehash) {
   return escalated;
 }
 ArrayData *SharedMap::set(CStrRef k, CVarRef v, bool copy, int64 prehash) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->set(k, v, false, prehash);
   if (ee) {
     escalated->release();
@@ -127,7 +128,7 @@ ArrayData *SharedMap::set(CStrRef k, CVarRef v, bool copy, int64 prehash) {
   return escalated;
 }
 ArrayData *SharedMap::set(CVarRef k, CVarRef v, bool copy, int64 prehash) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->set(k, v, false, prehash);
   if (ee) {
     escalated->release();
@@ -174,11 +175,11 @@ ArrayData *SharedMap::remove(CVarRef k, bool copy, int64 prehash /* = -1 */) {
 }
 
 ArrayData *SharedMap::copy() const {
-  return escalate();
+  return escalateForWrite();
 }
 
 ArrayData *SharedMap::append(CVarRef v, bool copy) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->append(v, false);
   if (ee) {
     escalated->release();
@@ -188,7 +189,7 @@ ArrayData *SharedMap::append(CVarRef v, bool copy) {
 }
 
 ArrayData *SharedMap::append(const ArrayData *elems, ArrayOp op, bool copy) {
-  ArrayData *escalated = escalate();
+  ArrayData *escalated = escalateForWrite();
   ArrayData *ee = escalated->append(elems, op, false);
   if (ee) {
     escalated->release();
@@ -214,6 +215,11 @@ ArrayData *SharedMap::escalate(bool mutableIteration /* = false */) const {
   return ret;
 }
 
+ArrayData *SharedMap::escalateForWrite() const {
+  ArrayData *ret = TypedVector::Pack(this);
+  return ret ? ret : escalate();
+}
+
 MapVariant *SharedMap::escalateToMapVariant() const {
   ASSERT(!RuntimeOption::UseZendArray);
   return (MapVariant *)escalate();
@@ -136,6 +136,13 @@ public:
   virtual ArrayData *escalate(bool mutableIteration = false) const;
   MapVariant *escalateToMapVariant() const;
 
+  /**
+   * Local copy to modify: a TypedVector when the array is a vector of one
+   * scalar type, as nobody can have references into a fresh copy, or else
+   * the same as escalate().
+   */
+  ArrayData *escalateForWrite() const;
+
 private:
   SharedVariant *m_arr;
   mutable Array m_localCache;
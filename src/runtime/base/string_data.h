@@ -80,6 +80,21 @@ class StringData {
     return m_hash & 0x7fffffffffffffffull;
   }
 
+  /**
+   * Same as hash_string() of the contents, computed on first use and kept
+   * until the string is modified. Shared memory strings use the space for
+   * their SharedVariant, so they are hashed every time.
+   */
+  int64 hash() const {
+    if (isShared()) return hash_string(data(), size());
+    int64 h = m_hash & 0x7fffffffffffffffull;
+    if (h == 0 && !isStatic()) {
+      h = hash_string(data(), size());
+      m_hash = h;
+    }
+    return h;
+  }
+
   StringData() : m_data(NULL), _count(0), m_len(0), m_shared(NULL) {
     #ifdef TAINTED
     m_tainted = false;
@@ -190,7 +205,7 @@ class StringData {
   mutable unsigned int m_len;
   union {
     SharedVariant *m_shared;
-    mutable int64  m_hash;   // precompute hash codes for static strings
+    mutable int64  m_hash;   // hash codes, precomputed for static strings
   };
   #ifdef TAINTED
   bool m_tainted;
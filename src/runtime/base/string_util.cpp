@@ -421,6 +421,130 @@ String StringUtil::UrlDecode(CStrRef input, bool decodePlus /* = true */) {
   return String(ret, len, AttachString);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// charset conversion
+
+enum NativeCharset {
+  CharsetUnknown,
+  CharsetASCII,
+  CharsetLatin1,
+  CharsetUTF8,
+};
+
+static NativeCharset native_charset(const char *name) {
+  if (!strcasecmp(name, "UTF-8") || !strcasecmp(name, "UTF8")) {
+    return CharsetUTF8;
+  }
+  if (!strcasecmp(name, "ISO-8859-1") || !strcasecmp(name, "ISO8859-1") ||
+      !strcasecmp(name, "ISO_8859-1") || !strcasecmp(name, "LATIN1")) {
+    return CharsetLatin1;
+  }
+  if (!strcasecmp(name, "ASCII") || !strcasecmp(name, "US-ASCII")) {
+    return CharsetASCII;
+  }
+  return CharsetUnknown;
+}
+
+/**
+ * Length of the leading run of 7-bit characters, checking 8 bytes a time.
+ */
+static int ascii_prefix(const char *s, int len) {
+  int i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64 word;
+    memcpy(&word, s + i, sizeof(word));
+    if (word & 0x8080808080808080ULL) break;
+  }
+  while (i < len && !(s[i] & 0x80)) i++;
+  return i;
+}
+
+/**
+ * Decodes one non-ASCII character, rejecting overlong forms, surrogates and
+ * anything above U+10FFFF just like iconv does. Returns bytes used, or 0.
+ */
+static int utf8_decode_char(const unsigned char *s, int len, int &cp) {
+  unsigned char c = s[0];
+  if (c < 0xc2 || c > 0xf4) return 0;
+  if (c < 0xe0) {
+    if (len < 2 || (s[1] & 0xc0) != 0x80) return 0;
+    cp = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+    return 2;
+  }
+  if (c < 0xf0) {
+    if (len < 3 || (s[1] & 0xc0) != 0x80 || (s[2] & 0xc0) != 0x80) return 0;
+    cp = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+    if (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff)) return 0;
+    return 3;
+  }
+  if (len < 4 || (s[1] & 0xc0) != 0x80 || (s[2] & 0xc0) != 0x80 ||
+      (s[3] & 0xc0) != 0x80) {
+    return 0;
+  }
+  cp = ((c & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) |
+    (s[3] & 0x3f);
+  if (cp < 0x10000 || cp > 0x10ffff) return 0;
+  return 4;
+}
+
+String StringUtil::ConvertCharset(CStrRef input, const char *to,
+                                  const char *from) {
+  ASSERT(to && from);
+  NativeCharset cto = native_charset(to);
+  NativeCharset cfrom = native_charset(from);
+  if (cto == CharsetUnknown || cfrom == CharsetUnknown) return String();
+
+  // 7-bit text is the same in all three
+  const char *s = input.data();
+  int len = input.size();
+  int pos = ascii_prefix(s, len);
+  if (pos == len) return input;
+  if (cto == CharsetASCII || cfrom == CharsetASCII) return String();
+  if (cto == CharsetLatin1 && cfrom == CharsetLatin1) return input;
+
+  if (cfrom == CharsetLatin1) {
+    char *ret = (char *)malloc(len * 2 + 1);
+    memcpy(ret, s, pos);
+    int n = pos;
+    while (pos < len) {
+      unsigned char c = s[pos++];
+      ret[n++] = 0xc0 | (c >> 6);
+      ret[n++] = 0x80 | (c & 0x3f);
+      int run = ascii_prefix(s + pos, len - pos);
+      memcpy(ret + n, s + pos, run);
+      pos += run;
+      n += run;
+    }
+    ret[n] = '\0';
+    return String(ret, n, AttachString);
+  }
+
+  // from UTF-8, validating to UTF-8 or narrowing to ISO-8859-1
+  bool narrow = (cto == CharsetLatin1);
+  char *ret = narrow ? (char *)malloc(len + 1) : NULL;
+  if (ret) memcpy(ret, s, pos);
+  int n = pos;
+  while (pos < len) {
+    int cp;
+    int used = utf8_decode_char((const unsigned char *)s + pos, len - pos, cp);
+    if (used == 0 || (narrow && cp > 0xff)) {
+      free(ret);
+      return String();
+    }
+    if (ret) ret[n++] = cp;
+    pos += used;
+    int run = ascii_prefix(s + pos, len - pos);
+    if (ret) {
+      memcpy(ret + n, s + pos, run);
+      n += run;
+    }
+    pos += run;
+  }
+  if (!narrow) return input;
+  ret[n] = '\0';
+  return String(ret, n, AttachString);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // formatting
 
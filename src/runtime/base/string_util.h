@@ -103,6 +103,16 @@ public:
   static String UrlEncode(CStrRef input, bool encodePlus = true);
   static String UrlDecode(CStrRef input, bool decodePlus = true);
 
+  /**
+   * Converts among UTF-8, ISO-8859-1 and ASCII without going through iconv
+   * or mbfl. Returns a null string when either charset is something else,
+   * or when input is not valid in its charset or not representable in the
+   * other one, so callers can fall back to their own conversion, with their
+   * own error handling.
+   */
+  static String ConvertCharset(CStrRef input, const char *to,
+                               const char *from);
+
   /**
    * Formatting.
    */
@@ -19,6 +19,7 @@
 #include <runtime/base/util/string_buffer.h>
 #include <runtime/base/runtime_error.h>
 #include <runtime/base/builtin_functions.h>
+#include <util/thread_local.h>
 
 namespace HPHP {
 
@@ -213,6 +214,345 @@ Array DateTime::Parse(CStrRef ts, CStrRef format) {
   return ret;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// formatting
+
+/**
+ * Everything date formats print, gathered once per call instead of through
+ * accessors that query timelib and the timezone again for every character.
+ */
+struct DateFields {
+  int year, month, day, hour, minute, second;
+  double fraction;
+  int64 sse;
+  bool utc;
+  timelib_tzinfo *tzi;  // zone of local time, NULL for UTC
+  int64 timestamp;      // only set when format needs it
+  int offset;
+  bool dst;
+  const char *abbr;     // abbreviation in effect, for strftime()
+};
+
+/**
+ * A date() format split once into specifiers and literal text. Programs use
+ * a handful of constant formats, so compiled ones are kept per thread in a
+ * small table indexed by hash, and a collision just compiles again.
+ */
+class CompiledDateFormat {
+public:
+  static const int CacheSize = 64;
+  static const CompiledDateFormat &Get(CStrRef format);
+
+  struct Op {
+    char spec;  // 0 for next "len" chars of literals
+    int len;
+  };
+
+  std::string format;
+  std::vector<Op> ops;
+  std::string literals;
+  bool needsTimestamp;
+
+  void compile(CStrRef fmt);
+};
+
+struct CompiledDateFormats {
+  CompiledDateFormat formats[CompiledDateFormat::CacheSize];
+};
+static IMPLEMENT_THREAD_LOCAL(CompiledDateFormats, s_compiled_date_formats);
+
+const CompiledDateFormat &CompiledDateFormat::Get(CStrRef format) {
+  int slot = hash_string(format.data(), format.size()) & (CacheSize - 1);
+  CompiledDateFormat &compiled = s_compiled_date_formats->formats[slot];
+  if (compiled.format.size() != (size_t)format.size() ||
+      memcmp(compiled.format.data(), format.data(), format.size())) {
+    compiled.compile(format);
+  }
+  return compiled;
+}
+
+void CompiledDateFormat::compile(CStrRef fmt) {
+  format.assign(fmt.data(), fmt.size());
+  ops.clear();
+  literals.clear();
+  needsTimestamp = false;
+
+  for (int i = 0; i < fmt.size(); i++) {
+    char c = fmt.charAt(i);
+    switch (c) {
+    case 'I': case 'P': case 'O': case 'Z': case 'c': case 'r': case 'U':
+      needsTimestamp = true; /* break intentionally missing */
+    case 'd': case 'D': case 'j': case 'l': case 'S': case 'w': case 'N':
+    case 'z': case 'W': case 'o': case 'F': case 'm': case 'M': case 'n':
+    case 't': case 'L': case 'y': case 'Y': case 'a': case 'A': case 'B':
+    case 'g': case 'G': case 'h': case 'H': case 'i': case 's': case 'u':
+    case 'T': case 'e':
+      {
+        Op op = {c, 0};
+        ops.push_back(op);
+      }
+      continue;
+    case '\\':
+      // a trailing backslash prints the terminating NUL, as it always did
+      c = fmt.charAt(++i);
+      break;
+    default:
+      break;
+    }
+    if (ops.empty() || ops.back().spec) {
+      Op op = {0, 0};
+      ops.push_back(op);
+    }
+    ops.back().len++;
+    literals += c;
+  }
+}
+
+/**
+ * Broken-down time of the timestamp formatted last on this thread, and the
+ * date of the local day it falls on. Pages format current time over and
+ * over, and only a new second or a new zone needs any conversion at all.
+ */
+class DateFieldsCache {
+public:
+  DateFieldsCache() : valid(false), m_day(-1) {}
+
+  bool valid;
+  DateFields fields;
+  std::string zoneName; // not a String, which wouldn't outlive the request
+  TimeZoneInfo zone;
+
+  /**
+   * Fills in date and time of fields from seconds since epoch in local time.
+   */
+  void split(int64 local);
+
+private:
+  int64 m_day; // local days since epoch of the cached date
+  int m_year, m_month, m_dayOfMonth;
+};
+static IMPLEMENT_THREAD_LOCAL(DateFieldsCache, s_date_fields_cache);
+
+void DateFieldsCache::split(int64 local) {
+  DateFields &f = fields;
+  if (local >= 0) {
+    int64 day = local / 86400;
+    if (day != m_day) {
+      timelib_time t;
+      memset(&t, 0, sizeof(t));
+      timelib_unixtime2gmt(&t, day * 86400);
+      m_day = day;
+      m_year = t.y;
+      m_month = t.m;
+      m_dayOfMonth = t.d;
+    }
+    int rem = local % 86400;
+    f.year = m_year;
+    f.month = m_month;
+    f.day = m_dayOfMonth;
+    f.hour = rem / 3600;
+    f.minute = rem % 3600 / 60;
+    f.second = rem % 60;
+  } else {
+    // timelib has its own idea of days before 1970, so ask it every time
+    timelib_time t;
+    memset(&t, 0, sizeof(t));
+    timelib_unixtime2gmt(&t, local);
+    f.year = t.y;
+    f.month = t.m;
+    f.day = t.d;
+    f.hour = t.h;
+    f.minute = t.i;
+    f.second = t.s;
+  }
+}
+
+/**
+ * Same as printf("%0*d"), without parsing a format for every field.
+ */
+static void append_padded(StringBuffer &s, int n, int width) {
+  if (n < 0) {
+    s.printf("%0*d", width, n);
+    return;
+  }
+  char buf[16];
+  char *end = buf + sizeof(buf);
+  char *p = end;
+  do {
+    *--p = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  while (end - p < width) *--p = '0';
+  s.append(p, end - p);
+}
+
+static int beat_of(int64 sse) {
+  int retval = (((((long)sse)-(((long)sse) -
+                               ((((long)sse) % 86400) + 3600))) * 10) / 864);
+  while (retval < 0) {
+    retval += 1000;
+  }
+  return retval % 1000;
+}
+
+static String format_rfc(const CompiledDateFormat &compiled,
+                         const DateFields &f) {
+  StringBuffer s(compiled.literals.size() + compiled.ops.size() * 4 + 16);
+  const char *literal = compiled.literals.data();
+  bool rfc_colon = false;
+  int hour12 = (f.hour % 12) ? f.hour % 12 : 12;
+  for (unsigned int i = 0; i < compiled.ops.size(); i++) {
+    const CompiledDateFormat::Op &op = compiled.ops[i];
+    switch (op.spec) {
+    case 0:
+      s.append(literal, op.len);
+      literal += op.len;
+      break;
+    case 'd': append_padded(s, f.day, 2); break;
+    case 'D':
+      s.append(DateTime::GetShortWeekdayName(f.year, f.month, f.day));
+      break;
+    case 'j': s.append(f.day); break;
+    case 'l': s.append(DateTime::GetWeekdayName(f.year, f.month, f.day));
+      break;
+    case 'S': s.append(DateTime::OrdinalSuffix(f.day)); break;
+    case 'w': s.append((int)timelib_day_of_week(f.year, f.month, f.day));
+      break;
+    case 'N':
+      s.append((int)timelib_iso_day_of_week(f.year, f.month, f.day));
+      break;
+    case 'z': s.append((int)timelib_day_of_year(f.year, f.month, f.day));
+      break;
+    case 'W':
+    case 'o':
+      {
+        timelib_sll iw, iy;
+        timelib_isoweek_from_date(f.year, f.month, f.day, &iw, &iy);
+        if (op.spec == 'W') {
+          append_padded(s, (int)iw, 2);
+        } else {
+          s.append((int)iy);
+        }
+      }
+      break;
+    case 'F': s.append(DateTime::MonthNames[f.month - 1]); break;
+    case 'm': append_padded(s, f.month, 2); break;
+    case 'M': s.append(DateTime::ShortMonthNames[f.month - 1]); break;
+    case 'n': s.append(f.month); break;
+    case 't': s.append(DateTime::DaysInMonth(f.year, f.month)); break;
+    case 'L': s.append(DateTime::IsLeap(f.year)); break;
+    case 'y': append_padded(s, f.year % 100, 2); break;
+    case 'Y':
+      if (f.year < 0) s.append('-');
+      append_padded(s, abs(f.year), 4);
+      break;
+    case 'a': s.append(f.hour >= 12 ? "pm" : "am"); break;
+    case 'A': s.append(f.hour >= 12 ? "PM" : "AM"); break;
+    case 'B': append_padded(s, beat_of(f.sse), 3); break;
+    case 'g': s.append(hour12); break;
+    case 'G': s.append(f.hour); break;
+    case 'h': append_padded(s, hour12, 2); break;
+    case 'H': append_padded(s, f.hour, 2); break;
+    case 'i': append_padded(s, f.minute, 2); break;
+    case 's': append_padded(s, f.second, 2); break;
+    case 'u': append_padded(s, (int)floor(f.fraction * 1000000), 6); break;
+    case 'I': s.append(!f.utc && f.dst ? 1 : 0); break;
+    case 'P': rfc_colon = true; /* break intentionally missing */
+    case 'O':
+      if (f.utc) {
+        s.append(rfc_colon ? "+0:0" : "+00");
+      } else {
+        s.append(f.offset < 0 ? '-' : '+');
+        append_padded(s, abs(f.offset / 3600), 2);
+        if (rfc_colon) s.append(':');
+        append_padded(s, abs((f.offset % 3600) / 60), 2);
+      }
+      break;
+    case 'T':
+      if (f.utc) {
+        s.append("GMT");
+      } else if (f.tzi && f.tzi->timezone_abbr) {
+        s.append(f.tzi->timezone_abbr);
+      }
+      break;
+    case 'e':
+      if (f.utc) {
+        s.append("UTC");
+      } else if (f.tzi && f.tzi->name) {
+        s.append(f.tzi->name);
+      }
+      break;
+    case 'Z': s.append(f.utc ? 0 : f.offset); break;
+    case 'c':
+      if (f.utc) {
+        s.printf("%04d-%02d-%02dT%02d:%02d:%02d+0:0",
+                 f.year, f.month, f.day, f.hour, f.minute, f.second);
+      } else {
+        s.printf("%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d",
+                 f.year, f.month, f.day, f.hour, f.minute, f.second,
+                 (f.offset < 0 ? '-' : '+'),
+                 abs(f.offset / 3600), abs((f.offset % 3600) / 60));
+      }
+      break;
+    case 'r':
+      {
+        const char *wday =
+          DateTime::GetShortWeekdayName(f.year, f.month, f.day);
+        const char *mon = DateTime::ShortMonthNames[f.month - 1];
+        if (f.utc) {
+          s.printf("%3s, %02d %3s %04d %02d:%02d:%02d +00",
+                   wday, f.day, mon, f.year, f.hour, f.minute, f.second);
+        } else {
+          s.printf("%3s, %02d %3s %04d %02d:%02d:%02d %c%02d%02d",
+                   wday, f.day, mon, f.year, f.hour, f.minute, f.second,
+                   (f.offset < 0 ? '-' : '+'),
+                   abs(f.offset / 3600), abs((f.offset % 3600) / 60));
+        }
+      }
+      break;
+    case 'U': s.append(f.timestamp); break;
+    default:
+      ASSERT(false);
+      break;
+    }
+  }
+  return s.detach();
+}
+
+static String format_stdc(CStrRef format, const DateFields &f) {
+  struct tm ta;
+  ta.tm_sec  = f.second;
+  ta.tm_min  = f.minute;
+  ta.tm_hour = f.hour;
+  ta.tm_mday = f.day;
+  ta.tm_mon  = f.month - 1;
+  ta.tm_year = f.year - 1900;
+  ta.tm_wday = timelib_day_of_week(f.year, f.month, f.day);
+  ta.tm_yday = timelib_day_of_year(f.year, f.month, f.day);
+  ta.tm_isdst = f.utc ? 0 : f.dst;
+  ta.tm_gmtoff = f.utc ? 0 : f.offset;
+  ta.tm_zone = f.utc ? "GMT" : f.abbr;
+
+  int max_reallocs = 5;
+  size_t buf_len = 256, real_len;
+  char *buf = (char *)malloc(buf_len);
+  while ((real_len = strftime(buf, buf_len, format.data(), &ta)) == buf_len ||
+         real_len == 0) {
+    buf_len *= 2;
+    free(buf);
+    buf = (char *)malloc(buf_len);
+    if (!--max_reallocs) {
+      break;
+    }
+  }
+  if (real_len && real_len != buf_len) {
+    return String(buf, real_len, AttachString);
+  }
+  free(buf);
+  throw_invalid_argument("format: (over internal buffer)");
+  return String();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // constructors
 
@@ -490,137 +830,86 @@ String DateTime::toString(DateFormat format) const {
 }
 
 String DateTime::rfcFormat(CStrRef format) const {
-  StringBuffer s;
-  bool rfc_colon = false;
-  bool error;
-  for (int i = 0; i < format.size(); i++) {
-    switch (format.charAt(i)) {
-    case 'd': s.printf("%02d", day()); break;
-    case 'D': s.append(shortWeekdayName()); break;
-    case 'j': s.append(day()); break;
-    case 'l': s.append(weekdayName()); break;
-    case 'S': s.append(OrdinalSuffix(day())); break;
-    case 'w': s.append(dow()); break;
-    case 'N': s.append(isoDow()); break;
-    case 'z': s.append(doy()); break;
-    case 'W': s.printf("%02d", isoWeek()); break;
-    case 'o': s.append(isoYear()); break;
-    case 'F': s.append(monthName()); break;
-    case 'm': s.printf("%02d", month()); break;
-    case 'M': s.append(shortMonthName()); break;
-    case 'n': s.append(month()); break;
-    case 't': s.append(DaysInMonth(year(), month())); break;
-    case 'L': s.append(IsLeap(year())); break;
-    case 'y': s.printf("%02d", year() % 100); break;
-    case 'Y': s.printf("%s%04d", year() < 0 ? "-" : "", abs(year()));
-      break;
-    case 'a': s.append(hour() >= 12 ? "pm" : "am"); break;
-    case 'A': s.append(hour() >= 12 ? "PM" : "AM"); break;
-    case 'B': s.printf("%03d", beat()); break;
-    case 'g': s.append((hour() % 12) ? (int)hour() % 12 : 12); break;
-    case 'G': s.append(hour()); break;
-    case 'h': s.printf("%02d", (hour() % 12) ? (int)hour() % 12 : 12); break;
-    case 'H': s.printf("%02d", (int)hour()); break;
-    case 'i': s.printf("%02d", (int)minute()); break;
-    case 's': s.printf("%02d", (int)second()); break;
-    case 'u': s.printf("%06d", (int)floor(fraction() * 1000000)); break;
-    case 'I': s.append(!utc() && m_tz->dst(toTimeStamp(error)) ? 1 : 0);
-      break;
-    case 'P': rfc_colon = true; /* break intentionally missing */
-    case 'O':
-      if (utc()) {
-        s.printf("+0%s0", rfc_colon ? ":" : "");
-      } else {
-        int offset = m_tz->offset(toTimeStamp(error));
-        s.printf("%c%02d%s%02d",
-                 (offset < 0 ? '-' : '+'), abs(offset / 3600),
-                 rfc_colon ? ":" : "", abs((offset % 3600) / 60));
-      }
-      break;
-    case 'T': s.append(utc() ? "GMT" : m_tz->abbr()); break;
-    case 'e': s.append(utc() ? "UTC" : m_tz->name()); break;
-    case 'Z': s.append(utc() ? 0 : m_tz->offset(toTimeStamp(error)));
-      break;
-    case 'c':
-      if (utc()) {
-        s.printf("%04d-%02d-%02dT%02d:%02d:%02d+0:0",
-                 year(), month(), day(), hour(), minute(), second());
-      } else {
-        int offset = m_tz->offset(toTimeStamp(error));
-        s.printf("%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d",
-                 year(), month(), day(), hour(), minute(), second(),
-                 (offset < 0 ? '-' : '+'),
-                 abs(offset / 3600), abs((offset % 3600) / 60));
-      }
-      break;
-    case 'r':
-      if (utc()) {
-        s.printf("%3s, %02d %3s %04d %02d:%02d:%02d +00",
-                 shortWeekdayName(), day(), shortMonthName(), year(),
-                 hour(), minute(), second());
-      } else {
-        int offset = m_tz->offset(toTimeStamp(error));
-        s.printf("%3s, %02d %3s %04d %02d:%02d:%02d %c%02d%02d",
-                 shortWeekdayName(), day(), shortMonthName(), year(),
-                 hour(), minute(), second(),
-                 (offset < 0 ? '-' : '+'),
-                 abs(offset / 3600), abs((offset % 3600) / 60));
-      }
-      break;
-    case 'U': s.printf("%lld", toTimeStamp(error)); break;
-    case '\\':
-      if (i < format.size()) i++; /* break intentionally missing */
-    default:
-      s.append(format[i]);
-      break;
+  const CompiledDateFormat &compiled = CompiledDateFormat::Get(format);
+  DateFields f;
+  f.year = year();
+  f.month = month();
+  f.day = day();
+  f.hour = hour();
+  f.minute = minute();
+  f.second = second();
+  f.fraction = fraction();
+  f.sse = m_time->sse;
+  f.utc = utc();
+  f.tzi = f.utc ? NULL : m_tz->get();
+  f.timestamp = 0;
+  f.offset = 0;
+  f.dst = false;
+  f.abbr = "GMT";
+  if (compiled.needsTimestamp) {
+    bool error;
+    f.timestamp = toTimeStamp(error);
+    if (!f.utc) {
+      f.offset = TimeZone::Offset(f.tzi, f.timestamp, &f.dst);
     }
   }
-  return s.detach();
+  return format_rfc(compiled, f);
 }
 
 String DateTime::stdcFormat(CStrRef format) const {
-  struct tm ta;
-  timelib_time_offset *offset = NULL;
-  ta.tm_sec  = second();
-  ta.tm_min  = minute();
-  ta.tm_hour = hour();
-  ta.tm_mday = day();
-  ta.tm_mon  = month() - 1;
-  ta.tm_year = year() - 1900;
-  ta.tm_wday = dow();
-  ta.tm_yday = doy();
-  if (utc()) {
-    ta.tm_isdst = 0;
-    ta.tm_gmtoff = 0;
-    ta.tm_zone = "GMT";
-  } else {
-    offset = timelib_get_time_zone_info(m_time->sse, m_time->tz_info);
-    ta.tm_isdst = offset->is_dst;
-    ta.tm_gmtoff = offset->offset;
-    ta.tm_zone = offset->abbr;
+  DateFields f;
+  f.year = year();
+  f.month = month();
+  f.day = day();
+  f.hour = hour();
+  f.minute = minute();
+  f.second = second();
+  f.utc = utc();
+  f.offset = 0;
+  f.dst = false;
+  f.abbr = "GMT";
+  if (!f.utc) {
+    f.offset = TimeZone::Offset(m_time->tz_info, m_time->sse, &f.dst,
+                                &f.abbr);
   }
+  return format_stdc(format, f);
+}
 
-  int max_reallocs = 5;
-  size_t buf_len = 256, real_len;
-  char *buf = (char *)malloc(buf_len);
-  while ((real_len = strftime(buf, buf_len, format.data(), &ta)) == buf_len ||
-         real_len == 0) {
-    buf_len *= 2;
-    free(buf);
-    buf = (char *)malloc(buf_len);
-    if (!--max_reallocs) {
-      break;
+String DateTime::Format(CStrRef format, int64 timestamp, bool utc,
+                        bool stdc) {
+  if (format.empty()) return String();
+
+  DateFieldsCache *cache = s_date_fields_cache.get();
+  timelib_tzinfo *tzi = NULL;
+  if (!utc) {
+    String name = TimeZone::CurrentName();
+    if (!cache->zone || cache->zoneName != name.data()) {
+      cache->zone = TimeZone::GetTimeZoneInfo(name);
+      cache->zoneName = name.data();
+      cache->valid = false;
     }
+    tzi = cache->zone.get();
   }
-  if (!utc()) {
-    timelib_time_offset_dtor(offset);
-  }
-  if (real_len && real_len != buf_len) {
-    return String(buf, real_len, AttachString);
+
+  DateFields &f = cache->fields;
+  if (!cache->valid || f.timestamp != timestamp || f.utc != utc) {
+    f.utc = utc;
+    f.tzi = tzi;
+    f.timestamp = timestamp;
+    f.sse = timestamp;
+    f.fraction = 0;
+    f.offset = 0;
+    f.dst = false;
+    f.abbr = "GMT";
+    if (!utc) {
+      f.offset = TimeZone::Offset(tzi, timestamp, &f.dst, &f.abbr);
+    }
+    cache->split(timestamp + f.offset);
+    cache->valid = true;
   }
-  free(buf);
-  throw_invalid_argument("format: (over internal buffer)");
-  return String();
+
+  if (stdc) return format_stdc(format, f);
+  return format_rfc(CompiledDateFormat::Get(format), f);
 }
 
 Array DateTime::toArray(ArrayFormat format) const {
@@ -218,6 +218,13 @@ public:
   static Array Parse(CStrRef datetime);
   static Array Parse(CStrRef ts, CStrRef format);
 
+  /**
+   * date(), gmdate(), strftime() or gmstrftime() of a timestamp, without
+   * constructing a DateTime. Broken-down time of last timestamp and the
+   * compiled form of each format are cached per thread.
+   */
+  static String Format(CStrRef format, int64 timestamp, bool utc, bool stdc);
+
 public:
   // constructor
   DateTime();
@@ -21,6 +21,8 @@
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/runtime_error.h>
 #include <util/logger.h>
+#include <util/lock.h>
+#include <util/atomic.h>
 
 namespace HPHP {
 
@@ -65,40 +67,203 @@ static GuessedTimeZone s_guessed_timezone;
 ///////////////////////////////////////////////////////////////////////////////
 // statics
 
+/**
+ * One step of a zone's history: from "start" until the next step starts,
+ * local time is UTC + offset. The first step starts at LLONG_MIN, so a
+ * binary search always finds one.
+ */
+struct TimeZoneTransition {
+  int64 start;
+  int offset;
+  int abbr;    // index into timezone_abbr, -1 for none
+  bool dst;
+};
+typedef std::vector<TimeZoneTransition> TimeZoneTransitionVec;
+
+/**
+ * Flattens timelib's trans/trans_idx/type tables into one array, making
+ * the same choices as its fetch_timezone_offset().
+ */
+static void compile_transitions(timelib_tzinfo *tzi,
+                                TimeZoneTransitionVec &transitions) {
+  TimeZoneTransition first = {LLONG_MIN, 0, -1, false};
+  ttinfo *to = NULL;
+  if (!tzi->timecnt || !tzi->trans) {
+    if (tzi->typecnt == 1) to = &tzi->type[0];
+  } else {
+    // before first transition, first non-DST type is used
+    unsigned int j = 0;
+    while (j < tzi->timecnt && tzi->type[j].isdst) j++;
+    if (j == tzi->timecnt) j = 0;
+    to = &tzi->type[j];
+  }
+  if (to) {
+    first.offset = to->offset;
+    first.abbr = to->abbr_idx;
+    first.dst = to->isdst;
+  }
+
+  transitions.clear();
+  transitions.reserve(tzi->timecnt + 1);
+  transitions.push_back(first);
+  if (tzi->trans) {
+    for (unsigned int i = 0; i < tzi->timecnt; i++) {
+      ttinfo &type = tzi->type[tzi->trans_idx[i]];
+      TimeZoneTransition t = {tzi->trans[i], type.offset, type.abbr_idx,
+                              (bool)type.isdst};
+      transitions.push_back(t);
+    }
+  }
+}
+
+/**
+ * Every zone ever asked for, parsed once per process and never modified or
+ * freed afterwards. Readers find zones in the current map without locking.
+ * A miss parses the zone under a lock, then publishes a copy of the map
+ * with the zone added. Replaced maps are leaked on purpose, because other
+ * threads may still be reading them; there are only as many as zones used.
+ */
+class TimeZoneRegistry {
+public:
+  struct Zone {
+    TimeZoneInfo info;
+    TimeZoneTransitionVec transitions;
+  };
+  typedef hphp_const_char_map<Zone*> ZoneMap;
+
+  TimeZoneRegistry() : m_zones(new ZoneMap()) {}
+
+  const Zone *find(const char *name) const {
+    const ZoneMap *zones = m_zones;
+    ZoneMap::const_iterator iter = zones->find(name);
+    return iter == zones->end() ? NULL : iter->second;
+  }
+
+  const Zone *load(const char *name, const timelib_tzdb *db) {
+    Lock lock(m_mutex);
+    const Zone *zone = find(name);
+    if (zone) return zone;
+
+    timelib_tzinfo *tzi = timelib_parse_tzfile((char *)name, db);
+    if (!tzi) return NULL;
+
+    Zone *added = new Zone();
+    added->info = TimeZoneInfo(tzi, TimeZone::tzinfo_deleter());
+    compile_transitions(tzi, added->transitions);
+
+    ZoneMap *old = m_zones;
+    ZoneMap *zones = new ZoneMap(*old);
+    (*zones)[tzi->name] = added;
+    atomic_cas(m_zones, old, zones); // full barrier before publishing
+    return added;
+  }
+
+private:
+  ZoneMap *m_zones;
+  Mutex m_mutex;
+};
+static TimeZoneRegistry s_timezone_registry;
+
+/**
+ * Time between two transitions of one zone, and what applies during it.
+ */
+struct TimeZoneInterval {
+  TimeZoneInterval() : start(0), end(0), offset(0), dst(false), abbr(-1) {}
+
+  std::string name;
+  int64 start; // inclusive
+  int64 end;   // exclusive
+  int offset;
+  bool dst;
+  int abbr;    // index into timezone_abbr, -1 for none
+};
+
 class TimeZoneData {
 public:
-  TimeZoneData() : Database(NULL) {}
+  static const int IntervalCount = 4;
 
-  const timelib_tzdb *Database;
-  MapStringToTimeZoneInfo Cache;
+  TimeZoneData() : NextInterval(0) {}
+
+  TimeZoneInterval Intervals[IntervalCount];
+  int NextInterval;
 };
 static IMPLEMENT_THREAD_LOCAL(TimeZoneData, s_timezone_data);
 
 const timelib_tzdb *TimeZone::GetDatabase() {
-  const timelib_tzdb *&Database = s_timezone_data->Database;
-  if (Database == NULL) {
-    Database = timelib_builtin_db();
-  }
-  return Database;
+  return timelib_builtin_db();
 }
 
 TimeZoneInfo TimeZone::GetTimeZoneInfo(CStrRef name) {
-  MapStringToTimeZoneInfo &Cache = s_timezone_data->Cache;
+  const TimeZoneRegistry::Zone *zone = s_timezone_registry.find(name.data());
+  if (zone == NULL) {
+    zone = s_timezone_registry.load(name.data(), GetDatabase());
+    if (zone == NULL) return TimeZoneInfo();
+  }
+  return zone->info;
+}
+
+int TimeZone::Offset(timelib_tzinfo *tzi, int64 timestamp,
+                     bool *dst /* = NULL */, const char **abbr /* = NULL */) {
+  if (!tzi) {
+    if (dst) *dst = false;
+    if (abbr) *abbr = "GMT";
+    return 0;
+  }
 
-  MapStringToTimeZoneInfo::const_iterator iter = Cache.find(name.data());
-  if (iter != Cache.end()) {
-    return iter->second;
+  // zone data is identical for every copy of the same zone, so intervals
+  // are looked up by name rather than by tzinfo pointer
+  TimeZoneData *data = s_timezone_data.get();
+  TimeZoneInterval *iv = NULL;
+  for (int i = 0; i < TimeZoneData::IntervalCount; i++) {
+    TimeZoneInterval &cached = data->Intervals[i];
+    if (timestamp >= cached.start && timestamp < cached.end &&
+        cached.name == tzi->name) {
+      iv = &cached;
+      break;
+    }
+  }
+
+  if (iv == NULL) {
+    // copies made by timelib itself aren't registered, and are compiled
+    // here just for this lookup
+    const TimeZoneRegistry::Zone *zone = s_timezone_registry.find(tzi->name);
+    TimeZoneTransitionVec compiled;
+    if (zone == NULL) compile_transitions(tzi, compiled);
+    const TimeZoneTransitionVec &transitions =
+      zone ? zone->transitions : compiled;
+
+    // transitions[lo].start <= timestamp < transitions[hi].start
+    unsigned int lo = 0, hi = transitions.size();
+    while (hi - lo > 1) {
+      unsigned int mid = (lo + hi) / 2;
+      if (transitions[mid].start <= timestamp) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+
+    iv = &data->Intervals[data->NextInterval];
+    data->NextInterval =
+      (data->NextInterval + 1) % TimeZoneData::IntervalCount;
+    iv->name = tzi->name;
+    iv->start = transitions[lo].start;
+    iv->end = hi < transitions.size() ? transitions[hi].start : LLONG_MAX;
+    iv->offset = transitions[lo].offset;
+    iv->dst = transitions[lo].dst;
+    iv->abbr = transitions[lo].abbr;
   }
 
-  TimeZoneInfo tzi(timelib_parse_tzfile((char *)name.data(), GetDatabase()),
-                   tzinfo_deleter());
-  if (tzi) {
-    Cache[name.data()] = tzi;
+  if (dst) *dst = iv->dst;
+  if (abbr) {
+    *abbr = iv->abbr >= 0 ? tzi->timezone_abbr + iv->abbr : tzi->timezone_abbr;
+    if (*abbr == NULL) *abbr = "GMT";
   }
-  return tzi;
+  return iv->offset;
 }
 
 bool TimeZone::IsValid(CStrRef name) {
+  if (s_timezone_registry.find(name.data())) return true;
   return timelib_timezone_id_is_valid((char*)name.data(), GetDatabase());
 }
 
@@ -207,22 +372,12 @@ String TimeZone::abbr() const {
 }
 
 int TimeZone::offset(int timestamp) const {
-  if (!m_tzi) return 0;
-
-  timelib_time_offset *offset =
-    timelib_get_time_zone_info(timestamp, m_tzi.get());
-  int ret = offset->offset;
-  timelib_time_offset_dtor(offset);
-  return ret;
+  return Offset(m_tzi.get(), timestamp);
 }
 
 bool TimeZone::dst(int timestamp) const {
-  if (!m_tzi) return false;
-
-  timelib_time_offset *offset =
-    timelib_get_time_zone_info(timestamp, m_tzi.get());
-  bool ret = offset->is_dst;
-  timelib_time_offset_dtor(offset);
+  bool ret;
+  Offset(m_tzi.get(), timestamp, &ret);
   return ret;
 }
 
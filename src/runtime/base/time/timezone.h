@@ -107,7 +107,18 @@ protected:
    */
   timelib_tzinfo *get() const { return m_tzi.get();}
 
+  /**
+   * Offset from UTC, DST flag and abbreviation in effect at the timestamp.
+   * The interval between the two transitions around it is remembered per
+   * thread, so all timestamps until next DST change are answered without
+   * searching the transition table. For internal use only.
+   */
+  static int Offset(timelib_tzinfo *tzi, int64 timestamp, bool *dst = NULL,
+                    const char **abbr = NULL);
+
 private:
+  friend class TimeZoneRegistry;
+
   struct tzinfo_deleter {
     void operator()(timelib_tzinfo *tzi) {
       if (tzi) {
@@ -119,7 +130,9 @@ private:
   static const timelib_tzdb *GetDatabase();
 
   /**
-   * Look up cache and if found return it, otherwise, read it from database.
+   * Look up process-wide registry and if found return it, otherwise, read
+   * it from database and register it. Zones returned are shared by all
+   * threads and must not be modified.
    */
   static TimeZoneInfo GetTimeZoneInfo(CStrRef name);
 
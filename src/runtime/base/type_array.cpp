@@ -21,17 +21,21 @@
 #include <runtime/base/array/vector_variant.h>
 #include <runtime/base/array/map_variant.h>
 #include <runtime/base/array/small_array.h>
+#include <runtime/base/array/array_init.h>
+#include <runtime/base/array/value_set.h>
 #include <runtime/base/shared/shared_map.h>
 #include <system/gen/php/classes/stdclass.h>
 #include <runtime/base/variable_serializer.h>
 #include <runtime/base/variable_unserializer.h>
 #include <runtime/base/comparisons.h>
 #include <runtime/base/zend/zend_string.h>
+#include <runtime/base/zend/zend_functions.h>
 #include <runtime/base/array/array_util.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/ext/ext_iconv.h>
 #include <unicode/coll.h> // icu
 #include <compiler/parser/hphp.tab.hpp>
+#include <algorithm>
 
 using namespace std;
 
@@ -122,10 +126,6 @@ Array Array::diffImpl(CArrRef array, bool by_key, bool by_value, bool match,
   ASSERT(by_key || key_cmp_function == NULL);
   ASSERT(by_value || value_cmp_function == NULL);
 
-  if (!value_cmp_function) {
-    value_cmp_function = SortStringAscending;
-  }
-
   Array ret = Array::Create();
   if (by_key && !key_cmp_function) {
     // Fast case
@@ -133,11 +133,13 @@ Array Array::diffImpl(CArrRef array, bool by_key, bool by_value, bool match,
       Variant key(iter.first());
       bool found = false;
       if (array.exists(key)) {
-        if (by_value) {
+        if (!by_value) {
+          found = true;
+        } else if (value_cmp_function) {
           found = value_cmp_function(iter.second(),
                                      array.rvalAt(key), value_data) == 0;
         } else {
-          found = true;
+          found = ValueSet::Equal(iter.second(), array.rvalAt(key));
         }
       }
       if (found == match) {
@@ -147,6 +149,21 @@ Array Array::diffImpl(CArrRef array, bool by_key, bool by_value, bool match,
     return ret;
   }
 
+  if (!by_key && !value_cmp_function) {
+    // Values compared as strings can be hashed
+    ValueSet values(array);
+    for (ArrayIter iter(*this); iter; ++iter) {
+      if (values.contains(iter.second()) == match) {
+        ret.set(iter.first(), iter.second());
+      }
+    }
+    return ret;
+  }
+
+  if (!value_cmp_function) {
+    value_cmp_function = SortStringAscending;
+  }
+
   if (!key_cmp_function) {
     key_cmp_function = SortRegularAscending;
   }
@@ -932,15 +949,7 @@ static int array_compare_func(const void *n1, const void *n2, const void *op) {
   int index1 = *(int*)n1;
   int index2 = *(int*)n2;
   Array::SortData *opaque = (Array::SortData*)op;
-  ssize_t pos1 = opaque->positions[index1];
-  ssize_t pos2 = opaque->positions[index2];
-  if (opaque->by_key) {
-    return opaque->cmp_func((*opaque->array)->getKey(pos1),
-                            (*opaque->array)->getKey(pos2),
-                            opaque->data);
-  }
-  return opaque->cmp_func((*opaque->array)->getValue(pos1),
-                          (*opaque->array)->getValue(pos2),
+  return opaque->cmp_func(opaque->elements[index1], opaque->elements[index2],
                           opaque->data);
 }
 
@@ -987,29 +996,285 @@ static void _sort(vector<int> &indices, CArrRef source, Array::SortData &opaque,
   opaque.cmp_func = cmp_func;
   opaque.data = data;
   opaque.positions.reserve(count);
+  opaque.elements.reserve(count);
   for (ssize_t pos = source->iter_begin(); pos != ArrayData::invalid_index;
        pos = source->iter_advance(pos)) {
     opaque.positions.push_back(pos);
+    opaque.elements.push_back(by_key ? source->getKey(pos) :
+                              source->getValue(pos));
   }
   zend_qsort(&indices[0], count, sizeof(int), array_compare_func, &opaque);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// type-specialized sorting
+
+/**
+ * When all keys or values being sorted are integers, doubles or strings, and
+ * the comparator is a builtin one that has a cheap equivalent for that type,
+ * they are extracted into a plain C++ vector and compared without Variants.
+ * The same zend_qsort() runs with a comparator that gives exactly the same
+ * answers, so even equal elements end up in the same order as before.
+ * Integers that can't tie in a visible way (keys, or values of an array that
+ * is renumbered) are radix sorted instead.
+ */
+enum TypedCompare {
+  NoTypedCompare,
+  RegularCompare, // integers, doubles or non-numeric strings
+  NumericCompare, // integers and doubles, as doubles
+  StringCompare   // strings, with strcmp()
+};
+
+static TypedCompare get_typed_compare(Array::PFUNC_CMP cmp_func,
+                                      bool &descending) {
+  descending = (cmp_func == Array::SortRegularDescending ||
+                cmp_func == Array::SortNumericDescending ||
+                cmp_func == Array::SortStringDescending);
+  if (cmp_func == Array::SortRegularAscending ||
+      cmp_func == Array::SortRegularDescending) {
+    return RegularCompare;
+  }
+  if (cmp_func == Array::SortNumericAscending ||
+      cmp_func == Array::SortNumericDescending) {
+    return NumericCompare;
+  }
+  if (cmp_func == Array::SortStringAscending ||
+      cmp_func == Array::SortStringDescending) {
+    return StringCompare;
+  }
+  return NoTypedCompare;
+}
+
+template <typename T>
+struct TypedSortData {
+  std::vector<T> elements;
+  bool descending;
+};
+
+static int int_compare_func(const void *n1, const void *n2, const void *op) {
+  const TypedSortData<int64> *opaque = (const TypedSortData<int64> *)op;
+  int64 v1 = opaque->elements[*(int*)n1];
+  int64 v2 = opaque->elements[*(int*)n2];
+  int ret = v1 < v2 ? -1 : (v1 == v2 ? 0 : 1);
+  return opaque->descending ? -ret : ret;
+}
+
+static int double_compare_func(const void *n1, const void *n2,
+                               const void *op) {
+  const TypedSortData<double> *opaque = (const TypedSortData<double> *)op;
+  double v1 = opaque->elements[*(int*)n1];
+  double v2 = opaque->elements[*(int*)n2];
+  int ret = v1 < v2 ? -1 : (v1 == v2 ? 0 : 1);
+  return opaque->descending ? -ret : ret;
+}
+
+/**
+ * Same as StringData::compare() when neither string is numeric.
+ */
+static int binary_compare_func(const void *n1, const void *n2,
+                               const void *op) {
+  const TypedSortData<String> *opaque = (const TypedSortData<String> *)op;
+  const String &s1 = opaque->elements[*(int*)n1];
+  const String &s2 = opaque->elements[*(int*)n2];
+  int len1 = s1.size();
+  int len2 = s2.size();
+  int ret = memcmp(s1.data(), s2.data(), len1 < len2 ? len1 : len2);
+  if (ret == 0) ret = len1 - len2;
+  return opaque->descending ? -ret : ret;
+}
+
+static int strcmp_compare_func(const void *n1, const void *n2,
+                               const void *op) {
+  const TypedSortData<String> *opaque = (const TypedSortData<String> *)op;
+  const String &s1 = opaque->elements[*(int*)n1];
+  const String &s2 = opaque->elements[*(int*)n2];
+  int ret = strcmp(s1.data(), s2.data());
+  return opaque->descending ? -ret : ret;
+}
+
+template <typename T>
+static void typed_qsort(TypedSortData<T> &opaque, compare_func_t cmp,
+                        std::vector<int> &indices) {
+  int count = opaque.elements.size();
+  indices.resize(count);
+  for (int i = 0; i < count; i++) {
+    indices[i] = i;
+  }
+  zend_qsort(&indices[0], count, sizeof(int), cmp, &opaque);
+}
+
+/**
+ * LSD radix sort on 8-bit digits, skipping digits every element shares.
+ */
+static void radix_sort(const std::vector<int64> &elements, bool descending,
+                       std::vector<int> &indices) {
+  int count = elements.size();
+  std::vector<uint64> keys(count);
+  for (int i = 0; i < count; i++) {
+    keys[i] = (uint64)elements[i] ^ 0x8000000000000000ULL;
+  }
+  indices.resize(count);
+  for (int i = 0; i < count; i++) {
+    indices[i] = i;
+  }
+  std::vector<int> buffer(count);
+  for (int shift = 0; shift < 64; shift += 8) {
+    int counts[257];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < count; i++) {
+      counts[((keys[i] >> shift) & 0xFF) + 1]++;
+    }
+    if (counts[((keys[0] >> shift) & 0xFF) + 1] == count) {
+      continue;
+    }
+    for (int i = 0; i < 256; i++) {
+      counts[i + 1] += counts[i];
+    }
+    for (int i = 0; i < count; i++) {
+      int index = indices[i];
+      buffer[counts[(keys[index] >> shift) & 0xFF]++] = index;
+    }
+    indices.swap(buffer);
+  }
+  if (descending) {
+    std::reverse(indices.begin(), indices.end());
+  }
+}
+
+/**
+ * Below this many elements zend_qsort() is faster than 8 counting passes.
+ */
+static const int RadixSortThreshold = 64;
+
+static bool is_numeric(const String &s) {
+  int64 lval;
+  double dval;
+  return is_numeric_string(s.data(), s.size(), &lval, &dval, 0) != KindOfNull;
+}
+
+/**
+ * Fills "sorted" with positions in sorted order, or returns false when the
+ * keys or values are not homogeneous enough for a typed comparison.
+ */
+static bool sort_typed(const ArrayData *arr, Array::PFUNC_CMP cmp_func,
+                       bool by_key, bool renumber,
+                       std::vector<ssize_t> &sorted) {
+  bool descending;
+  TypedCompare compare = get_typed_compare(cmp_func, descending);
+  if (compare == NoTypedCompare) return false;
+  if (!by_key && !arr->supportValueRef()) return false;
+
+  int count = arr->size();
+  std::vector<ssize_t> positions;
+  positions.reserve(count);
+  TypedSortData<int64> ints;
+  TypedSortData<double> doubles;
+  TypedSortData<String> strings;
+  for (ssize_t pos = arr->iter_begin(); pos != ArrayData::invalid_index;
+       pos = arr->iter_advance(pos)) {
+    Variant key;
+    if (by_key) key = arr->getKey(pos);
+    CVarRef v = by_key ? key : arr->getValueRef(pos);
+    DataType type = v.getRawType();
+    switch (type) {
+    case KindOfByte:
+    case KindOfInt16:
+    case KindOfInt32:
+    case KindOfInt64:
+      type = KindOfInt64;
+      break;
+    case KindOfDouble:
+      break;
+    case LiteralString:
+    case KindOfStaticString:
+    case KindOfString:
+      type = KindOfString;
+      break;
+    default:
+      return false;
+    }
+    if (compare == NumericCompare) {
+      if (type == KindOfString) return false;
+      doubles.elements.push_back(v.toDouble());
+    } else if (type == KindOfString) {
+      if (!ints.elements.empty() || !doubles.elements.empty()) return false;
+      strings.elements.push_back(v.toString());
+      if (compare == RegularCompare &&
+          is_numeric(strings.elements.back())) {
+        return false;
+      }
+    } else {
+      if (compare == StringCompare || !strings.elements.empty()) return false;
+      if (type == KindOfInt64) {
+        if (!doubles.elements.empty()) return false;
+        ints.elements.push_back(v.toInt64());
+      } else {
+        if (!ints.elements.empty()) return false;
+        doubles.elements.push_back(v.toDouble());
+      }
+    }
+    positions.push_back(pos);
+  }
+
+  std::vector<int> indices;
+  if (!ints.elements.empty()) {
+    if ((by_key || renumber) && compare == RegularCompare &&
+        count >= RadixSortThreshold) {
+      radix_sort(ints.elements, descending, indices);
+    } else {
+      ints.descending = descending;
+      typed_qsort(ints, int_compare_func, indices);
+    }
+  } else if (!doubles.elements.empty()) {
+    doubles.descending = descending;
+    typed_qsort(doubles, double_compare_func, indices);
+  } else {
+    strings.descending = descending;
+    typed_qsort(strings, compare == StringCompare ?
+                strcmp_compare_func : binary_compare_func, indices);
+  }
+
+  sorted.reserve(count);
+  for (int i = 0; i < count; i++) {
+    sorted.push_back(positions[indices[i]]);
+  }
+  return true;
+}
+
 void Array::sort(PFUNC_CMP cmp_func, bool by_key, bool renumber,
                  const void *data /* = NULL */) {
-  Array sorted = Array::Create();
-  SortData opaque;
-  vector<int> indices;
-  _sort(indices, *this, opaque, cmp_func, by_key, data);
   int count = size();
+  if (count == 0) {
+    operator=(Array::Create());
+    return;
+  }
+
+  std::vector<ssize_t> sorted;
+  if (!sort_typed(m_px, cmp_func, by_key, renumber, sorted)) {
+    SortData opaque;
+    vector<int> indices;
+    _sort(indices, *this, opaque, cmp_func, by_key, data);
+    sorted.reserve(count);
+    for (int i = 0; i < count; i++) {
+      sorted.push_back(opaque.positions[indices[i]]);
+    }
+  }
+
+  // nobody else can see the array, so its elements can simply be relinked
+  if (m_px->getCount() == 1 && m_px->reorder(sorted, renumber)) {
+    return;
+  }
+
+  ArrayInit init(count, renumber);
   for (int i = 0; i < count; i++) {
-    ssize_t pos = opaque.positions[indices[i]];
+    ssize_t pos = sorted[i];
     if (renumber) {
-      sorted.append(m_px->getValue(pos));
+      init.set(i, m_px->getValue(pos));
     } else {
-      sorted.set(m_px->getKey(pos), m_px->getValue(pos));
+      init.set(i, m_px->getKey(pos), m_px->getValue(pos), -1, true);
     }
   }
-  operator=(sorted);
+  operator=(Array(init.create()));
 }
 
 bool Array::MultiSort(std::vector<SortData> &data, bool renumber) {
@@ -192,6 +192,7 @@ class Array : public SmartPtr<ArrayData> {
     PFUNC_CMP   cmp_func;
     const void *data;
     std::vector<ssize_t> positions;
+    std::vector<Variant> elements; // keys or values at positions
   };
   static bool MultiSort(std::vector<SortData> &data, bool renumber);
 
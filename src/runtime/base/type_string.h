@@ -348,8 +348,7 @@ typedef hphp_hash_map<String, int, zend_hash, zend_eqstr> MapStringToInt;
 
 struct string_data_hash {
   size_t operator()(const StringData *s) const {
-    if (s->isStatic()) return s->getStaticHash();
-    return hash_string(s->data(), s->size());
+    return s->hash();
   }
 };
 
@@ -2885,7 +2885,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
     {
       int64 id;
       in >> id;
-      Variant *v = unserializer->get(id);
+      Variant *v = unserializer->getReference(id);
       if (v == NULL) {
         throw Exception("Id %ld out of range", id);
       }
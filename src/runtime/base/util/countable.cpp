@@ -16,4 +16,12 @@
 
 #include <runtime/base/util/countable.h>
 
+namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
+
+#ifdef REFCOUNT_STATS
+__thread int64 g_refCountOps = 0;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+}
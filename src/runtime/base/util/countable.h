@@ -22,14 +22,38 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A counting build, configured with -DREFCOUNT_STATS=ON, counts every
+ * incRefCount() and decRefCount() a thread makes, so to measure how many
+ * refcount operations a request costs.
+ */
+#ifdef REFCOUNT_STATS
+extern __thread int64 g_refCountOps;
+#define COUNT_REFCOUNT_OP() (++g_refCountOps)
+#else
+#define COUNT_REFCOUNT_OP()
+#endif
+
+inline int64 get_refcount_ops() {
+#ifdef REFCOUNT_STATS
+  return g_refCountOps;
+#else
+  return 0;
+#endif
+}
+
 /**
  * StringData and Variant do not formally derived from Countable, but they
  * have a _count field and define all of the methods from Countable. These
  * macros are provided to avoid code duplication.
  */
 #define IMPLEMENT_COUNTABLE_METHODS_NO_STATIC                        \
-  void incRefCount() const { if (!isStatic()) ++_count; }            \
+  void incRefCount() const {                                         \
+    COUNT_REFCOUNT_OP();                                             \
+    if (!isStatic()) ++_count;                                       \
+  }                                                                  \
   int decRefCount() const {                                          \
+    COUNT_REFCOUNT_OP();                                             \
     ASSERT(_count > 0);                                              \
     return isStatic() ? _count : --_count;                           \
   }                                                                  \
@@ -17,9 +17,11 @@
 #include <runtime/base/util/libevent_http_client.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/util/exceptions.h>
 #include <util/compression.h>
 #include <util/logger.h>
 #include <util/timer.h>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -46,6 +48,24 @@ static void timer_callback(int fd, short events, void *context) {
   event_base_loopbreak((struct event_base *)context);
 }
 
+static void on_multi_ready(int fd, short events, void *obj) {
+  ASSERT(obj);
+  ((HPHP::LibEventHttpMultiClient*)obj)->onReady();
+}
+
+static void on_multi_request_completed(struct evhttp_request *req,
+                                       void *obj) {
+  ASSERT(obj);
+  HPHP::LibEventHttpTask *task = (HPHP::LibEventHttpTask*)obj;
+  task->getClient()->onRequestCompleted(task, req);
+}
+
+static void on_multi_timeout(int fd, short events, void *obj) {
+  ASSERT(obj);
+  HPHP::LibEventHttpTask *task = (HPHP::LibEventHttpTask*)obj;
+  task->getClient()->onTimeout(task);
+}
+
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 // connection pooling
@@ -117,6 +137,85 @@ LibEventHttpClientPtr LibEventHttpClient::Get(const std::string &address,
   return ret;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// request and response helpers, shared with LibEventHttpMultiClient
+
+static void add_host_header(evhttp_request *request,
+                            const std::string &address, int port) {
+  // REVIEW: libevent never sends a Host header (nor does it properly send HTTP
+  // 400 for HTTP/1.1 requests without such a header), in blatent violation of
+  // RFC2616; this should perhaps be fixed in the library proper.
+  if (port == 80) {
+    evhttp_add_header(request->output_headers, "Host", address.c_str());
+  } else {
+    std::ostringstream ss;
+    ss << address << ":" << port;
+    evhttp_add_header(request->output_headers, "Host", ss.str().c_str());
+  }
+}
+
+static void add_request_headers(evhttp_request *request,
+                                const std::vector<std::string> &headers) {
+  bool keepalive = true;
+  for (unsigned int i = 0; i < headers.size(); i++) {
+    const std::string &header = headers[i];
+    size_t pos = header.find(':');
+    if (pos != string::npos && header[pos + 1] == ' ') {
+      string name = header.substr(0, pos);
+      if (strcasecmp(name.c_str(), "Connection") == 0) {
+        keepalive = false;
+      }
+      int ret = evhttp_add_header(request->output_headers,
+                                  name.c_str(), header.c_str() + pos + 2);
+      if (ret >= 0) {
+        continue;
+      }
+    }
+    Logger::Error("invalid request header: [%s]", header.c_str());
+  }
+  if (keepalive) {
+    evhttp_add_header(request->output_headers, "Connection", "keep-alive");
+  }
+}
+
+static void read_response(evhttp_request *request, int &code,
+                          std::string &codeLine,
+                          std::vector<std::string> &responseHeaders,
+                          char *&response, int &len) {
+  // response code line
+  code = request->response_code;
+  if (request->response_code_line) {
+    codeLine = request->response_code_line;
+  }
+
+  bool gzip = false;
+  // response headers
+  for (evkeyval *p = ((evkeyvalq_*)request->input_headers)->tqh_first; p;
+       p = p->next.tqe_next) {
+    if (p->key && p->value) {
+      if (strcasecmp(p->key, "Content-Encoding") == 0 &&
+          strncmp(p->value, "gzip", 4) == 0 &&
+          (!p->value[4] || isspace(p->value[4]))) {
+        // in the (illegal) case of multiple Content-Encoding headers, any one
+        // with the value 'gzip' means we treat it as gzip.
+        gzip = true;
+      }
+      responseHeaders.push_back(string(p->key) + ": " + p->value);
+    }
+  }
+
+  // response body
+  len = EVBUFFER_LENGTH(request->input_buffer);
+  if (gzip) {
+    response =
+      gzdecode((const char*)EVBUFFER_DATA(request->input_buffer), len);
+  } else {
+    response = (char*)malloc(len + 1);
+    strncpy(response, (char*)EVBUFFER_DATA(request->input_buffer), len);
+    response[len] = '\0';
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // constructor and destructor
 
@@ -173,38 +272,8 @@ bool LibEventHttpClient::send(const std::string &url,
 
   evhttp_request* request = evhttp_request_new(on_request_completed, this);
 
-  // REVIEW: libevent never sends a Host header (nor does it properly send HTTP
-  // 400 for HTTP/1.1 requests without such a header), in blatent violation of
-  // RFC2616; this should perhaps be fixed in the library proper.
-  if (m_port == 80) {
-    evhttp_add_header(request->output_headers, "Host", m_address.c_str());
-  } else {
-    std::ostringstream ss;
-    ss << m_address << ":" << m_port;
-    evhttp_add_header(request->output_headers, "Host", ss.str().c_str());
-  }
-
-  // request headers
-  bool keepalive = true;
-  for (unsigned int i = 0; i < headers.size(); i++) {
-    const std::string &header = headers[i];
-    size_t pos = header.find(':');
-    if (pos != string::npos && header[pos + 1] == ' ') {
-      string name = header.substr(0, pos);
-      if (strcasecmp(name.c_str(), "Connection") == 0) {
-        keepalive = false;
-      }
-      int ret = evhttp_add_header(request->output_headers,
-                                  name.c_str(), header.c_str() + pos + 2);
-      if (ret >= 0) {
-        continue;
-      }
-    }
-    Logger::Error("invalid request header: [%s]", header.c_str());
-  }
-  if (keepalive) {
-    evhttp_add_header(request->output_headers, "Connection", "keep-alive");
-  }
+  add_host_header(request, m_address, m_port);
+  add_request_headers(request, headers);
 
   // post data
   if (data && size) {
@@ -269,38 +338,8 @@ void LibEventHttpClient::onRequestCompleted(evhttp_request* request) {
     return;
   }
 
-  // response code line
-  m_code = request->response_code;
-  if (request->response_code_line) {
-    m_codeLine = request->response_code_line;
-  }
-
-  bool gzip = false;
-  // response headers
-  for (evkeyval *p = ((evkeyvalq_*)request->input_headers)->tqh_first; p;
-       p = p->next.tqe_next) {
-    if (p->key && p->value) {
-      if (strcasecmp(p->key, "Content-Encoding") == 0 &&
-          strncmp(p->value, "gzip", 4) == 0 &&
-          (!p->value[4] || isspace(p->value[4]))) {
-        // in the (illegal) case of multiple Content-Encoding headers, any one
-        // with the value 'gzip' means we treat it as gzip.
-        gzip = true;
-      }
-      m_responseHeaders.push_back(string(p->key) + ": " + p->value);
-    }
-  }
-
-  // response body
-  m_len = EVBUFFER_LENGTH(request->input_buffer);
-  if (gzip) {
-    m_response =
-      gzdecode((const char*)EVBUFFER_DATA(request->input_buffer), m_len);
-  } else {
-    m_response = (char*)malloc(m_len + 1);
-    strncpy(m_response, (char*)EVBUFFER_DATA(request->input_buffer), m_len);
-    m_response[m_len] = '\0';
-  }
+  read_response(request, m_code, m_codeLine, m_responseHeaders,
+                m_response, m_len);
 
   ++m_requests;
   event_base_loopbreak(m_eventBase);
@@ -325,5 +364,301 @@ char *LibEventHttpClient::recv(int &len) {
   return ret;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// LibEventHttpTask
+
+LibEventHttpTask::LibEventHttpTask(const std::string &address, int port,
+                                   const std::string &url,
+                                   const std::vector<std::string> &headers,
+                                   int timeoutSeconds, const void *data,
+                                   int size)
+  : m_client(NULL), m_address(address), m_port(port),
+    m_hash(get_hash(address, port) + '/' +
+           lexical_cast<string>(timeoutSeconds)),
+    m_url(url), m_headers(headers), m_timeout(timeoutSeconds), m_post(data != NULL),
+    m_timer(Timer::WallTime), m_done(false), m_failed(false),
+    m_reused(false), m_latency(0), m_code(0), m_response(NULL), m_len(0) {
+  if (data && size) {
+    m_data.append((const char *)data, size);
+  }
+}
+
+LibEventHttpTask::~LibEventHttpTask() {
+  if (m_response) {
+    free(m_response);
+  }
+}
+
+bool LibEventHttpTask::isDone() {
+  Lock lock(this);
+  return m_done;
+}
+
+bool LibEventHttpTask::wait(char *&response, int &len) {
+  Lock lock(this);
+  while (!m_done) Synchronizable::wait();
+
+  response = m_response;
+  len = m_len;
+  m_response = NULL;
+  m_len = 0;
+  return !m_failed;
+}
+
+void LibEventHttpTask::finish(bool failed) {
+  Lock lock(this);
+  if (m_done) return;
+  m_done = true;
+  m_failed = failed;
+  m_latency = m_timer.getMicroSeconds();
+  notify();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LibEventHttpMultiClient
+
+Mutex LibEventHttpMultiClient::s_mutex;
+LibEventHttpMultiClient *LibEventHttpMultiClient::s_client;
+
+bool LibEventHttpMultiClient::Start(LibEventHttpTaskPtr task) {
+  LibEventHttpMultiClient *client;
+  {
+    Lock lock(s_mutex);
+    if (s_client == NULL) {
+      s_client = new LibEventHttpMultiClient();
+      s_client->m_thread.start();
+    }
+    client = s_client;
+  }
+  return client->enqueue(task);
+}
+
+void LibEventHttpMultiClient::Stop() {
+  Lock lock(s_mutex);
+  if (s_client) {
+    s_client->stop();
+    delete s_client;
+    s_client = NULL;
+  }
+}
+
+LibEventHttpMultiClient::LibEventHttpMultiClient()
+  : m_thread(this, &LibEventHttpMultiClient::run), m_stopped(false) {
+  m_eventBase = event_base_new();
+  if (!m_ready.open()) {
+    throw FatalErrorException("unable to create pipe for ready signal");
+  }
+  event_set(&m_eventReady, m_ready.getOut(), EV_READ|EV_PERSIST,
+            on_multi_ready, this);
+  event_base_set(m_eventBase, &m_eventReady);
+  event_add(&m_eventReady, NULL);
+}
+
+LibEventHttpMultiClient::~LibEventHttpMultiClient() {
+  event_del(&m_eventReady);
+  for (map<string, ConnectionVec>::iterator iter = m_pool.begin();
+       iter != m_pool.end(); ++iter) {
+    ConnectionVec &conns = iter->second;
+    for (unsigned int i = 0; i < conns.size(); i++) {
+      // in-flight requests are freed along with their connections
+      for (unsigned int j = 0; j < conns[i]->tasks.size(); j++) {
+        LibEventHttpTask *task = conns[i]->tasks[j].get();
+        if (task->m_timeout > 0) {
+          event_del(&task->m_eventTimeout);
+        }
+        task->finish(true);
+      }
+      evhttp_connection_free(conns[i]->conn);
+      delete conns[i];
+    }
+  }
+  event_base_free(m_eventBase);
+}
+
+bool LibEventHttpMultiClient::enqueue(LibEventHttpTaskPtr task) {
+  {
+    Lock lock(m_mutex);
+    if (m_stopped) return false;
+    task->m_client = this;
+    m_pending.push_back(task);
+  }
+
+  // signal to call onReady()
+  if (write(m_ready.getIn(), "", 1) < 0) {
+    // an error occured but nothing we can really do
+  }
+  return true;
+}
+
+void LibEventHttpMultiClient::run() {
+  while (true) {
+    {
+      Lock lock(m_mutex);
+      if (m_stopped) break;
+    }
+    event_base_loop(m_eventBase, EVLOOP_ONCE);
+  }
+}
+
+void LibEventHttpMultiClient::stop() {
+  {
+    Lock lock(m_mutex);
+    m_stopped = true;
+    for (unsigned int i = 0; i < m_pending.size(); i++) {
+      m_pending[i]->finish(true);
+    }
+    m_pending.clear();
+  }
+  if (write(m_ready.getIn(), "", 1) < 0) {
+    // an error occured but we're in shutdown already, so ignore
+  }
+  m_thread.waitForEnd();
+}
+
+void LibEventHttpMultiClient::onReady() {
+  // clean up the pipe for next signals
+  char buf[512];
+  if (read(m_ready.getOut(), buf, sizeof(buf)) < 0) {
+    // an error occured but nothing we can really do
+  }
+
+  // making a copy so we don't hold up the mutex very long
+  std::vector<LibEventHttpTaskPtr> tasks;
+  {
+    Lock lock(m_mutex);
+    tasks.swap(m_pending);
+  }
+  for (unsigned int i = 0; i < tasks.size(); i++) {
+    sendImpl(tasks[i]);
+  }
+}
+
+LibEventHttpMultiClient::Connection *
+LibEventHttpMultiClient::getConnection(LibEventHttpTask *task) {
+  ConnectionVec &conns = m_pool[task->m_hash];
+
+  // an idle kept-alive connection first, then a new connection while we are
+  // under the limit, otherwise queue up on the least loaded one
+  Connection *best = NULL;
+  for (unsigned int i = 0; i < conns.size(); i++) {
+    Connection *c = conns[i];
+    if (c->tasks.empty()) {
+      task->m_reused = c->requests > 0;
+      return c;
+    }
+    if (best == NULL || c->tasks.size() < best->tasks.size()) {
+      best = c;
+    }
+  }
+  if (best && (int)conns.size() >= RuntimeOption::HttpMaxConnectionsPerHost) {
+    task->m_reused = true;
+    return best;
+  }
+
+  Connection *c = new Connection();
+  c->conn = evhttp_connection_new(task->m_address.c_str(), task->m_port);
+  evhttp_connection_set_base(c->conn, m_eventBase);
+  if (task->m_timeout > 0) {
+    // a hung server fails all requests queued up on the connection, rather
+    // than holding it forever; the timeout is part of the pooling key, so
+    // it holds for every task that ever runs on this connection
+    evhttp_connection_set_timeout(c->conn, task->m_timeout);
+  }
+  conns.push_back(c);
+  return c;
+}
+
+void LibEventHttpMultiClient::closeConnection(const std::string &hash,
+                                              Connection *c) {
+  ConnectionVec &conns = m_pool[hash];
+  conns.erase(std::find(conns.begin(), conns.end(), c));
+  if (conns.empty()) {
+    m_pool.erase(hash);
+  }
+
+  // evhttp frees queued requests without calling back
+  for (unsigned int i = 0; i < c->tasks.size(); i++) {
+    LibEventHttpTask *task = c->tasks[i].get();
+    m_running.erase(task);
+    if (task->m_timeout > 0) {
+      event_del(&task->m_eventTimeout);
+    }
+    task->finish(true);
+  }
+  evhttp_connection_free(c->conn);
+  delete c;
+}
+
+void LibEventHttpMultiClient::sendImpl(LibEventHttpTaskPtr task) {
+  evhttp_request* request =
+    evhttp_request_new(on_multi_request_completed, task.get());
+  add_host_header(request, task->m_address, task->m_port);
+  add_request_headers(request, task->m_headers);
+  if (!task->m_data.empty()) {
+    evbuffer_add(request->output_buffer, task->m_data.data(),
+                 task->m_data.size());
+  }
+
+  Connection *c = getConnection(task.get());
+  evhttp_cmd_type cmd = task->m_post ? EVHTTP_REQ_POST : EVHTTP_REQ_GET;
+  if (evhttp_make_request(c->conn, request, cmd, task->m_url.c_str()) != 0) {
+    // When connecting fails, evhttp leaves the request queued up on the
+    // connection, where a later retry would call us back with a task that
+    // is long gone. Throwing away the connection frees it for good.
+    Logger::Error("evhttp_make_request failed");
+    closeConnection(task->m_hash, c);
+    task->finish(true);
+    return;
+  }
+  c->tasks.push_back(task);
+  m_running[task.get()] = c;
+
+  if (task->m_timeout > 0) {
+    struct timeval timeout;
+    timeout.tv_sec = task->m_timeout;
+    timeout.tv_usec = 0;
+
+    event_set(&task->m_eventTimeout, -1, 0, on_multi_timeout, task.get());
+    event_base_set(m_eventBase, &task->m_eventTimeout);
+    event_add(&task->m_eventTimeout, &timeout);
+  }
+}
+
+void LibEventHttpMultiClient::onRequestCompleted(LibEventHttpTask *task,
+                                                 evhttp_request *request) {
+  map<LibEventHttpTask*, Connection*>::iterator iter = m_running.find(task);
+  ASSERT(iter != m_running.end());
+  Connection *c = iter->second;
+  m_running.erase(iter);
+
+  // evhttp completes requests on one connection in the order they were made
+  ASSERT(!c->tasks.empty() && c->tasks.front().get() == task);
+  LibEventHttpTaskPtr holder = c->tasks.front();
+  c->tasks.pop_front();
+  if (task->m_timeout > 0) {
+    event_del(&task->m_eventTimeout);
+  }
+
+  if (!request) {
+    // connection failed or timed out, and evhttp has reset it
+    c->requests = 0;
+    task->finish(true);
+    return;
+  }
+
+  ++c->requests;
+  if (!task->isDone()) { // otherwise it has timed out already
+    read_response(request, task->m_code, task->m_codeLine,
+                  task->m_responseHeaders, task->m_response, task->m_len);
+    task->finish(false);
+  }
+}
+
+void LibEventHttpMultiClient::onTimeout(LibEventHttpTask *task) {
+  // The request stays on its connection until evhttp's own timeout fails it
+  // or its response shows up and gets thrown away.
+  task->finish(true);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
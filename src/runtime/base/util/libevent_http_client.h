@@ -20,6 +20,9 @@
 #include <util/base.h>
 #include <util/async_func.h>
 #include <util/lock.h>
+#include <util/process.h>
+#include <util/synchronizable.h>
+#include <util/timer.h>
 #include <evhttp.h>
 
 namespace HPHP {
@@ -114,6 +117,140 @@ private:
   void clear();
 };
 
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * One GET/POST issued through LibEventHttpMultiClient. It is shared between
+ * the PHP thread that started it and the I/O thread running it, and it stays
+ * alive until both sides are done with it.
+ */
+class LibEventHttpMultiClient;
+DECLARE_BOOST_TYPES(LibEventHttpTask);
+class LibEventHttpTask : public Synchronizable {
+public:
+  LibEventHttpTask(const std::string &address, int port,
+                   const std::string &url,
+                   const std::vector<std::string> &headers,
+                   int timeoutSeconds, const void *data, int size);
+  ~LibEventHttpTask();
+
+  /**
+   * Non-blocking query of whether a response has been received, or whether
+   * the task has failed or timed out.
+   */
+  bool isDone();
+
+  /**
+   * Block until the task is done. Returns false if it failed or timed out.
+   * Caller is in charge of free-ing returned response.
+   */
+  bool wait(char *&response, int &len);
+
+  const std::string &getHash() const { return m_hash; }
+  int getCode() const { return m_code; }
+  const std::vector<std::string> &getResponseHeaders() const {
+    return m_responseHeaders;
+  }
+  int64 getLatency() const { return m_latency; }
+  bool isConnectionReused() const { return m_reused; }
+  LibEventHttpMultiClient *getClient() const { return m_client; }
+
+private:
+  friend class LibEventHttpMultiClient;
+
+  LibEventHttpMultiClient *m_client; // the I/O thread running this task
+  std::string m_address;
+  unsigned short m_port;
+  std::string m_hash;        // address:port/timeout, the pooling key
+  std::string m_url;
+  std::vector<std::string> m_headers;
+  int m_timeout;             // in seconds
+  std::string m_data;        // POST data
+  bool m_post;
+
+  Timer m_timer;             // from creation to completion
+  event m_eventTimeout;
+  bool m_done;
+  bool m_failed;
+  bool m_reused;             // whether it ran on a kept-alive connection
+  int64 m_latency;           // in microseconds
+
+  int m_code;
+  std::string m_codeLine;
+  std::vector<std::string> m_responseHeaders;
+  char *m_response;
+  int m_len;
+
+  void finish(bool failed);
+};
+
+/**
+ * Multiplexes many concurrent evhttp requests over one event_base, driven by
+ * a single dedicated I/O thread, so a PHP request can start N fetches and
+ * harvest them together without paying a thread per fetch. Connections are
+ * kept alive and pooled per address:port, up to
+ * RuntimeOption::HttpMaxConnectionsPerHost of them; once a host has that
+ * many busy connections, new requests queue up behind the least loaded one
+ * and evhttp sends them down the same connection as soon as it frees up.
+ * Requests with different timeouts never share a connection, since evhttp
+ * applies one timeout to everything queued up on a connection.
+ */
+class LibEventHttpMultiClient {
+public:
+  /**
+   * Hand a task over to the I/O thread, starting the thread if needed.
+   */
+  static bool Start(LibEventHttpTaskPtr task);
+
+  /**
+   * Stop the I/O thread. Outstanding tasks fail.
+   */
+  static void Stop();
+
+public:
+  // libevent callbacks
+  void onReady();
+  void onRequestCompleted(LibEventHttpTask *task, evhttp_request *request);
+  void onTimeout(LibEventHttpTask *task);
+
+private:
+  class Connection {
+  public:
+    Connection() : conn(NULL), requests(0) {}
+    evhttp_connection *conn;
+    int requests;            // number of requests we've sent on this conn
+    std::deque<LibEventHttpTaskPtr> tasks; // in-flight, in sending order
+  };
+  typedef std::vector<Connection*> ConnectionVec;
+
+  static Mutex s_mutex;
+  static LibEventHttpMultiClient *s_client;
+
+  LibEventHttpMultiClient();
+  ~LibEventHttpMultiClient();
+
+  event_base *m_eventBase;
+  AsyncFunc<LibEventHttpMultiClient> m_thread;
+  bool m_stopped;
+
+  // signal between PHP threads and the I/O thread
+  event m_eventReady;
+  CPipe m_ready;
+  Mutex m_mutex;
+  std::vector<LibEventHttpTaskPtr> m_pending;
+
+  // only accessed from the I/O thread
+  std::map<std::string, ConnectionVec> m_pool;
+  std::map<LibEventHttpTask*, Connection*> m_running;
+
+  bool enqueue(LibEventHttpTaskPtr task);
+  void run();
+  void stop();
+  Connection *getConnection(LibEventHttpTask *task);
+  void closeConnection(const std::string &hash, Connection *c);
+  void sendImpl(LibEventHttpTaskPtr task);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
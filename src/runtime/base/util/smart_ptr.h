@@ -112,6 +112,15 @@ public:
     operator=((T*)NULL);
   }
 
+  /**
+   * Exchange raw pointers without touching reference counts.
+   */
+  void swap(SmartPtr<T> &src) {
+    T *px = m_px;
+    m_px = src.m_px;
+    src.m_px = px;
+  }
+
  protected:
   T *m_px;  // raw pointer
 };
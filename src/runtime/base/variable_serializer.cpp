@@ -31,7 +31,9 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 VariableSerializer::VariableSerializer(Type type, int option /* = 0 */)
-  : m_type(type), m_option(option), m_buf(NULL), m_indent(0),
+  : m_type(type), m_option(option), m_buf(NULL), m_streaming(false),
+    m_flushed(0),
+    m_indent(0),
     m_valueCount(0), m_referenced(false), m_refCount(1), m_maxCount(3),
     m_outputLimit(0) {
 }
@@ -52,21 +54,50 @@ void VariableSerializer::setResourceInfo(const char *rsrcName, int rsrcId) {
 }
 
 Variant VariableSerializer::serialize(CVarRef v, bool ret) {
+  if (!ret) {
+    serializeToOutput(v);
+    return true;
+  }
   StringBuffer buf;
   m_buf = &buf;
-  if (ret) {
+  m_outputLimit = RuntimeOption::SerializationSizeLimit;
+  m_valueCount = 1;
+  if (m_type == VarDump && v.isContagious()) m_buf->append('&');
+  write(v);
+  return m_buf->detach();
+}
+
+/**
+ * Whether serializing v may call into PHP code. Arrays nested too deeply,
+ * which may well be cyclic through references, are assumed to.
+ */
+static bool may_call_user_code(CVarRef v, int depth) {
+  if (v.isObject()) return true;
+  if (!v.isArray()) return false;
+  if (depth >= 64) return true;
+  for (ArrayIter iter(v.toArray()); iter; ++iter) {
+    if (may_call_user_code(iter.second(), depth + 1)) return true;
+  }
+  return false;
+}
+
+void VariableSerializer::serializeToOutput(CVarRef v,
+                                           bool limit /* = false */) {
+  StringBuffer buf;
+  m_buf = &buf;
+  // Output buffers are looked up on every flush. Yet anything echoed by
+  // __sleep() would land in the middle of what was flushed before it.
+  m_streaming = m_type != Serialize || !may_call_user_code(v, 0);
+  m_flushed = 0;
+  if (limit) {
     m_outputLimit = RuntimeOption::SerializationSizeLimit;
   }
   m_valueCount = 1;
   if (m_type == VarDump && v.isContagious()) m_buf->append('&');
   write(v);
-  if (ret) {
-    return m_buf->detach();
-  } else {
-    String str = m_buf->detach();
-    g_context->out().write(str.c_str(), str.size());
-  }
-  return true;
+  g_context->out().write(m_buf->data(), m_buf->length());
+  m_buf = NULL;
+  m_streaming = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -747,9 +778,14 @@ void VariableSerializer::decNestedLevel(void *ptr) {
 }
 
 void VariableSerializer::checkOutputSize() {
-  if (m_outputLimit > 0 && m_buf->length() > m_outputLimit) {
+  if (m_outputLimit > 0 && m_flushed + m_buf->length() > m_outputLimit) {
     raise_error("Value too large for serialization");
   }
+  if (m_streaming && m_buf->length() >= ChunkSize) {
+    g_context->out().write(m_buf->data(), m_buf->length());
+    m_flushed += m_buf->length();
+    m_buf->reset();
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -55,6 +55,15 @@ public:
    */
   Variant serialize(CVarRef v, bool ret);
 
+  /**
+   * Writes serialization of a variable to the current output buffer while
+   * it's being produced, in chunks of ChunkSize bytes, instead of building
+   * it in memory first. With limit, the size limit for returned strings
+   * still applies. Values that may run __sleep() or serialize() methods,
+   * which can echo or switch output buffers, are built in memory as usual.
+   */
+  void serializeToOutput(CVarRef v, bool limit = false);
+
   /**
    * Type specialized output functions.
    */
@@ -95,9 +104,13 @@ public:
   void getResourceInfo(std::string &rsrcName, int &rsrcId);
   Type getType() const { return m_type; }
 private:
+  static const int ChunkSize = 64 * 1024;
+
   Type m_type;
   int m_option;                  // type specific extra options
   StringBuffer *m_buf;
+  bool m_streaming;              // flush m_buf to output every ChunkSize
+  int64 m_flushed;               // bytes already flushed to output
   int m_indent;
   PointerCounterMap m_counts;    // counting seen arrays for recursive levels
   PointerCounterMap m_arrayIds;  // reference ids for objs/arrays
@@ -18,17 +18,24 @@
 #define __HPHP_VARIABLE_UNSERIALIZER_H__
 
 #include <runtime/base/types.h>
+#include <runtime/base/array/typed_vector.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 class VariableUnserializer {
 public:
-  VariableUnserializer(std::istream &in) : m_in(in), m_key(false) {}
+  VariableUnserializer(std::istream &in)
+    : m_in(in), m_key(false), m_hasReference(false) {}
 
+  /**
+   * Without any "R:" entry, nothing can point into the arrays just created,
+   * so they are free to be packed.
+   */
   Variant unserialize() {
     Variant v;
     v.unserialize(this);
+    if (!m_hasReference) TypedVector::PackAll(v);
     return v;
   }
 
@@ -52,11 +59,16 @@ public:
     if (id <= 0  || id > (int)m_refs.size()) return NULL;
     return m_refs[id-1];
   }
+  Variant *getReference(int id) {
+    m_hasReference = true;
+    return get(id);
+  }
 
  private:
   std::istream &m_in;
   std::vector<Variant*> m_refs;
   bool m_key;
+  bool m_hasReference;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
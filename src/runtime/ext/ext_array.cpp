@@ -17,6 +17,7 @@
 
 #include <runtime/ext/ext_array.h>
 #include <runtime/ext/ext_function.h>
+#include <runtime/base/array/parallel_array.h>
 #include <runtime/base/util/request_local.h>
 #include <runtime/base/zend/zend_collator.h>
 #include <unicode/ucol.h> // icu
@@ -75,6 +76,10 @@ Variant f_array_filter(CVarRef input, CVarRef callback /* = null_variant */) {
   if (callback.isNull()) {
     return ArrayUtil::Filter(toArray(input));
   }
+  Variant ret;
+  if (ParallelArray::Filter(toArray(input), callback, ret)) {
+    return ret;
+  }
   return ArrayUtil::Filter(toArray(input), filter_func, &callback);
 }
 
@@ -104,6 +109,12 @@ Variant f_array_map(int _argc, CVarRef callback, CVarRef arr1, CArrRef _argv /*
     throw_bad_array_exception(__func__);
     return null;
   }
+  if (_argv.empty()) {
+    Variant ret;
+    if (ParallelArray::Map(toArray(arr1), callback, ret)) {
+      return ret;
+    }
+  }
   inputs.append(arr1);
   if (!_argv.empty()) {
     inputs = inputs.merge(_argv);
@@ -927,6 +938,57 @@ static Array::PFUNC_CMP get_cmp_func(int sort_flags, bool ascending) {
   }
 }
 
+/**
+ * Sorting with a builtin comparator. The array is taken out of the variant
+ * first, so that an unshared one can be reordered in place by Array::sort()
+ * instead of being copied.
+ */
+static void php_sort(Variant &array, Array::PFUNC_CMP cmp_func, bool by_key,
+                     bool renumber) {
+  Array temp = array.toArray();
+  array = null;
+  try {
+    temp.sort(cmp_func, by_key, renumber);
+  } catch (...) {
+    array = temp;
+    throw;
+  }
+  array = temp;
+}
+
+/**
+ * Comparison callback of usort() family, resolved once per sort rather than
+ * once per comparison: a plain function name is invoked directly with its
+ * hash computed upfront, and anything else goes through
+ * call_user_func_array().
+ */
+class SortCallback {
+public:
+  SortCallback(CVarRef function) : m_function(function), m_hash(-1) {
+    if (function.isString()) {
+      m_name = function.toString();
+      if (m_name.find("::") == String::npos) {
+        m_hash = hash_string_i(m_name.data(), m_name.size());
+      }
+    }
+  }
+
+  static int Compare(CVarRef v1, CVarRef v2, const void *data) {
+    const SortCallback *callback = (const SortCallback *)data;
+    if (callback->m_hash >= 0) {
+      return invoke(callback->m_name.data(), CREATE_VECTOR2(v1, v2),
+                    callback->m_hash, true, false);
+    }
+    return f_call_user_func_array(callback->m_function,
+                                  CREATE_VECTOR2(v1, v2));
+  }
+
+private:
+  CVarRef m_function;
+  String m_name;
+  int64 m_hash;
+};
+
 bool f_sort(Variant array, int sort_flags /* = 0 */,
             bool use_collator /* = false */) {
   if (!array.isArray()) {
@@ -940,9 +1002,7 @@ bool f_sort(Variant array, int sort_flags /* = 0 */,
       return collator_sort(array, sort_flags, true, coll, &errcode);
     }
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, true), false, true);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, true), false, true);
   return true;
 }
 
@@ -959,9 +1019,7 @@ bool f_rsort(Variant array, int sort_flags /* = 0 */,
       return collator_sort(array, sort_flags, false, coll, &errcode);
     }
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, false), false, true);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, false), false, true);
   return true;
 }
 
@@ -978,9 +1036,7 @@ bool f_asort(Variant array, int sort_flags /* = 0 */,
       return collator_asort(array, sort_flags, true, coll, &errcode);
     }
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, true), false, false);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, true), false, false);
   return true;
 }
 
@@ -997,9 +1053,7 @@ bool f_arsort(Variant array, int sort_flags /* = 0 */,
       return collator_asort(array, sort_flags, false, coll, &errcode);
     }
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, false), false, false);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, false), false, false);
   return true;
 }
 
@@ -1008,9 +1062,7 @@ bool f_ksort(Variant array, int sort_flags /* = 0 */) {
     throw_bad_array_exception(__func__);
     return false;
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, true), true, false);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, true), true, false);
   return true;
 }
 
@@ -1019,9 +1071,7 @@ bool f_krsort(Variant array, int sort_flags /* = 0 */) {
     throw_bad_array_exception(__func__);
     return false;
   }
-  Array temp = array.toArray();
-  temp.sort(get_cmp_func(sort_flags, false), true, false);
-  array = temp;
+  php_sort(array, get_cmp_func(sort_flags, false), true, false);
   return true;
 }
 
@@ -1031,7 +1081,13 @@ bool f_usort(Variant array, CVarRef cmp_function) {
     return false;
   }
   Array temp = array.toArray();
-  temp.sort(cmp_func, false, true, &cmp_function);
+  Array sorted;
+  if (ParallelArray::Usort(temp, cmp_function, sorted)) {
+    array = sorted;
+    return true;
+  }
+  SortCallback callback(cmp_function);
+  temp.sort(SortCallback::Compare, false, true, &callback);
   array = temp;
   return true;
 }
@@ -1041,8 +1097,9 @@ bool f_uasort(Variant array, CVarRef cmp_function) {
     throw_bad_array_exception(__func__);
     return false;
   }
+  SortCallback callback(cmp_function);
   Array temp = array.toArray();
-  temp.sort(cmp_func, false, false, &cmp_function);
+  temp.sort(SortCallback::Compare, false, false, &callback);
   array = temp;
   return true;
 }
@@ -1052,8 +1109,9 @@ bool f_uksort(Variant array, CVarRef cmp_function) {
     throw_bad_array_exception(__func__);
     return false;
   }
+  SortCallback callback(cmp_function);
   Array temp = array.toArray();
-  temp.sort(cmp_func, true, false, &cmp_function);
+  temp.sort(SortCallback::Compare, true, false, &callback);
   array = temp;
   return true;
 }
@@ -1065,9 +1123,7 @@ Variant f_natsort(Variant array) {
     throw_bad_array_exception(__func__);
     return null;
   }
-  Array temp = array.toArray();
-  temp.sort(Array::SortNatural, false, false);
-  array = temp;
+  php_sort(array, Array::SortNatural, false, false);
   return true;
 }
 
@@ -1078,9 +1134,7 @@ Variant f_natcasesort(Variant array) {
     throw_bad_array_exception(__func__);
     return null;
   }
-  Array temp = array.toArray();
-  temp.sort(Array::SortNaturalCase, false, false);
-  array = temp;
+  php_sort(array, Array::SortNaturalCase, false, false);
   return true;
 }
 
@@ -19,6 +19,7 @@
 #include <runtime/ext/ext_function.h>
 #include <runtime/base/util/string_buffer.h>
 #include <runtime/base/util/libevent_http_client.h>
+#include <runtime/base/server/server_stats.h>
 #include <runtime/base/runtime_option.h>
 
 using namespace std;
@@ -1028,32 +1029,30 @@ public:
 };
 IMPLEMENT_OBJECT_ALLOCATION(LibEventHttpHandle);
 
-static LibEventHttpClientPtr prepare_client
-(CStrRef url, CStrRef data, CArrRef headers, int timeout,
- bool async, bool post) {
+static bool parse_url(CStrRef url, string &address, int &port,
+                      string &path) {
   string sUrl = url.data();
   if (sUrl.size() < 7 || sUrl.substr(0, 7) != "http://") {
     raise_warning("Invalid URL: %s", sUrl.c_str());
-    return LibEventHttpClientPtr();
+    return false;
   }
 
   // parsing server address
   size_t pos = sUrl.find('/', 7);
-  string path;
   if (pos == string::npos) {
     pos = sUrl.length();
     path = "/";
   } else if (pos == 7) {
     raise_warning("Invalid URL: %s", sUrl.c_str());
-    return LibEventHttpClientPtr();
+    return false;
   } else {
     path = sUrl.substr(pos);
   }
-  string address = sUrl.substr(7, pos - 7);
+  address = sUrl.substr(7, pos - 7);
 
   // parsing server port
   pos = address.find(':');
-  int port = 80;
+  port = 80;
   if (pos != string::npos) {
     if (pos < address.length() - 1) {
       string sport = address.substr(pos + 1, address.length() - pos - 1);
@@ -1061,6 +1060,23 @@ static LibEventHttpClientPtr prepare_client
     }
     address = address.substr(0, pos);
   }
+  return true;
+}
+
+static void prepare_headers(CArrRef headers, vector<string> &sheaders) {
+  for (ArrayIter iter(headers); iter; ++iter) {
+    sheaders.push_back(iter.second().toString().data());
+  }
+}
+
+static LibEventHttpClientPtr prepare_client
+(CStrRef url, CStrRef data, CArrRef headers, int timeout,
+ bool async, bool post) {
+  string address, path;
+  int port;
+  if (!parse_url(url, address, port, path)) {
+    return LibEventHttpClientPtr();
+  }
 
   LibEventHttpClientPtr client = LibEventHttpClient::Get(address, port);
   if (!client) {
@@ -1068,9 +1084,7 @@ static LibEventHttpClientPtr prepare_client
   }
 
   vector<string> sheaders;
-  for (ArrayIter iter(headers); iter; ++iter) {
-    sheaders.push_back(iter.second().toString().data());
-  }
+  prepare_headers(headers, sheaders);
   if (!client->send(path.c_str(), sheaders, timeout, async,
                     post ? (void*)data.data() : NULL,
                     post ? data.size() : 0)) {
@@ -1157,5 +1171,90 @@ Variant f_evhttp_recv(CObjRef handle) {
   return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// evhttp tasks, multiplexed over one I/O thread
+
+class LibEventHttpTaskHandle : public ResourceData {
+public:
+  DECLARE_OBJECT_ALLOCATION(LibEventHttpTaskHandle);
+
+  // overriding ResourceData
+  virtual const char *o_getClassName() const { return "LibEventHttpTask";}
+
+  LibEventHttpTaskHandle(LibEventHttpTaskPtr task)
+    : m_task(task), m_harvested(false) {
+  }
+
+  LibEventHttpTaskPtr m_task;
+  bool m_harvested;
+  Variant m_result; // response is only handed over by the task once
+};
+IMPLEMENT_OBJECT_ALLOCATION(LibEventHttpTaskHandle);
+
+Variant f_evhttp_task_start(CStrRef url, CArrRef headers /* = null_array */,
+                            int timeout /* = 5 */,
+                            CStrRef post_data /* = null_string */) {
+  string address, path;
+  int port;
+  if (!parse_url(url, address, port, path)) {
+    return false;
+  }
+
+  vector<string> sheaders;
+  prepare_headers(headers, sheaders);
+  bool post = !post_data.isNull();
+  LibEventHttpTaskPtr task
+    (new LibEventHttpTask(address, port, path, sheaders, timeout,
+                          post ? post_data.data() : NULL,
+                          post ? post_data.size() : 0));
+  if (!LibEventHttpMultiClient::Start(task)) {
+    return false;
+  }
+  return Object(NEW(LibEventHttpTaskHandle)(task));
+}
+
+bool f_evhttp_task_status(CObjRef task) {
+  LibEventHttpTaskHandle *obj = task.getTyped<LibEventHttpTaskHandle>();
+  return obj->m_task->isDone();
+}
+
+Variant f_evhttp_task_result(CObjRef task) {
+  LibEventHttpTaskHandle *obj = task.getTyped<LibEventHttpTaskHandle>();
+  if (obj->m_harvested) {
+    return obj->m_result;
+  }
+  obj->m_harvested = true;
+  LibEventHttpTask &t = *obj->m_task;
+
+  int len = 0;
+  char *res = NULL;
+  bool ok = t.wait(res, len); // block on return
+
+  const string &hash = t.getHash();
+  ServerStats::Log(t.isConnectionReused() ? "evhttp.task.hit" :
+                   "evhttp.task.miss", 1);
+  ServerStats::Log("evhttp.task.latency", t.getLatency());
+  ServerStats::Log("evhttp.task.latency." + hash, t.getLatency());
+  if (!ok) {
+    ServerStats::Log("evhttp.task.error." + hash, 1);
+    obj->m_result = false;
+    return false;
+  }
+
+  Array ret = Array::Create();
+  ret.set("code", t.getCode());
+  ret.set("response", String(res, len, AttachString));
+
+  Array headers = Array::Create();
+  const vector<string> &responseHeaders = t.getResponseHeaders();
+  for (unsigned int i = 0; i < responseHeaders.size(); i++) {
+    headers.append(String(responseHeaders[i]));
+  }
+  ret.set("headers", headers);
+  ret.set("latency", t.getLatency());
+  obj->m_result = ret;
+  return ret;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
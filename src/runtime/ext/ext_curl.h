@@ -52,6 +52,9 @@ Variant f_evhttp_post(CStrRef url, CStrRef data, CArrRef headers = null_array, i
 Variant f_evhttp_async_get(CStrRef url, CArrRef headers = null_array, int timeout = 5);
 Variant f_evhttp_async_post(CStrRef url, CStrRef data, CArrRef headers = null_array, int timeout = 5);
 Variant f_evhttp_recv(CObjRef handle);
+Variant f_evhttp_task_start(CStrRef url, CArrRef headers = null_array, int timeout = 5, CStrRef post_data = null_string);
+bool f_evhttp_task_status(CObjRef task);
+Variant f_evhttp_task_result(CObjRef task);
 
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -216,28 +216,28 @@ inline Variant f_idate(CStrRef format, int64 timestamp = TimeStamp::Current()) {
 
 inline Variant f_date(CStrRef format, int64 timestamp = TimeStamp::Current()) {
   if (format.empty()) return "";
-  String ret = DateTime(timestamp, false).toString(format, false);
+  String ret = DateTime::Format(format, timestamp, false, false);
   if (ret.isNull()) return false;
   return ret;
 }
 
 inline Variant f_gmdate(CStrRef format,
                        int64 timestamp = TimeStamp::Current()) {
-  String ret = DateTime(timestamp, true).toString(format, false);
+  String ret = DateTime::Format(format, timestamp, true, false);
   if (ret.isNull()) return false;
   return ret;
 }
 
 inline Variant f_strftime(CStrRef format,
                          int64 timestamp = TimeStamp::Current()) {
-  String ret = DateTime(timestamp, false).toString(format, true);
+  String ret = DateTime::Format(format, timestamp, false, true);
   if (ret.isNull()) return false;
   return ret;
 }
 
 inline String f_gmstrftime(CStrRef format,
                            int64 timestamp = TimeStamp::Current()) {
-  String ret = DateTime(timestamp, true).toString(format, true);
+  String ret = DateTime::Format(format, timestamp, true, true);
   if (ret.isNull()) return false;
   return ret;
 }
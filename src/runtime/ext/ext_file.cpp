@@ -22,11 +22,13 @@
 #include <runtime/base/runtime_error.h>
 #include <runtime/base/ini_setting.h>
 #include <runtime/base/array/array_util.h>
+#include <runtime/base/array/array_init.h>
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/util/request_local.h>
 #include <runtime/base/server/static_content_cache.h>
 #include <runtime/base/zend/zend_scanf.h>
 #include <runtime/base/file/pipe.h>
+#include <runtime/base/file/plain_file.h>
 #include <util/logger.h>
 #include <util/util.h>
 #include <util/process.h>
@@ -308,6 +310,14 @@ Variant f_file_get_contents(CStrRef filename,
                             int64 maxlen /* = 0 */) {
   Variant stream = f_fopen(filename, "rb");
   if (same(stream, false)) return false;
+
+  PlainFile *file = stream.toObject().getTyped<PlainFile>(true, true);
+  if (file && maxlen >= 0 && (offset <= 0 || file->seek(offset, SEEK_SET))) {
+    String content = file->readRemaining(maxlen);
+    if (!content.isNull()) {
+      return content;
+    }
+  }
   return f_stream_get_contents(stream, maxlen, offset);
 }
 
@@ -327,7 +337,7 @@ Variant f_file_put_contents(CStrRef filename, CVarRef data,
     return false;
   }
 
-  int numbytes = 0;
+  int64 numbytes = 0;
   switch (data.getType()) {
   case KindOfObject:
     {
@@ -336,8 +346,13 @@ Variant f_file_put_contents(CStrRef filename, CVarRef data,
         raise_warning("Not a valid stream resource");
         return false;
       }
+      PlainFile *psrc = dynamic_cast<PlainFile*>(fsrc);
+      if (psrc && fflush(f) == 0) {
+        int64 sent = psrc->sendfile(fileno(f));
+        if (sent > 0) numbytes += sent;
+      }
       while (true) {
-        char buffer[1024];
+        char buffer[8192];
         int len = fsrc->readImpl(buffer, sizeof(buffer));
         if (len == 0) break;
         numbytes += len;
@@ -402,6 +417,14 @@ Variant f_file(CStrRef filename, int flags /* = 0 */,
   const char *s = content.data();
   const char *e = s + content.size();
 
+  // counting lines first, so the array is allocated just once
+  int lines = 1;
+  for (const char *p = s; (p = (const char *)memchr(p, eol_marker, e - p));
+       p++) {
+    lines++;
+  }
+  ArrayInit init(lines, true);
+
   int i = 0;
   const char *p = (const char *)memchr(s, '\n', content.size());
   if (!p) {
@@ -413,7 +436,7 @@ Variant f_file(CStrRef filename, int flags /* = 0 */,
     do {
       p++;
     parse_eol:
-      ret.set(i++, String(s, p-s, CopyString));
+      init.set(i++, String(s, p-s, CopyString));
       s = p;
     } while ((p = (const char *)memchr(p, eol_marker, (e-p))));
   } else {
@@ -422,7 +445,7 @@ Variant f_file(CStrRef filename, int flags /* = 0 */,
         s = ++p;
         continue;
       }
-      ret.set(i++, String(s, p-s, CopyString));
+      init.set(i++, String(s, p-s, CopyString));
       s = ++p;
     } while ((p = (const char *)memchr(p, eol_marker, (e-p))));
   }
@@ -432,7 +455,7 @@ Variant f_file(CStrRef filename, int flags /* = 0 */,
     p = e;
     goto parse_eol;
   }
-  return ret;
+  return Array(init.create());
 }
 
 Variant f_readfile(CStrRef filename, bool use_include_path /* = false */,
@@ -948,11 +971,12 @@ bool f_touch(CStrRef filename, int64 mtime /* = 0 */, int64 atime /* = 0 */) {
 
 bool f_copy(CStrRef source, CStrRef dest,
             CObjRef context /* = null_object */) {
-  Variant content = f_file_get_contents(source);
-  if (same(content, false)) {
+  // passing the stream, so plain files are copied with sendfile()
+  Variant stream = f_fopen(source, "rb");
+  if (same(stream, false)) {
     return false;
   }
-  Variant ret = f_file_put_contents(File::TranslatePath(dest), content);
+  Variant ret = f_file_put_contents(File::TranslatePath(dest), stream);
   return !same(ret, false);
 }
 
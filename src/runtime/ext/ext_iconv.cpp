@@ -20,6 +20,8 @@
 #include <runtime/base/util/request_local.h>
 #include <runtime/base/zend/zend_functions.h>
 #include <runtime/base/zend/zend_string.h>
+#include <runtime/base/string_util.h>
+#include <util/thread_local.h>
 
 #define ICONV_SUPPORTS_ERRNO 1
 #include <iconv.h>
@@ -133,6 +135,81 @@ static Variant check_charset(CStrRef charset) {
   return charset;
 }
 
+/**
+ * iconv_open() loads and initializes gconv modules every time, which costs
+ * far more than converting a typical short string. Idle descriptors are kept
+ * per thread, keyed by charset pair, and reset to initial shift state before
+ * being handed out again.
+ */
+class ICONVDescriptors {
+public:
+  static const int MaxIdle = 64;
+
+  ICONVDescriptors() : m_idle(0) {}
+  ~ICONVDescriptors() {
+    for (DescriptorMap::iterator iter = m_free.begin();
+         iter != m_free.end(); ++iter) {
+      for (unsigned int i = 0; i < iter->second.size(); i++) {
+        iconv_close(iter->second[i]);
+      }
+    }
+  }
+
+  iconv_t open(const char *out_charset, const char *in_charset) {
+    std::string key = out_charset;
+    key += '\0';
+    key += in_charset;
+
+    iconv_t cd;
+    DescriptorMap::iterator iter = m_free.find(key);
+    if (iter != m_free.end() && !iter->second.empty()) {
+      cd = iter->second.back();
+      iter->second.pop_back();
+      m_idle--;
+    } else {
+      cd = iconv_open(out_charset, in_charset);
+      if (cd == (iconv_t)(-1)) return cd;
+    }
+    m_keys[cd] = key;
+    return cd;
+  }
+
+  void close(iconv_t cd) {
+    int saved = errno; // callers look at errno of last conversion after this
+    std::map<iconv_t, std::string>::iterator iter = m_keys.find(cd);
+    if (iter == m_keys.end()) {
+      iconv_close(cd);
+      errno = saved;
+      return;
+    }
+    if (m_idle < MaxIdle) {
+      iconv(cd, NULL, NULL, NULL, NULL);
+      m_free[iter->second].push_back(cd);
+      m_idle++;
+    } else {
+      iconv_close(cd);
+    }
+    m_keys.erase(iter);
+    errno = saved;
+  }
+
+private:
+  typedef std::map<std::string, std::vector<iconv_t> > DescriptorMap;
+  DescriptorMap m_free;
+  std::map<iconv_t, std::string> m_keys; // descriptors in use
+  int m_idle;
+};
+static IMPLEMENT_THREAD_LOCAL(ICONVDescriptors, s_iconv_descriptors);
+
+static iconv_t php_iconv_open(const char *out_charset,
+                              const char *in_charset) {
+  return s_iconv_descriptors->open(out_charset, in_charset);
+}
+
+static void php_iconv_close(iconv_t cd) {
+  s_iconv_descriptors->close(cd);
+}
+
 static php_iconv_err_t _php_iconv_appendl(StringBuffer &d, const char *s,
                                           size_t l, iconv_t cd) {
   const char *in_p = s;
@@ -227,7 +304,7 @@ static php_iconv_err_t php_iconv_string(const char *in_p, size_t in_len,
 
   in_size = in_len;
 
-  cd = iconv_open(out_charset, in_charset);
+  cd = php_iconv_open(out_charset, in_charset);
 
   if (cd == (iconv_t)(-1)) {
     return PHP_ICONV_ERR_UNKNOWN;
@@ -258,7 +335,7 @@ static php_iconv_err_t php_iconv_string(const char *in_p, size_t in_len,
   out_buffer[*out_len] = '\0';
   *out = out_buffer;
 
-  iconv_close(cd);
+  php_iconv_close(cd);
 
   return PHP_ICONV_ERR_SUCCESS;
 
@@ -273,7 +350,7 @@ static php_iconv_err_t php_iconv_string(const char *in_p, size_t in_len,
   *out = NULL;
   *out_len = 0;
 
-  cd = iconv_open(out_charset, in_charset);
+  cd = php_iconv_open(out_charset, in_charset);
 
   if (cd == (iconv_t)(-1)) {
     if (errno == EINVAL) {
@@ -330,7 +407,7 @@ static php_iconv_err_t php_iconv_string(const char *in_p, size_t in_len,
     }
   }
 
-  iconv_close(cd);
+  php_iconv_close(cd);
 
   if (result == (size_t)(-1)) {
     switch (errno) {
@@ -368,7 +445,7 @@ static php_iconv_err_t _php_iconv_strlen(unsigned int *pretval,
 
   *pretval = (unsigned int)-1;
 
-  cd = iconv_open(GENERIC_SUPERSET_NAME, enc);
+  cd = php_iconv_open(GENERIC_SUPERSET_NAME, enc);
   if (cd == (iconv_t)(-1)) {
 #if ICONV_SUPPORTS_ERRNO
     if (errno == EINVAL) {
@@ -418,7 +495,7 @@ static php_iconv_err_t _php_iconv_strlen(unsigned int *pretval,
   *pretval = cnt;
 #endif
 
-  iconv_close(cd);
+  php_iconv_close(cd);
   return err;
 }
 
@@ -470,7 +547,7 @@ static php_iconv_err_t _php_iconv_substr(StringBuffer &pretval,
     return PHP_ICONV_ERR_SUCCESS;
   }
 
-  cd1 = iconv_open(GENERIC_SUPERSET_NAME, enc);
+  cd1 = php_iconv_open(GENERIC_SUPERSET_NAME, enc);
 
   if (cd1 == (iconv_t)(-1)) {
 #if ICONV_SUPPORTS_ERRNO
@@ -503,7 +580,7 @@ static php_iconv_err_t _php_iconv_substr(StringBuffer &pretval,
 
     if (cnt >= (unsigned int)offset) {
       if (cd2 == (iconv_t)NULL) {
-        cd2 = iconv_open(enc, GENERIC_SUPERSET_NAME);
+        cd2 = php_iconv_open(enc, GENERIC_SUPERSET_NAME);
 
         if (cd2 == (iconv_t)(-1)) {
           cd2 = (iconv_t)NULL;
@@ -549,11 +626,11 @@ static php_iconv_err_t _php_iconv_substr(StringBuffer &pretval,
   }
 
   if (cd1 != (iconv_t)NULL) {
-    iconv_close(cd1);
+    php_iconv_close(cd1);
   }
 
   if (cd2 != (iconv_t)NULL) {
-    iconv_close(cd2);
+    php_iconv_close(cd2);
   }
   return err;
 }
@@ -588,7 +665,7 @@ static php_iconv_err_t _php_iconv_strpos(unsigned int *pretval,
     return err;
   }
 
-  cd = iconv_open(GENERIC_SUPERSET_NAME, enc);
+  cd = php_iconv_open(GENERIC_SUPERSET_NAME, enc);
 
   if (cd == (iconv_t)(-1)) {
     if (ndl_buf != NULL) {
@@ -724,7 +801,7 @@ static php_iconv_err_t _php_iconv_strpos(unsigned int *pretval,
     free(ndl_buf);
   }
 
-  iconv_close(cd);
+  php_iconv_close(cd);
   return err;
 }
 
@@ -753,7 +830,7 @@ static php_iconv_err_t _php_iconv_mime_decode(StringBuffer &retval,
   if (next_pos != NULL) {
     *next_pos = NULL;
   }
-  cd_pl = iconv_open(enc, "ASCII");
+  cd_pl = php_iconv_open(enc, "ASCII");
 
   if (cd_pl == (iconv_t)(-1)) {
 #if ICONV_SUPPORTS_ERRNO
@@ -866,10 +943,10 @@ static php_iconv_err_t _php_iconv_mime_decode(StringBuffer &retval,
         tmpbuf[csname_len] = '\0';
 
         if (cd != (iconv_t)(-1)) {
-          iconv_close(cd);
+          php_iconv_close(cd);
         }
 
-        cd = iconv_open(enc, tmpbuf);
+        cd = php_iconv_open(enc, tmpbuf);
 
         if (cd == (iconv_t)(-1)) {
           if ((mode & PHP_ICONV_MIME_DECODE_CONTINUE_ON_ERROR)) {
@@ -1230,10 +1307,10 @@ static php_iconv_err_t _php_iconv_mime_decode(StringBuffer &retval,
 
  out:
   if (cd != (iconv_t)(-1)) {
-    iconv_close(cd);
+    php_iconv_close(cd);
   }
   if (cd_pl != (iconv_t)(-1)) {
-    iconv_close(cd_pl);
+    php_iconv_close(cd_pl);
   }
   return err;
 }
@@ -1316,7 +1393,7 @@ Variant f_iconv_mime_encode(CStrRef field_name, CStrRef field_value,
     goto out;
   }
 
-  cd_pl = iconv_open("ASCII", in_charset.data());
+  cd_pl = php_iconv_open("ASCII", in_charset.data());
   if (cd_pl == (iconv_t)(-1)) {
 #if ICONV_SUPPORTS_ERRNO
     if (errno == EINVAL) {
@@ -1330,7 +1407,7 @@ Variant f_iconv_mime_encode(CStrRef field_name, CStrRef field_value,
     goto out;
   }
 
-  cd = iconv_open(out_charset.data(), in_charset.data());
+  cd = php_iconv_open(out_charset.data(), in_charset.data());
   if (cd == (iconv_t)(-1)) {
 #if ICONV_SUPPORTS_ERRNO
     if (errno == EINVAL) {
@@ -1581,10 +1658,10 @@ Variant f_iconv_mime_encode(CStrRef field_name, CStrRef field_value,
 
  out:
   if (cd != (iconv_t)(-1)) {
-    iconv_close(cd);
+    php_iconv_close(cd);
   }
   if (cd_pl != (iconv_t)(-1)) {
-    iconv_close(cd_pl);
+    php_iconv_close(cd_pl);
   }
   if (buf != NULL) {
     free(buf);
@@ -1716,6 +1793,10 @@ Variant f_iconv(CStrRef in_charset, CStrRef out_charset, CStrRef str) {
   if (!validate_charset(in_charset)) return false;
   if (!validate_charset(out_charset)) return false;
 
+  String converted = StringUtil::ConvertCharset(str, out_charset.data(),
+                                                in_charset.data());
+  if (!converted.isNull()) return converted;
+
   char *out_buffer;
   size_t out_len;
   php_iconv_err_t err =
@@ -1804,6 +1885,13 @@ Variant f_iconv_substr(CStrRef str, int offset, int length /* = INT_MAX */,
 String f_ob_iconv_handler(CStrRef contents, int status) {
   String mimetype = g_context->getMimeType();
   if (!mimetype.empty()) {
+    String converted =
+      StringUtil::ConvertCharset(contents, ICONVG(output_encoding).data(),
+                                 ICONVG(internal_encoding).data());
+    if (!converted.isNull()) {
+      g_context->setContentType(mimetype, ICONVG(output_encoding));
+      return converted;
+    }
     char *out_buffer;
     size_t out_len;
     php_iconv_err_t err =
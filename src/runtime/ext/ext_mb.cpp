@@ -23,6 +23,7 @@
 #include <runtime/ext/ext_process.h>
 #include <runtime/base/zend/zend_url.h>
 #include <runtime/base/zend/zend_string.h>
+#include <runtime/base/string_util.h>
 
 extern "C" {
 #include <mbfl/mbfl_convert.h>
@@ -1188,6 +1189,10 @@ Variant f_mb_convert_encoding(CStrRef str, CStrRef to_encoding,
       _from_encodings.append(iter.second().toString());
     }
     encoding = _from_encodings.detach();
+  } else if (!encoding.empty()) {
+    String converted = StringUtil::ConvertCharset(str, to_encoding.data(),
+                                                  encoding.data());
+    if (!converted.isNull()) return converted;
   }
 
   unsigned int size;
@@ -26,6 +26,9 @@
 #include <runtime/base/ini_setting.h>
 #include <runtime/base/time/datetime.h>
 #include <util/lock.h>
+#include <util/synchronizable.h>
+#include <util/thread_local.h>
+#include <util/hash.h>
 #include <util/compatibility.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -224,6 +227,27 @@ public:
     return NULL;
   }
 
+protected:
+  /* If you change the logic here, please also update the error message in
+   * ps_files_open() appropriately */
+  static bool IsValid(const char *key) {
+    const char *p; char c;
+    bool ret = true;
+    for (p = key; (c = *p); p++) {
+      /* valid characters are a..z,A..Z,0..9 */
+      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == ',' || c == '-')) {
+        ret = false;
+        break;
+      }
+    }
+    size_t len = p - key;
+    if (len == 0) {
+      ret = false;
+    }
+    return ret;
+  }
+
 private:
   static std::vector<SessionModule*> RegisteredModules;
 
@@ -531,26 +555,6 @@ private:
   size_t m_st_size;
   int m_filemode;
 
-  /* If you change the logic here, please also update the error message in
-   * ps_files_open() appropriately */
-  static bool IsValid(const char *key) {
-    const char *p; char c;
-    bool ret = true;
-    for (p = key; (c = *p); p++) {
-      /* valid characters are a..z,A..Z,0..9 */
-      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
-            || (c >= '0' && c <= '9') || c == ',' || c == '-')) {
-        ret = false;
-        break;
-      }
-    }
-    size_t len = p - key;
-    if (len == 0) {
-      ret = false;
-    }
-    return ret;
-  }
-
 #define FILE_PREFIX "sess_"
 
   bool createPath(char *buf, size_t buflen, const char *key) {
@@ -686,6 +690,295 @@ private:
 };
 static FileSessionModule s_file_session_module;
 
+///////////////////////////////////////////////////////////////////////////////
+// ShmSessionModule
+
+// session this thread's request has read and locked, if any
+static IMPLEMENT_THREAD_LOCAL(string, s_locked_key);
+
+/**
+ * Sessions kept in memory and shared by all request threads of this process.
+ * A session is locked from read() until close(), so concurrent requests of
+ * the same session take turns, and garbage collection walks the table
+ * instead of scanning a directory. A request waits for a session held by
+ * another one until it runs out of time, and at most gc_maxlifetime
+ * seconds. Then it gives up with a warning and an empty session, which it
+ * can't write back over the holder's.
+ *
+ * When session.save_path is set, it names a directory that sessions are
+ * written back to, as "sess_<id>" files just like the "files" module's, so
+ * they survive a restart: gc() flushes changed sessions, and a session
+ * that isn't in memory yet is loaded from its file on first read, unless
+ * the file has expired in the meantime.
+ */
+class ShmSessionModule : public SessionModule {
+public:
+  ShmSessionModule() : SessionModule("shm") {}
+
+  virtual bool open(const char *save_path, const char *session_name) {
+    return true;
+  }
+
+  virtual bool close() {
+    release();
+    return true;
+  }
+
+  virtual bool read(const char *key, String &value) {
+    if (!IsValid(key)) {
+      raise_warning("The session id contains illegal characters, "
+                    "valid characters are a-z, A-Z, 0-9 and '-,'");
+      PS(invalid_session_id) = true;
+      return false;
+    }
+    release();
+
+    string skey(key);
+    Stripe &stripe = getStripe(skey);
+    bool missing = false;
+    bool timedOut = false;
+    time_t deadline = LockDeadline();
+    {
+      Lock lock(stripe.getMutex());
+      EntryMap::iterator iter;
+      while ((iter = stripe.entries.find(skey)) != stripe.entries.end() &&
+             iter->second.locked) {
+        if (time(NULL) >= deadline ||
+            ThreadInfo::s_threadInfo->m_reqInjectionData.timedout) {
+          timedOut = true;
+          break;
+        }
+        // wakes up every second to notice a request timeout
+        stripe.wait(1);
+      }
+      if (!timedOut) {
+        if (iter == stripe.entries.end()) {
+          iter = stripe.entries.insert(EntryMap::value_type(skey, Entry()))
+            .first;
+          iter->second.mtime = time(NULL);
+          missing = true;
+        }
+        iter->second.locked = true;
+        value = String(iter->second.data.data(), iter->second.data.size(),
+                       CopyString);
+      }
+    }
+    // raised without the stripe locked, as an error handler may use
+    // sessions itself
+    if (timedOut) {
+      raise_warning("Timed out waiting for session %s, which another "
+                    "request holds", key);
+      return false;
+    }
+    *s_locked_key = skey;
+
+    // The entry is ours now, so the file can be read without blocking
+    // other sessions of the same stripe.
+    string data;
+    time_t mtime;
+    if (missing && ReadFile(getFilePath(skey), data, mtime)) {
+      Lock lock(stripe.getMutex());
+      EntryMap::iterator iter = stripe.entries.find(skey);
+      if (iter != stripe.entries.end()) {
+        iter->second.data = data;
+        iter->second.mtime = mtime;
+      }
+      value = String(data.data(), data.size(), CopyString);
+    }
+    return true;
+  }
+
+  virtual bool write(const char *key, CStrRef value) {
+    string skey(key);
+    bool persist = !PS(save_path).empty();
+    Stripe &stripe = getStripe(skey);
+    Lock lock(stripe.getMutex());
+    Entry &entry = stripe.entries[skey];
+    if (entry.locked && *s_locked_key != skey) {
+      // read() timed out waiting for it
+      return false;
+    }
+    entry.data.assign(value.data(), value.size());
+    entry.mtime = time(NULL);
+    entry.dirty = persist;
+    return true;
+  }
+
+  virtual bool destroy(const char *key) {
+    string skey(key);
+    Stripe &stripe = getStripe(skey);
+    {
+      Lock lock(stripe.getMutex());
+      EntryMap::iterator iter = stripe.entries.find(skey);
+      if (iter != stripe.entries.end()) {
+        if (*s_locked_key == skey) {
+          stripe.entries.erase(iter);
+          s_locked_key->clear();
+          stripe.notifyAll();
+        } else if (iter->second.locked) {
+          // someone else's request is using it: empty it and let gc() or
+          // the holder's close() take care of the rest
+          iter->second.data.clear();
+          iter->second.mtime = 0;
+          iter->second.dirty = false;
+        } else {
+          stripe.entries.erase(iter);
+        }
+      }
+    }
+    string path = getFilePath(skey);
+    if (!path.empty()) {
+      // after any write back of it that gc() is in the middle of
+      Lock lock(m_writeBackMutex);
+      unlink(path.c_str());
+    }
+    return true;
+  }
+
+  virtual bool gc(int maxlifetime, int *nrdels) {
+    time_t now = time(NULL);
+    string dir = PS(save_path);
+    vector<pair<string, string> > dirty;
+    vector<string> expired;
+    // held from taking snapshots to writing them out, so an older snapshot
+    // of a session never overwrites a newer one
+    Lock writeBackLock(m_writeBackMutex);
+    for (int i = 0; i < StripeCount; i++) {
+      Stripe &stripe = m_stripes[i];
+      Lock lock(stripe.getMutex());
+      for (EntryMap::iterator iter = stripe.entries.begin();
+           iter != stripe.entries.end(); ) {
+        Entry &entry = iter->second;
+        if (!entry.locked && now - entry.mtime > maxlifetime) {
+          expired.push_back(iter->first);
+          stripe.entries.erase(iter++);
+          continue;
+        }
+        if (entry.dirty) {
+          dirty.push_back(pair<string, string>(iter->first, entry.data));
+          entry.dirty = false;
+        }
+        ++iter;
+      }
+    }
+    *nrdels = expired.size();
+
+    if (!dir.empty()) {
+      for (unsigned int i = 0; i < dirty.size(); i++) {
+        WriteFile(getFilePath(dirty[i].first), dirty[i].second);
+      }
+      for (unsigned int i = 0; i < expired.size(); i++) {
+        unlink(getFilePath(expired[i]).c_str());
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Entry {
+    Entry() : mtime(0), locked(false), dirty(false) {}
+    string data;
+    time_t mtime;
+    bool locked; // between a request's read() and close()
+    bool dirty;  // not written back to save_path yet
+  };
+  typedef hphp_hash_map<string, Entry, string_hash> EntryMap;
+
+  struct Stripe : public Synchronizable {
+    EntryMap entries;
+  };
+
+  static const int StripeCount = 64;
+  Stripe m_stripes[StripeCount];
+  Mutex m_writeBackMutex;
+
+  Stripe &getStripe(const string &key) {
+    return m_stripes[hash_string(key.data(), key.size()) % StripeCount];
+  }
+
+  /**
+   * Until when read() waits for a session another request holds.
+   */
+  static time_t LockDeadline() {
+    time_t now = time(NULL);
+    int64 timeout = PS(gc_maxlifetime);
+    RequestInjectionData &data =
+      ThreadInfo::s_threadInfo->m_reqInjectionData;
+    if (data.timeoutSeconds > 0 &&
+        data.started + data.timeoutSeconds - now < timeout) {
+      timeout = data.started + data.timeoutSeconds - now;
+    }
+    return now + (timeout > 0 ? timeout : 0);
+  }
+
+  /**
+   * Unlocks the session this thread's request has read, if any.
+   */
+  void release() {
+    if (s_locked_key->empty()) return;
+    Stripe &stripe = getStripe(*s_locked_key);
+    Lock lock(stripe.getMutex());
+    EntryMap::iterator iter = stripe.entries.find(*s_locked_key);
+    if (iter != stripe.entries.end()) {
+      iter->second.locked = false;
+      stripe.notifyAll();
+    }
+    s_locked_key->clear();
+  }
+
+  static string getFilePath(const string &key) {
+    if (PS(save_path).empty()) return "";
+    return PS(save_path) + PHP_DIR_SEPARATOR + "sess_" + key;
+  }
+
+  /**
+   * Reads a session file, unless it is older than gc_maxlifetime. Such a
+   * file is left over from before a restart, and no gc() would ever get to
+   * it, so it is removed instead.
+   */
+  static bool ReadFile(const string &path, string &data, time_t &mtime) {
+    if (path.empty()) return false;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+      ::close(fd);
+      return false;
+    }
+    mtime = sb.st_mtime;
+    if (time(NULL) - mtime > PS(gc_maxlifetime)) {
+      ::close(fd);
+      unlink(path.c_str());
+      return false;
+    }
+    char buf[8192];
+    int n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+      data.append(buf, n);
+    }
+    ::close(fd);
+    return n == 0;
+  }
+
+  static void WriteFile(const string &path, const string &data) {
+    string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    if (fd < 0) {
+      raise_warning("open(%s, O_WRONLY) failed: %s (%d)", tmp.c_str(),
+                    strerror(errno), errno);
+      return;
+    }
+    long n = ::write(fd, data.data(), data.size());
+    ::close(fd);
+    if (n != (long)data.size() || rename(tmp.c_str(), path.c_str()) < 0) {
+      raise_warning("write back of %s failed: %s (%d)", path.c_str(),
+                    strerror(errno), errno);
+      unlink(tmp.c_str());
+    }
+  }
+};
+static ShmSessionModule s_shm_session_module;
+
 ///////////////////////////////////////////////////////////////////////////////
 // UserSessionModule
 
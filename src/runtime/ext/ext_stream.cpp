@@ -27,6 +27,7 @@
 #include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #if defined(AF_UNIX)
 #include <sys/un.h>
 #endif
@@ -43,6 +44,21 @@ IMPLEMENT_OBJECT_ALLOCATION(StreamContext);
 Variant f_stream_copy_to_stream(CObjRef source, CObjRef dest,
                                 int maxlength /* = 0 */,
                                 int offset /* = 0 */) {
+  // between two regular files, kernel can copy without a round trip
+  PlainFile *src = source.getTyped<PlainFile>(true, true);
+  PlainFile *dst = dest.getTyped<PlainFile>(true, true);
+  struct stat sb;
+  if (src && dst && maxlength >= 0 && dst->valid() &&
+      fstat(dst->fd(), &sb) == 0 && S_ISREG(sb.st_mode) &&
+      (offset <= 0 || src->seek(offset, SEEK_SET))) {
+    dst->seek(dst->tell(), SEEK_SET); // same as File::write()
+    int64 sent = src->sendfile(dst->fd(), maxlength);
+    if (sent >= 0) {
+      dst->seek(sent, SEEK_CUR);
+      return sent;
+    }
+  }
+
   Variant ret = f_stream_get_contents(source, maxlength, offset);
   if (same(ret, false)) {
     return false;
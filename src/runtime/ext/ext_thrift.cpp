@@ -17,6 +17,7 @@
 
 #include <runtime/ext/ext_thrift.h>
 #include <runtime/ext/ext_class.h>
+#include <util/lock.h>
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -163,7 +164,7 @@ protected:
     t->o_invoke("flush", Array(), -1);
   }
   void directWrite(const char* data, size_t len) {
-    Array args = CREATE_VECTOR1(String(buffer, buffer_used, CopyString));
+    Array args = CREATE_VECTOR1(String(data, len, CopyString));
     t->o_invoke("write", args, -1);
   }
 };
@@ -217,6 +218,10 @@ public:
   }
 
   int8_t readI8() {
+    if (buffer_used) {
+      buffer_used--;
+      return *buffer_ptr++;
+    }
     int8_t c;
     readBytes(&c, 1);
     return c;
@@ -240,6 +245,29 @@ public:
     return (int32_t)ntohl(c);
   }
 
+  int64_t readI64() {
+    int64_t c;
+    readBytes(&c, 8);
+    return (int64_t)ntohll(c);
+  }
+
+  /**
+   * Strings that are already in the buffer are copied out in one go.
+   */
+  String readString(uint32_t size) {
+    if (size == 0) return "";
+    if (size <= buffer_used) {
+      String ret(buffer_ptr, size, CopyString);
+      buffer_ptr += size;
+      buffer_used -= size;
+      return ret;
+    }
+    char* strbuf = (char*) malloc(size + 1);
+    readBytes(strbuf, size);
+    strbuf[size] = '\0';
+    return String(strbuf, size, AttachString);
+  }
+
 protected:
   void refill() {
     ASSERT(buffer_used == 0);
@@ -252,11 +280,6 @@ protected:
 
 };
 
-void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport, CArrRef spec);
-void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport, CArrRef spec);
-void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport, CVarRef value, CArrRef fieldspec);
-void skip_element(long thrift_typeID, PHPInputTransport& transport);
-
 // Create a PHP object given a typename and call the ctor, optionally passing up to 2 arguments
 Object createObject(CStrRef obj_typename, int nargs = 0,
                     CVarRef arg1 = null_variant, CVarRef arg2 = null_variant) {
@@ -279,130 +302,730 @@ void throw_tprotocolexception(CStrRef what, long errorcode) {
   throw ex;
 }
 
-Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
-                           CArrRef fieldspec) {
-  Variant ret;
+///////////////////////////////////////////////////////////////////////////////
+// compiled _TSPEC
+
+inline bool ttype_is_int(int8_t t) {
+  return ((t == T_BYTE) || ((t >= T_I16)  && (t <= T_I64)));
+}
+
+inline bool ttype_is_string(int8_t t) {
+  return t == T_STRING || t == T_UTF8 || t == T_UTF16;
+}
+
+inline bool ttypes_are_compatible(int8_t t1, int8_t t2) {
+  // Integer types of different widths are considered compatible, and so are
+  // string encodings, since compact protocol has only one of them on wire;
+  // otherwise the typeID must match.
+  return ((t1 == t2) || (ttype_is_int(t1) && ttype_is_int(t2)) ||
+          (ttype_is_string(t1) && ttype_is_string(t2)));
+}
+
+/**
+ * What a field spec (or nested "key", "val" or "elem" spec) says, read out
+ * of its array once. A missing nested spec is a NULL pointer, which behaves
+ * like an empty array.
+ */
+struct ThriftType {
+  ThriftType() : type(T_STOP), hasClass(false), ktype(T_STOP), vtype(T_STOP),
+                 etype(T_STOP), key(NULL), val(NULL), elem(NULL) {}
+  ~ThriftType() {
+    delete key;
+    delete val;
+    delete elem;
+  }
+
+  int8_t type;
+  bool hasClass;
+  String className;
+  int8_t ktype;
+  int8_t vtype;
+  int8_t etype;
+  ThriftType *key;
+  ThriftType *val;
+  ThriftType *elem;
+
+  static const ThriftType &Get(const ThriftType *t) {
+    static const ThriftType s_empty;
+    return t ? *t : s_empty;
+  }
+
+  void compile(CArrRef spec) {
+    type = (int8_t)spec.rvalAt("type").toInt64();
+    Variant cls = spec.rvalAt("class");
+    hasClass = !cls.isNull();
+    if (hasClass) className = cls.toString();
+    ktype = (int8_t)spec.rvalAt("ktype").toInt64();
+    vtype = (int8_t)spec.rvalAt("vtype").toInt64();
+    etype = (int8_t)spec.rvalAt("etype").toInt64();
+    key = CompileNested(spec.rvalAt("key"));
+    val = CompileNested(spec.rvalAt("val"));
+    elem = CompileNested(spec.rvalAt("elem"));
+  }
+
+private:
+  ThriftType(const ThriftType &);
+  ThriftType &operator=(const ThriftType &);
+
+  static ThriftType *CompileNested(CVarRef spec) {
+    if (spec.isNull()) return NULL;
+    ThriftType *t = new ThriftType();
+    t->compile(spec.toArray());
+    return t;
+  }
+};
+
+struct ThriftField {
+  bool intKey;   // only integer keys are valid field numbers
+  bool hasSpec;  // non-null, so it can be deserialized into
+  int64 fieldno;
+  String name;
+  ThriftType type;
+};
+
+/**
+ * A struct's _TSPEC compiled into fields in spec order, for serialization,
+ * plus an index by field number, for deserialization.
+ */
+class ThriftStructSpec {
+public:
+  ThriftStructSpec(CArrRef spec) {
+    m_fields.reserve(spec.size());
+    for (ArrayIter iter(spec); !iter.end(); ++iter) {
+      Variant key = iter.first();
+      Variant value = iter.second();
+      ThriftField *field = new ThriftField();
+      field->intKey = key.isInteger();
+      field->hasSpec = !value.isNull();
+      field->fieldno = key.toInt64();
+      Array fieldspec = value.toArray();
+      field->name = fieldspec.rvalAt("var").toString();
+      field->type.compile(fieldspec);
+      m_fields.push_back(field);
+      if (field->intKey && field->hasSpec) {
+        m_byNumber[field->fieldno] = field;
+      }
+    }
+  }
+
+  ~ThriftStructSpec() {
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+      delete m_fields[i];
+    }
+  }
+
+  const std::vector<ThriftField*> &fields() const { return m_fields;}
+
+  const ThriftField *find(int16_t fieldno) const {
+    FieldMap::const_iterator iter = m_byNumber.find(fieldno);
+    return iter == m_byNumber.end() ? NULL : iter->second;
+  }
+
+private:
+  typedef hphp_hash_map<int64, ThriftField*, int64_hash> FieldMap;
+
+  std::vector<ThriftField*> m_fields;
+  FieldMap m_byNumber;
+
+  ThriftStructSpec(const ThriftStructSpec &);
+  ThriftStructSpec &operator=(const ThriftStructSpec &);
+};
+
+/**
+ * Looks up compiled specs for one read or write call, so every struct
+ * class's _TSPEC is fetched and compiled at most once per call, no matter
+ * how many instances a list or map holds.
+ *
+ * A _TSPEC that is a static array (a literal in compiled code) never
+ * changes or goes away, and everything in it is static, so its compiled
+ * form is shared by all threads and kept for the life of the process.
+ */
+class ThriftSpecs {
+public:
+  ~ThriftSpecs() {
+    for (unsigned int i = 0; i < m_owned.size(); i++) {
+      delete m_owned[i];
+    }
+  }
+
+  /**
+   * NULL if the class's _TSPEC isn't an array, with its type in kind.
+   */
+  const ThriftStructSpec *forClass(CStrRef className, DataType &kind) {
+    ClassMap::const_iterator iter = m_classes.find(className.data());
+    if (iter != m_classes.end()) {
+      kind = KindOfArray;
+      return iter->second;
+    }
+    Variant spec = get_static_property(className, "_TSPEC");
+    kind = spec.getType();
+    if (!spec.is(KindOfArray)) return NULL;
+    const ThriftStructSpec *ret = get(spec.toArray());
+    m_classes[className.data()] = ret;
+    return ret;
+  }
+
+  /**
+   * Same as above, except a _TSPEC that's not an array is treated as an
+   * empty one.
+   */
+  const ThriftStructSpec &forClass(CStrRef className) {
+    DataType kind;
+    const ThriftStructSpec *ret = forClass(className, kind);
+    if (ret) return *ret;
+    static const ThriftStructSpec s_empty((Array()));
+    return s_empty;
+  }
+
+private:
+  typedef hphp_hash_map<std::string, const ThriftStructSpec*, string_hash>
+    ClassMap;
+  typedef hphp_hash_map<const ArrayData*, ThriftStructSpec*,
+                        pointer_hash<ArrayData> > SpecMap;
+
+  ClassMap m_classes;
+  std::vector<ThriftStructSpec*> m_owned;
+
+  static ReadWriteMutex s_mutex;
+  static SpecMap s_specs;
+
+  const ThriftStructSpec *get(CArrRef spec) {
+    const ArrayData *data = spec.get();
+    if (!data->isStatic()) {
+      ThriftStructSpec *ret = new ThriftStructSpec(spec);
+      m_owned.push_back(ret);
+      return ret;
+    }
+    {
+      ReadLock lock(s_mutex);
+      SpecMap::const_iterator iter = s_specs.find(data);
+      if (iter != s_specs.end()) return iter->second;
+    }
+    ThriftStructSpec *ret = new ThriftStructSpec(spec);
+    WriteLock lock(s_mutex);
+    std::pair<SpecMap::iterator, bool> inserted =
+      s_specs.insert(SpecMap::value_type(data, ret));
+    if (!inserted.second) {
+      delete ret; // compiled by another thread in the meantime
+    }
+    return inserted.first->second;
+  }
+};
+
+ReadWriteMutex ThriftSpecs::s_mutex;
+ThriftSpecs::SpecMap ThriftSpecs::s_specs;
+
+///////////////////////////////////////////////////////////////////////////////
+// protocols
+
+/**
+ * TBinaryProtocol. Bytes and i16s are returned unsigned, as they always
+ * have been.
+ */
+class BinaryReader {
+public:
+  BinaryReader(PHPInputTransport &transport) : m_transport(transport) {}
+
+  void readStructBegin() {}
+  void readStructEnd() {}
+  bool readFieldBegin(int8_t &ttype, int16_t &fieldno) {
+    ttype = m_transport.readI8();
+    if (ttype == T_STOP) return false;
+    fieldno = m_transport.readI16();
+    return true;
+  }
+  void readMapBegin(int8_t &ktype, int8_t &vtype, uint32_t &size) {
+    ktype = m_transport.readI8();
+    vtype = m_transport.readI8();
+    size = m_transport.readU32();
+  }
+  void readListBegin(int8_t &etype, uint32_t &size) {
+    etype = m_transport.readI8();
+    size = m_transport.readU32();
+  }
+  bool readBool() { return m_transport.readI8() != 0;}
+  int64 readByte() { return (uint8_t)m_transport.readI8();}
+  int64 readI16() { return (uint16_t)m_transport.readI16();}
+  int64 readI32() { return m_transport.readI32();}
+  int64 readI64() { return m_transport.readI64();}
+  double readDouble() {
+    union {
+      int64_t c;
+      double d;
+    } a;
+    a.c = m_transport.readI64();
+    return a.d;
+  }
+  String readString() {
+    return m_transport.readString(m_transport.readU32());
+  }
+  void skipString() { m_transport.skip(m_transport.readU32());}
+
+  void skipFixed(int8_t ttype) {
+    switch (ttype) {
+      case T_BOOL:
+      case T_BYTE:   m_transport.skip(1); return;
+      case T_I16:    m_transport.skip(2); return;
+      case T_I32:    m_transport.skip(4); return;
+      default:       m_transport.skip(8); return;
+    }
+  }
+
+private:
+  PHPInputTransport &m_transport;
+};
+
+class BinaryWriter {
+public:
+  BinaryWriter(PHPOutputTransport &transport) : m_transport(transport) {}
+
+  void writeStructBegin() {}
+  void writeStructEnd() {}
+  void writeFieldBegin(int8_t ttype, int16_t fieldno) {
+    m_transport.writeI8(ttype);
+    m_transport.writeI16(fieldno);
+  }
+  void writeFieldStop() { m_transport.writeI8(T_STOP);}
+  void writeMapBegin(int8_t ktype, int8_t vtype, uint32_t size) {
+    m_transport.writeI8(ktype);
+    m_transport.writeI8(vtype);
+    m_transport.writeI32(size);
+  }
+  void writeListBegin(int8_t etype, uint32_t size) {
+    m_transport.writeI8(etype);
+    m_transport.writeI32(size);
+  }
+  void writeBool(bool v) { m_transport.writeI8(v ? 1 : 0);}
+  void writeByte(int8_t v) { m_transport.writeI8(v);}
+  void writeI16(int16_t v) { m_transport.writeI16(v);}
+  void writeI32(int32_t v) { m_transport.writeI32(v);}
+  void writeI64(int64_t v) { m_transport.writeI64(v);}
+  void writeDouble(double d) {
+    union {
+      int64_t c;
+      double d;
+    } a;
+    a.d = d;
+    m_transport.writeI64(a.c);
+  }
+  void writeString(CStrRef s) { m_transport.writeString(s, s.size());}
+
+private:
+  PHPOutputTransport &m_transport;
+};
+
+/**
+ * TCompactProtocol: field ids as deltas, integers as zigzag varints and
+ * booleans folded into field headers.
+ */
+enum CType {
+  C_STOP          = 0,
+  C_BOOLEAN_TRUE  = 1,
+  C_BOOLEAN_FALSE = 2,
+  C_BYTE          = 3,
+  C_I16           = 4,
+  C_I32           = 5,
+  C_I64           = 6,
+  C_DOUBLE        = 7,
+  C_BINARY        = 8,
+  C_LIST          = 9,
+  C_SET           = 10,
+  C_MAP           = 11,
+  C_STRUCT        = 12
+};
+
+const int8_t COMPACT_PROTOCOL_ID = (int8_t)0x82;
+const int8_t COMPACT_VERSION = 1;
+const int8_t COMPACT_VERSION_MASK = 0x1f;
+const int COMPACT_TYPE_SHIFT = 5;
+
+class CompactReader {
+public:
+  CompactReader(PHPInputTransport &transport)
+    : m_transport(transport), m_lastFieldId(0), m_boolValue(-1) {}
+
+  void readStructBegin() {
+    m_lastFieldIds.push_back(m_lastFieldId);
+    m_lastFieldId = 0;
+  }
+  void readStructEnd() {
+    m_lastFieldId = m_lastFieldIds.back();
+    m_lastFieldIds.pop_back();
+  }
+  bool readFieldBegin(int8_t &ttype, int16_t &fieldno) {
+    uint8_t header = m_transport.readI8();
+    int8_t ctype = header & 0x0f;
+    if (ctype == C_STOP) return false;
+    int16_t delta = header >> 4;
+    fieldno = delta ? m_lastFieldId + delta : (int16_t)readI16();
+    m_lastFieldId = fieldno;
+    if (ctype == C_BOOLEAN_TRUE || ctype == C_BOOLEAN_FALSE) {
+      m_boolValue = (ctype == C_BOOLEAN_TRUE);
+    }
+    ttype = toTType(ctype);
+    return true;
+  }
+  void readMapBegin(int8_t &ktype, int8_t &vtype, uint32_t &size) {
+    size = readVarint32();
+    uint8_t types = size ? m_transport.readI8() : 0;
+    ktype = size ? toTType(types >> 4) : T_STOP;
+    vtype = size ? toTType(types & 0x0f) : T_STOP;
+  }
+  void readListBegin(int8_t &etype, uint32_t &size) {
+    uint8_t header = m_transport.readI8();
+    size = header >> 4;
+    if (size == 15) size = readVarint32();
+    etype = toTType(header & 0x0f);
+  }
+  bool readBool() {
+    if (m_boolValue >= 0) {
+      bool ret = m_boolValue;
+      m_boolValue = -1;
+      return ret;
+    }
+    return m_transport.readI8() == C_BOOLEAN_TRUE;
+  }
+  int64 readByte() { return m_transport.readI8();}
+  int64 readI16() { return (int16_t)unzigzag(readVarint64());}
+  int64 readI32() { return (int32_t)unzigzag(readVarint64());}
+  int64 readI64() { return unzigzag(readVarint64());}
+  double readDouble() {
+    union {
+      uint64_t c;
+      double d;
+    } a;
+    m_transport.readBytes(&a.c, 8);
+    a.c = le64toh(a.c);
+    return a.d;
+  }
+  String readString() { return m_transport.readString(readVarint32());}
+  void skipString() { m_transport.skip(readVarint32());}
+
+  void skipFixed(int8_t ttype) {
+    switch (ttype) {
+      case T_BOOL:   readBool(); return;
+      case T_BYTE:   m_transport.skip(1); return;
+      case T_DOUBLE: m_transport.skip(8); return;
+      default:       readVarint64(); return;
+    }
+  }
+
+  uint32_t readVarint32() {
+    return (uint32_t)readVarint64();
+  }
+
+  uint64_t readVarint64() {
+    uint64_t ret = 0;
+    for (int shift = 0; shift < 70; shift += 7) {
+      uint8_t byte = m_transport.readI8();
+      ret |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return ret;
+    }
+    throw_tprotocolexception("Variable-length int over 10 bytes",
+                             INVALID_DATA);
+    return 0;
+  }
+
+private:
+  PHPInputTransport &m_transport;
+  int16_t m_lastFieldId;
+  std::vector<int16_t> m_lastFieldIds;
+  int m_boolValue; // of last bool field header, -1 if none
+
+  static int64 unzigzag(uint64_t n) {
+    return (int64)(n >> 1) ^ -(int64)(n & 1);
+  }
+
+  static int8_t toTType(int8_t ctype) {
+    switch (ctype) {
+      case C_STOP:          return T_STOP;
+      case C_BOOLEAN_TRUE:
+      case C_BOOLEAN_FALSE: return T_BOOL;
+      case C_BYTE:          return T_BYTE;
+      case C_I16:           return T_I16;
+      case C_I32:           return T_I32;
+      case C_I64:           return T_I64;
+      case C_DOUBLE:        return T_DOUBLE;
+      case C_BINARY:        return T_STRING;
+      case C_LIST:          return T_LIST;
+      case C_SET:           return T_SET;
+      case C_MAP:           return T_MAP;
+      case C_STRUCT:        return T_STRUCT;
+    }
+    char errbuf[128];
+    sprintf(errbuf, "Unknown compact type %d", ctype);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+    return T_STOP;
+  }
+};
+
+class CompactWriter {
+public:
+  CompactWriter(PHPOutputTransport &transport)
+    : m_transport(transport), m_lastFieldId(0), m_pendingBool(false),
+      m_boolFieldId(0) {}
+
+  void writeStructBegin() {
+    m_lastFieldIds.push_back(m_lastFieldId);
+    m_lastFieldId = 0;
+  }
+  void writeStructEnd() {
+    m_lastFieldId = m_lastFieldIds.back();
+    m_lastFieldIds.pop_back();
+  }
+  void writeFieldBegin(int8_t ttype, int16_t fieldno) {
+    if (ttype == T_BOOL) {
+      // header is written with the value
+      m_pendingBool = true;
+      m_boolFieldId = fieldno;
+    } else {
+      writeFieldHeader(toCType(ttype), fieldno);
+    }
+  }
+  void writeFieldStop() { m_transport.writeI8(C_STOP);}
+  void writeMapBegin(int8_t ktype, int8_t vtype, uint32_t size) {
+    writeVarint32(size);
+    if (size) m_transport.writeI8((toCType(ktype) << 4) | toCType(vtype));
+  }
+  void writeListBegin(int8_t etype, uint32_t size) {
+    if (size < 15) {
+      m_transport.writeI8((size << 4) | toCType(etype));
+    } else {
+      m_transport.writeI8(0xf0 | toCType(etype));
+      writeVarint32(size);
+    }
+  }
+  void writeBool(bool v) {
+    int8_t ctype = v ? C_BOOLEAN_TRUE : C_BOOLEAN_FALSE;
+    if (m_pendingBool) {
+      writeFieldHeader(ctype, m_boolFieldId);
+      m_pendingBool = false;
+    } else {
+      m_transport.writeI8(ctype);
+    }
+  }
+  void writeByte(int8_t v) { m_transport.writeI8(v);}
+  void writeI16(int16_t v) { writeVarint64(zigzag(v));}
+  void writeI32(int32_t v) { writeVarint64(zigzag(v));}
+  void writeI64(int64_t v) { writeVarint64(zigzag(v));}
+  void writeDouble(double d) {
+    union {
+      uint64_t c;
+      double d;
+    } a;
+    a.d = d;
+    a.c = htole64(a.c);
+    m_transport.write((const char *)&a.c, 8);
+  }
+  void writeString(CStrRef s) {
+    writeVarint32(s.size());
+    m_transport.write(s.data(), s.size());
+  }
+
+  void writeVarint32(uint32_t n) { writeVarint64(n);}
+
+  void writeVarint64(uint64_t n) {
+    char buf[10];
+    int len = 0;
+    while (n & ~(uint64_t)0x7f) {
+      buf[len++] = (char)((n & 0x7f) | 0x80);
+      n >>= 7;
+    }
+    buf[len++] = (char)n;
+    m_transport.write(buf, len);
+  }
+
+private:
+  PHPOutputTransport &m_transport;
+  int16_t m_lastFieldId;
+  std::vector<int16_t> m_lastFieldIds;
+  bool m_pendingBool; // a bool field's header waits for its value
+  int16_t m_boolFieldId;
+
+  void writeFieldHeader(int8_t ctype, int16_t fieldno) {
+    if (fieldno > m_lastFieldId && fieldno - m_lastFieldId <= 15) {
+      m_transport.writeI8(((fieldno - m_lastFieldId) << 4) | ctype);
+    } else {
+      m_transport.writeI8(ctype);
+      writeI16(fieldno);
+    }
+    m_lastFieldId = fieldno;
+  }
+
+  static uint64_t zigzag(int64_t n) {
+    return (uint64_t)(n << 1) ^ (uint64_t)(n >> 63);
+  }
+
+  static int8_t toCType(int8_t ttype) {
+    switch (ttype) {
+      case T_STOP:   return C_STOP;
+      case T_BOOL:   return C_BOOLEAN_TRUE;
+      case T_BYTE:   return C_BYTE;
+      case T_I16:    return C_I16;
+      case T_I32:    return C_I32;
+      case T_U64:
+      case T_I64:    return C_I64;
+      case T_DOUBLE: return C_DOUBLE;
+      case T_UTF8:
+      case T_UTF16:
+      case T_STRING: return C_BINARY;
+      case T_LIST:   return C_LIST;
+      case T_SET:    return C_SET;
+      case T_MAP:    return C_MAP;
+      case T_STRUCT: return C_STRUCT;
+    }
+    char errbuf[128];
+    sprintf(errbuf, "Unknown thrift typeID %d", ttype);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+    return C_STOP;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// deserialization
+
+template<class Reader>
+void skip_element(int8_t thrift_typeID, Reader &reader) {
+  switch (thrift_typeID) {
+    case T_STOP:
+    case T_VOID:
+      return;
+    case T_STRUCT: {
+      int8_t ttype;
+      int16_t fieldno;
+      reader.readStructBegin();
+      while (reader.readFieldBegin(ttype, fieldno)) {
+        skip_element(ttype, reader);
+      }
+      reader.readStructEnd();
+    } return;
+    case T_BOOL:
+    case T_BYTE:
+    case T_I16:
+    case T_I32:
+    case T_U64:
+    case T_I64:
+    case T_DOUBLE:
+      reader.skipFixed(thrift_typeID);
+      return;
+    //case T_UTF7: // aliases T_STRING
+    case T_UTF8:
+    case T_UTF16:
+    case T_STRING:
+      reader.skipString();
+      return;
+    case T_MAP: {
+      int8_t keytype, valtype;
+      uint32_t size;
+      reader.readMapBegin(keytype, valtype, size);
+      for (uint32_t i = 0; i < size; ++i) {
+        skip_element(keytype, reader);
+        skip_element(valtype, reader);
+      }
+    } return;
+    case T_LIST:
+    case T_SET: {
+      int8_t valtype;
+      uint32_t size;
+      reader.readListBegin(valtype, size);
+      for (uint32_t i = 0; i < size; ++i) {
+        skip_element(valtype, reader);
+      }
+    } return;
+  };
+
+  char errbuf[128];
+  sprintf(errbuf, "Unknown thrift typeID %d", thrift_typeID);
+  throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+}
+
+template<class Reader>
+void deserialize_struct(CObjRef zthis, Reader &reader,
+                        const ThriftStructSpec &spec, ThriftSpecs &specs);
+
+template<class Reader>
+Variant deserialize(int8_t thrift_typeID, Reader &reader,
+                    const ThriftType &fieldspec, ThriftSpecs &specs) {
   switch (thrift_typeID) {
     case T_STOP:
     case T_VOID:
       return null;
     case T_STRUCT: {
-      Variant val;
-      if ((val = fieldspec.rvalAt("class")).isNull()) {
+      if (!fieldspec.hasClass) {
         throw_tprotocolexception("no class type in spec", INVALID_DATA);
-        skip_element(T_STRUCT, transport);
+        skip_element(T_STRUCT, reader);
         return null;
       }
-      String structType = val.toString();
-      ret = createObject(structType);
+      Object ret = createObject(fieldspec.className);
       if (ret.isNull()) {
         // unable to create class entry
-        skip_element(T_STRUCT, transport);
+        skip_element(T_STRUCT, reader);
         return null;
       }
-      Variant spec = get_static_property(structType, "_TSPEC");
-      if (!spec.is(KindOfArray)) {
+      DataType kind;
+      const ThriftStructSpec *spec = specs.forClass(fieldspec.className, kind);
+      if (!spec) {
         char errbuf[128];
         snprintf(errbuf, 128, "spec for %s is wrong type: %d\n",
-                 structType.data(), ret.getType());
+                 fieldspec.className.data(), kind);
         throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
         return null;
       }
-      binary_deserialize_spec(ret, transport, spec.toArray());
+      deserialize_struct(ret, reader, *spec, specs);
       return ret;
-    } break;
-    case T_BOOL: {
-      uint8_t c;
-      transport.readBytes(&c, 1);
-      return c != 0;
     }
+    case T_BOOL:
+      return reader.readBool();
   //case T_I08: // same numeric value as T_BYTE
-    case T_BYTE: {
-      uint8_t c;
-      transport.readBytes(&c, 1);
-      return c;
-    }
-    case T_I16: {
-      uint16_t c;
-      transport.readBytes(&c, 2);
-      return ntohs(c);
-    }
-    case T_I32: {
-      uint32_t c;
-      transport.readBytes(&c, 4);
-      return Variant((int)ntohl(c));
-    }
+    case T_BYTE:
+      return reader.readByte();
+    case T_I16:
+      return reader.readI16();
+    case T_I32:
+      return reader.readI32();
     case T_U64:
-    case T_I64: {
-      uint64_t c;
-      transport.readBytes(&c, 8);
-      return Variant((int64)ntohll(c));
-    }
-    case T_DOUBLE: {
-      union {
-        uint64_t c;
-        double d;
-      } a;
-      transport.readBytes(&(a.c), 8);
-      a.c = ntohll(a.c);
-      return a.d;
-    }
+    case T_I64:
+      return reader.readI64();
+    case T_DOUBLE:
+      return reader.readDouble();
     //case T_UTF7: // aliases T_STRING
     case T_UTF8:
     case T_UTF16:
-    case T_STRING: {
-      uint32_t size = transport.readU32();
-      if (size && (size + 1)) {
-        char* strbuf = (char*) malloc(size + 1);
-        transport.readBytes(strbuf, size);
-        strbuf[size] = '\0';
-        return String(strbuf, size, AttachString);
-      } else {
-        return "";
-      }
-    }
+    case T_STRING:
+      return reader.readString();
     case T_MAP: { // array of key -> value
-      uint8_t types[2];
-      transport.readBytes(types, 2);
-      uint32_t size = transport.readU32();
-
-      Array keyspec = fieldspec.rvalAt("key", -1).toArray();
-      Array valspec = fieldspec.rvalAt("val", -1).toArray();
-      ret = Array::Create();
-
+      int8_t keytype, valtype;
+      uint32_t size;
+      reader.readMapBegin(keytype, valtype, size);
+      const ThriftType &keyspec = ThriftType::Get(fieldspec.key);
+      const ThriftType &valspec = ThriftType::Get(fieldspec.val);
+      Array ret = Array::Create();
       for (uint32_t s = 0; s < size; ++s) {
-        Variant key = binary_deserialize(types[0], transport, keyspec);
-        Variant value = binary_deserialize(types[1], transport, valspec);
+        Variant key = deserialize(keytype, reader, keyspec, specs);
+        Variant value = deserialize(valtype, reader, valspec, specs);
         ret.set(key, value);
       }
-      return ret; // return_value already populated
+      return ret;
     }
     case T_LIST: { // array with autogenerated numeric keys
-      int8_t type = transport.readI8();
-      uint32_t size = transport.readU32();
-      Variant elemvar = fieldspec.rvalAt("elem", -1);
-      Array elemspec = elemvar.toArray();
-      ret = Array::Create();
-
+      int8_t type;
+      uint32_t size;
+      reader.readListBegin(type, size);
+      const ThriftType &elemspec = ThriftType::Get(fieldspec.elem);
+      Array ret = Array::Create();
       for (uint32_t s = 0; s < size; ++s) {
-        Variant value = binary_deserialize(type, transport, elemspec);
-        ret.append(value);
+        ret.append(deserialize(type, reader, elemspec, specs));
       }
       return ret;
     }
     case T_SET: { // array of key -> TRUE
-      uint8_t type;
+      int8_t type;
       uint32_t size;
-      transport.readBytes(&type, 1);
-      transport.readBytes(&size, 4);
-      size = ntohl(size);
-      Variant elemvar = fieldspec.rvalAt("elem", -1);
-      Array elemspec = elemvar.toArray();
-      ret = Array::Create();
-
+      reader.readListBegin(type, size);
+      const ThriftType &elemspec = ThriftType::Get(fieldspec.elem);
+      Array ret = Array::Create();
       for (uint32_t s = 0; s < size; ++s) {
-        Variant key = binary_deserialize(type, transport, elemspec);
-
+        Variant key = deserialize(type, reader, elemspec, specs);
         if (key.isInteger()) {
           ret.set(key, true);
         } else {
@@ -419,121 +1042,47 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
   return null;
 }
 
-void skip_element(long thrift_typeID, PHPInputTransport& transport) {
-  switch (thrift_typeID) {
-    case T_STOP:
-    case T_VOID:
-      return;
-    case T_STRUCT:
-      while (true) {
-        int8_t ttype = transport.readI8(); // get field type
-        if (ttype == T_STOP) break;
-        transport.skip(2); // skip field number, I16
-        skip_element(ttype, transport); // skip field payload
-      }
-      return;
-    case T_BOOL:
-    case T_BYTE:
-      transport.skip(1);
-      return;
-    case T_I16:
-      transport.skip(2);
-      return;
-    case T_I32:
-      transport.skip(4);
-      return;
-    case T_U64:
-    case T_I64:
-    case T_DOUBLE:
-      transport.skip(8);
-      return;
-    //case T_UTF7: // aliases T_STRING
-    case T_UTF8:
-    case T_UTF16:
-    case T_STRING: {
-      uint32_t len = transport.readU32();
-      transport.skip(len);
-      } return;
-    case T_MAP: {
-      int8_t keytype = transport.readI8();
-      int8_t valtype = transport.readI8();
-      uint32_t size = transport.readU32();
-      for (uint32_t i = 0; i < size; ++i) {
-        skip_element(keytype, transport);
-        skip_element(valtype, transport);
-      }
-    } return;
-    case T_LIST:
-    case T_SET: {
-      int8_t valtype = transport.readI8();
-      uint32_t size = transport.readU32();
-      for (uint32_t i = 0; i < size; ++i) {
-        skip_element(valtype, transport);
-      }
-    } return;
-  };
-
-  char errbuf[128];
-  sprintf(errbuf, "Unknown thrift typeID %ld", thrift_typeID);
-  throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
-}
-
-void binary_serialize_hashtable_key(int8_t keytype, PHPOutputTransport& transport,
-                                    Variant key) {
-  bool keytype_is_numeric = (!((keytype == T_STRING) || (keytype == T_UTF8) ||
-                               (keytype == T_UTF16)));
-
-  if (keytype_is_numeric) {
-    key = key.toInt64();
-  } else {
-    key = key.toString();
+template<class Reader>
+void deserialize_struct(CObjRef zthis, Reader &reader,
+                        const ThriftStructSpec &spec, ThriftSpecs &specs) {
+  int8_t ttype;
+  int16_t fieldno;
+  reader.readStructBegin();
+  while (reader.readFieldBegin(ttype, fieldno)) {
+    const ThriftField *field = spec.find(fieldno);
+    if (field && ttypes_are_compatible(ttype, field->type.type)) {
+      zthis->set(field->name, deserialize(ttype, reader, field->type, specs));
+    } else {
+      skip_element(ttype, reader);
+    }
   }
-  binary_serialize(keytype, transport, key, Array());
+  reader.readStructEnd();
 }
 
-inline bool ttype_is_int(int8_t t) {
-  return ((t == T_BYTE) || ((t >= T_I16)  && (t <= T_I64)));
-}
+///////////////////////////////////////////////////////////////////////////////
+// serialization
 
-inline bool ttypes_are_compatible(int8_t t1, int8_t t2) {
-  // Integer types of different widths are considered compatible;
-  // otherwise the typeID must match.
-  return ((t1 == t2) || (ttype_is_int(t1) && ttype_is_int(t2)));
-}
+template<class Writer>
+void serialize_struct(CObjRef zthis, Writer &writer,
+                      const ThriftStructSpec &spec, ThriftSpecs &specs);
 
-void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
-                             CArrRef spec) {
-  // SET and LIST have 'elem' => array('type', [optional] 'class')
-  // MAP has 'val' => array('type', [optiona] 'class')
-  while (true) {
-    Variant val;
-
-    int8_t ttype = transport.readI8();
-    if (ttype == T_STOP) return;
-    int16_t fieldno = transport.readI16();
-    if (!(val = spec.rvalAt(fieldno)).isNull()) {
-      Array fieldspec = val.toArray();
-      // pull the field name
-      // zend hash tables use the null at the end in the length... so strlen(hash key) + 1.
-      String varname = fieldspec.rvalAt("var").toString();
-
-      // and the type
-      int8_t expected_ttype = fieldspec.rvalAt("type").toInt64();
-
-      if (ttypes_are_compatible(ttype, expected_ttype)) {
-        Variant rv = binary_deserialize(ttype, transport, fieldspec);
-        zthis->set(varname, rv);
-      } else {
-        skip_element(ttype, transport);
-      }
-    } else {
-      skip_element(ttype, transport);
-    }
+template<class Writer>
+void serialize(int8_t thrift_typeID, Writer &writer, CVarRef value,
+               const ThriftType &fieldspec, ThriftSpecs &specs);
+
+template<class Writer>
+void serialize_hashtable_key(int8_t keytype, Writer &writer, CVarRef key,
+                             ThriftSpecs &specs) {
+  if (ttype_is_string(keytype)) {
+    serialize(keytype, writer, key.toString(), ThriftType::Get(NULL), specs);
+  } else {
+    serialize(keytype, writer, key.toInt64(), ThriftType::Get(NULL), specs);
   }
 }
 
-void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
-                      CVarRef value, CArrRef fieldspec) {
+template<class Writer>
+void serialize(int8_t thrift_typeID, Writer &writer, CVarRef value,
+               const ThriftType &fieldspec, ThriftSpecs &specs) {
   // At this point the typeID (and field num, if applicable) should've already
   // been written to the output so all we need to do is write the payload.
   switch (thrift_typeID) {
@@ -545,78 +1094,57 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
         throw_tprotocolexception("Attempt to send non-object "
                                  "type as a T_STRUCT", INVALID_DATA);
       }
-      binary_serialize_spec(value, transport,
-                            get_static_property(toObject(value)->
-                                                o_getClassName(),
-                                                "_TSPEC").toArray());
+      Object obj = value.toObject();
+      serialize_struct(obj, writer, specs.forClass(obj->o_getClassName()),
+                       specs);
     } return;
     case T_BOOL:
-      transport.writeI8(value.toBoolean() ? 1 : 0);
+      writer.writeBool(value.toBoolean());
       return;
     case T_BYTE:
-      transport.writeI8(value.toByte());
+      writer.writeByte(value.toByte());
       return;
     case T_I16:
-      transport.writeI16(value.toInt16());
+      writer.writeI16(value.toInt16());
       return;
     case T_I32:
-      transport.writeI32(value.toInt32());
+      writer.writeI32(value.toInt32());
       return;
     case T_I64:
     case T_U64:
-      transport.writeI64(value.toInt64());
+      writer.writeI64(value.toInt64());
+      return;
+    case T_DOUBLE:
+      writer.writeDouble(value.toDouble());
       return;
-    case T_DOUBLE: {
-      union {
-        int64_t c;
-        double d;
-      } a;
-      a.d = value.toDouble();
-      transport.writeI64(a.c);
-    } return;
     //case T_UTF7:
     case T_UTF8:
     case T_UTF16:
-    case T_STRING: {
-        String sv = value.toString();
-        transport.writeString(sv, sv.size());
-    } return;
+    case T_STRING:
+      writer.writeString(value.toString());
+      return;
     case T_MAP: {
       Array ht = value.toArray();
-      uint8_t keytype = fieldspec.rvalAt("ktype", -1).toByte();
-      transport.writeI8(keytype);
-      uint8_t valtype = fieldspec.rvalAt("vtype", -1).toByte();
-      transport.writeI8(valtype);
-
-      Array valspec = fieldspec.rvalAt("val", -1).toArray();
-
-      transport.writeI32(ht.size());
-      for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
-        binary_serialize_hashtable_key(keytype, transport, key_ptr.first());
-        binary_serialize(valtype, transport, key_ptr.second(), valspec);
+      const ThriftType &valspec = ThriftType::Get(fieldspec.val);
+      writer.writeMapBegin(fieldspec.ktype, fieldspec.vtype, ht.size());
+      for (ArrayIter iter(ht); !iter.end(); ++iter) {
+        serialize_hashtable_key(fieldspec.ktype, writer, iter.first(), specs);
+        serialize(fieldspec.vtype, writer, iter.second(), valspec, specs);
       }
     } return;
     case T_LIST: {
       Array ht = value.toArray();
-      Variant val;
-
-      uint8_t valtype = fieldspec.rvalAt("etype", -1).toInt64();
-      transport.writeI8(valtype);
-      Array valspec = fieldspec.rvalAt("elem", -1).toArray();
-      transport.writeI32(ht.size());
-      for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
-        binary_serialize(valtype, transport, key_ptr.second(), valspec);
+      const ThriftType &elemspec = ThriftType::Get(fieldspec.elem);
+      writer.writeListBegin(fieldspec.etype, ht.size());
+      for (ArrayIter iter(ht); !iter.end(); ++iter) {
+        serialize(fieldspec.etype, writer, iter.second(), elemspec, specs);
       }
     } return;
     case T_SET: {
       Array ht = value.toArray();
-
-      uint8_t keytype = fieldspec.rvalAt("etype", -1).toByte();
-      transport.writeI8(keytype);
-
-      transport.writeI32(ht.size());
-      for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
-        binary_serialize_hashtable_key(keytype, transport, key_ptr.first());
+      writer.writeListBegin(fieldspec.etype, ht.size());
+      for (ArrayIter iter(ht); !iter.end(); ++iter) {
+        serialize_hashtable_key(fieldspec.etype, writer, iter.first(), specs);
       }
     } return;
   };
@@ -625,34 +1153,30 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
   throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
 }
 
-
-void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport,
-                           CArrRef spec) {
-  for (ArrayIter key_ptr = spec.begin(); !key_ptr.end(); ++key_ptr) {
-    Variant key = key_ptr.first();
-    if (!key.isInteger()) {
-      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')", INVALID_DATA);
+template<class Writer>
+void serialize_struct(CObjRef zthis, Writer &writer,
+                      const ThriftStructSpec &spec, ThriftSpecs &specs) {
+  const std::vector<ThriftField*> &fields = spec.fields();
+  writer.writeStructBegin();
+  for (unsigned int i = 0; i < fields.size(); i++) {
+    const ThriftField *field = fields[i];
+    if (!field->intKey) {
+      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')",
+                               INVALID_DATA);
       return;
     }
-    ulong fieldno = key.toInt64();
-    Array fieldspec = key_ptr.second().toArray();
-
-    // field name
-    String varname = fieldspec.rvalAt("var", -1).toString();
-
-    // thrift type
-    int8_t ttype = fieldspec.rvalAt("type", -1).toByte();
-
-    Variant prop = zthis->o_get(varname, -1);
+    Variant prop = zthis->o_get(field->name, -1);
     if (!prop.isNull()) {
-      transport.writeI8(ttype);
-      transport.writeI16(fieldno);
-      binary_serialize(ttype, transport, prop, fieldspec);
+      writer.writeFieldBegin(field->type.type, field->fieldno);
+      serialize(field->type.type, writer, prop, field->type, specs);
     }
   }
-  transport.writeI8(T_STOP); // struct end
+  writer.writeFieldStop(); // struct end
+  writer.writeStructEnd();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
 void f_thrift_protocol_write_binary(CObjRef transportobj, CStrRef method_name,
                                     int64 msgtype, CObjRef request_struct,
                                     int seqid, bool strict_write) {
@@ -670,9 +1194,10 @@ void f_thrift_protocol_write_binary(CObjRef transportobj, CStrRef method_name,
     transport.writeI32(seqid);
   }
 
-  Variant spec = get_static_property(request_struct->o_getClassName(),
-                                     "_TSPEC");
-  binary_serialize_spec(request_struct, transport, spec.toArray());
+  ThriftSpecs specs;
+  BinaryWriter writer(transport);
+  serialize_struct(request_struct, writer,
+                   specs.forClass(request_struct->o_getClassName()), specs);
 }
 
 Variant f_thrift_protocol_read_binary(CObjRef transportobj,
@@ -703,16 +1228,65 @@ Variant f_thrift_protocol_read_binary(CObjRef transportobj,
     }
   }
 
+  ThriftSpecs specs;
+  BinaryReader reader(transport);
+  if (messageType == T_EXCEPTION) {
+    Object ex = createObject("TApplicationException");
+    deserialize_struct(ex, reader, specs.forClass("TApplicationException"),
+                       specs);
+    throw ex;
+  }
+
+  Object ret_val = createObject(obj_typename);
+  deserialize_struct(ret_val, reader, specs.forClass(obj_typename), specs);
+  return ret_val;
+}
+
+void f_thrift_protocol_write_compact(CObjRef transportobj,
+                                     CStrRef method_name,
+                                     int64 msgtype, CObjRef request_struct,
+                                     int seqid) {
+  PHPOutputTransport transport(transportobj);
+  CompactWriter writer(transport);
+
+  transport.writeI8(COMPACT_PROTOCOL_ID);
+  transport.writeI8((COMPACT_VERSION & COMPACT_VERSION_MASK) |
+                    (msgtype << COMPACT_TYPE_SHIFT));
+  writer.writeVarint32(seqid);
+  writer.writeString(method_name);
+
+  ThriftSpecs specs;
+  serialize_struct(request_struct, writer,
+                   specs.forClass(request_struct->o_getClassName()), specs);
+}
+
+Variant f_thrift_protocol_read_compact(CObjRef transportobj,
+                                       CStrRef obj_typename) {
+  PHPInputTransport transport(transportobj);
+  CompactReader reader(transport);
+
+  if (transport.readI8() != COMPACT_PROTOCOL_ID) {
+    throw_tprotocolexception("Bad protocol identifier", BAD_VERSION);
+  }
+  uint8_t versionAndType = transport.readI8();
+  if ((versionAndType & COMPACT_VERSION_MASK) != COMPACT_VERSION) {
+    throw_tprotocolexception("Bad version identifier", BAD_VERSION);
+  }
+  int8_t messageType = versionAndType >> COMPACT_TYPE_SHIFT;
+  // skip the sequence ID and the name string, we don't care about those
+  reader.readVarint32();
+  reader.skipString();
+
+  ThriftSpecs specs;
   if (messageType == T_EXCEPTION) {
     Object ex = createObject("TApplicationException");
-    Variant spec = get_static_property("TApplicationException", "_TSPEC");
-    binary_deserialize_spec(ex, transport, spec.toArray());
+    deserialize_struct(ex, reader, specs.forClass("TApplicationException"),
+                       specs);
     throw ex;
   }
 
   Object ret_val = createObject(obj_typename);
-  Variant spec = get_static_property(obj_typename, "_TSPEC");
-  binary_deserialize_spec(ret_val, transport, spec.toArray());
+  deserialize_struct(ret_val, reader, specs.forClass(obj_typename), specs);
   return ret_val;
 }
 
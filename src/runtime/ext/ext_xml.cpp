@@ -18,6 +18,7 @@
 #include <runtime/ext/ext_xml.h>
 #include <runtime/base/zend/zend_functions.h>
 #include <runtime/base/zend/zend_string.h>
+#include <runtime/base/string_util.h>
 #include <expat.h>
 
 namespace HPHP {
@@ -875,6 +876,11 @@ String f_xml_error_string(int code) {
 ///////////////////////////////////////////////////////////////////////////////
 
 String f_utf8_decode(CStrRef data) {
+  // well-formed Latin-1 text goes through the word-at-a-time converter, and
+  // only the rest needs the lenient loop below with its '?' substitutions
+  String converted = StringUtil::ConvertCharset(data, "ISO-8859-1", "UTF-8");
+  if (!converted.isNull()) return converted;
+
   char *newbuf = (char*)malloc(data.size() + 1);
   int newlen = 0;
   const char *s = data.data();
@@ -916,29 +922,7 @@ String f_utf8_decode(CStrRef data) {
 }
 
 String f_utf8_encode(CStrRef data) {
-  char *newbuf = (char*)malloc(data.size() * 4 + 1);
-  int newlen = 0;
-  const char *s = data.data();
-  for (int pos = data.size(); pos > 0; pos--, s++) {
-    unsigned int c = (unsigned char)(*s);
-    if (c < 0x80) {
-      newbuf[newlen++] = (char) c;
-    } else if (c < 0x800) {
-      newbuf[newlen++] = (0xc0 | (c >> 6));
-      newbuf[newlen++] = (0x80 | (c & 0x3f));
-    } else if (c < 0x10000) {
-      newbuf[newlen++] = (0xe0 | (c >> 12));
-      newbuf[newlen++] = (0xc0 | ((c >> 6) & 0x3f));
-      newbuf[newlen++] = (0x80 | (c & 0x3f));
-    } else if (c < 0x200000) {
-      newbuf[newlen++] = (0xf0 | (c >> 18));
-      newbuf[newlen++] = (0xe0 | ((c >> 12) & 0x3f));
-      newbuf[newlen++] = (0xc0 | ((c >> 6) & 0x3f));
-      newbuf[newlen++] = (0x80 | (c & 0x3f));
-    }
-  }
-  newbuf[newlen] = '\0';
-  return String(newbuf, newlen, AttachString);
+  return StringUtil::ConvertCharset(data, "UTF-8", "ISO-8859-1");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -145,6 +145,21 @@ inline Variant x_evhttp_recv(CObjRef handle) {
   return f_evhttp_recv(handle);
 }
 
+inline Variant x_evhttp_task_start(CStrRef url, CArrRef headers = null_array, int timeout = 5, CStrRef post_data = null_string) {
+  FUNCTION_INJECTION_BUILTIN(evhttp_task_start);
+  return f_evhttp_task_start(url, headers, timeout, post_data);
+}
+
+inline bool x_evhttp_task_status(CObjRef task) {
+  FUNCTION_INJECTION_BUILTIN(evhttp_task_status);
+  return f_evhttp_task_status(task);
+}
+
+inline Variant x_evhttp_task_result(CObjRef task) {
+  FUNCTION_INJECTION_BUILTIN(evhttp_task_result);
+  return f_evhttp_task_result(task);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 }
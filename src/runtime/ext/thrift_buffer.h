@@ -177,12 +177,14 @@ public:
   void read(String &data) {
     int32 size;
     read(size);
-    if (size > 0 && ++size > 0) {
-      char *buf = (char*)malloc(size);
+    if (size > 0) {
+      char *buf = (char*)malloc((size_t)size + 1);
       if (!buf) throwOutOfMemory();
       read(buf, size);
       buf[size] = '\0';
       data = String(buf, size, AttachString);
+    } else if (size == 0) {
+      data = String("", 0, AttachLiteral);
     } else {
       throwInvalidStringSize(size);
     }
@@ -12567,6 +12567,39 @@ Variant i_fb_call_user_func_array_safe(CArrRef params) {
   if (count != 2) return throw_wrong_arguments("fb_call_user_func_array_safe", count, 2, 2, 1);
   return (f_fb_call_user_func_array_safe(params[0], params[1]));
 }
+Variant i_evhttp_task_start(CArrRef params) {
+  FUNCTION_INJECTION(evhttp_task_start);
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 4) return throw_wrong_arguments("evhttp_task_start", count, 1, 4, 1);
+  if (count <= 1) return (f_evhttp_task_start(params[0]));
+  if (count == 2) return (f_evhttp_task_start(params[0], params[1]));
+  if (count == 3) return (f_evhttp_task_start(params[0], params[1], params[2]));
+  return (f_evhttp_task_start(params[0], params[1], params[2], params[3]));
+}
+Variant i_evhttp_task_status(CArrRef params) {
+  FUNCTION_INJECTION(evhttp_task_status);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 1) return throw_wrong_arguments("evhttp_task_status", count, 1, 1, 1);
+  return (f_evhttp_task_status(params[0]));
+}
+Variant i_evhttp_task_result(CArrRef params) {
+  FUNCTION_INJECTION(evhttp_task_result);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 1) return throw_wrong_arguments("evhttp_task_result", count, 1, 1, 1);
+  return (f_evhttp_task_result(params[0]));
+}
+Variant i_thrift_protocol_write_compact(CArrRef params) {
+  FUNCTION_INJECTION(thrift_protocol_write_compact);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 5) return throw_wrong_arguments("thrift_protocol_write_compact", count, 5, 5, 1);
+  return (f_thrift_protocol_write_compact(params[0], params[1], params[2], params[3], params[4]), null);
+}
+Variant i_thrift_protocol_read_compact(CArrRef params) {
+  FUNCTION_INJECTION(thrift_protocol_read_compact);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 2) return throw_wrong_arguments("thrift_protocol_read_compact", count, 2, 2, 1);
+  return (f_thrift_protocol_read_compact(params[0], params[1]));
+}
 Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
   if (hash < 0) hash = hash_string_i(s);
   switch (hash & 4095) {
@@ -14638,6 +14671,7 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       HASH_INVOKE(0x798B4197212456B5LL, bcpowmod);
       HASH_INVOKE(0x623CE67C41A9E6B5LL, ldap_next_attribute);
       HASH_INVOKE(0x7E773A36449576B5LL, imagecharup);
+      HASH_INVOKE(0x3B81B5A6BE3ED6B5LL, thrift_protocol_write_compact);
       break;
     case 1721:
       HASH_INVOKE(0x316F054CB76446B9LL, openssl_sign);
@@ -15660,6 +15694,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
     case 2564:
       HASH_INVOKE(0x17B83C425BD09A04LL, atanh);
       break;
+    case 2566:
+      HASH_INVOKE(0x0B76282C3D493A06LL, evhttp_task_status);
+      break;
     case 2567:
       HASH_INVOKE(0x391E0A4CF1EC9A07LL, stream_socket_recvfrom);
       break;
@@ -16943,6 +16980,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
     case 3549:
       HASH_INVOKE(0x3B00B916C3682DDDLL, ctype_upper);
       break;
+    case 3553:
+      HASH_INVOKE(0x04AB2709A2EABDE1LL, evhttp_task_result);
+      break;
     case 3560:
       HASH_INVOKE(0x47A4BA8616D02DE8LL, restore_exception_handler);
       break;
@@ -17054,6 +17094,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
     case 3654:
       HASH_INVOKE(0x7F4C1DF551150E46LL, pixelgetnextiteratorrow);
       break;
+    case 3655:
+      HASH_INVOKE(0x7DD8BA86A4574E47LL, evhttp_task_start);
+      break;
     case 3660:
       HASH_INVOKE(0x1EEBDFD62B6BEE4CLL, mcrypt_module_get_algo_block_size);
       break;
@@ -17605,6 +17648,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       HASH_INVOKE(0x7F5FC3CAF8CE9FDELL, gzcompress);
       HASH_INVOKE(0x72925D2DF7E61FDELL, drawpathcurvetoquadraticbeziersmoothrelative);
       break;
+    case 4069:
+      HASH_INVOKE(0x43BA2CB702E68FE5LL, thrift_protocol_read_compact);
+      break;
     case 4071:
       HASH_INVOKE(0x217067889854CFE7LL, xmlwriter_start_dtd);
       break;
@@ -57625,6 +57671,121 @@ Variant ei_fb_call_user_func_array_safe(Eval::VariableEnvironment &env, const Ev
   }
   return (x_fb_call_user_func_array_safe(a0, a1));
 }
+Variant ei_evhttp_task_start(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  Variant a2;
+  Variant a3;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 4) return throw_wrong_arguments("evhttp_task_start", count, 1, 4, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a2 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a3 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 1) return (x_evhttp_task_start(a0));
+  else if (count == 2) return (x_evhttp_task_start(a0, a1));
+  else if (count == 3) return (x_evhttp_task_start(a0, a1, a2));
+  else return (x_evhttp_task_start(a0, a1, a2, a3));
+}
+Variant ei_evhttp_task_status(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 1) return throw_wrong_arguments("evhttp_task_status", count, 1, 1, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_evhttp_task_status(a0));
+}
+Variant ei_evhttp_task_result(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 1) return throw_wrong_arguments("evhttp_task_result", count, 1, 1, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_evhttp_task_result(a0));
+}
+Variant ei_thrift_protocol_write_compact(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  Variant a2;
+  Variant a3;
+  Variant a4;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 5) return throw_wrong_arguments("thrift_protocol_write_compact", count, 5, 5, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a2 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a3 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a4 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_thrift_protocol_write_compact(a0, a1, a2, a3, a4), null);
+}
+Variant ei_thrift_protocol_read_compact(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 2) return throw_wrong_arguments("thrift_protocol_read_compact", count, 2, 2, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_thrift_protocol_read_compact(a0, a1));
+}
 Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller, int64 hash, bool fatal) {
   if (hash < 0) hash = hash_string_i(s);
   switch (hash & 4095) {
@@ -59696,6 +59857,7 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       HASH_INVOKE_FROM_EVAL(0x798B4197212456B5LL, bcpowmod);
       HASH_INVOKE_FROM_EVAL(0x623CE67C41A9E6B5LL, ldap_next_attribute);
       HASH_INVOKE_FROM_EVAL(0x7E773A36449576B5LL, imagecharup);
+      HASH_INVOKE_FROM_EVAL(0x3B81B5A6BE3ED6B5LL, thrift_protocol_write_compact);
       break;
     case 1721:
       HASH_INVOKE_FROM_EVAL(0x316F054CB76446B9LL, openssl_sign);
@@ -60718,6 +60880,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
     case 2564:
       HASH_INVOKE_FROM_EVAL(0x17B83C425BD09A04LL, atanh);
       break;
+    case 2566:
+      HASH_INVOKE_FROM_EVAL(0x0B76282C3D493A06LL, evhttp_task_status);
+      break;
     case 2567:
       HASH_INVOKE_FROM_EVAL(0x391E0A4CF1EC9A07LL, stream_socket_recvfrom);
       break;
@@ -62001,6 +62166,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
     case 3549:
       HASH_INVOKE_FROM_EVAL(0x3B00B916C3682DDDLL, ctype_upper);
       break;
+    case 3553:
+      HASH_INVOKE_FROM_EVAL(0x04AB2709A2EABDE1LL, evhttp_task_result);
+      break;
     case 3560:
       HASH_INVOKE_FROM_EVAL(0x47A4BA8616D02DE8LL, restore_exception_handler);
       break;
@@ -62112,6 +62280,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
     case 3654:
       HASH_INVOKE_FROM_EVAL(0x7F4C1DF551150E46LL, pixelgetnextiteratorrow);
       break;
+    case 3655:
+      HASH_INVOKE_FROM_EVAL(0x7DD8BA86A4574E47LL, evhttp_task_start);
+      break;
     case 3660:
       HASH_INVOKE_FROM_EVAL(0x1EEBDFD62B6BEE4CLL, mcrypt_module_get_algo_block_size);
       break;
@@ -62663,6 +62834,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       HASH_INVOKE_FROM_EVAL(0x7F5FC3CAF8CE9FDELL, gzcompress);
       HASH_INVOKE_FROM_EVAL(0x72925D2DF7E61FDELL, drawpathcurvetoquadraticbeziersmoothrelative);
       break;
+    case 4069:
+      HASH_INVOKE_FROM_EVAL(0x43BA2CB702E68FE5LL, thrift_protocol_read_compact);
+      break;
     case 4071:
       HASH_INVOKE_FROM_EVAL(0x217067889854CFE7LL, xmlwriter_start_dtd);
       break;
@@ -19,6 +19,7 @@
 #include <compiler/builtin_symbols.h>
 #include <compiler/code_generator.h>
 #include <compiler/analysis/analysis_result.h>
+#include <compiler/analysis/alias_manager.h>
 #include <util/util.h>
 #include <util/process.h>
 #include <compiler/option.h>
@@ -463,6 +464,9 @@ bool TestCodeRun::RunTests(const std::string &which) {
   RUN_TEST(TestConstructor);
   RUN_TEST(TestTernary);
   RUN_TEST(TestUselessAssignment);
+  RUN_TEST(TestGlobalOptimizations);
+  RUN_TEST(TestFunctionInlining);
+  RUN_TEST(TestReturnLocals);
   RUN_TEST(TestTypes);
   RUN_TEST(TestSwitchStatement);
   RUN_TEST(TestExtString);
@@ -8659,6 +8663,40 @@ bool TestCodeRun::TestJson() {
        "$obj = new A();"
        "$obj->aaaa();");
 
+  // large enough to be streamed out in several chunks
+  MVCR("<?php "
+       "$a = array('x' => str_repeat('a', 70000),"
+       "           'y' => array(1, 2.5, true, null, 'q\\\"'),"
+       "           'z' => str_repeat('b', 70000));"
+       "echo json_encode(array(1, 'a\\\"b')), serialize(array(1)), \"\\n\";"
+       "ob_start();"
+       "echo json_encode($a);"
+       "$s = ob_get_clean();"
+       "var_dump(md5($s), $s === json_encode($a));"
+       "ob_start();"
+       "echo serialize($a);"
+       "$s = ob_get_clean();"
+       "var_dump(md5($s), $s === serialize($a));");
+
+  // __sleep() echoing and switching output buffers halfway
+  MVCR("<?php "
+       "class S {"
+       "  public $v = 1;"
+       "  function __sleep() {"
+       "    echo 'sleep;';"
+       "    ob_start();"
+       "    echo 'dropped';"
+       "    ob_end_clean();"
+       "    return array('v');"
+       "  }"
+       "}"
+       "$a = array('x' => str_repeat('a', 70000), 's' => new S(),"
+       "           'z' => str_repeat('b', 70000));"
+       "ob_start();"
+       "echo serialize($a);"
+       "$s = ob_get_clean();"
+       "var_dump(strlen($s), substr($s, 0, 6), md5($s));");
+
 #if 0
   MVCR("<?php "
       "$a = array(1);"
@@ -9027,6 +9065,125 @@ bool TestCodeRun::TestThrift() {
       "  var_dump(thrift_protocol_read_binary($p, 'TestStruct', true));"
       "}"
       "test();");
+
+  VCRO("<?php "
+       "class DummyTransport {"
+       "  public $buff = '';"
+       "  public $pos = 0;"
+       "  function flush() { }"
+       "  function write($buff) {"
+       "    $this->buff .= $buff;"
+       "  }"
+       "  function read($n) {"
+       "    $r = substr($this->buff, $this->pos, $n);"
+       "    $this->pos += $n;"
+       "    return $r;"
+       "  }"
+       "}"
+       "class DummyProtocol {"
+       "  public $t;"
+       "  function __construct() {"
+       "    $this->t = new DummyTransport();"
+       "  }"
+       "  function getTransport() {"
+       "    return $this->t;"
+       "  }"
+       "}"
+       "class Point {"
+       "  static $_TSPEC = array(1 => array('var' => 'x', 'type' => 8),"
+       "                         2 => array('var' => 'y', 'type' => 8));"
+       "  public $x = null;"
+       "  public $y = null;"
+       "  public function __construct($x = null, $y = null) {"
+       "    $this->x = $x;"
+       "    $this->y = $y;"
+       "  }"
+       "}"
+       "class Shape {"
+       "  static $_TSPEC;"
+       "  public $name = null;"
+       "  public $closed = null;"
+       "  public $origin = null;"
+       "  public $points = null;"
+       "  public $area = null;"
+       "  public $scale = null;"
+       "  public function __construct() {"
+       "    if (!isset(self::$_TSPEC)) {"
+       "      self::$_TSPEC = array("
+       "        1 => array('var' => 'name', 'type' => 11),"
+       "        2 => array('var' => 'closed', 'type' => 2),"
+       "        3 => array('var' => 'origin', 'type' => 12,"
+       "                   'class' => 'Point'),"
+       "        4 => array('var' => 'points', 'type' => 15, 'etype' => 12,"
+       "                   'elem' => array('type' => 12,"
+       "                                   'class' => 'Point')),"
+       "        17 => array('var' => 'area', 'type' => 10),"
+       "        40 => array('var' => 'scale', 'type' => 4));"
+       "    }"
+       "  }"
+       "}"
+       "$p = new DummyProtocol();"
+       "$s = new Shape();"
+       "$s->name = 'ab';"
+       "$s->closed = false;"
+       "$s->origin = new Point(-1, 2);"
+       "$s->points = array(new Point(3, 4), new Point(300, -300));"
+       "$s->area = -8589934592;"
+       "$s->scale = 1.5;"
+       "thrift_protocol_write_compact($p, 'm', 1, $s, 5);"
+       "echo bin2hex($p->getTransport()->buff), \"\\n\";"
+       "$r = thrift_protocol_read_compact($p, 'Shape');"
+       "echo $r->name, ',', var_export($r->closed, true), ',',"
+       "     $r->origin->x, ',', $r->origin->y, ',', count($r->points), ',',"
+       "     $r->points[1]->x, ',', $r->points[1]->y, ',', $r->area, ',',"
+       "     $r->scale, \"\\n\";",
+
+       "822105016d18026162121c1501150400192c1506150800"
+       "15d80415d70400d6ffffffff3f0750000000000000f83f00\n"
+       "ab,false,-1,2,2,300,-300,-8589934592,1.5\n");
+
+  // bool fields with negative ids still get their field headers
+  VCRO("<?php "
+       "class DummyTransport {"
+       "  public $buff = '';"
+       "  public $pos = 0;"
+       "  function flush() { }"
+       "  function write($buff) {"
+       "    $this->buff .= $buff;"
+       "  }"
+       "  function read($n) {"
+       "    $r = substr($this->buff, $this->pos, $n);"
+       "    $this->pos += $n;"
+       "    return $r;"
+       "  }"
+       "}"
+       "class DummyProtocol {"
+       "  public $t;"
+       "  function __construct() {"
+       "    $this->t = new DummyTransport();"
+       "  }"
+       "  function getTransport() {"
+       "    return $this->t;"
+       "  }"
+       "}"
+       "class Flags {"
+       "  static $_TSPEC = array(-1 => array('var' => 'on', 'type' => 2),"
+       "                         -2 => array('var' => 'off', 'type' => 2));"
+       "  public $on = null;"
+       "  public $off = null;"
+       "}"
+       "$p = new DummyProtocol();"
+       "$f = new Flags();"
+       "$f->on = true;"
+       "$f->off = false;"
+       "thrift_protocol_write_compact($p, 'm', 1, $f, 5);"
+       "echo bin2hex($p->getTransport()->buff), \"\\n\";"
+       "$r = thrift_protocol_read_compact($p, 'Flags');"
+       "echo var_export($r->on, true), ',',"
+       "     var_export($r->off, true), \"\\n\";",
+
+       "822105016d0101020300\n"
+       "true,false\n");
   return true;
 }
 
@@ -10884,6 +11041,237 @@ bool TestCodeRun::TestUselessAssignment() {
   return true;
 }
 
+bool TestCodeRun::TestGlobalOptimizations() {
+  bool saveGlobalOpts = AliasManager::doGlobalOpts();
+  AliasManager::setGlobalOpts(true);
+
+  MVCR("<?php "
+      "function f($a) {"
+      "  $x = 1;"
+      "  if ($a) {"
+      "    $y = 2;"
+      "  } else {"
+      "    $y = 2;"
+      "  }"
+      "  echo $x + $y, \"\\n\";"
+      "  $z = 'a';"
+      "  if ($a) $z = 'b';"
+      "  echo $z, \"\\n\";"
+      "}"
+      "f(0);"
+      "f(1);");
+
+  MVCR("<?php "
+      "function g($n) {"
+      "  $s = 0;"
+      "  $k = 5;"
+      "  for ($i = 0; $i < $n; $i++) {"
+      "    $s += $k;"
+      "    $k = 7;"
+      "  }"
+      "  echo $s, \"\\n\";"
+      "  $t = 1;"
+      "  while ($n-- > 0) {"
+      "    echo $t;"
+      "    $t = 2;"
+      "  }"
+      "  echo \"\\n\";"
+      "  $u = 1;"
+      "  do {"
+      "    $v = $u;"
+      "    $u = 3;"
+      "  } while ($v == 1);"
+      "  echo $v, \"\\n\";"
+      "}"
+      "g(3);");
+
+  MVCR("<?php "
+      "function h($v) {"
+      "  $r = 'none';"
+      "  switch ($v) {"
+      "  case 1:"
+      "    $r = 'one';"
+      "  case 2:"
+      "    $r .= 'two';"
+      "    break;"
+      "  default:"
+      "    $r = 'other';"
+      "  }"
+      "  echo $r, \"\\n\";"
+      "  $last = 'x';"
+      "  foreach (array(1, 2, 3) as $k => $x) {"
+      "    if ($x == $v) continue;"
+      "    $last = $k;"
+      "  }"
+      "  echo $last, \"\\n\";"
+      "  for ($i = 0; $i < 3; $i++) {"
+      "    $w = 'in';"
+      "    while (true) {"
+      "      if ($i == $v) break 2;"
+      "      $w = 'out';"
+      "      break;"
+      "    }"
+      "  }"
+      "  echo $w, \"\\n\";"
+      "}"
+      "h(1);"
+      "h(2);"
+      "h(3);");
+
+  MVCR("<?php "
+      "function t($a) {"
+      "  $x = 'before';"
+      "  try {"
+      "    $x = 'inside';"
+      "    if ($a) throw new Exception('e');"
+      "    $x = 'done';"
+      "  } catch (Exception $e) {"
+      "    echo $x, \"\\n\";"
+      "    $x = 'caught';"
+      "  }"
+      "  echo $x, \"\\n\";"
+      "}"
+      "t(0);"
+      "t(1);");
+
+  MVCR("<?php "
+      "class A {"
+      "  function __destruct() { echo \"destroyed\\n\"; }"
+      "}"
+      "function d($a) {"
+      "  $x = 10;"
+      "  $x = 20;"
+      "  if ($a) {"
+      "    $y = 1;"
+      "  }"
+      "  $unused = 3;"
+      "  echo $x, \"\\n\";"
+      "  var_dump(isset($y));"
+      "  $b = 1;"
+      "  $c = &$b;"
+      "  $c = 2;"
+      "  echo $b, \"\\n\";"
+      "  $o = new A();"
+      "  echo \"end\\n\";"
+      "}"
+      "d(0);"
+      "d(1);");
+
+  AliasManager::setGlobalOpts(saveGlobalOpts);
+  return true;
+}
+
+bool TestCodeRun::TestFunctionInlining() {
+  int saveThreshold = Option::PHPInlineThreshold;
+  Option::PHPInlineThreshold = 20;
+
+  MVCR("<?php "
+      "function sq($x) { return $x * $x; }"
+      "function add($a, $b = 10) { return $a + $b; }"
+      "function first($a) { return $a[0]; }"
+      "function wrap($s) { return '[' . $s . ']'; }"
+      "function neg($b) { return !$b; }"
+      "function pair($a, $b) { return array($a, $b); }"
+      "define('TEN', 10);"
+      "function f($n) {"
+      "  $arr = array(3, 4);"
+      "  var_dump(sq(3) + 1);"
+      "  var_dump(2 * add(1, 2));"
+      "  var_dump(add(TEN));"
+      "  var_dump(add($n));"
+      "  var_dump(first($arr));"
+      "  var_dump(wrap('x') . wrap($n));"
+      "  var_dump(neg(0), neg($n));"
+      "  var_dump(pair(1, 'a'));"
+      "  var_dump(sq($n));"
+      "  var_dump(sq($n + 1));"
+      "}"
+      "f(5);"
+      "f('7');");
+
+  MVCR("<?php "
+      "function twice(&$x) { return $x * 2; }"
+      "function &refret($x) { return $x; }"
+      "function hinted(array $a) { return $a[0]; }"
+      "function varargs() { return func_num_args(); }"
+      "function line() { return __FUNCTION__ . __LINE__; }"
+      "function counter($x) { static $n = 0; $n++; return $x + $n; }"
+      "function rec($n) { return $n <= 1 ? 1 : $n * rec($n - 1); }"
+      "$v = 3;"
+      "var_dump(twice($v));"
+      "var_dump(refret(4));"
+      "var_dump(hinted(array(5)));"
+      "var_dump(varargs(1, 2, 3));"
+      "var_dump(line());"
+      "var_dump(counter(1), counter(1));"
+      "var_dump(rec(5));");
+
+  MVCR("<?php "
+      "function get($a, $k) { return $a[$k]; }"
+      "function bt($x) { return $x + 1; }"
+      "function h() {"
+      "  $a = array('k' => 'v');"
+      "  var_dump(get($a, 'k'));"
+      "  var_dump(get($a, 'missing'));"
+      "  var_dump(bt($undefined));"
+      "}"
+      "h();");
+
+  // reading an undefined variable raises a notice, so variable arguments
+  // are only inlined when the body reads them once each, in call order
+  MVCR("<?php "
+      "function rev($a, $b) { return $b . $a; }"
+      "function both($a, $b) { return $a && $b; }"
+      "function pick($c, $a, $b) { return $c ? $a : $b; }"
+      "function inorder($a, $b) { return $a . $b; }"
+      "function k() {"
+      "  $x = 'x'; $y = 'y';"
+      "  var_dump(rev($x, $y));"
+      "  var_dump(rev('x', $y));"
+      "  var_dump(both($x, $y));"
+      "  var_dump(both(0, $u1));"
+      "  var_dump(pick(1, $x, $u2));"
+      "  var_dump(pick(0, $u3, $y));"
+      "  var_dump(inorder($x, $y));"
+      "}"
+      "k();");
+
+  Option::PHPInlineThreshold = saveThreshold;
+  return true;
+}
+
+bool TestCodeRun::TestReturnLocals() {
+  MVCR("<?php "
+      "function s($n) { $s = str_repeat('a', $n); return $s; }"
+      "function a($n) { $a = array(); $a[] = $n; return $a; }"
+      "function v($n) { $v = $n ? 'x' : array(1); return $v; }"
+      "class C { public $p = 1; }"
+      "function o() { $o = new C(); $o->p = 2; return $o; }"
+      "function p($x) { $x .= 'b'; return $x; }"
+      "var_dump(s(3), a(1), v(0), v(1), o(), p('a'));");
+
+  MVCR("<?php "
+      "function r(&$x) { $x = 'changed'; return $x; }"
+      "function b() { $x = 1; $y = &$x; $y = 2; return $x; }"
+      "function c() { $x = array(1); $y = &$x; $r = $x; $y[] = 2; return $r; }"
+      "function f() { static $n = 0; $n++; return $n; }"
+      "function g() { global $gv; $gv = 'g'; return $gv; }"
+      "$v = 'orig';"
+      "var_dump(r($v), $v, b(), c(), f(), f(), g(), $gv);");
+
+  MVCR("<?php "
+      "class A { public $v = 'p'; }"
+      "function keep($o) { $a = $o->v; $o->v = 'q'; return $a; }"
+      "function loop() {"
+      "  $s = '';"
+      "  foreach (array(1, 2, 3) as $i) { $s .= $i; if ($i == 2) return $s; }"
+      "  return 'none';"
+      "}"
+      "$o = new A();"
+      "var_dump(keep($o), $o->v, loop());");
+  return true;
+}
+
 bool TestCodeRun::TestTypes() {
   MVCR("<?php "
       "function foo($m, $n) {"
@@ -155,6 +155,9 @@ class TestCodeRun : public TestBase {
   bool TestDirectory();
   bool TestFile();
   bool TestUselessAssignment();
+  bool TestGlobalOptimizations();
+  bool TestFunctionInlining();
+  bool TestReturnLocals();
   bool TestExtString();
   bool TestExtArray();
   bool TestExtFile();
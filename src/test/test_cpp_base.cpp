@@ -26,6 +26,8 @@
 #include <runtime/base/shared/shared_store.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/ip_block_map.h>
+#include <runtime/base/array/typed_vector.h>
+#include <runtime/base/rtti_info.h>
 #include <test/test_mysql_info.inc>
 
 using namespace std;
@@ -49,6 +51,7 @@ bool TestCppBase::RunTests(const std::string &which) {
   RUN_TEST(TestMemoryManager);
 #endif
   RUN_TEST(TestIpBlockMap);
+  RUN_TEST(TestRTTIMetaData);
   return ret;
 }
 
@@ -213,6 +216,25 @@ bool TestCppBase::TestString() {
     VS((const char *)s, "tez q");
   }
 
+  // hash codes cached for array lookups
+  {
+    String s = String("ke") + "y";
+    VERIFY(s->hash() == hash_string("key", 3));
+    VERIFY(s->hash() == hash_string("key", 3));
+    Array arr;
+    arr.set(s, 1);
+    VERIFY(arr.exists(s));
+    s += "2";
+    VERIFY(s->hash() == hash_string("key2", 4));
+    VERIFY(!arr.exists(s));
+    arr.set(s, 2);
+    VS(arr[s], 2);
+    s.lvalAt(3) = "3";
+    VERIFY(s->hash() == hash_string("key3", 4));
+    VERIFY(!arr.exists(s));
+    VS(arr[String("key2")], 2);
+  }
+
   return Count(true);
 }
 
@@ -622,6 +644,114 @@ bool TestCppBase::TestArray() {
     VERIFY(!arr->isVectorData());
   }
 
+  // growing through incremental rehashing
+  {
+    Array arr = Array::Create();
+    for (int i = 0; i < 20000; i++) {
+      arr.set(i * 7, i);
+      arr.set(String("k") + String(i), i);
+      if (i % 1000 == 999) {
+        for (int j = 0; j <= i; j += 37) {
+          VS(arr[j * 7], j);
+          VS(arr[String("k") + String(j)], j);
+        }
+        VERIFY(!arr.exists(i * 7 + 1));
+      }
+    }
+    VS(arr.size(), 40000);
+    arr.remove(7);
+    arr.remove("k1");
+    VERIFY(!arr.exists(7));
+    VERIFY(!arr.exists("k1"));
+    VS(arr[14], 2);
+    VS(arr.size(), 39998);
+  }
+
+  // dequeue() renumbers keys
+  {
+    Array arr = Array::Create();
+    for (int i = 0; i < 10000; i++) {
+      arr.append(i);
+    }
+    for (int i = 0; i < 9990; i++) {
+      VS(arr.dequeue(), i);
+    }
+    arr.append(10000);
+    VS(arr.size(), 11);
+    VS(arr[0], 9990);
+    VS(arr[10], 10000);
+    VERIFY(!arr.exists(11));
+    VERIFY(arr->isVectorData());
+    arr.set("a", "b");
+    VS(arr.dequeue(), 9990);
+    VS(arr[0], 9991);
+    VS(arr[9], 10000);
+    VS(arr["a"], "b");
+    VERIFY(!arr->isVectorData());
+    arr.remove("a");
+    VS(arr.pop(), 10000);
+    VERIFY(arr->isVectorData());
+    Array copy = arr;
+    copy.append(1);
+    VS(copy[9], 1);
+    VS(arr.size(), 9);
+  }
+
+  // typed vectors
+  {
+    Array arr;
+    for (int i = 0; i < 10; i++) {
+      arr.append(i * 10);
+    }
+    Variant v = f_unserialize(f_serialize(arr));
+    Array ints = v.toArray();
+    VERIFY(dynamic_cast<TypedVector *>(ints.get()));
+    VS(ints, arr);
+    ints.append(100);
+    ints.set(0, -1);
+    VERIFY(dynamic_cast<TypedVector *>(ints.get()));
+    VS(ints.size(), 11);
+    VS(ints[0], -1);
+    VS(ints[10], 100);
+    VS(ints.pop(), 100);
+    VS(ints.dequeue(), -1);
+    VS(ints[0], 10);
+    ints.set(1, "twenty");
+    VERIFY(!dynamic_cast<TypedVector *>(ints.get()));
+    VS(ints[1], "twenty");
+    VS(ints[8], 90);
+    ints.append(100);
+    VS(ints[9], 100);
+
+    arr.set(3, "thirty");
+    v = f_unserialize(f_serialize(arr));
+    VERIFY(!dynamic_cast<TypedVector *>(v.getArrayData()));
+    VS(v, arr);
+
+    v = f_unserialize("a:1:{i:0;a:8:{i:0;s:1:\"a\";i:1;s:1:\"b\";"
+                      "i:2;s:1:\"c\";i:3;s:1:\"d\";i:4;s:1:\"e\";"
+                      "i:5;s:1:\"f\";i:6;s:1:\"g\";i:7;s:1:\"h\";}}");
+    Array strings = v[0].toArray();
+    VERIFY(dynamic_cast<TypedVector *>(strings.get()));
+    VS(strings[7], "h");
+    Array copy = strings;
+    copy.set(7, "z");
+    VS(copy[7], "z");
+    VS(strings[7], "h");
+    Variant &elem = copy.lvalAt(0);
+    elem = 1.5;
+    VERIFY(!dynamic_cast<TypedVector *>(copy.get()));
+    VS(copy[0], 1.5);
+    VS(strings[0], "a");
+
+    // they can only escalate to ZendArray
+    arr.set(3, 30);
+    RuntimeOption::UseZendArray = false;
+    v = f_unserialize(f_serialize(arr));
+    RuntimeOption::UseZendArray = true;
+    VERIFY(!dynamic_cast<TypedVector *>(v.getArrayData()));
+  }
+
   return Count(true);
 }
 
@@ -849,10 +979,17 @@ public:
     m_string = a + "orange"; // so mallocing m_data internally
 
     m_array = CREATE_MAP2("a", "apple", "b", "orange");
+
+    Array ints;
+    for (int i = 0; i < 10; i++) {
+      ints.append(i * 10);
+    }
+    m_vector = f_unserialize(f_serialize(ints)).toArray();
   }
 
   Variant m_string;
   Array m_array;
+  Array m_vector;
   Variant m_string2;
   Array m_array2;
   Variant m_conn;
@@ -876,6 +1013,7 @@ bool TestCppBase::TestMemoryManager() {
   globals->m_string2 = f_apc_fetch("key2");
   globals->m_conn = f_mysql_connect(TEST_HOSTNAME, TEST_DATABASE,
                                     TEST_PASSWORD, false, 0);
+  VERIFY(dynamic_cast<TypedVector *>(globals->m_vector.get()));
   MemoryManager::TheMemoryManager()->checkpoint();
   globals->m_curlconn = f_curl_init("http://localhost:8080/request");
   f_curl_setopt(globals->m_curlconn, CURLOPT_WRITEFUNCTION,
@@ -943,6 +1081,14 @@ bool TestCppBase::TestMemoryManager() {
     VS(globals->m_array["a"], "pear");
     VS(globals->m_array["c"], "banana");
 
+    // restored typed vectors copy their elements out before writing them
+    globals->m_vector.set(1, -1);
+    globals->m_vector.dequeue();
+    globals->m_vector.append(100);
+    globals->m_vector.prepend(-2);
+    VS(globals->m_vector.size(), 11);
+    VS(globals->m_vector[1], -1);
+
     globals->m_conn = null;
     MemoryManager::TheMemoryManager()->rollback();
     VS(globals->m_array2["0"], "value");
@@ -955,6 +1101,11 @@ bool TestCppBase::TestMemoryManager() {
     VS(globals->m_array["a"], "apple");
     VERIFY(!globals->m_array.exists("c"));
 
+    VS(globals->m_vector.size(), 10);
+    VS(globals->m_vector[0], 0);
+    VS(globals->m_vector[1], 10);
+    VS(globals->m_vector[9], 90);
+
   }
   DELETE(TestGlobals)(globals);
   return Count(true);
@@ -993,3 +1144,45 @@ bool TestCppBase::TestIpBlockMap() {
 
   return Count(true);
 }
+
+static void write_rtti_meta(const char *filename, const char *content) {
+  FILE *f = fopen(filename, "w");
+  fputs(content, f);
+  fclose(f);
+}
+
+bool TestCppBase::TestRTTIMetaData() {
+  const char *filename = "test/test_rtti.tmp";
+  string header = string(RTTIInfo::MetaDataVersion) + "\n";
+
+  {
+    write_rtti_meta(filename, (header + "2\nfoo::a\nfoo::b\nfoo\n").c_str());
+    RTTIInfo info;
+    VERIFY(info.loadMetaData(filename));
+    VS(info.getCount(), 2);
+    VERIFY(info.exists("foo"));
+    VERIFY(!info.exists("foo::a"));
+  }
+  {
+    // old format: no version line, so the count would be misread
+    write_rtti_meta(filename, "1\nfoo\n");
+    RTTIInfo info;
+    VERIFY(!info.loadMetaData(filename));
+    VS(info.getCount(), 0);
+    VERIFY(!info.exists("foo"));
+  }
+  {
+    write_rtti_meta(filename, "hphp-rtti-meta 1\n1\nfoo::a\nfoo\n");
+    RTTIInfo info;
+    VERIFY(!info.loadMetaData(filename));
+  }
+  {
+    write_rtti_meta(filename, (header + "3\nfoo::a\n").c_str());
+    RTTIInfo info;
+    VERIFY(!info.loadMetaData(filename));
+    VS(info.getCount(), 0);
+  }
+
+  unlink(filename);
+  return Count(true);
+}
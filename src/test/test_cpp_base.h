@@ -41,6 +41,7 @@ class TestCppBase : public TestBase {
   bool TestSmartAllocator();
   bool TestMemoryManager();
   bool TestIpBlockMap();
+  bool TestRTTIMetaData();
 
   /**
    * Date types. This in turn tests StringData, ArrayData, StringOffset,
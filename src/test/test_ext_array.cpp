@@ -17,6 +17,7 @@
 #include <test/test_ext_array.h>
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_array.h>
+#include <runtime/base/runtime_option.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -243,6 +244,18 @@ bool TestExtArray::test_array_filter() {
      "    [e] => 5\n"
      ")\n");
 
+  {
+    Array entry = CREATE_MAP5("a", "0", "b", "", 3, "x", "c", 0, 4, "00");
+    Array serial = f_array_filter(entry, "intval");
+    RuntimeOption::ParallelArrayThreads = 4;
+    RuntimeOption::ParallelArrayMinSize = 2;
+    VS(f_array_filter(entry, "intval"), serial);
+    VS(f_array_filter(entry, "strtolower"), CREATE_MAP2(3, "x", 4, "00"));
+    RuntimeOption::ParallelArrayThreads = 0;
+    RuntimeOption::ParallelArrayMinSize = 10000;
+    VS(serial, Array::Create());
+  }
+
   VS(f_print_r(f_array_filter(array2, "even"), true),
      "Array\n"
      "(\n"
@@ -337,6 +350,27 @@ bool TestExtArray::test_array_map() {
      "    [4] => 125\n"
      ")\n");
 
+  {
+    Array m = CREATE_MAP5("x", "Foo", 3, 12, "y", "", 7, "bAr", "z", null);
+    Array serial = f_array_map(2, "strtoupper", m);
+    Array lengths = f_array_map(2, "strlen", m);
+    RuntimeOption::ParallelArrayThreads = 4;
+    RuntimeOption::ParallelArrayMinSize = 2;
+    VS(f_array_map(2, "strtoupper", m), serial);
+    VS(f_array_map(2, "STRLEN", m), lengths);
+    RuntimeOption::ParallelArrayThreads = 0;
+    RuntimeOption::ParallelArrayMinSize = 10000;
+    VS(f_print_r(serial, true),
+       "Array\n"
+       "(\n"
+       "    [x] => FOO\n"
+       "    [3] => 12\n"
+       "    [y] => \n"
+       "    [7] => BAR\n"
+       "    [z] => \n"
+       ")\n");
+  }
+
   return Count(true);
 }
 
@@ -951,6 +985,10 @@ bool TestExtArray::test_array_unique() {
        "    [2] => 3\n"
        ")\n");
   }
+  {
+    Array input = CREATE_VECTOR6(1, 1.0, "1", "01", true, "");
+    VS(f_array_unique(input), CREATE_MAP3(0, 1, 3, "01", 5, ""));
+  }
   return Count(true);
 }
 
@@ -1331,6 +1369,13 @@ bool TestExtArray::test_array_diff() {
   Array b = CREATE_VECTOR2("b", "c");
   VS(f_array_diff(2, b, a), CREATE_MAP1(1, "c"));
 
+  // values are equal when their strings are
+  Array c = CREATE_VECTOR6(1, "2", 3.0, "04", true, null);
+  Array d = CREATE_VECTOR4("1", 2, "3", 4);
+  VS(f_array_diff(2, c, d), CREATE_MAP2(3, "04", 5, null));
+  VS(f_array_diff(2, c, CREATE_VECTOR1("")), CREATE_VECTOR5(1, "2", 3.0, "04",
+                                                            true));
+
   return Count(true);
 }
 
@@ -1458,6 +1503,10 @@ bool TestExtArray::test_array_intersect() {
                                    set(2, "red").create());
   VS(f_array_intersect(2, array1, array2),
      CREATE_MAP2("a", "green", "0", "red"));
+
+  Array a = CREATE_VECTOR4(1, "2", 3.5, String("a\0b", 3, AttachLiteral));
+  Array b = CREATE_VECTOR4("1", 2, "3.5", String("a\0c", 3, AttachLiteral));
+  VS(f_array_intersect(2, a, b), CREATE_VECTOR3(1, "2", 3.5));
   return Count(true);
 }
 
@@ -1562,6 +1611,35 @@ bool TestExtArray::test_sort() {
      "    [2] => lemon\n"
      "    [3] => orange\n"
      ")\n");
+
+  {
+    // integers, long enough to be radix sorted
+    Variant a = f_range(200, -99, 1);
+    Variant copy = a;
+    f_sort(ref(a));
+    VS(a, f_range(-99, 200, 1));
+    VS(copy, f_range(200, -99, 1));
+    f_rsort(ref(a));
+    VS(a, copy);
+  }
+  {
+    Variant a = CREATE_VECTOR4(1.5, -2.25, 1e10, 0.5);
+    f_sort(ref(a));
+    VS(a, CREATE_VECTOR4(-2.25, 0.5, 1.5, 1e10));
+  }
+  {
+    // numeric strings compare as numbers
+    Variant a = CREATE_VECTOR3("10", "9", "8.5");
+    f_sort(ref(a));
+    VS(a, CREATE_VECTOR3("8.5", "9", "10"));
+    f_sort(ref(a), k_SORT_STRING);
+    VS(a, CREATE_VECTOR3("10", "8.5", "9"));
+  }
+  {
+    Variant a = CREATE_MAP3("x", 3, "y", 1, "z", 2);
+    f_sort(ref(a));
+    VS(a, CREATE_VECTOR3(1, 2, 3));
+  }
   return Count(true);
 }
 
@@ -1656,6 +1734,14 @@ bool TestExtArray::test_ksort() {
      "    [c] => apple\n"
      "    [d] => lemon\n"
      ")\n");
+
+  {
+    Variant a = f_array_flip(f_range(99, 0, 1));
+    f_ksort(ref(a));
+    VS(f_array_keys(a), f_range(0, 99, 1));
+    f_krsort(ref(a));
+    VS(f_array_keys(a), f_range(99, 0, 1));
+  }
   return Count(true);
 }
 
@@ -1680,6 +1766,19 @@ bool TestExtArray::test_usort() {
     f_usort(ref(a), "reverse_comp_func");
     VS(a, CREATE_VECTOR5(10, 6, 5, 3, 2));
   }
+  {
+    Variant a = CREATE_MAP6("a", "pear", "b", "apple", "c", "fig",
+                            "d", "apple", "e", "Zoo", "f", "apples");
+    Variant b = a;
+    f_usort(ref(a), "strcmp");
+    RuntimeOption::ParallelArrayThreads = 4;
+    RuntimeOption::ParallelArrayMinSize = 2;
+    f_usort(ref(b), "strcmp");
+    RuntimeOption::ParallelArrayThreads = 0;
+    RuntimeOption::ParallelArrayMinSize = 10000;
+    VS(b, a);
+    VS(a, CREATE_VECTOR6("Zoo", "apple", "apple", "apples", "fig", "pear"));
+  }
   return Count(true);
 }
 
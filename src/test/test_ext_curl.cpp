@@ -91,6 +91,9 @@ bool TestExtCurl::RunTests(const std::string &which) {
   RUN_TEST(test_evhttp_async_get);
   RUN_TEST(test_evhttp_async_post);
   RUN_TEST(test_evhttp_recv);
+  RUN_TEST(test_evhttp_task_start);
+  RUN_TEST(test_evhttp_task_status);
+  RUN_TEST(test_evhttp_task_result);
 
   server->stop();
 
@@ -383,3 +386,51 @@ bool TestExtCurl::test_evhttp_recv() {
   // tested in test_evhttp_async_get() and test_evhttp_async_post()
   return Count(true);
 }
+
+bool TestExtCurl::test_evhttp_task_start() {
+  // more requests than pooled connections, so some queue up behind others
+  Array tasks = Array::Create();
+  for (int i = 0; i < 20; i++) {
+    tasks.append(f_evhttp_task_start(REQUEST_URI, CREATE_VECTOR1("ECHO: foo")));
+  }
+  tasks.append(f_evhttp_task_start(REQUEST_URI, CREATE_VECTOR1("ECHO: bar"),
+                                   5, "echo"));
+  for (int i = 0; i < 20; i++) {
+    Variant ret = f_evhttp_task_result(tasks[i]);
+    VS(ret["code"], 200);
+    VS(ret["response"], "OK");
+    VS(ret["headers"][0], "ECHOED: foo");
+  }
+  Variant ret = f_evhttp_task_result(tasks[20]);
+  VS(ret["code"], 200);
+  VS(ret["response"], "POST: echo");
+  VS(ret["headers"][0], "ECHOED: bar");
+
+  VS(f_evhttp_task_start("localhost:8080/request"), false);
+  return Count(true);
+}
+
+bool TestExtCurl::test_evhttp_task_status() {
+  Variant task = f_evhttp_task_start(REQUEST_URI);
+  while (!f_evhttp_task_status(task)) {
+    usleep(1000);
+  }
+  VS(f_evhttp_task_status(task), true);
+  Variant ret = f_evhttp_task_result(task);
+  VS(ret["response"], "OK");
+  return Count(true);
+}
+
+bool TestExtCurl::test_evhttp_task_result() {
+  // nothing is listening on this port
+  Variant task = f_evhttp_task_start("http://127.0.0.1:1/request");
+  VS(f_evhttp_task_result(task), false);
+  VS(f_evhttp_task_result(task), false);
+
+  // asking again returns the same result
+  task = f_evhttp_task_start(REQUEST_URI, CREATE_VECTOR1("ECHO: foo"));
+  Variant ret = f_evhttp_task_result(task);
+  VS(ret["response"], "OK");
+  VS(f_evhttp_task_result(task), ret);
+  return Count(true);
+}
@@ -52,6 +52,9 @@ class TestExtCurl : public TestCppExt {
   bool test_evhttp_async_get();
   bool test_evhttp_async_post();
   bool test_evhttp_recv();
+  bool test_evhttp_task_start();
+  bool test_evhttp_task_status();
+  bool test_evhttp_task_result();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,10 +93,18 @@ bool TestExtDatetime::test_date_default_timezone_get() {
 }
 
 bool TestExtDatetime::test_date_default_timezone_set() {
+  int d = f_strtotime("2008-09-10 12:34:56");
   VERIFY(f_date_default_timezone_set("Asia/Shanghai"));
   VS(f_date_default_timezone_get(), "Asia/Shanghai");
+  VS(f_date("Y-m-d H:i:s O", d), "2008-09-11 03:34:56 +0800");
+  VERIFY(f_date_default_timezone_set("Europe/London"));
+  VS(f_date("Y-m-d H:i:s O", d), "2008-09-10 20:34:56 +0100");
+  VERIFY(!f_date_default_timezone_set("Nowhere/Nothing"));
+  VERIFY(f_date_default_timezone_set("Asia/Shanghai"));
+  VS(f_date("Y-m-d H:i:s O", d), "2008-09-11 03:34:56 +0800");
   VERIFY(f_date_default_timezone_set("America/Los_Angeles"));
   VS(f_date_default_timezone_get(), "America/Los_Angeles");
+  VS(f_date("Y-m-d H:i:s O", d), "2008-09-10 12:34:56 -0700");
   return Count(true);
 }
 
@@ -230,6 +238,22 @@ bool TestExtDatetime::test_date() {
      "2000-07-01T00:00:00-07:00");
 
   VS(f_date("l \\t\\h\\e jS", d), "Wednesday the 10th");
+  VS(f_date("l \\t\\h\\e jS", d + 86400), "Thursday the 11th");
+  VS(f_date("Y-m-d H:i:s", d + 1), "2008-09-10 12:34:57");
+  VS(f_date("Y-m-d H:i:s", d + 86400), "2008-09-11 12:34:56");
+
+  // across a DST change, and back
+  int dst = f_mktime(1, 59, 59, 3, 8, 2009);
+  VS(f_date("Y-m-d H:i:s I O", dst), "2009-03-08 01:59:59 0 -0800");
+  VS(f_date("Y-m-d H:i:s I O", dst + 1), "2009-03-08 03:00:00 1 -0700");
+  VS(f_date("Y-m-d H:i:s I O", dst), "2009-03-08 01:59:59 0 -0800");
+
+  // after switching timezone
+  String tz = f_date_default_timezone_get();
+  f_date_default_timezone_set("UTC");
+  VS(f_date("Y-m-d H:i:s e", d), "2008-09-10 19:34:56 UTC");
+  f_date_default_timezone_set(tz);
+  VS(f_date("Y-m-d H:i:s", d), "2008-09-10 12:34:56");
 
   int tomorrow = f_mktime(0,0,0,
                           f_date("m", d).toInt32(),
@@ -308,6 +332,9 @@ bool TestExtDatetime::test_gmdate() {
   int d = f_mktime(0, 0, 0, 1, 1, 1998);
   VS(f_date("M d Y H:i:s",   d), "Jan 01 1998 00:00:00");
   VS(f_gmdate("M d Y H:i:s", d), "Jan 01 1998 08:00:00");
+  VS(f_gmdate("D, d M Y H:i:s", 86399), "Thu, 01 Jan 1970 23:59:59");
+  VS(f_gmdate("D, d M Y H:i:s", 86400), "Fri, 02 Jan 1970 00:00:00");
+  VS(f_gmdate("Y-m-d H:i:s", -1), "1969-12-31 23:59:59");
   return Count(true);
 }
 
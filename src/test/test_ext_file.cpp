@@ -161,6 +161,8 @@ bool TestExtFile::test_fpassthru() {
   VS(f_fpassthru(f), 17);
   VS(f_ob_get_clean(), "Testing Ext File\n");
   f_ob_end_clean();
+  VS(f_ftell(f), 17);
+  VERIFY(f_feof(f));
   return Count(true);
 }
 
@@ -430,6 +432,12 @@ bool TestExtFile::test_file_get_contents() {
 
   VS(f_file_get_contents("test/test_ext_file.tmp"),
      "testing file_get_contents");
+  VS(f_file_get_contents("test/test_ext_file.tmp", false, null_object, 8),
+     "file_get_contents");
+  VS(f_file_get_contents("test/test_ext_file.tmp", false, null_object, 8, 4),
+     "file");
+  VS(f_file_get_contents("test/test_ext_file.tmp", false, null_object, 100),
+     "");
 
   VS(f_unserialize(f_file_get_contents("compress.zlib://test/test_zlib_file")),
      CREATE_VECTOR1("rblock:216105"));
@@ -450,6 +458,11 @@ bool TestExtFile::test_file() {
 
   Variant items = f_file("test/test_ext_file.tmp");
   VS(items, CREATE_VECTOR2("testing\n", "file\n"));
+
+  f_file_put_contents("test/test_ext_file.tmp", "a\n\nb");
+  VS(f_file("test/test_ext_file.tmp"), CREATE_VECTOR3("a\n", "\n", "b"));
+  // FILE_IGNORE_NEW_LINES | FILE_SKIP_EMPTY_LINES
+  VS(f_file("test/test_ext_file.tmp", 6), CREATE_VECTOR2("a", "b"));
   return Count(true);
 }
 
@@ -458,6 +471,14 @@ bool TestExtFile::test_readfile() {
   VS(f_readfile("test/test_ext_file.txt"), 17);
   VS(f_ob_get_clean(), "Testing Ext File\n");
   f_ob_end_clean();
+
+  // big enough to be printed in 64KB reads
+  String big = f_str_repeat("0123456789abcdef", 64 * 1024);
+  f_file_put_contents("test/test_ext_file.tmp", big);
+  f_ob_start();
+  VS(f_readfile("test/test_ext_file.tmp"), big.size());
+  VS(f_ob_get_clean(), big);
+  f_ob_end_clean();
   return Count(true);
 }
 
@@ -600,6 +621,11 @@ bool TestExtFile::test_copy() {
   f_copy("test/test_ext_file.tmp", "test/test_ext_file2.tmp");
   VERIFY(f_file_exists("test/test_ext_file2.tmp"));
   VERIFY(f_file_exists("test/test_ext_file.tmp"));
+
+  String big = f_str_repeat("0123456789abcdef", 64 * 1024);
+  f_file_put_contents("test/test_ext_file.tmp", big);
+  VERIFY(f_copy("test/test_ext_file.tmp", "test/test_ext_file2.tmp"));
+  VS(f_file_get_contents("test/test_ext_file2.tmp"), big);
   return Count(true);
 }
 
@@ -97,6 +97,20 @@ bool TestExtIconv::test_iconv_set_encoding() {
 bool TestExtIconv::test_iconv() {
   VS(f_iconv("UTF-8", "BIG5", "\xE2\x82\xAC"), "\xa3\xe1");
   VS(f_iconv("ISO-8859-1", "UTF-8", "Pr\xDC""fung"), "Pr\xC3\x9C""fung");
+  VS(f_iconv("UTF-8", "ISO-8859-1", "Pr\xC3\x9C""fung"), "Pr\xDC""fung");
+  VS(f_iconv("utf8", "latin1", "0123456789abcdef\xC3\x9C"),
+     "0123456789abcdef\xDC");
+  VS(f_iconv("ASCII", "UTF-8", "plain"), "plain");
+
+  // not representable or not valid, handled by iconv itself
+  VS(f_iconv("UTF-8", "ISO-8859-1//TRANSLIT", "\xE2\x82\xAC"), "EUR");
+  VS(f_iconv("UTF-8", "ISO-8859-1//IGNORE", "a\xE2\x82\xAC""b"), "ab");
+
+  // pooled descriptors start from initial state every time
+  for (int i = 0; i < 3; i++) {
+    VS(f_iconv("UTF-8", "BIG5", "\xE2\x82\xAC"), "\xa3\xe1");
+    VS(f_iconv("UTF-8", "UTF-7", "\xC3\x9C"), "+ANw-");
+  }
   return Count(true);
 }
 
@@ -122,6 +122,8 @@ bool TestExtMb::test_mb_convert_encoding() {
   VS(f_mb_convert_encoding(str, "ISO-8859-1", "UTF-8"),      "Pr\xDC""fung");
   VS(f_mb_convert_encoding(str, "ISO-8859-1", "UTF-8, JIS"), "Pr\xDC""fung");
   VS(f_mb_convert_encoding(str, "ISO-8859-1", "auto"),       "Pr\xDC""fung");
+  VS(f_mb_convert_encoding("Pr\xDC""fung", "UTF-8", "ISO-8859-1"), str);
+  VS(f_mb_convert_encoding("\xE2\x82\xAC", "ISO-8859-1", "UTF-8"), "?");
 
   return Count(true);
 }
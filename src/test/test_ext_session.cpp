@@ -16,6 +16,10 @@
 
 #include <test/test_ext_session.h>
 #include <runtime/ext/ext_session.h>
+#include <runtime/ext/ext_options.h>
+#include <runtime/ext/ext_file.h>
+#include <runtime/base/program_functions.h>
+#include <util/async_func.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +46,11 @@ bool TestExtSession::RunTests(const std::string &which) {
   RUN_TEST(test_session_register);
   RUN_TEST(test_session_unregister);
   RUN_TEST(test_session_is_registered);
+  RUN_TEST(test_shm_session_read_write);
+  RUN_TEST(test_shm_session_lock);
+  RUN_TEST(test_shm_session_destroy);
+  RUN_TEST(test_shm_session_gc);
+  RUN_TEST(test_shm_session_save_path);
 
   return ret;
 }
@@ -71,6 +80,8 @@ bool TestExtSession::test_session_name() {
 }
 
 bool TestExtSession::test_session_module_name() {
+  VS(f_session_module_name("shm"), "files");
+  VS(f_session_module_name("files"), "shm");
   return Count(true);
 }
 
@@ -154,3 +165,144 @@ bool TestExtSession::test_session_is_registered() {
   }
   return Count(false);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static String start_shm_session(CStrRef id) {
+  f_session_module_name("shm");
+  f_session_id(id);
+  f_session_start();
+  return f_session_encode().toString();
+}
+
+static void end_shm_session() {
+  f_session_write_close();
+  f_session_module_name("files");
+}
+
+/**
+ * A second request, on its own thread, of a session the test may hold.
+ */
+class ShmSessionRequest {
+public:
+  ShmSessionRequest(const char *id, int maxlifetime)
+    : m_id(id), m_maxlifetime(maxlifetime), m_started(false) {}
+
+  void run() {
+    hphp_session_init();
+    f_ini_set("session.gc_maxlifetime", m_maxlifetime);
+    m_data = start_shm_session(m_id).data();
+    m_started = true;
+    end_shm_session();
+    hphp_session_exit();
+  }
+
+  const char *m_id;
+  int m_maxlifetime;
+  volatile bool m_started;
+  std::string m_data;
+};
+
+bool TestExtSession::test_shm_session_read_write() {
+  VS(start_shm_session("shmrw"), "");
+  f_session_decode("a|i:1;b|s:1:\"x\";");
+  end_shm_session();
+
+  VS(start_shm_session("shmrw"), "a|i:1;b|s:1:\"x\";");
+  f_session_decode("a|i:2;");
+  end_shm_session();
+
+  VS(start_shm_session("shmrw"), "a|i:2;b|s:1:\"x\";");
+  end_shm_session();
+  VS(start_shm_session("shmrw2"), "");
+  end_shm_session();
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_lock() {
+  // a second request waits until the first one closes the session
+  start_shm_session("shmlock");
+  f_session_decode("a|i:1;");
+  {
+    ShmSessionRequest req("shmlock", 60);
+    AsyncFunc<ShmSessionRequest> func(&req, &ShmSessionRequest::run);
+    func.start();
+    usleep(200000);
+    VERIFY(!req.m_started);
+    end_shm_session();
+    func.waitForEnd();
+    VERIFY(req.m_started);
+    VS(req.m_data, "a|i:1;");
+  }
+
+  // it gives up after gc_maxlifetime seconds and can't write the session
+  start_shm_session("shmlock");
+  {
+    ShmSessionRequest req("shmlock", 1);
+    AsyncFunc<ShmSessionRequest> func(&req, &ShmSessionRequest::run);
+    func.start();
+    func.waitForEnd();
+    VERIFY(req.m_started);
+    VS(req.m_data, "");
+  }
+  end_shm_session();
+  VS(start_shm_session("shmlock"), "a|i:1;");
+  end_shm_session();
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_destroy() {
+  start_shm_session("shmdestroy");
+  f_session_decode("a|i:1;");
+  end_shm_session();
+
+  VS(start_shm_session("shmdestroy"), "a|i:1;");
+  VERIFY(f_session_destroy());
+  VS(start_shm_session("shmdestroy"), "");
+  end_shm_session();
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_gc() {
+  start_shm_session("shmgc1");
+  f_session_decode("a|i:1;");
+  end_shm_session();
+
+  // collect on every start, everything that isn't in use
+  String probability = f_ini_set("session.gc_probability", "1");
+  String divisor = f_ini_set("session.gc_divisor", "1");
+  String maxlifetime = f_ini_set("session.gc_maxlifetime", "-1");
+  start_shm_session("shmgc2");
+  f_session_decode("b|i:2;");
+  end_shm_session();
+  f_ini_set("session.gc_probability", probability);
+  f_ini_set("session.gc_divisor", divisor);
+  f_ini_set("session.gc_maxlifetime", maxlifetime);
+
+  VS(start_shm_session("shmgc1"), "");
+  end_shm_session();
+  VS(start_shm_session("shmgc2"), "b|i:2;");
+  end_shm_session();
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_save_path() {
+  Util::mkdir("runtime/tmp/");
+  String path = f_session_save_path("runtime/tmp");
+  f_file_put_contents("runtime/tmp/sess_shmfresh", "a|i:1;");
+  f_file_put_contents("runtime/tmp/sess_shmstale", "b|i:2;");
+  f_touch("runtime/tmp/sess_shmstale", time(NULL) - 3600);
+  String maxlifetime = f_ini_set("session.gc_maxlifetime", "60");
+
+  // a file left over from before a restart is loaded, unless it expired
+  VS(start_shm_session("shmfresh"), "a|i:1;");
+  end_shm_session();
+  VS(start_shm_session("shmstale"), "");
+  end_shm_session();
+  VERIFY(!f_file_exists("runtime/tmp/sess_shmstale"));
+
+  f_ini_set("session.gc_maxlifetime", maxlifetime);
+  f_unlink("runtime/tmp/sess_shmfresh");
+  f_session_save_path(path);
+  return Count(true);
+}
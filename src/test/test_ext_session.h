@@ -47,6 +47,13 @@ class TestExtSession : public TestCppExt {
   bool test_session_register();
   bool test_session_unregister();
   bool test_session_is_registered();
+
+  // "shm" save handler
+  bool test_shm_session_read_write();
+  bool test_shm_session_lock();
+  bool test_shm_session_destroy();
+  bool test_shm_session_gc();
+  bool test_shm_session_save_path();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
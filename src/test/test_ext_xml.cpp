@@ -181,10 +181,15 @@ bool TestExtXml::test_xml_error_string() {
 
 bool TestExtXml::test_utf8_decode() {
   VS(f_utf8_decode("abc \xc3\x80 def"), "abc \xc0 def");
+  VS(f_utf8_decode("abc def"), "abc def");
+  VS(f_utf8_decode("abc \xe2\x82\xac def"), "abc ? def");
+  VS(f_utf8_decode("abc \xc3"), "abc ?");
   return Count(true);
 }
 
 bool TestExtXml::test_utf8_encode() {
   VS(f_utf8_encode("abc \xc0 def"), "abc \xc3\x80 def");
+  VS(f_utf8_encode("abc def"), "abc def");
+  VS(f_utf8_encode("\xff\x80"), "\xc3\xbf\xc2\x80");
   return Count(true);
 }
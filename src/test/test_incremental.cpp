@@ -0,0 +1,210 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <test/test_incremental.h>
+#include <compiler/parser/parser.h>
+#include <compiler/analysis/analysis_result.h>
+#include <compiler/code_generator.h>
+#include <compiler/builtin_symbols.h>
+#include <util/process.h>
+#include <util/util.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TestIncremental::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestManifest);
+  RUN_TEST(TestSameOutput);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool write_file(const string &path, const char *content) {
+  Util::mkdir(path);
+  ofstream f(path.c_str());
+  if (!f) return false;
+  f << content;
+  return true;
+}
+
+static bool same_dir(const string &dir1, const string &dir2) {
+  const char *argv[] = {"", "-r", dir1.c_str(), dir2.c_str(), NULL};
+  string out, err;
+  Process::Exec("diff", argv, NULL, out, &err);
+  if (!out.empty() || !err.empty()) {
+    printf("%s\n%s\n", out.c_str(), err.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool TestIncremental::Build(const std::string &root, const char **files,
+                            const std::string &outputDir,
+                            const std::string &compileDir,
+                            const BuildManifest *previous,
+                            BuildManifest &current) {
+  AnalysisResultPtr ar(new AnalysisResult());
+  ar->setOutputPath(outputDir);
+  for (int i = 0; files[i]; i += 2) {
+    if (!write_file(root + files[i], files[i + 1])) return false;
+    Parser::ParseString(files[i + 1], ar, files[i]);
+  }
+  BuiltinSymbols::Load(ar);
+  ar->loadBuiltins();
+  ar->analyzeProgram();
+  ar->preOptimize();
+  ar->inferTypes();
+  ar->postOptimize();
+  ar->analyzeProgramFinal();
+  if (previous) {
+    map<string, string> clusters;
+    previous->getClusters(clusters);
+    ar->setClusters(clusters);
+  }
+  ar->outputAllCPP(CodeGenerator::ClusterCPP, 2, &compileDir);
+  current.collect(ar, root);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TestIncremental::TestManifest() {
+  string filename = "runtime/tmp/incremental/test.manifest";
+  Util::mkdir(filename);
+
+  BuildManifest m1;
+  m1.setFingerprint("fp");
+  m1.addFile("a.php", "1", "cls_1");
+  m1.addFile("b.php", "2", "cls_2");
+  m1.addFile("c.php", "3", "-");
+  m1.addDependency("b.php", "a.php");
+  m1.addDependency("c.php", "b.php");
+  VERIFY(m1.save(filename));
+
+  BuildManifest m2;
+  VERIFY(m2.load(filename));
+  VS(m2.getFingerprint(), "fp");
+  VS(m2.getFileCount(), 3);
+
+  map<string, string> clusters;
+  m2.getClusters(clusters);
+  VS((int)clusters.size(), 2);
+  VS(clusters["a.php"], "cls_1");
+  VS(clusters["b.php"], "cls_2");
+
+  BuildManifest m3;
+  m3.addFile("a.php", "1", "cls_1");
+  m3.addFile("b.php", "4", "cls_2");
+  m3.addFile("d.php", "5", "cls_1");
+  set<string> changed, removed;
+  m2.diff(m3, changed, removed);
+  VS((int)changed.size(), 2);
+  VERIFY(changed.find("b.php") != changed.end());
+  VERIFY(changed.find("d.php") != changed.end());
+  VS((int)removed.size(), 1);
+  VERIFY(removed.find("c.php") != removed.end());
+
+  set<string> files, dependents;
+  files.insert("a.php");
+  m2.getDependents(files, dependents);
+  VS((int)dependents.size(), 2);
+  VERIFY(dependents.find("b.php") != dependents.end());
+  VERIFY(dependents.find("e.php") != dependents.end());
+  VERIFY(dependents.find("c.php") != dependents.end());
+
+  vector<string> inputs;
+  inputs.push_back("a.php");
+  inputs.push_back("b.php");
+  string fp = BuildManifest::Fingerprint("options", inputs);
+  reverse(inputs.begin(), inputs.end());
+  VS(BuildManifest::Fingerprint("options", inputs), fp);
+  inputs.push_back("d.php");
+  VERIFY(BuildManifest::Fingerprint("options", inputs) != fp);
+  inputs.pop_back();
+  VERIFY(BuildManifest::Fingerprint("other options", inputs) != fp);
+
+  write_file(filename, "hphp-manifest 0\n");
+  BuildManifest m4;
+  VERIFY(!m4.load(filename));
+  return Count(true);
+}
+
+bool TestIncremental::TestSameOutput() {
+  string root = "runtime/tmp/incremental/src/";
+  string incDir = "runtime/tmp/incremental/inc";
+  string syncDir = "runtime/tmp/incremental/inc.sync";
+  string fullDir = "runtime/tmp/incremental/full";
+
+  // no new files in v2: a full build would cluster them differently from
+  // an incremental one, which is fine, but then there's nothing to compare
+  const char *v1[] = {
+    "a.php", "<?php function a() { return 1; }",
+    "b.php", "<?php function b() { return a() + 1; }",
+    "c.php", "<?php class C { function c() { return 'c'; } }",
+    "d.php", "<?php function d($x) { return strlen($x); }",
+    "e.php", "<?php function e() { return b(); }",
+    NULL
+  };
+  const char *v2[] = {
+    "a.php", "<?php function a() { return 'a'; }",
+    "b.php", "<?php function b() { return a() + 1; }",
+    "c.php", "<?php class C { function c() { return 'c'; } }",
+    "d.php", "<?php function d($x) { return count($x); }",
+    "e.php", "<?php function e() { return b(); }",
+    NULL
+  };
+
+  BuildManifest m1;
+  VERIFY(Build(root, v1, incDir, incDir, NULL, m1));
+  m1.setFingerprint("fp");
+  VERIFY(m1.isUpToDate(root, "fp"));
+  VERIFY(!m1.isUpToDate(root, "other"));
+
+  // incremental build: generate elsewhere, then only touch what changed
+  BuildManifest m2;
+  VERIFY(Build(root, v2, syncDir, incDir, &m1, m2));
+  VERIFY(!m1.isUpToDate(root, "fp"));
+  Util::syncdir(incDir, syncDir);
+
+  set<string> changed, removed, dependents;
+  m1.diff(m2, changed, removed);
+  VS((int)changed.size(), 2);
+  VS((int)removed.size(), 0);
+  m2.getDependents(changed, dependents);
+  VERIFY(dependents.find("b.php") != dependents.end());
+  VERIFY(dependents.find("e.php") != dependents.end());
+
+  map<string, string> clusters1, clusters2;
+  m1.getClusters(clusters1);
+  m2.getClusters(clusters2);
+  for (map<string, string>::const_iterator iter = clusters1.begin();
+       iter != clusters1.end(); ++iter) {
+    VS(clusters2[iter->first], iter->second);
+  }
+
+  // a full build from scratch has to produce the very same code
+  Util::ssystem(("rm -rf " + fullDir).c_str());
+  BuildManifest m3;
+  VERIFY(Build(root, v2, fullDir, fullDir, NULL, m3));
+  map<string, string> clusters3;
+  m3.getClusters(clusters3);
+  VERIFY(clusters3 == clusters2);
+  VERIFY(same_dir(incDir, fullDir));
+  return Count(true);
+}
@@ -0,0 +1,45 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __TEST_INCREMENTAL_H__
+#define __TEST_INCREMENTAL_H__
+
+#include <test/test_base.h>
+#include <compiler/build_manifest.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TestIncremental : public TestBase {
+ public:
+  virtual bool RunTests(const std::string &which);
+
+  bool TestManifest();
+  bool TestSameOutput();
+
+ private:
+  /**
+   * Compiles PHP files under root into outputDir, as if they were compiled
+   * into compileDir, keeping files in the clusters "previous" had.
+   */
+  bool Build(const std::string &root, const char **files,
+             const std::string &outputDir, const std::string &compileDir,
+             const HPHP::BuildManifest *previous,
+             HPHP::BuildManifest &current);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // __TEST_INCREMENTAL_H__
@@ -16,6 +16,16 @@
 
 #include <test/test_performance.h>
 #include <util/util.h>
+#include <util/timer.h>
+#include <util/process.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/array/typed_vector.h>
+#include <runtime/ext/ext_array.h>
+#include <runtime/ext/ext_datetime.h>
+#include <runtime/ext/ext_file.h>
+#include <runtime/ext/ext_output.h>
+#include <runtime/ext/ext_string.h>
+#include <numeric>
 
 using namespace std;
 
@@ -49,6 +59,15 @@ bool TestPerformance::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestBasicOperations);
   RUN_TEST(TestMemoryUsage);
+  RUN_TEST(TestThriftSerialization);
+  RUN_TEST(TestSessionStore);
+  RUN_TEST(TestStreamingSerialization);
+  RUN_TEST(TestParallelArray);
+  RUN_TEST(TestArrayLatency);
+  RUN_TEST(TestArrayLookup);
+  RUN_TEST(TestTypedVector);
+  RUN_TEST(TestFileRead);
+  RUN_TEST(TestDateFormat);
   RUN_TEST(TestAdHocFile);
   RUN_TEST(TestAdHoc);
   return ret;
@@ -147,6 +166,290 @@ bool TestPerformance::TestMemoryUsage() {
   return true;
 }
 
+#define THRIFT_PERF_START                                               \
+  PERF_START                                                            \
+  "class Transport {\n"                                                 \
+  "  public $buff = ''; public $pos = 0;\n"                             \
+  "  function flush() {}\n"                                             \
+  "  function write($buff) { $this->buff .= $buff; }\n"                 \
+  "  function read($n) {\n"                                             \
+  "    $r = substr($this->buff, $this->pos, $n); $this->pos += $n;\n"   \
+  "    return $r;\n"                                                    \
+  "  }\n"                                                               \
+  "}\n"                                                                 \
+  "class Protocol {\n"                                                  \
+  "  public $t;\n"                                                      \
+  "  function __construct() { $this->t = new Transport(); }\n"          \
+  "  function getTransport() { return $this->t; }\n"                    \
+  "}\n"                                                                 \
+  "class Item {\n"                                                      \
+  "  static $_TSPEC = array(\n"                                         \
+  "    1 => array('var' => 'id', 'type' => 10),\n"                      \
+  "    2 => array('var' => 'name', 'type' => 11),\n"                    \
+  "    3 => array('var' => 'tags', 'type' => 15, 'etype' => 11,\n"      \
+  "               'elem' => array('type' => 11)));\n"                   \
+  "  public $id; public $name; public $tags;\n"                         \
+  "}\n"                                                                 \
+  "class Page {\n"                                                      \
+  "  static $_TSPEC = array(\n"                                         \
+  "    1 => array('var' => 'owner', 'type' => 12, 'class' => 'Item'),\n"\
+  "    2 => array('var' => 'items', 'type' => 15, 'etype' => 12,\n"     \
+  "               'elem' => array('type' => 12, 'class' => 'Item')));\n"\
+  "  public $owner; public $items;\n"                                   \
+  "}\n"                                                                 \
+  "function item($i) {\n"                                               \
+  "  $item = new Item(); $item->id = $i; $item->name = 'item'.$i;\n"    \
+  "  $item->tags = array('a', 'b', 'c');\n"                             \
+  "  return $item;\n"                                                   \
+  "}\n"                                                                 \
+  "$page = new Page(); $page->owner = item(0); $page->items = array();\n"\
+  "for ($i = 0; $i < 100; $i++) $page->items[] = item($i);\n"           \
+
+bool TestPerformance::TestThriftSerialization() {
+  VCR(THRIFT_PERF_START
+      "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) {"
+      "  $p = new Protocol();"
+      "  thrift_protocol_write_binary($p, 'get', 1, $page, 1, true);"
+      "  thrift_protocol_read_binary($p, 'Page', true);"
+      "}"
+      "\n\n/* Thrift binary protocol, nested structs in a list */"
+      PERF_END);
+
+  VCR(THRIFT_PERF_START
+      "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) {"
+      "  $p = new Protocol();"
+      "  thrift_protocol_write_compact($p, 'get', 1, $page, 1);"
+      "  thrift_protocol_read_compact($p, 'Page');"
+      "}"
+      "\n\n/* Thrift compact protocol, nested structs in a list */"
+      PERF_END);
+
+  return true;
+}
+
+bool TestPerformance::TestSessionStore() {
+  VCR(PERF_START
+      "session_module_name('files');\n"
+      "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) {"
+      "  session_id('perf'.($i % 10)); session_start();"
+      "  $_SESSION['count'] = $i; session_write_close();"
+      "}"
+      "\n\n/* Session read and write with files module */"
+      PERF_END);
+
+  VCR(PERF_START
+      "session_module_name('shm');\n"
+      "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) {"
+      "  session_id('perf'.($i % 10)); session_start();"
+      "  $_SESSION['count'] = $i; session_write_close();"
+      "}"
+      "\n\n/* Session read and write with shm module */"
+      PERF_END);
+
+  return true;
+}
+
+bool TestPerformance::TestStreamingSerialization() {
+  VCR(PERF_START
+      "$a = array();\n"
+      "for ($i = 0; $i < 200000; $i++) $a[] = str_repeat('x', 40).$i;\n"
+      "ob_start(); echo json_encode($a); ob_end_clean();\n"
+      "echo memory_get_peak_usage(), \" bytes at peak\\n\";"
+      "\n\n/* echo json_encode() of 10MB */"
+      PERF_END);
+
+  VCR(PERF_START
+      "$a = array();\n"
+      "for ($i = 0; $i < 200000; $i++) $a[] = str_repeat('x', 40).$i;\n"
+      "ob_start(); echo serialize($a); ob_end_clean();\n"
+      "echo memory_get_peak_usage(), \" bytes at peak\\n\";"
+      "\n\n/* echo serialize() of 10MB */"
+      PERF_END);
+
+  return true;
+}
+
+bool TestPerformance::TestParallelArray() {
+  Array a = Array::Create();
+  for (int i = 0; i < 200000; i++) {
+    a.append(String("Element Number ") + String(i));
+  }
+
+  int threads[] = {0, 2, 4, 8};
+  for (unsigned int i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    RuntimeOption::ParallelArrayThreads = threads[i];
+    int64 map, filter, sort;
+    {
+      Timer timer(Timer::WallTime);
+      f_array_map(2, "md5", a);
+      map = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::WallTime);
+      f_array_filter(a, "strtolower");
+      filter = timer.getMicroSeconds();
+    }
+    {
+      Variant b = f_array_map(2, "sha1", a);
+      Timer timer(Timer::WallTime);
+      f_usort(ref(b), "strcmp");
+      sort = timer.getMicroSeconds();
+    }
+    printf("%d threads: array_map('md5') %lldms, array_filter('strtolower') "
+           "%lldms, usort('strcmp') %lldms on 200000 elements\n",
+           threads[i], map / 1000, filter / 1000, sort / 1000);
+  }
+  RuntimeOption::ParallelArrayThreads = 0;
+  return true;
+}
+
+static void print_latencies(const char *what, std::vector<int64> &times) {
+  sort(times.begin(), times.end());
+  int n = times.size();
+  printf("%s: total %lldus, p50 %lldus, p99 %lldus, p99.9 %lldus, "
+         "max %lldus\n", what, accumulate(times.begin(), times.end(), 0LL),
+         times[n / 2], times[n * 99 / 100], times[n * 999 / 1000],
+         times[n - 1]);
+}
+
+bool TestPerformance::TestArrayLatency() {
+  {
+    std::vector<int64> times;
+    times.reserve(1000000);
+    Array arr = Array::Create();
+    for (int i = 0; i < 1000000; i++) {
+      Timer timer(Timer::WallTime);
+      arr.set(String("key") + String(i), i);
+      times.push_back(timer.getMicroSeconds());
+    }
+    print_latencies("1M string key insertions", times);
+  }
+  {
+    std::vector<int64> times;
+    times.reserve(100000);
+    Array arr = Array::Create();
+    for (int i = 0; i < 100000; i++) {
+      arr.append(i);
+    }
+    for (int i = 0; i < 100000; i++) {
+      Timer timer(Timer::WallTime);
+      arr.append(i);
+      arr.dequeue();
+      times.push_back(timer.getMicroSeconds());
+    }
+    print_latencies("100K enqueue/dequeue pairs on 100K queue", times);
+  }
+  return true;
+}
+
+bool TestPerformance::TestArrayLookup() {
+  Array arr;
+  std::vector<String> keys;
+  for (int i = 0; i < 1000; i++) {
+    keys.push_back(String("key") + String(i));
+    arr.set(keys.back(), i);
+  }
+  int64 sum = 0;
+  Timer timer(Timer::WallTime);
+  for (int n = 0; n < 1000; n++) {
+    for (unsigned int i = 0; i < keys.size(); i++) {
+      sum += arr[keys[i]].toInt64();
+    }
+  }
+  printf("1M lookups by runtime string keys: %lldms (%lld)\n",
+         timer.getMicroSeconds() / 1000, sum);
+  return true;
+}
+
+bool TestPerformance::TestTypedVector() {
+  for (int typed = 0; typed < 2; typed++) {
+    int rss = Process::GetProcessRSS(Process::GetProcessId());
+    Array arr = Array::Create();
+    if (typed) {
+      arr = Array(NEW(TypedVector)(KindOfInt64, 10000000));
+    }
+    for (int64 i = 0; i < 10000000; i++) {
+      arr.append(i);
+    }
+    int used = Process::GetProcessRSS(Process::GetProcessId()) - rss;
+
+    int64 sum = 0;
+    Timer timer(Timer::WallTime);
+    for (ArrayIter iter(arr); iter; ++iter) {
+      sum += iter.second().toInt64();
+    }
+    printf("10M integers in %s: %dMB, iterated in %lldms (%lld)\n",
+           typed ? "TypedVector" : "ZendArray", used,
+           timer.getMicroSeconds() / 1000, sum);
+  }
+  return true;
+}
+
+bool TestPerformance::TestFileRead() {
+  const char *name = "test/test_performance.tmp";
+  const char *copy = "test/test_performance2.tmp";
+  int sizes[] = {4 << 10, 64 << 10, 1 << 20, 16 << 20};
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    String line = f_str_repeat("x", 79) + "\n";
+    f_file_put_contents(name, f_str_repeat(line, sizes[i] / 80));
+    int count = (64 << 20) / sizes[i]; // 64MB total for each size
+
+    int64 get, lines, print, cp;
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < count; n++) f_file_get_contents(name);
+      get = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < count; n++) f_file(name);
+      lines = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < count; n++) {
+        f_ob_start();
+        f_readfile(name);
+        f_ob_end_clean();
+      }
+      print = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < count; n++) f_copy(name, copy);
+      cp = timer.getMicroSeconds();
+    }
+    printf("%dKB x %d: file_get_contents %lldms, file %lldms, "
+           "readfile %lldms, copy %lldms\n", sizes[i] >> 10, count,
+           get / 1000, lines / 1000, print / 1000, cp / 1000);
+  }
+  f_unlink(name);
+  f_unlink(copy);
+  return true;
+}
+
+bool TestPerformance::TestDateFormat() {
+  const char *formats[] = {"Y-m-d H:i:s", "D, d M Y H:i:s O", "c"};
+  int64 now = time(0);
+  for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    String format(formats[i]);
+    int64 same, each;
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < 1000000; n++) f_date(format, now);
+      same = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < 1000000; n++) f_date(format, now + n);
+      each = timer.getMicroSeconds();
+    }
+    printf("1M date(\"%s\"): same second %lldms, every second %lldms\n",
+           formats[i], same / 1000, each / 1000);
+  }
+  return true;
+}
+
 bool TestPerformance::TestAdHocFile() {
   string input;
   FILE *f = fopen("test/perf_ad_hoc.php", "r");
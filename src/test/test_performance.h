@@ -32,6 +32,15 @@ class TestPerformance : public TestCodeRun {
 
   bool TestBasicOperations();
   bool TestMemoryUsage();
+  bool TestThriftSerialization();
+  bool TestSessionStore();
+  bool TestStreamingSerialization();
+  bool TestParallelArray();
+  bool TestArrayLatency();
+  bool TestArrayLookup();
+  bool TestTypedVector();
+  bool TestFileRead();
+  bool TestDateFormat();
   bool TestAdHocFile();
   bool TestAdHoc();
 };
@@ -28,6 +28,7 @@
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/runtime_option.h>
+#include <util/timer.h>
 
 using namespace std;
 using namespace boost;
@@ -166,6 +167,7 @@ bool TestServer::RunTests(const std::string &which) {
   //RUN_TEST(TestRequestHandling);
   //RUN_TEST(TestLibeventServer);
   RUN_TEST(TestHttpClient);
+  RUN_TEST(TestLibeventReactors);
 
   return ret;
 }
@@ -505,3 +507,61 @@ bool TestServer::TestHttpClient() {
   server->waitForEnd();
   return Count(true);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+class ReactorClient {
+public:
+  ReactorClient() : m_errors(0) {}
+
+  void run() {
+    HeaderMap headers;
+    for (int i = 0; i < 50; i++) {
+      HttpClient http;
+      StringBuffer response;
+      int code = http.get("http://127.0.0.1:8080/echo?name=value", response,
+                          &headers);
+      if (code != 200 ||
+          strncmp(response.data(), "\nGET param: name = value", 24)) {
+        m_errors++;
+      }
+    }
+  }
+
+  int m_errors;
+};
+
+typedef AsyncFunc<ReactorClient> ReactorClientAsyncFunc;
+typedef boost::shared_ptr<ReactorClientAsyncFunc> ReactorClientAsyncFuncPtr;
+
+bool TestServer::TestLibeventReactors() {
+  int counts[] = {1, 4};
+  for (unsigned int n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+    TypedServer<LibEventServer, EchoHandler> *typed =
+      new TypedServer<LibEventServer, EchoHandler>("127.0.0.1", 8080, 50, -1);
+    typed->setReactorCount(counts[n]);
+    ServerPtr server(typed);
+    server->start();
+
+    // responses have to come back through the reactor that got the request
+    Timer timer(Timer::WallTime);
+    ReactorClient clients[8];
+    std::vector<ReactorClientAsyncFuncPtr> funcs;
+    for (int i = 0; i < 8; i++) {
+      funcs.push_back(ReactorClientAsyncFuncPtr
+                      (new ReactorClientAsyncFunc(&clients[i],
+                                                  &ReactorClient::run)));
+      funcs.back()->start();
+    }
+    for (int i = 0; i < 8; i++) {
+      funcs[i]->waitForEnd();
+      VS(clients[i].m_errors, 0);
+    }
+    printf("%d reactor(s): 400 requests in %lld us\n", counts[n],
+           timer.getMicroSeconds());
+
+    server->stop();
+    server->waitForEnd();
+  }
+  return Count(true);
+}
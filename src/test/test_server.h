@@ -51,6 +51,9 @@ public:
   // test HttpClient class that proxy server uses
   bool TestHttpClient();
 
+  // test multiple libevent event loops sharing one listen socket
+  bool TestLibeventReactors();
+
 protected:
   void RunServer();
   void StopServer();
@@ -20,6 +20,14 @@
 #include <runtime/base/complex_types.h>
 #include <util/logger.h>
 #include <runtime/base/shared/shared_string.h>
+#include <util/db_conn.h>
+#include <util/async_func.h>
+#include <util/atomic.h>
+#include <util/compression.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 using namespace std;
 
@@ -45,6 +53,9 @@ bool TestUtil::RunTests(const std::string &which) {
   //RUN_TEST(TestLFUTable);
   RUN_TEST(TestSharedString);
   RUN_TEST(TestCanonicalize);
+  RUN_TEST(TestDBAsync);
+  RUN_TEST(TestAtomicStack);
+  RUN_TEST(TestStreamCompressor);
   return ret;
 }
 
@@ -522,3 +533,270 @@ bool TestUtil::TestCanonicalize() {
   VERIFY(Util::canonicalize("./../../") == "../../");
   return Count(true);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// a MySQL server that answers "SELECT x" with x, and "FAIL" with an error
+
+class StandInMySQL {
+public:
+  StandInMySQL() : m_port(0) {
+    m_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    if (bind(m_fd, (struct sockaddr *)&sa, len) == 0 &&
+        listen(m_fd, 1024) == 0 &&
+        getsockname(m_fd, (struct sockaddr *)&sa, &len) == 0) {
+      m_port = ntohs(sa.sin_port);
+    }
+  }
+
+  int getPort() const { return m_port;}
+
+  void stop() {
+    shutdown(m_fd, SHUT_RDWR);
+  }
+
+  void run() {
+    while (true) {
+      int fd = accept(m_fd, NULL, NULL);
+      if (fd < 0) break;
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      serve(fd);
+      close(fd);
+    }
+    close(m_fd);
+  }
+
+private:
+  int m_fd;
+  int m_port;
+
+  static void send(int fd, int seq, const string &payload) {
+    string packet;
+    packet.push_back(payload.size() & 0xff);
+    packet.push_back((payload.size() >> 8) & 0xff);
+    packet.push_back((payload.size() >> 16) & 0xff);
+    packet.push_back(seq);
+    packet += payload;
+    write(fd, packet.data(), packet.size());
+  }
+
+  static bool recv(int fd, string &payload) {
+    unsigned char header[4];
+    if (::recv(fd, header, 4, MSG_WAITALL) != 4) return false;
+    int len = header[0] | (header[1] << 8) | (header[2] << 16);
+    payload.resize(len);
+    return len == 0 || ::recv(fd, &payload[0], len, MSG_WAITALL) == len;
+  }
+
+  static void lenenc(string &out, const string &s) {
+    out.push_back(s.size());
+    out += s;
+  }
+
+  void serve(int fd) {
+    // protocol 10, native password, PROTOCOL_41 | SECURE_CONNECTION
+    string greeting("\x0a" "5.1.0-standin", 15);
+    greeting += string("\x01\0\0\0" "abcdefgh" "\0", 13);
+    greeting += string("\x0f\xa2" "\x08" "\x02\0" "\x08\0" "\x15", 8);
+    greeting += string(10, '\0');
+    greeting += string("ijklmnopqrst", 13);
+    greeting += string("mysql_native_password", 22);
+    send(fd, 0, greeting);
+
+    string payload;
+    if (!recv(fd, payload)) return;
+    send(fd, 2, string("\0\0\0\x02\0\0\0", 7));
+
+    while (recv(fd, payload) && !payload.empty() && payload[0] == 0x03) {
+      string sql = payload.substr(1);
+      if (sql == "FAIL") {
+        send(fd, 1, string("\xff\x28\x04#42000boom", 13));
+        continue;
+      }
+      string value = sql.substr(sql.find(' ') + 1);
+      string column;
+      lenenc(column, "def"); lenenc(column, "db");
+      lenenc(column, "t"); lenenc(column, "t");
+      lenenc(column, "v"); lenenc(column, "v");
+      column += string("\x0c\x08\0\xff\0\0\0\xfd\0\0\0\0\0", 13);
+      string row;
+      lenenc(row, value);
+      string eof("\xfe\0\0\x02\0", 5);
+      send(fd, 1, "\x01");
+      send(fd, 2, column);
+      send(fd, 3, eof);
+      send(fd, 4, row);
+      send(fd, 5, eof);
+    }
+  }
+};
+
+static bool run_parallel_queries(int port, int count, bool async) {
+  ServerQueryVec queries;
+  for (int i = 0; i < count; i++) {
+    ServerDataPtr server(new ServerData("127.0.0.1", "db", port, "user",
+                                        "password"));
+    queries.push_back(ServerQuery(server, "SELECT INDEX"));
+  }
+
+  DBConn::AsyncEnabled = async;
+  DBDataSet ds;
+  map<int, string> errors;
+  int affected = DBConn::parallelExecute(queries, ds, errors, 50);
+  DBConn::AsyncEnabled = false;
+
+  if (affected != count || !errors.empty() ||
+      ds.getRowCount() != count || ds.getColCount() != 1 ||
+      strcmp(ds.getFields()[0].name, "v") != 0) {
+    return false;
+  }
+  int sum = 0;
+  for (ds.moveFirst(); ds.getRow(); ds.moveNext()) {
+    sum += ds.getIntField(0);
+  }
+  return sum == count * (count - 1) / 2;
+}
+
+bool TestUtil::TestDBAsync() {
+  StandInMySQL server;
+  VERIFY(server.getPort() > 0);
+  AsyncFunc<StandInMySQL> func(&server, &StandInMySQL::run);
+  func.start();
+
+  // the stand-in server answers one connection at a time, so this only
+  // checks results, not how fast either way is
+  VERIFY(run_parallel_queries(server.getPort(), 200, true));
+  VERIFY(run_parallel_queries(server.getPort(), 200, false));
+
+  {
+    ServerQueryVec queries;
+    ServerDataPtr data(new ServerData("127.0.0.1", "db", server.getPort(),
+                                      "user", ""));
+    queries.push_back(ServerQuery(data, "SELECT 1"));
+    queries.push_back(ServerQuery(data, "FAIL"));
+    DBDataSet ds;
+    map<int, string> errors;
+    DBConn::AsyncEnabled = true;
+    int affected = DBConn::parallelExecute(queries, ds, errors, 1, false);
+    DBConn::AsyncEnabled = false;
+    VS(affected, 1);
+    VS(ds.getRowCount(), 1);
+    VS((int)errors.size(), 1);
+    VS(errors[1], "Failed to execute SQL 'FAIL': boom");
+  }
+
+  server.stop();
+  func.waitForEnd();
+  return Count(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct StackNode {
+  StackNode *next;
+  int value;
+};
+
+/**
+ * Same lock-free stack PendingResponseQueue uses: threads push with
+ * atomic_cas(), and whole stack is taken at once with atomic_swap().
+ */
+class StackPusher {
+public:
+  static const int Count = 10000;
+
+  StackPusher() : m_head(NULL), m_taken(0), m_sum(0) {}
+
+  void push() {
+    for (int i = 1; i <= Count; i++) {
+      StackNode *node = new StackNode();
+      node->value = i;
+      StackNode *head;
+      do {
+        head = m_head;
+        node->next = head;
+      } while (!atomic_cas(m_head, head, node));
+    }
+  }
+
+  void take() {
+    StackNode *node = atomic_swap(m_head, (StackNode*)NULL);
+    while (node) {
+      StackNode *next = node->next;
+      m_taken++;
+      m_sum += node->value;
+      delete node;
+      node = next;
+    }
+  }
+
+  StackNode *m_head;
+  int m_taken;
+  int64 m_sum;
+};
+
+bool TestUtil::TestAtomicStack() {
+  StackPusher pusher;
+  vector<boost::shared_ptr<AsyncFunc<StackPusher> > > funcs;
+  for (int i = 0; i < 4; i++) {
+    funcs.push_back(boost::shared_ptr<AsyncFunc<StackPusher> >
+                    (new AsyncFunc<StackPusher>(&pusher, &StackPusher::push)));
+    funcs.back()->start();
+  }
+  for (int i = 0; i < 100; i++) {
+    pusher.take();
+  }
+  for (int i = 0; i < 4; i++) {
+    funcs[i]->waitForEnd();
+  }
+  pusher.take();
+
+  VS(pusher.m_taken, 4 * StackPusher::Count);
+  VS(pusher.m_sum,
+     (int64)4 * StackPusher::Count * (StackPusher::Count + 1) / 2);
+
+  int flag = 0;
+  VS(atomic_swap(flag, 1), 0);
+  VS(atomic_swap(flag, 1), 1);
+  VERIFY(!atomic_cas(flag, 0, 2));
+  VERIFY(atomic_cas(flag, 1, 2));
+  VS(flag, 2);
+  return Count(true);
+}
+
+bool TestUtil::TestStreamCompressor() {
+  StreamCompressor compressor(-1, CODING_GZIP, true);
+  const char *inputs[] = {
+    "one request's worth of response",
+    "another request, through the same compressor after reset()",
+    "and a third, sent in two chunks",
+  };
+  for (int i = 0; i < 3; i++) {
+    if (i) compressor.reset();
+
+    // last input goes in two chunks, the way chunked encoding sends it
+    int total = strlen(inputs[i]);
+    int first = (i == 2) ? total / 2 : total;
+    string zipped;
+    for (int start = 0; start < total; start += first) {
+      int len = (start == 0) ? first : total - first;
+      char *chunk = compressor.compress(inputs[i] + start, len,
+                                        start + len == total);
+      VERIFY(chunk);
+      zipped.append(chunk, len);
+      free(chunk);
+    }
+
+    int len = zipped.size();
+    char *unzipped = gzdecode(zipped.data(), len);
+    VERIFY(unzipped);
+    VS(string(unzipped, len), inputs[i]);
+    free(unzipped);
+  }
+  return Count(true);
+}
@@ -33,6 +33,9 @@ class TestUtil : public TestBase {
   bool TestLFUTable();
   bool TestSharedString();
   bool TestCanonicalize();
+  bool TestDBAsync();
+  bool TestAtomicStack();
+  bool TestStreamCompressor();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -48,6 +48,19 @@ inline T atomic_add(T &mem, T val) {
   return r;
 }
 
+template<class T>
+inline bool atomic_cas(T &mem, T oldValue, T newValue) {
+  return __sync_bool_compare_and_swap(&mem, oldValue, newValue);
+}
+
+/**
+ * Stores value and returns what was there before, with acquire semantics.
+ */
+template<class T>
+inline T atomic_swap(T &mem, T value) {
+  return __sync_lock_test_and_set(&mem, value);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
@@ -164,15 +164,18 @@ bool is_compressible_file(const char *filename) {
 // StreamCompressor
 
 StreamCompressor::StreamCompressor(int level, int encoding_mode, bool header)
-  : m_level(level), m_encoding(encoding_mode), m_header(header),
-    m_ended(false) {
+  : m_level(level), m_encoding(encoding_mode), m_gzipHeader(header),
+    m_header(header), m_ended(true) {
   if (level < -1 || level > 9) {
     throw Exception("compression level(%ld) must be within -1..9", level);
   }
   if (encoding_mode != CODING_GZIP && encoding_mode != CODING_DEFLATE) {
     throw Exception("encoding mode must be FORCE_GZIP or FORCE_DEFLATE");
   }
+  init();
+}
 
+void StreamCompressor::init() {
   m_stream.zalloc = Z_NULL;
   m_stream.zfree = Z_NULL;
   m_stream.opaque = Z_NULL;
@@ -185,20 +188,34 @@ StreamCompressor::StreamCompressor(int level, int encoding_mode, bool header)
   m_crc = crc32(0L, Z_NULL, 0);
 
   int status;
-  switch (encoding_mode) {
+  switch (m_encoding) {
   case CODING_GZIP:
     /* windowBits is passed < 0 to suppress zlib header & trailer */
-    if ((status = deflateInit2(&m_stream, level, Z_DEFLATED, -MAX_WBITS,
+    if ((status = deflateInit2(&m_stream, m_level, Z_DEFLATED, -MAX_WBITS,
                                MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY)) != Z_OK) {
       throw Exception("%s", zError(status));
     }
     break;
   case CODING_DEFLATE:
-    if ((status = deflateInit(&m_stream, level)) != Z_OK) {
+    if ((status = deflateInit(&m_stream, m_level)) != Z_OK) {
       throw Exception("%s", zError(status));
     }
     break;
   }
+  m_ended = false;
+}
+
+void StreamCompressor::reset() {
+  m_header = m_gzipHeader;
+  if (m_ended) {
+    init();
+    return;
+  }
+  int status = deflateReset(&m_stream);
+  if (status != Z_OK) {
+    throw Exception("%s", zError(status));
+  }
+  m_crc = crc32(0L, Z_NULL, 0);
 }
 
 StreamCompressor::~StreamCompressor() {
@@ -236,7 +253,10 @@ char *StreamCompressor::compress(const char *data, int &len, bool trailer) {
   }
 
   int status = deflate(&m_stream, trailer ? Z_FINISH : Z_SYNC_FLUSH);
-  if (status == Z_BUF_ERROR || status == Z_STREAM_END) {
+  if (status == Z_STREAM_END) {
+    // keeping the stream for reset()
+    status = Z_OK;
+  } else if (status == Z_BUF_ERROR) {
     status = deflateEnd(&m_stream);
     m_ended = true;
   }
@@ -49,13 +49,24 @@ public:
    */
   char *compress(const char *data, int &len, bool trailer);
 
+  /**
+   * Gets ready for a new stream with same settings, keeping zlib's internal
+   * buffers, so one compressor can serve request after request.
+   */
+  void reset();
+
+  int getLevel() const { return m_level;}
+
 private:
   int m_level;
   int m_encoding;
+  bool m_gzipHeader;
   bool m_header;
   z_stream m_stream;
   uLong m_crc;
   bool m_ended;
+
+  void init();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,704 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "db_async.h"
+#include "logger.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <openssl/sha.h>
+#include <mysql/mysql_com.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+// wire format helpers
+
+#ifndef CLIENT_PLUGIN_AUTH // only in 5.5+ headers
+#define CLIENT_PLUGIN_AUTH       0x00080000
+#endif
+
+#define COM_QUERY_CMD            0x03
+#define MAX_PACKET_SIZE          0xffffff
+#define NATIVE_PASSWORD          "mysql_native_password"
+
+static int64 now_ms() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static unsigned int read_int(const char *p, int bytes) {
+  unsigned int ret = 0;
+  for (int i = 0; i < bytes; i++) {
+    ret |= ((unsigned int)(unsigned char)p[i]) << (i * 8);
+  }
+  return ret;
+}
+
+static void write_int(string &out, unsigned int value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.push_back((char)((value >> (i * 8)) & 0xff));
+  }
+}
+
+/**
+ * Length-encoded integer. Returns false if it runs past end of packet.
+ * "isNull" is set for 0xfb, which only rows use to mark NULL columns.
+ */
+static bool read_lenenc(const char *&p, const char *end, uint64 &value,
+                        bool *isNull = NULL) {
+  if (p >= end) return false;
+  unsigned char c = *p++;
+  int bytes = 0;
+  if (isNull) *isNull = false;
+  if (c < 0xfb) {
+    value = c;
+    return true;
+  }
+  switch (c) {
+  case 0xfb:
+    if (!isNull) return false;
+    *isNull = true;
+    value = 0;
+    return true;
+  case 0xfc: bytes = 2; break;
+  case 0xfd: bytes = 3; break;
+  case 0xfe: bytes = 8; break;
+  default:
+    return false;
+  }
+  if (end - p < bytes) return false;
+  value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= ((uint64)(unsigned char)p[i]) << (i * 8);
+  }
+  p += bytes;
+  return true;
+}
+
+static bool read_lenenc_str(const char *&p, const char *end,
+                            const char *&s, int &len, bool *isNull = NULL) {
+  uint64 value;
+  if (!read_lenenc(p, end, value, isNull)) return false;
+  if ((uint64)(end - p) < value) return false;
+  s = p;
+  len = value;
+  p += value;
+  return true;
+}
+
+/**
+ * SHA1(password) XOR SHA1(scramble + SHA1(SHA1(password)))
+ */
+static string native_password_token(const string &password,
+                                    const string &scramble) {
+  if (password.empty()) return "";
+
+  unsigned char stage1[SHA_DIGEST_LENGTH];
+  unsigned char stage2[SHA_DIGEST_LENGTH];
+  unsigned char token[SHA_DIGEST_LENGTH];
+  SHA1((const unsigned char *)password.data(), password.size(), stage1);
+  SHA1(stage1, SHA_DIGEST_LENGTH, stage2);
+
+  SHA_CTX ctx;
+  SHA1_Init(&ctx);
+  SHA1_Update(&ctx, scramble.data(), scramble.size());
+  SHA1_Update(&ctx, stage2, SHA_DIGEST_LENGTH);
+  SHA1_Final(token, &ctx);
+
+  for (int i = 0; i < SHA_DIGEST_LENGTH; i++) {
+    token[i] ^= stage1[i];
+  }
+  return string((const char *)token, SHA_DIGEST_LENGTH);
+}
+
+static bool parse_ipv4(const string &ip, struct in_addr &addr) {
+  return !ip.empty() && inet_pton(AF_INET, ip.c_str(), &addr) == 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DBAsyncQuery
+
+bool DBAsyncQuery::Supports(ServerDataPtr server) {
+  struct in_addr addr;
+  // hostnames need a blocking DNS lookup, and "localhost" means a unix
+  // domain socket to libmysqlclient
+  return server && parse_ipv4(server->getIP(), addr);
+}
+
+DBAsyncQuery::DBAsyncQuery(ServerDataPtr server, const std::string &sql,
+                           bool retryQueryOnFail, int connectTimeout,
+                           int readTimeout)
+  : m_server(server), m_sql(sql), m_retryQueryOnFail(retryQueryOnFail),
+    m_connectTimeout(connectTimeout), m_readTimeout(readTimeout),
+    m_fd(-1), m_state(Idle), m_deadline(0), m_seq(0), m_sent(0),
+    m_columns(0), m_columnsRead(0), m_unsupported(false), m_affected(-1) {
+  if (m_connectTimeout <= 0) m_connectTimeout = DBConn::DefaultConnectTimeout;
+  if (m_readTimeout <= 0) m_readTimeout = DBConn::DefaultReadTimeout;
+}
+
+DBAsyncQuery::~DBAsyncQuery() {
+  closeSocket();
+}
+
+void DBAsyncQuery::closeSocket() {
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool DBAsyncQuery::start() {
+  ASSERT(m_state == Idle);
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(m_server->getPort());
+  if (!parse_ipv4(m_server->getIP(), sa.sin_addr)) {
+    return unsupported("non-numeric host");
+  }
+
+  m_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_fd < 0) {
+    // most likely out of descriptors, so let threads have a try later
+    return unsupported("socket() failed");
+  }
+  fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  m_input.clear();
+  m_output.clear();
+  m_sent = 0;
+  m_seq = 0;
+  m_state = Connecting;
+  m_deadline = now_ms() + m_connectTimeout;
+
+  if (connect(m_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 &&
+      errno != EINPROGRESS) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "Can't connect to MySQL server on '%s' (%d)",
+             m_server->getIP().c_str(), errno);
+    return fail(buf, true);
+  }
+  return true;
+}
+
+bool DBAsyncQuery::onEvent(bool readable, bool writable) {
+  if (m_state == Connecting) {
+    if (!writable && !readable) return true;
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+    if (err) {
+      char buf[128];
+      snprintf(buf, sizeof(buf), "Can't connect to MySQL server on '%s' (%d)",
+               m_server->getIP().c_str(), err);
+      return fail(buf, true);
+    }
+    m_state = Handshake;
+    // server speaks first, so the greeting may already be there
+    readable = true;
+  }
+
+  if (readable) {
+    char buf[16384];
+    while (true) {
+      ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+      if (n > 0) {
+        m_input.append(buf, n);
+        if (m_state >= Querying) {
+          // like MYSQL_OPT_READ_TIMEOUT, this limits each read, so a big
+          // resultset that keeps streaming in never times out
+          m_deadline = now_ms() + m_readTimeout;
+        }
+        if (n < (ssize_t)sizeof(buf)) break;
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EINTR)) break;
+      // either EOF or a hard error: whatever we have is all we'll get
+      if (!processPackets()) return false;
+      if (m_state == Connecting) return true; // retrying on a new socket
+      return fail(m_state == Handshake ?
+                  "Lost connection to MySQL server at "
+                  "'reading initial communication packet'" :
+                  "Lost connection to MySQL server during query",
+                  m_state < Querying);
+    }
+    if (!processPackets()) return false;
+  }
+
+  // anything queued up by packets just processed goes out right away
+  if (wantWrite()) {
+    ssize_t n = send(m_fd, m_output.data() + m_sent,
+                     m_output.size() - m_sent, MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      return fail("Lost connection to MySQL server during query",
+                  m_state < Querying);
+    }
+    if (n > 0) {
+      m_sent += n;
+      if (m_sent == m_output.size()) {
+        m_output.clear();
+        m_sent = 0;
+      }
+    }
+  }
+  return true;
+}
+
+bool DBAsyncQuery::onTimeout() {
+  if (m_state < Querying) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "Can't connect to MySQL server on '%s' (%d)",
+             m_server->getIP().c_str(), ETIMEDOUT);
+    return fail(buf, true);
+  }
+  return fail("Lost connection to MySQL server during query", false);
+}
+
+bool DBAsyncQuery::processPackets() {
+  // a logical packet longer than 16M is split into 0xffffff-sized pieces,
+  // terminated by a shorter one
+  size_t pos = 0;
+  while (true) {
+    string payload;
+    size_t cur = pos;
+    bool complete = false;
+    while (m_input.size() - cur >= 4) {
+      int len = read_int(m_input.data() + cur, 3);
+      if (m_input.size() - cur - 4 < (size_t)len) break;
+      m_seq = (unsigned char)m_input[cur + 3] + 1;
+      payload.append(m_input.data() + cur + 4, len);
+      cur += 4 + len;
+      if (len < MAX_PACKET_SIZE) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) break;
+    pos = cur;
+    if (!processPacket(payload.data(), payload.size())) {
+      return false;
+    }
+    if (m_state == Connecting) return true; // retrying, m_input was reset
+  }
+  if (pos) m_input.erase(0, pos);
+  return true;
+}
+
+bool DBAsyncQuery::processPacket(const char *p, int len) {
+  switch (m_state) {
+  case Handshake:      return onHandshake(p, len);
+  case Authenticating: return onAuthResult(p, len);
+  case Querying:       return onQueryResult(p, len);
+  case ReadingColumns: return onColumn(p, len);
+  case ReadingRows:    return onRow(p, len);
+  default:
+    break;
+  }
+  return fail("Commands out of sync", false);
+}
+
+static string parse_error_packet(const char *p, int len) {
+  // 0xff, 2-byte errno, optional '#' + 5-byte SQLSTATE, message
+  if (len < 3) return "Unknown MySQL error";
+  p += 3; len -= 3;
+  if (len >= 6 && *p == '#') {
+    p += 6; len -= 6;
+  }
+  return string(p, len);
+}
+
+bool DBAsyncQuery::onHandshake(const char *p, int len) {
+  const char *end = p + len;
+  if (len > 0 && (unsigned char)*p == 0xff) {
+    return fail(parse_error_packet(p, len), true);
+  }
+  if (len < 1 || *p != 10) {
+    return unsupported("handshake protocol version");
+  }
+  p++;
+  const char *version_end = (const char *)memchr(p, 0, end - p);
+  if (!version_end) return fail("Bad handshake", true);
+  p = version_end + 1;
+  if (end - p < 4 + 8 + 1 + 2) return fail("Bad handshake", true);
+  p += 4; // connection id
+  m_scramble.assign(p, 8);
+  p += 9;
+  unsigned int caps = read_int(p, 2);
+  p += 2;
+  if (end - p >= 1 + 2 + 2 + 1 + 10) {
+    p += 3; // charset, status
+    caps |= read_int(p, 2) << 16;
+    p += 2;
+    int authLen = (unsigned char)*p;
+    p += 11;
+    if (caps & CLIENT_SECURE_CONNECTION) {
+      int rest = authLen - 8 > 13 ? authLen - 8 : 13;
+      if (end - p < rest) return fail("Bad handshake", true);
+      m_scramble.append(p, rest);
+      // part 2 is NUL terminated on the wire, but not part of scramble
+      if (!m_scramble.empty() && m_scramble[m_scramble.size() - 1] == '\0') {
+        m_scramble.resize(m_scramble.size() - 1);
+      }
+    }
+  }
+  if (!(caps & CLIENT_PROTOCOL_41) || !(caps & CLIENT_SECURE_CONNECTION)) {
+    return unsupported("pre-4.1 server");
+  }
+  // whatever default plugin the server announces, we always answer with
+  // native password; accounts using other plugins get an auth switch request
+
+  const string &database = m_server->getDatabase();
+  unsigned int flags = CLIENT_LONG_PASSWORD | CLIENT_LONG_FLAG |
+    CLIENT_PROTOCOL_41 | CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION;
+  if (!database.empty()) flags |= CLIENT_CONNECT_WITH_DB;
+  if (caps & CLIENT_PLUGIN_AUTH) flags |= CLIENT_PLUGIN_AUTH;
+
+  string token = native_password_token(m_server->getPassword(), m_scramble);
+  string response;
+  write_int(response, flags, 4);
+  write_int(response, MAX_PACKET_SIZE, 4);
+  response.push_back(8); // latin1, same as libmysqlclient's default
+  response.append(23, '\0');
+  response.append(m_server->getUserName());
+  response.push_back('\0');
+  response.push_back((char)token.size());
+  response.append(token);
+  if (!database.empty()) {
+    response.append(database);
+    response.push_back('\0');
+  }
+  if (flags & CLIENT_PLUGIN_AUTH) {
+    response.append(NATIVE_PASSWORD);
+    response.push_back('\0');
+  }
+
+  m_state = Authenticating;
+  sendPacket(response);
+  return true;
+}
+
+bool DBAsyncQuery::onAuthResult(const char *p, int len) {
+  if (len < 1) return fail("Bad authentication packet", true);
+  unsigned char c = *p;
+  if (c == 0x00) {
+    sendQuery();
+    return true;
+  }
+  if (c == 0xff) {
+    return fail(parse_error_packet(p, len), true);
+  }
+  if (c == 0xfe && len > 1) {
+    // auth switch request: plugin name, then new scramble
+    const char *end = p + len;
+    p++;
+    const char *plugin_end = (const char *)memchr(p, 0, end - p);
+    if (!plugin_end || string(p, plugin_end - p) != NATIVE_PASSWORD) {
+      return unsupported("authentication plugin");
+    }
+    p = plugin_end + 1;
+    m_scramble.assign(p, end - p);
+    if (!m_scramble.empty() && m_scramble[m_scramble.size() - 1] == '\0') {
+      m_scramble.resize(m_scramble.size() - 1);
+    }
+    sendPacket(native_password_token(m_server->getPassword(), m_scramble));
+    return true;
+  }
+  return unsupported("authentication method");
+}
+
+void DBAsyncQuery::sendQuery() {
+  m_state = Querying;
+  m_seq = 0;
+  m_deadline = now_ms() + m_readTimeout;
+  string payload;
+  payload.reserve(m_sql.size() + 1);
+  payload.push_back(COM_QUERY_CMD);
+  payload.append(m_sql);
+  sendPacket(payload);
+}
+
+void DBAsyncQuery::sendPacket(const std::string &payload) {
+  size_t pos = 0;
+  while (true) {
+    size_t len = payload.size() - pos;
+    if (len > MAX_PACKET_SIZE) len = MAX_PACKET_SIZE;
+    write_int(m_output, len, 3);
+    m_output.push_back((char)m_seq++);
+    m_output.append(payload.data() + pos, len);
+    pos += len;
+    if (len < MAX_PACKET_SIZE) break;
+  }
+}
+
+bool DBAsyncQuery::onQueryResult(const char *p, int len) {
+  if (len < 1) return fail("Bad query response", false);
+  unsigned char c = *p;
+  if (c == 0xff) {
+    return fail(parse_error_packet(p, len), false);
+  }
+  const char *end = p + len;
+  if (c == 0x00) {
+    uint64 affected;
+    p++;
+    if (!read_lenenc(p, end, affected)) {
+      return fail("Bad OK packet", false);
+    }
+    return finish(affected);
+  }
+  if (c == 0xfb) {
+    return fail("LOAD DATA LOCAL INFILE is not supported", false);
+  }
+  uint64 columns;
+  if (!read_lenenc(p, end, columns) || columns == 0) {
+    return fail("Bad resultset header", false);
+  }
+  m_columns = columns;
+  m_columnsRead = 0;
+  m_result = DBRawResultPtr(new DBRawResult());
+  m_state = ReadingColumns;
+  return true;
+}
+
+static bool is_eof_packet(const char *p, int len) {
+  return len > 0 && len < 9 && (unsigned char)*p == 0xfe;
+}
+
+bool DBAsyncQuery::onColumn(const char *p, int len) {
+  if (m_columnsRead == m_columns) {
+    if (!is_eof_packet(p, len)) return fail("Bad column list", false);
+    m_state = ReadingRows;
+    return true;
+  }
+  if (len > 0 && (unsigned char)*p == 0xff) {
+    return fail(parse_error_packet(p, len), false);
+  }
+
+  // catalog, schema, table, org_table, name, org_name, fixed fields
+  const char *end = p + len;
+  const char *s; int slen;
+  const char *name = NULL; int nameLen = 0;
+  for (int i = 0; i < 6; i++) {
+    if (!read_lenenc_str(p, end, s, slen)) {
+      return fail("Bad column definition", false);
+    }
+    if (i == 4) {
+      name = s;
+      nameLen = slen;
+    }
+  }
+  // 0x0c, charset(2), length(4), type(1)
+  if (end - p < 8) return fail("Bad column definition", false);
+  enum_field_types type = (enum_field_types)(unsigned char)p[7];
+  m_result->addField(string(name, nameLen), type);
+  m_columnsRead++;
+  return true;
+}
+
+bool DBAsyncQuery::onRow(const char *p, int len) {
+  if (is_eof_packet(p, len)) {
+    // same as mysql_affected_rows() after mysql_store_result()
+    return finish(m_result->getRowCount());
+  }
+  if (len > 0 && (unsigned char)*p == 0xff) {
+    return fail(parse_error_packet(p, len), false);
+  }
+  const char *end = p + len;
+  for (int i = 0; i < m_columns; i++) {
+    const char *s; int slen; bool isNull;
+    if (!read_lenenc_str(p, end, s, slen, &isNull)) {
+      return fail("Bad row packet", false);
+    }
+    m_result->addValue(isNull ? NULL : s, slen);
+  }
+  m_result->endRow();
+  return true;
+}
+
+bool DBAsyncQuery::fail(const std::string &msg, bool connecting) {
+  closeSocket();
+  if (m_retryQueryOnFail && !connecting && m_state != Done) {
+    // same as DBConn::execute(): reconnect and retry exactly once
+    m_retryQueryOnFail = false;
+    m_result.reset();
+    m_state = Idle;
+    return start();
+  }
+
+  char buf[1024];
+  if (connecting) {
+    snprintf(buf, sizeof(buf), "Failed to connect to %s %s: %s",
+             m_server->getIP().c_str(), m_server->getDatabase().c_str(),
+             msg.c_str());
+  } else {
+    snprintf(buf, sizeof(buf), "Failed to execute SQL '%s': %s",
+             m_sql.c_str(), msg.c_str());
+  }
+  m_error = buf;
+  m_affected = -1;
+  m_result.reset();
+  m_state = Done;
+  return false;
+}
+
+bool DBAsyncQuery::unsupported(const char *what) {
+  closeSocket();
+  m_unsupported = true;
+  m_error = what;
+  m_state = Done;
+  return false;
+}
+
+bool DBAsyncQuery::finish(int affected) {
+  closeSocket();
+  m_affected = affected;
+  m_state = Done;
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DBAsyncExecutor
+
+void DBAsyncExecutor::Run(DBAsyncQueryPtrVec &queries, int maxConnections) {
+  if (queries.empty()) return;
+  if (maxConnections <= 0) maxConnections = queries.size();
+
+  int epfd = epoll_create(maxConnections);
+  if (epfd < 0) {
+    Logger::Error("epoll_create() failed: %d", errno);
+    for (unsigned int i = 0; i < queries.size(); i++) {
+      queries[i]->unsupported("epoll_create() failed");
+    }
+    return;
+  }
+
+  // fd => query index, so a retried query registers its new socket
+  map<int, int> active;
+  unsigned int next = 0;
+  vector<struct epoll_event> events(maxConnections);
+  vector<int> touched;
+
+  // earliest deadline of all active queries, only recomputed by a full scan
+  // when it passes, so each iteration costs O(events) instead of O(active)
+  int64 deadline = -1;
+
+  while (true) {
+    while ((int)active.size() < maxConnections && next < queries.size()) {
+      DBAsyncQuery *q = queries[next].get();
+      if (q->start()) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = next;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, q->m_fd, &ev);
+        active[q->m_fd] = next;
+        if (deadline < 0 || q->m_deadline < deadline) {
+          deadline = q->m_deadline;
+        }
+      }
+      next++;
+    }
+    if (active.empty()) break;
+
+    int64 now = now_ms();
+    int wait = deadline > now ? deadline - now : 0;
+    int n = epoll_wait(epfd, &events[0], events.size(), wait);
+    if (n < 0 && errno != EINTR) {
+      Logger::Error("epoll_wait() failed: %d", errno);
+      break;
+    }
+
+    touched.clear();
+    for (int i = 0; i < n; i++) {
+      int index = events[i].data.u32;
+      DBAsyncQuery *q = queries[index].get();
+      int fd = q->m_fd;
+      if (fd < 0) continue;
+      bool error = events[i].events & (EPOLLERR | EPOLLHUP);
+      q->onEvent((events[i].events & EPOLLIN) || error,
+                 (events[i].events & EPOLLOUT) || error);
+      touched.push_back(fd);
+    }
+
+    now = now_ms();
+    if (deadline >= 0 && deadline <= now) {
+      deadline = -1;
+      for (map<int, int>::iterator iter = active.begin();
+           iter != active.end(); ++iter) {
+        DBAsyncQuery *q = queries[iter->second].get();
+        if (q->isDone() || q->m_fd != iter->first) continue;
+        if (q->m_deadline <= now) {
+          q->onTimeout();
+          touched.push_back(iter->first);
+        } else if (deadline < 0 || q->m_deadline < deadline) {
+          deadline = q->m_deadline;
+        }
+      }
+    }
+
+    // re-register everything whose socket or interest set changed
+    for (unsigned int i = 0; i < touched.size(); i++) {
+      map<int, int>::iterator iter = active.find(touched[i]);
+      if (iter == active.end()) continue;
+      int index = iter->second;
+      DBAsyncQuery *q = queries[index].get();
+      if (q->m_fd != iter->first) {
+        // closing a descriptor removes it from epoll set automatically
+        active.erase(iter);
+        if (q->m_fd >= 0) {
+          active[q->m_fd] = index;
+        } else {
+          continue;
+        }
+      }
+      if (deadline < 0 || q->m_deadline < deadline) {
+        deadline = q->m_deadline;
+      }
+      struct epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      if (q->m_state == DBAsyncQuery::Connecting || q->wantWrite()) {
+        ev.events |= EPOLLOUT;
+      }
+      ev.data.u32 = index;
+      if (epoll_ctl(epfd, EPOLL_CTL_MOD, q->m_fd, &ev) < 0) {
+        epoll_ctl(epfd, EPOLL_CTL_ADD, q->m_fd, &ev);
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < queries.size(); i++) {
+    if (!queries[i]->isDone()) {
+      queries[i]->m_retryQueryOnFail = false;
+      queries[i]->fail("Lost connection to MySQL server during query", false);
+    }
+  }
+  close(epfd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
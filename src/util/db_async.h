@@ -0,0 +1,140 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __DB_ASYNC_H__
+#define __DB_ASYNC_H__
+
+#include "db_conn.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * One query that is executed by DBAsyncExecutor. The protocol is spoken
+ * directly over a non-blocking socket, so only the subset of MySQL that
+ * parallel queries need is understood: TCP connection to a numeric IPv4
+ * address, mysql_native_password authentication, COM_QUERY and text
+ * resultsets. When a server asks for anything else, the query is marked
+ * unsupported before any SQL is sent, and caller can retry it with
+ * libmysqlclient.
+ */
+DECLARE_BOOST_TYPES(DBAsyncQuery);
+class DBAsyncQuery {
+public:
+  /**
+   * Whether this server can be reached without libmysqlclient at all.
+   */
+  static bool Supports(ServerDataPtr server);
+
+public:
+  DBAsyncQuery(ServerDataPtr server, const std::string &sql,
+               bool retryQueryOnFail, int connectTimeout, int readTimeout);
+  ~DBAsyncQuery();
+
+  bool isDone() const { return m_state == Done;}
+  bool isUnsupported() const { return m_unsupported;}
+
+  /**
+   * Number of affected rows (or returned rows for SELECTs), -1 on failure.
+   */
+  int getAffected() const { return m_affected;}
+  const std::string &getError() const { return m_error;}
+  DBRawResultPtr getResult() const { return m_result;}
+
+private:
+  friend class DBAsyncExecutor;
+
+  enum State {
+    Idle,
+    Connecting,
+    Handshake,
+    Authenticating,
+    Querying,
+    ReadingColumns,
+    ReadingRows,
+    Done,
+  };
+
+  ServerDataPtr m_server;
+  std::string m_sql;
+  bool m_retryQueryOnFail;
+  int m_connectTimeout; // ms
+  int m_readTimeout;    // ms
+
+  int m_fd;
+  State m_state;
+  int64 m_deadline;     // ms since epoch
+  unsigned char m_seq;  // packet sequence id
+  std::string m_scramble;
+  std::string m_input;
+  std::string m_output;
+  size_t m_sent;
+  int m_columns;
+  int m_columnsRead;
+
+  bool m_unsupported;
+  int m_affected;
+  std::string m_error;
+  DBRawResultPtr m_result;
+
+  /**
+   * Starts connecting. Returns false when the query is already finished.
+   */
+  bool start();
+
+  /**
+   * Called when the socket is readable/writable or deadline expired.
+   * Returns false when the query is finished.
+   */
+  bool onEvent(bool readable, bool writable);
+  bool onTimeout();
+  bool wantWrite() const { return m_sent < m_output.size();}
+
+  bool onConnected();
+  bool processPackets();
+  bool processPacket(const char *p, int len);
+  bool onHandshake(const char *p, int len);
+  bool onAuthResult(const char *p, int len);
+  bool onQueryResult(const char *p, int len);
+  bool onColumn(const char *p, int len);
+  bool onRow(const char *p, int len);
+
+  void sendPacket(const std::string &payload);
+  void sendQuery();
+  void closeSocket();
+
+  bool fail(const std::string &msg, bool connecting);
+  bool unsupported(const char *what);
+  bool finish(int affected);
+};
+
+/**
+ * Drives a set of DBAsyncQuery objects to completion from calling thread,
+ * multiplexing all sockets over one epoll descriptor.
+ */
+class DBAsyncExecutor {
+public:
+  /**
+   * Runs all queries, keeping at most maxConnections of them in flight.
+   * Upon return every query is either done or unsupported.
+   */
+  static void Run(DBAsyncQueryPtrVec &queries, int maxConnections);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __DB_ASYNC_H__
@@ -15,6 +15,7 @@
 */
 
 #include "db_conn.h"
+#include "db_async.h"
 #include "db_query.h"
 #include "db_mysql.h"
 #include "exception.h"
@@ -97,6 +98,8 @@ const std::string &ServerData::getPassword() const {
 unsigned int DBConn::DefaultWorkerCount = 50;
 unsigned int DBConn::DefaultConnectTimeout = 1000;
 unsigned int DBConn::DefaultReadTimeout = 1000;
+bool DBConn::AsyncEnabled = false;
+unsigned int DBConn::AsyncMaxConnections = 1000;
 
 Mutex DBConn::s_mutex;
 ServerDataPtrVec DBConn::s_localDatabases;
@@ -305,8 +308,17 @@ int DBConn::parallelExecute(const ServerQueryVec &sqls,
 
 int DBConn::parallelExecute(QueryJobPtrVec &jobs,
                             map<int, string> &errors, int maxThread) {
-  if (maxThread <= 0) maxThread = DefaultWorkerCount;
-  JobDispatcher<QueryJob, QueryWorker>(jobs, maxThread).run();
+  if (AsyncEnabled) {
+    QueryJobPtrVec remaining;
+    asyncExecute(jobs, remaining);
+    if (!remaining.empty()) {
+      if (maxThread <= 0) maxThread = DefaultWorkerCount;
+      JobDispatcher<QueryJob, QueryWorker>(remaining, maxThread).run();
+    }
+  } else {
+    if (maxThread <= 0) maxThread = DefaultWorkerCount;
+    JobDispatcher<QueryJob, QueryWorker>(jobs, maxThread).run();
+  }
 
   int affected = 0;
   for (unsigned int i = 0; i < jobs.size(); i++) {
@@ -322,6 +334,43 @@ int DBConn::parallelExecute(QueryJobPtrVec &jobs,
   return affected;
 }
 
+void DBConn::asyncExecute(QueryJobPtrVec &jobs, QueryJobPtrVec &remaining) {
+  QueryJobPtrVec asyncJobs;
+  DBAsyncQueryPtrVec queries;
+  for (unsigned int i = 0; i < jobs.size(); i++) {
+    QueryJobPtr job = jobs[i];
+    if (!DBAsyncQuery::Supports(job->m_server)) {
+      remaining.push_back(job);
+      continue;
+    }
+    Util::replaceAll(job->m_sql, "INDEX",
+                     lexical_cast<string>(job->m_index).c_str());
+    asyncJobs.push_back(job);
+    queries.push_back(DBAsyncQueryPtr
+                      (new DBAsyncQuery(job->m_server, job->m_sql,
+                                        job->m_retryQueryOnFail,
+                                        job->m_connectTimeout,
+                                        job->m_readTimeout)));
+  }
+
+  DBAsyncExecutor::Run(queries, AsyncMaxConnections);
+
+  for (unsigned int i = 0; i < asyncJobs.size(); i++) {
+    QueryJobPtr job = asyncJobs[i];
+    DBAsyncQueryPtr query = queries[i];
+    if (query->isUnsupported()) {
+      remaining.push_back(job);
+      continue;
+    }
+    job->m_affected = query->getAffected();
+    if (job->m_affected < 0) {
+      job->m_error = query->getError();
+    } else if (job->m_dsResult && query->getResult()) {
+      job->m_dsResult->addResult(query->getResult());
+    }
+  }
+}
+
 void DBConn::QueryWorker::doJob(QueryJobPtr job) {
   string &sql = job->m_sql;
   Util::replaceAll(sql, "INDEX", lexical_cast<string>(job->m_index).c_str());
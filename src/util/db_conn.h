@@ -73,6 +73,13 @@ class DBConn {
   static unsigned int DefaultConnectTimeout;
   static unsigned int DefaultReadTimeout;
 
+  /**
+   * Whether parallelExecute() talks to IPv4 servers over non-blocking
+   * sockets from calling thread, instead of one worker thread per query.
+   */
+  static bool AsyncEnabled;
+  static unsigned int AsyncMaxConnections;
+
  public:
   DBConn();
   ~DBConn();
@@ -179,6 +186,12 @@ class DBConn {
   static int parallelExecute(QueryJobPtrVec &jobs,
                              std::map<int, std::string> &errors,
                              int maxThread);
+
+  /**
+   * Runs what it can with DBAsyncExecutor, and returns the rest in
+   * "remaining" for worker threads.
+   */
+  static void asyncExecute(QueryJobPtrVec &jobs, QueryJobPtrVec &remaining);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -18,9 +18,49 @@
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
+// DBRawResult
+
+void DBRawResult::addField(const std::string &name, enum_field_types type) {
+  ASSERT(m_rowCount == 0);
+  m_names.push_back(name);
+  MYSQL_FIELD field;
+  memset(&field, 0, sizeof(field));
+  field.name = (char*)m_names.back().c_str();
+  field.name_length = name.size();
+  field.type = type;
+  m_fields.push_back(field);
+}
+
+void DBRawResult::addValue(const char *data, int len) {
+  if (data) {
+    m_offsets.push_back(m_data.size());
+    m_data.append(data, len);
+    m_data.push_back('\0');
+    m_lengths.push_back(len);
+  } else {
+    m_offsets.push_back(-1);
+    m_lengths.push_back(0);
+  }
+}
+
+void DBRawResult::fetchRow(int row, MYSQL_ROW &out,
+                           unsigned long *&lengths) {
+  ASSERT(row >= 0 && row < m_rowCount);
+  int cols = m_fields.size();
+  m_row.resize(cols);
+  for (int i = 0; i < cols; i++) {
+    int offset = m_offsets[row * cols + i];
+    m_row[i] = offset < 0 ? NULL : (char*)m_data.data() + offset;
+  }
+  out = &m_row[0];
+  lengths = &m_lengths[row * cols];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DBDataSet
 
 DBDataSet::DBDataSet()
-  : m_fields(NULL), m_rowCount(0), m_colCount(0),
+  : m_fields(NULL), m_rowCount(0), m_colCount(0), m_rawRow(0),
     m_row(NULL), m_lengths(NULL) {
 }
 
@@ -33,16 +73,7 @@ void DBDataSet::addResult(MYSQL *conn, MYSQL_RES *result) {
 
   int rowCount = mysql_num_rows(result);
   if (rowCount) {
-    int fieldCount = (int)mysql_field_count(conn);
-    if (m_colCount == 0) {
-      m_colCount = fieldCount;
-    } else {
-      ASSERT(m_colCount == fieldCount);
-      if (m_colCount > fieldCount) {
-        m_colCount = fieldCount; // in case we overflow m_row later
-      }
-    }
-
+    updateColCount((int)mysql_field_count(conn));
     m_rowCount += rowCount;
     m_results.push_back(result);
   } else {
@@ -50,8 +81,28 @@ void DBDataSet::addResult(MYSQL *conn, MYSQL_RES *result) {
   }
 }
 
+void DBDataSet::addResult(DBRawResultPtr result) {
+  int rowCount = result->getRowCount();
+  if (rowCount) {
+    updateColCount(result->getColCount());
+    m_rowCount += rowCount;
+    m_rawResults.push_back(result);
+  }
+}
+
+void DBDataSet::updateColCount(int fieldCount) {
+  if (m_colCount == 0) {
+    m_colCount = fieldCount;
+  } else {
+    ASSERT(m_colCount == fieldCount);
+    if (m_colCount > fieldCount) {
+      m_colCount = fieldCount; // in case we overflow m_row later
+    }
+  }
+}
+
 void DBDataSet::addDataSet(DBDataSet &ds) {
-  if (ds.m_results.empty()) return;
+  if (ds.m_results.empty() && ds.m_rawResults.empty()) return;
 
   if (m_colCount == 0) {
     m_colCount = ds.m_colCount;
@@ -61,6 +112,8 @@ void DBDataSet::addDataSet(DBDataSet &ds) {
 
   m_rowCount += ds.m_rowCount;
   m_results.insert(m_results.end(), ds.m_results.begin(), ds.m_results.end());
+  m_rawResults.insert(m_rawResults.end(), ds.m_rawResults.begin(),
+                      ds.m_rawResults.end());
   ds.m_results.clear();
   ds.close();
 }
@@ -70,6 +123,7 @@ void DBDataSet::close() {
     mysql_free_result(*m_iter);
   }
   m_results.clear();
+  m_rawResults.clear();
   m_fields = NULL;
   m_row = NULL;
   m_lengths = NULL;
@@ -83,11 +137,7 @@ int DBDataSet::getFieldIndex(const char *fieldName) {
   ASSERT(fieldName && *fieldName);
 
   // without any results, cannot really resolve field names
-  if (m_results.empty()) return -1;
-
-  if (m_fields == NULL) {
-    m_fields = mysql_fetch_fields(m_results.front());
-  }
+  if (getFields() == NULL) return -1;
 
   for (int i = 0; i < m_colCount; i++) {
     if (strcmp(m_fields[i].name, fieldName) == 0) {
@@ -98,8 +148,12 @@ int DBDataSet::getFieldIndex(const char *fieldName) {
 }
 
 MYSQL_FIELD *DBDataSet::getFields() const {
-  if (m_fields == NULL && !m_results.empty()) {
-    m_fields = mysql_fetch_fields(m_results.front());
+  if (m_fields == NULL) {
+    if (!m_results.empty()) {
+      m_fields = mysql_fetch_fields(m_results.front());
+    } else if (!m_rawResults.empty()) {
+      m_fields = m_rawResults.front()->getFields();
+    }
   }
   return m_fields;
 }
@@ -117,12 +171,33 @@ void DBDataSet::moveFirst() {
       return;
     }
   }
+  seekRaw(m_rawResults.begin());
+}
+
+void DBDataSet::seekRaw(DBRawResultPtrList::const_iterator iter) {
+  for (m_rawIter = iter; m_rawIter != m_rawResults.end(); ++m_rawIter) {
+    if ((*m_rawIter)->getRowCount() > 0) {
+      m_rawRow = 0;
+      (*m_rawIter)->fetchRow(0, m_row, m_lengths);
+      return;
+    }
+  }
   m_row = NULL;
   m_lengths = NULL;
 }
 
 void DBDataSet::moveNext() {
-  if (m_iter != m_results.end()) {
+  if (m_iter == m_results.end()) {
+    if (m_rawIter != m_rawResults.end()) {
+      if (++m_rawRow < (*m_rawIter)->getRowCount()) {
+        (*m_rawIter)->fetchRow(m_rawRow, m_row, m_lengths);
+      } else {
+        DBRawResultPtrList::const_iterator next = m_rawIter;
+        seekRaw(++next);
+      }
+      return;
+    }
+  } else {
     if (*m_iter) {
       m_row = mysql_fetch_row(*m_iter);
       m_lengths = mysql_fetch_lengths(*m_iter);
@@ -138,6 +213,8 @@ void DBDataSet::moveNext() {
         return;
       }
     }
+    seekRaw(m_rawResults.begin());
+    return;
   }
   m_row = NULL;
   m_lengths = NULL;
@@ -24,6 +24,35 @@ namespace HPHP {
 DECLARE_BOOST_TYPES(DBDataSet);
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A result set read off the wire by DBAsyncQuery instead of libmysqlclient.
+ * Field values are NUL-terminated and packed into one buffer, and rows are
+ * handed out as MYSQL_ROW and length arrays, just like a MYSQL_RES does.
+ */
+DECLARE_BOOST_TYPES(DBRawResult);
+class DBRawResult {
+ public:
+  DBRawResult() : m_rowCount(0) {}
+
+  void addField(const std::string &name, enum_field_types type);
+  void addValue(const char *data, int len); // data == NULL for SQL NULL
+  void endRow() { ++m_rowCount;}
+
+  int getRowCount() const { return m_rowCount;}
+  int getColCount() const { return m_fields.size();}
+  MYSQL_FIELD *getFields() { return &m_fields[0];}
+  void fetchRow(int row, MYSQL_ROW &out, unsigned long *&lengths);
+
+ private:
+  std::vector<MYSQL_FIELD> m_fields;
+  std::list<std::string> m_names; // stable storage for MYSQL_FIELD::name
+  std::string m_data;
+  std::vector<int> m_offsets;    // offset into m_data, or -1 for NULL
+  std::vector<unsigned long> m_lengths;
+  std::vector<char *> m_row;
+  int m_rowCount;
+};
+
 /**
  * A DataSet that wraps a result set directly from an SQL query.
  */
@@ -36,6 +65,7 @@ class DBDataSet : public DataSet {
    * Internally called by DBConn::Execute() to prepare a DBDataSet.
    */
   void addResult(MYSQL *conn, MYSQL_RES *result);
+  void addResult(DBRawResultPtr result);
 
   /**
    * Merge ds into this, and clear ds.
@@ -61,14 +91,20 @@ class DBDataSet : public DataSet {
 
   typedef std::list<MYSQL_RES*> ResultList;
   ResultList m_results;
+  DBRawResultPtrList m_rawResults; // iterated after m_results
   mutable MYSQL_FIELD *m_fields;
 
   int m_rowCount;
   int m_colCount;
 
   ResultList::const_iterator m_iter;
+  DBRawResultPtrList::const_iterator m_rawIter;
+  int m_rawRow;
   MYSQL_ROW m_row;
   unsigned long *m_lengths;
+
+  void updateColCount(int fieldCount);
+  void seekRaw(DBRawResultPtrList::const_iterator iter);
 };
 
 ///////////////////////////////////////////////////////////////////////////////